@@ -21,6 +21,7 @@
 
 #include <stdexcept>
 #include <map>
+#include <mutex>
 #include <cassert>
 #include "cmsat.h"
 
@@ -244,51 +245,56 @@ APList<Var>::apply_variables(const std::set<Var> &vs,const pred_set &ps){
 template<class Var> typename APList<Var>::TrivialType APList<Var>::trivial(const Predicate &p){
 
   static typename std::map<Predicate,TrivialType> trivial_cache;
+  static std::mutex trivial_cache_mutex; // Guards trivial_cache
 
-  typename std::map<Predicate,TrivialType>::iterator it = trivial_cache.find(p);
-
-  if(it == trivial_cache.end()){
+  {
+    std::lock_guard<std::mutex> lock(trivial_cache_mutex);
+    typename std::map<Predicate,TrivialType>::iterator it = trivial_cache.find(p);
+    if(it != trivial_cache.end()){
+      return it->second;
+    }
+  }
 
 #if MATHSAT_VERSION == 4
-    MSat::msat_env env = MSat::msat_create_env();
-    MSat::msat_add_theory(env,MSat::MSAT_IDL);
+  MSat::msat_env env = MSat::msat_create_env();
+  MSat::msat_add_theory(env,MSat::MSAT_IDL);
 #elif MATHSAT_VERSION == 5
-    MSat::msat_config cfg = MSat::msat_create_config();
-    MSat::msat_env env = MSat::msat_create_env(cfg);
+  MSat::msat_config cfg = MSat::msat_create_config();
+  MSat::msat_env env = MSat::msat_create_env(cfg);
 #endif
-    std::map<Var,MSat::msat_decl> vd_map;
+  std::map<Var,MSat::msat_decl> vd_map;
 
 
-    MSat::msat_push_backtrack_point(env);
-    MSat::msat_assert_formula(env,p.to_msat_term(env,vd_map,std::mem_fun_ref(&Var::to_raw_string)));
+  MSat::msat_push_backtrack_point(env);
+  MSat::msat_assert_formula(env,p.to_msat_term(env,vd_map,std::mem_fun_ref(&Var::to_raw_string)));
 
-    MSat::msat_result res = MSat::msat_solve(env);
+  MSat::msat_result res = MSat::msat_solve(env);
 
-    if(res == MSat::MSAT_UNSAT){
-      MSat::msat_destroy_env(env);
+  if(res == MSat::MSAT_UNSAT){
+    MSat::msat_destroy_env(env);
 #if MATHSAT_VERSION == 5
-      MSat::msat_destroy_config(cfg);
+    MSat::msat_destroy_config(cfg);
 #endif
-      trivial_cache.insert(std::pair<Predicate,TrivialType>(p,CONTRADICTION));
-      return CONTRADICTION;
-    }else{
-      MSat::msat_pop_backtrack_point(env);
-      MSat::msat_assert_formula(env,Predicate::neg(p).to_msat_term(env,vd_map,std::mem_fun_ref(&Var::to_raw_string)));
-      res = MSat::msat_solve(env);
-      MSat::msat_destroy_env(env);
+    std::lock_guard<std::mutex> lock(trivial_cache_mutex);
+    trivial_cache.insert(std::pair<Predicate,TrivialType>(p,CONTRADICTION));
+    return CONTRADICTION;
+  }else{
+    MSat::msat_pop_backtrack_point(env);
+    MSat::msat_assert_formula(env,Predicate::neg(p).to_msat_term(env,vd_map,std::mem_fun_ref(&Var::to_raw_string)));
+    res = MSat::msat_solve(env);
+    MSat::msat_destroy_env(env);
 #if MATHSAT_VERSION == 5
-      MSat::msat_destroy_config(cfg);
+    MSat::msat_destroy_config(cfg);
 #endif
-      if(res == MSat::MSAT_UNSAT){
-        trivial_cache.insert(std::pair<Predicate,TrivialType>(p,TAUTOLOGY));
-        return TAUTOLOGY;
-      }else{
-        trivial_cache.insert(std::pair<Predicate,TrivialType>(p,UNKNOWN));
-        return UNKNOWN;
-      }
+    if(res == MSat::MSAT_UNSAT){
+      std::lock_guard<std::mutex> lock(trivial_cache_mutex);
+      trivial_cache.insert(std::pair<Predicate,TrivialType>(p,TAUTOLOGY));
+      return TAUTOLOGY;
+    }else{
+      std::lock_guard<std::mutex> lock(trivial_cache_mutex);
+      trivial_cache.insert(std::pair<Predicate,TrivialType>(p,UNKNOWN));
+      return UNKNOWN;
     }
-  }else{
-    return it->second;
   }
 };
 
@@ -24,15 +24,17 @@
 #include "parser.h"
 #include "test.h"
 
+#include <atomic>
 #include <functional>
 #include <sstream>
 
-Automaton::Automaton(){
-  states.resize(1);
+Automaton::Automaton() : body(new Body()) {
+  body->states.resize(1);
 }
 
-Automaton::Automaton(const Lang::Stmt<int> &ast) :
-  states(), label_map() {
+Automaton::Automaton(const Lang::Stmt<int> &ast) : body(new Body()) {
+  std::vector<State> &states = body->states;
+  std::map<Lang::label_t,int> &label_map = body->label_map;
   states.push_back(State());
   unsat_goto_t unsat_goto; // Collect forward gotos here
   construct_from_ast(ast,unsat_goto);
@@ -63,18 +65,12 @@ Automaton::Automaton(const Lang::Stmt<int> &ast) :
   check_fwd_bwd_consistency();
 }
 
-void Automaton::clear_and_copy(const Automaton &a){
-  /* clear */
-  dealloc();
-  label_map.clear();
-  states.clear();
-
-  /* copy */
-  label_map = a.label_map;
-  for(unsigned i = 0; i < a.states.size(); i++){
+Automaton::Body::Body(const Body &b){
+  label_map = b.label_map;
+  for(unsigned i = 0; i < b.states.size(); i++){
     State st;
-    for(std::set<Transition*>::const_iterator it = a.states[i].fwd_transitions.begin();
-        it != a.states[i].fwd_transitions.end(); it++){
+    for(std::set<Transition*>::const_iterator it = b.states[i].fwd_transitions.begin();
+        it != b.states[i].fwd_transitions.end(); it++){
       Transition *tr = new Transition((*it)->source,(*it)->instruction,(*it)->target);
       st.fwd_transitions.insert(tr);
     }
@@ -87,22 +83,29 @@ void Automaton::clear_and_copy(const Automaton &a){
       states[j].bwd_transitions.insert(*it);
     }
   }
-
-  check_fwd_bwd_consistency();
 }
 
-Automaton::Automaton(const Automaton &a){
-  clear_and_copy(a);
+Automaton::Automaton(const Automaton &a) : body(a.body) {
 }
 
 Automaton &Automaton::operator=(const Automaton &a){
-  if(&a != this)
-    clear_and_copy(a);
+  body = a.body;
   return *this;
 }
 
+void Automaton::detach(){
+  /* If body is not shared, then no other automaton can start sharing
+   * it concurrently, since that would require copying this automaton
+   * while it is being modified. */
+  if(body.use_count() > 1){
+    body = std::make_shared<Body>(*body);
+  }
+}
+
 void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsat_goto,
                                    int source){
+  std::vector<State> &states = body->states;
+  std::map<Lang::label_t,int> &label_map = body->label_map;
   switch(ast.get_type()){
   case Lang::NOP: case Lang::ASSIGNMENT: case Lang::ASSUME:
   case Lang::READASSERT: case Lang::READASSIGN: case Lang::WRITE:
@@ -131,7 +134,7 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
       for(std::map<Lang::label_t,int>::iterator it = label_map.begin();
           it != label_map.end(); it++){
         if(it->second == i){
-          dealloc();
+          body->dealloc();
           std::string str = "Label ";
           throw new LabeledGoto(str+(it->first)+" at goto statement "+
                                 ast.to_string(Lang::int_reg_to_string(),
@@ -200,7 +203,7 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
       Lang::label_t then_label = ast.get_then_label();
       if(then_label != ""){
         if(label_map.count(then_label)){
-          dealloc();
+          body->dealloc();
           throw new RedefinedLabel("Label "+then_label+" redefined in the same process.");
         }
         label_map[then_label] = then_state;
@@ -213,7 +216,7 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
         Lang::label_t else_label = ast.get_else_label();
         if(else_label != ""){
           if(label_map.count(else_label)){
-            dealloc();
+            body->dealloc();
             throw new RedefinedLabel("Label "+else_label+" redefined in the same process.");
           }
           label_map[else_label] = else_state;
@@ -247,7 +250,7 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
       Lang::label_t label = ast.get_label();
       if(label != ""){
         if(label_map.count(label)){
-          dealloc();
+          body->dealloc();
           throw new RedefinedLabel("Label "+label+" redefined in the same process.");
         }
         label_map[label] = i+1;
@@ -310,7 +313,7 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
         Lang::label_t lbl = ast.get_label(j);
         if(lbl != ""){
           if(label_map.count(lbl)){ // Already defined
-            dealloc();
+            body->dealloc();
             throw new RedefinedLabel("Label "+lbl+" redefined in the same process.");
           }
 
@@ -335,16 +338,16 @@ void Automaton::construct_from_ast(const Lang::Stmt<int> &ast,unsat_goto_t &unsa
   }
 }
 
-void Automaton::dealloc(){
+void Automaton::Body::dealloc(){
   for(unsigned i = 0; i < states.size(); i++){
     for(std::set<Transition*>::iterator it = states[i].fwd_transitions.begin();
         it != states[i].fwd_transitions.end(); it++)
       delete(*it);
   }
+  states.clear();
 }
 
 Automaton::~Automaton(){
-  dealloc();
 }
 
 std::string Automaton::Transition::to_string(const std::function<std::string(const int&)> &regts,
@@ -359,6 +362,8 @@ std::string Automaton::Transition::to_string(const std::function<std::string(con
 std::string Automaton::to_string(const std::function<std::string(const int&)> &regts,
                                  const std::function<std::string(const Lang::MemLoc<int> &)> &mlts,
                                  int indentation) const throw(){
+  const std::vector<State> &states = body->states;
+  const std::map<Lang::label_t,int> &label_map = body->label_map;
   std::string s;
   std::string ind(indentation,' ');
   for(auto it = label_map.begin(); it != label_map.end(); ++it){
@@ -376,6 +381,7 @@ std::string Automaton::to_string(const std::function<std::string(const int&)> &r
 }
 
 void Automaton::check_fwd_bwd_consistency() const throw(Exception*){
+  const std::vector<State> &states = body->states;
   std::string complaint = "Automaton::check_fwd_bwd_consistency: "
     "Forward and backward transitions are inconsistent.";
   for(unsigned i = 0; i < states.size(); i++){
@@ -395,6 +401,7 @@ void Automaton::check_fwd_bwd_consistency() const throw(Exception*){
 }
 
 int Automaton::state_index_of_label(Lang::label_t lbl) const throw(UnDefinedLabel*){
+  const std::map<Lang::label_t,int> &label_map = body->label_map;
   if(label_map.count(lbl))
     return (label_map.find(lbl))->second;
   else
@@ -403,9 +410,11 @@ int Automaton::state_index_of_label(Lang::label_t lbl) const throw(UnDefinedLabe
 
 std::string Automaton::to_dot(const std::function<std::string(const int&)> &regts,
                               const std::function<std::string(const Lang::MemLoc<int> &)> &mlts) const throw(){
-  static int gv_id = 0; // Used in names for nodes to ensure uniqueness
+  const std::vector<State> &states = body->states;
+  const std::map<Lang::label_t,int> &label_map = body->label_map;
+  static std::atomic<int> next_gv_id(0); // Used in names for nodes to ensure uniqueness
 
-  gv_id++;
+  int gv_id = ++next_gv_id;
   std::stringstream ss;
   for(unsigned i = 0; i < states.size(); i++){
     std::string labels = "";
@@ -426,6 +435,7 @@ std::string Automaton::to_dot(const std::function<std::string(const int&)> &regt
 }
 
 std::list<Lang::MemLoc<int> > Automaton::get_possible_writes() const{
+  const std::vector<State> &states = body->states;
   std::list<Lang::MemLoc<int> > mls;
   for(unsigned i = 0; i < states.size(); i++){
     for(std::set<Transition*>::const_iterator it = states[i].fwd_transitions.begin();
@@ -441,6 +451,8 @@ std::list<Lang::MemLoc<int> > Automaton::get_possible_writes() const{
 }
 
 bool Automaton::add_transition(const Transition &t){
+  detach();
+  std::vector<State> &states = body->states;
   int max_state = std::max(t.source,t.target);
   if(int(states.size()) <= max_state){
     states.resize(max_state+1);
@@ -464,6 +476,8 @@ bool Automaton::add_transition(const Transition &t){
 }
 
 bool Automaton::del_transition(const Transition &targ){
+  detach();
+  std::vector<State> &states = body->states;
   Transition t = targ;
 
   if(t.source >= int(states.size()) || t.target >= int(states.size())) return false;
@@ -503,6 +517,7 @@ bool Automaton::del_transition(const Transition &targ){
 };
 
 int Automaton::get_transition_count() const{
+  const std::vector<State> &states = body->states;
   int tc = 0;
   for(unsigned i = 0; i < states.size(); ++i){
     tc += states[i].fwd_transitions.size();
@@ -511,16 +526,16 @@ int Automaton::get_transition_count() const{
 }
 
 bool Automaton::same_automaton(const Automaton &a2, bool cmp_pos) const{
-  if(states.size() != a2.states.size()) return false;
+  if(body->states.size() != a2.body->states.size()) return false;
 
   class state_t{
   public:
     state_t(const Automaton *a1, const Automaton *a2, bool cmp_pos) : a1(a1), a2(a2), cmp_pos(cmp_pos) {
       std::set<int> all;
-      for(int q = 0; q < int(a1->states.size()); ++q){
+      for(int q = 0; q < int(a1->body->states.size()); ++q){
         all.insert(q);
       }
-      qmap.resize(a1->states.size(),all);
+      qmap.resize(a1->body->states.size(),all);
       limit_to(0,0);
       label_limit();
       edge_limit();
@@ -536,7 +551,7 @@ bool Automaton::same_automaton(const Automaton &a2, bool cmp_pos) const{
     void propagate(){
       while(prop_stack.size()){
         int q = prop_stack.back();
-        const State &qstate = a1->states[q];
+        const State &qstate = a1->body->states[q];
         prop_stack.pop_back();
         assert(qmap[q].size() <= 1);
         if(qmap[q].size() == 0){
@@ -544,7 +559,7 @@ bool Automaton::same_automaton(const Automaton &a2, bool cmp_pos) const{
           return;
         }else{
           int q2 = *qmap[q].begin();
-          const State &qstate2 = a2->states[q2];
+          const State &qstate2 = a2->body->states[q2];
           /* Eliminate the state q2 from all other qmap[q'] */
           for(int qq = 0; qq < int(qmap.size()); ++qq){
             if(qq != q){
@@ -653,8 +668,8 @@ bool Automaton::same_automaton(const Automaton &a2, bool cmp_pos) const{
         std::set<int> newqmap;
         for(auto it = qmap[q].begin(); it != qmap[q].end(); ++it){
           int q2 = *it;
-          const State &qstate = a1->states[q];
-          const State &q2state = a2->states[q2];
+          const State &qstate = a1->body->states[q];
+          const State &q2state = a2->body->states[q2];
           if(same_instrs(qstate.bwd_transitions,q2state.bwd_transitions) &&
              same_instrs(qstate.fwd_transitions,q2state.fwd_transitions)){
             newqmap.insert(q2);
@@ -665,27 +680,27 @@ bool Automaton::same_automaton(const Automaton &a2, bool cmp_pos) const{
     };
     void label_limit(){
       /* Check that both automata have the same labels */
-      if(a1->label_map.size() != a2->label_map.size()){
+      if(a1->body->label_map.size() != a2->body->label_map.size()){
         fail();
         return;
       }
-      for(auto it = a1->label_map.begin(); it != a1->label_map.end(); ++it){
-        if(a2->label_map.count(it->first) == 0){
+      for(auto it = a1->body->label_map.begin(); it != a1->body->label_map.end(); ++it){
+        if(a2->body->label_map.count(it->first) == 0){
           fail();
           return;
         }
       }
       /* Limit the control state mapping */
-      for(auto it = a1->label_map.begin(); it != a1->label_map.end(); ++it){
+      for(auto it = a1->body->label_map.begin(); it != a1->body->label_map.end(); ++it){
         int q = it->second;
-        assert(a2->label_map.count(it->first));
-        int q2 = a2->label_map.at(it->first);
+        assert(a2->body->label_map.count(it->first));
+        int q2 = a2->body->label_map.at(it->first);
         limit_to(q,q2);
       }
     };
     std::string to_string() const{
       std::stringstream ss;
-      for(unsigned i = 0; i < a1->states.size(); ++i){
+      for(unsigned i = 0; i < a1->body->states.size(); ++i){
         ss << "Q" << i << ": {";
         for(auto it = qmap[i].begin(); it != qmap[i].end(); ++it){
           if(it != qmap[i].begin()) ss << ", ";
@@ -836,4 +851,46 @@ void Automaton::test(){
                          "L0: $r0:=0; goto L0; $r2:=2; goto L1; $r1:=1; L1: $r3:=3",true));
 
   }
+
+  /* Test copy-on-write */
+  {
+    std::stringstream ss;
+    ss << "forbidden\n"
+       << "  * *\n"
+       << "data\n"
+       << "  x = *\n"
+       << "process\n"
+       << "text\n"
+       << "  write: x := 1; write: x := 2\n"
+       << "process\n"
+       << "text\n"
+       << "  write: x := 3\n";
+    Lexer lex(ss);
+    Machine m(Parser::p_test(lex));
+    Machine m2(m);
+    const Machine &cm2 = m2;
+    bool shared = m2.automata[0].shares_states_with(m.automata[0]) &&
+      m2.automata[1].shares_states_with(m.automata[1]);
+    /* Const access does not unshare */
+    int tc = cm2.automata[0].get_states()[0].fwd_transitions.size();
+    shared = shared && m2.automata[0].shares_states_with(m.automata[0]);
+    Test::inner_test("copy-on-write #1 (copies share)",shared && tc == 1);
+
+    Automaton::Transition t(1,Lang::Stmt<int>::full_fence(),3);
+    m2.automata[0].add_transition(t);
+    Test::inner_test("copy-on-write #2 (modification unshares)",
+                     !m2.automata[0].shares_states_with(m.automata[0]) &&
+                     m2.automata[1].shares_states_with(m.automata[1]) &&
+                     m.automata[0].get_transition_count() == 2 &&
+                     m2.automata[0].get_transition_count() == 3 &&
+                     m.automata[0].get_states().size() == 3 &&
+                     m2.automata[0].get_states().size() == 4);
+
+    Machine m3(m2);
+    m3.automata[0].del_transition(t);
+    Test::inner_test("copy-on-write #3 (deletion in copy)",
+                     m3.automata[0].get_transition_count() == 2 &&
+                     m2.automata[0].get_transition_count() == 3 &&
+                     m3.automata[1].shares_states_with(m.automata[1]));
+  }
 };
@@ -71,9 +71,13 @@ public:
   /* An automaton with a single state (0) and no transitions. */
   Automaton();
   Automaton(const Lang::Stmt<int>&);
-  Automaton(const Automaton&); // Deep copy
+  /* Copies share their states and transitions until either of them
+   * is modified (copy-on-write). Copying is therefore cheap, and the
+   * first modification of a copy costs a deep copy of the automaton.
+   */
+  Automaton(const Automaton&);
   virtual ~Automaton();
-  Automaton &operator=(const Automaton&); // Deep copy
+  Automaton &operator=(const Automaton&);
   std::string to_string(const std::function<std::string(const int&)> &regts, 
                         const std::function<std::string(const Lang::MemLoc<int> &)> &mlts,
                         int indentation = 0) const throw();
@@ -117,13 +121,16 @@ public:
      * The transitions are shared with fwd_transitions. */
     std::set<Transition*> bwd_transitions;
   };
-  const std::vector<State> &get_states() const throw() { return states; };
-  std::vector<State> &get_states() throw() { return states; };
-  const State &operator[](int i) const throw(std::out_of_range) { return states.at(i); };
+  const std::vector<State> &get_states() const throw() { return body->states; };
+  /* Non-const access unshares the states of this automaton (see
+   * detach). The returned reference should not be kept across copies
+   * of this automaton. */
+  std::vector<State> &get_states() { detach(); return body->states; };
+  const State &operator[](int i) const throw(std::out_of_range) { return body->states.at(i); };
   /* Returns the state labeled by lbl if there is such a
    * label. */
   int state_index_of_label(Lang::label_t lbl) const throw(UnDefinedLabel*);
-  const std::map<Lang::label_t,int> &get_labels() const throw() { return label_map; };
+  const std::map<Lang::label_t,int> &get_labels() const throw() { return body->label_map; };
   /* Returns a list with distinct elements ml such that this automaton
    * contains a transition writing to the memory location ml.
    */
@@ -141,7 +148,7 @@ public:
   bool del_transition(const Transition &t);
   /* Sets the label lbl to the state i. If lbl was previously present
    * as a label in this automaton, the old label is removed. */
-  void set_label(Lang::label_t lbl, int i) { label_map[lbl] = i; };
+  void set_label(Lang::label_t lbl, int i) { detach(); body->label_map[lbl] = i; };
   /* Returns the total number of transitions in this automaton. */
   int get_transition_count() const;
   /* Compares this automaton with the automaton a. Returns true if
@@ -156,22 +163,38 @@ public:
    * source code positions are ignored.
    */
   bool same_automaton(const Automaton &a, bool cmp_pos) const;
+  /* Returns true iff this automaton and a currently share their
+   * states and transitions. */
+  bool shares_states_with(const Automaton &a) const { return body == a.body; };
   static void test();
 private:
-  void clear_and_copy(const Automaton &); // Used for copy constructor and assignment
   /* Throw Exception if fwd and bwd transitions are inconsistent */
   void check_fwd_bwd_consistency() const throw(Exception*);
-  /* The states of the automaton, labeled by their indices.
-   * Execution starts in the state states[0].
-   */
-  std::vector<State> states;
-  std::map<Lang::label_t,int> label_map; // Maps labels to state indices
+  /* The states, transitions and labels of an automaton. A Body may
+   * be shared by several Automaton objects, none of which modifies
+   * it while it is shared. */
+  class Body{
+  public:
+    Body() {};
+    Body(const Body&); // Deep copy
+    Body &operator=(const Body&) = delete;
+    ~Body() { dealloc(); };
+    /* The states of the automaton, labeled by their indices.
+     * Execution starts in the state states[0].
+     */
+    std::vector<State> states;
+    std::map<Lang::label_t,int> label_map; // Maps labels to state indices
+    void dealloc(); // Delete all instructions owned by this body
+  };
+  std::shared_ptr<Body> body;
+  /* Makes body owned by this automaton alone, deep copying it if it
+   * is shared. Called before every modification. */
+  void detach();
   // Recursive function, used in constructor
   typedef std::set<std::pair<std::set<Transition *>,Lang::label_t> > unsat_goto_t;
   class ConstructFromAst;
   friend class ConstructFromAst;
   void construct_from_ast(const Lang::Stmt<int>&,unsat_goto_t&,int src = -1);
-  void dealloc(); // Delete all instructions owned by this automaton
 };
 
 #endif // __AUTOMATON_H__
@@ -0,0 +1,588 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "batch.h"
+#include "test.h"
+#include "timer.h"
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace{
+  /* Exit codes of worker processes */
+  const int WORKER_DONE = 0;
+  const int WORKER_ERROR = 1;
+  const int WORKER_OUT_OF_MEMORY = 2;
+
+  /* The longest report that a worker passes to the parent. Keeping
+   * it below the pipe capacity guarantees that the worker never
+   * blocks on writing its report. */
+  const std::size_t max_report_length = 4096;
+
+  int parse_int(const std::string &s, int line, const std::string &opt, int lb){
+    std::stringstream ss(s);
+    int i;
+    if(!(ss >> i) || !ss.eof() || i < lb){
+      std::stringstream msg;
+      msg << "Invalid argument '" << s << "' to " << opt << " at line " << line << " of manifest.";
+      throw new Batch::Error(msg.str());
+    }
+    return i;
+  };
+};
+
+const double Batch::cancel_grace = 2;
+
+std::string Batch::Job::to_json() const{
+  std::stringstream ss;
+  ss << "{\"line\":" << line
+     << ", \"file\":\"" << json_escape(file) << "\""
+     << ", \"abstraction\":\"" << json_escape(abstraction) << "\""
+     << ", \"k\":" << k
+     << ", \"rff\":" << (rff ? "true" : "false")
+     << ", \"slice\":" << (slice ? "true" : "false")
+     << ", \"cegar\":" << (cegar ? "true" : "false")
+     << ", \"timeout\":" << timeout
+     << ", \"max_memory\":" << max_memory
+     << "}";
+  return ss.str();
+};
+
+std::string Batch::Outcome::status_to_string(status_t s){
+  switch(s){
+  case DONE: return "done";
+  case TIMEOUT: return "timeout";
+  case OUT_OF_MEMORY: return "out of memory";
+  case ERROR: return "error";
+  case CRASHED: return "crashed";
+  case CANCELLED: return "cancelled";
+  }
+  throw new std::logic_error("Batch::Outcome::status_to_string: Unknown status.");
+};
+
+std::string Batch::to_json(const Job &j, const Outcome &o){
+  std::stringstream ss;
+  ss << "json: {\"action\":\"Batch Job\", \"job\":" << j.to_json()
+     << ", \"status\":\"" << Outcome::status_to_string(o.status) << "\""
+     << ", \"wall_time\":" << o.time
+     << ", \"result\":";
+  if(o.status == Outcome::DONE){
+    ss << o.report;
+  }else{
+    ss << "\"" << json_escape(o.report) << "\"";
+  }
+  ss << "}\n";
+  return ss.str();
+};
+
+std::string Batch::json_escape(const std::string &s){
+  std::stringstream ss;
+  for(char c : s){
+    switch(c){
+    case '"': ss << "\\\""; break;
+    case '\\': ss << "\\\\"; break;
+    case '\n': ss << "\\n"; break;
+    case '\t': ss << "\\t"; break;
+    default:
+      if((unsigned char)c < 0x20){
+        ss << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xf] << "0123456789abcdef"[c & 0xf];
+      }else{
+        ss << c;
+      }
+    }
+  }
+  return ss.str();
+};
+
+std::map<std::string,std::string> Batch::parse_report(const std::string &report){
+  std::map<std::string,std::string> fields;
+  std::size_t i = 0;
+  std::function<Error*()> malformed = [&report](){
+    return new Error("Malformed report '" + report + "'.");
+  };
+  std::function<void()> skip_space = [&report,&i](){
+    while(i < report.size() && std::isspace((unsigned char)report[i])) ++i;
+  };
+  std::function<void(char)> expect = [&report,&i,&skip_space,&malformed](char c){
+    skip_space();
+    if(i >= report.size() || report[i] != c) throw malformed();
+    ++i;
+  };
+  std::function<std::string()> read_string = [&report,&i,&expect,&malformed](){
+    expect('"');
+    std::string s;
+    while(i < report.size() && report[i] != '"'){
+      char c = report[i++];
+      if(c != '\\'){
+        s += c;
+        continue;
+      }
+      if(i >= report.size()) throw malformed();
+      c = report[i++];
+      switch(c){
+      case '"': case '\\': case '/': s += c; break;
+      case 'b': s += '\b'; break;
+      case 'f': s += '\f'; break;
+      case 'n': s += '\n'; break;
+      case 'r': s += '\r'; break;
+      case 't': s += '\t'; break;
+      case 'u':
+        {
+          /* Only code points below 0x80, as written by json_escape */
+          unsigned cp = 0;
+          for(int d = 0; d < 4; ++d){
+            if(i >= report.size() || !std::isxdigit((unsigned char)report[i])) throw malformed();
+            char h = std::tolower((unsigned char)report[i++]);
+            cp = cp*16 + ((h <= '9') ? h - '0' : h - 'a' + 10);
+          }
+          if(cp >= 0x80) throw malformed();
+          s += char(cp);
+          break;
+        }
+      default:
+        throw malformed();
+      }
+    }
+    if(i >= report.size()) throw malformed();
+    ++i;
+    return s;
+  };
+
+  expect('{');
+  skip_space();
+  if(i < report.size() && report[i] == '}'){
+    ++i;
+  }else{
+    while(true){
+      std::string key = read_string();
+      expect(':');
+      skip_space();
+      std::string value;
+      if(i < report.size() && report[i] == '"'){
+        value = read_string();
+      }else{
+        while(i < report.size() && report[i] != ',' && report[i] != '}' &&
+              !std::isspace((unsigned char)report[i])){
+          value += report[i++];
+        }
+        if(value.empty()) throw malformed();
+      }
+      fields[key] = value;
+      skip_space();
+      if(i < report.size() && report[i] == ','){
+        ++i;
+      }else{
+        break;
+      }
+    }
+    expect('}');
+  }
+  skip_space();
+  if(i != report.size()) throw malformed();
+  return fields;
+};
+
+std::vector<Batch::Job> Batch::parse_manifest(std::istream &is, const Job &defaults){
+  static const std::set<std::string> abstractions{"sb","pb","hsb","dual","pdual","vips","tso","pso"};
+  std::vector<Job> jobs;
+  std::string ln;
+  int line = 0;
+  while(std::getline(is,ln)){
+    ++line;
+    std::stringstream ss(ln);
+    std::vector<std::string> toks;
+    std::string tok;
+    while(ss >> tok) toks.push_back(tok);
+    if(toks.empty() || toks[0][0] == '#') continue;
+
+    Job job = defaults;
+    job.line = line;
+    job.file = toks[0];
+    for(unsigned i = 1; i < toks.size(); ++i){
+      bool has_arg = (i+1 < toks.size());
+      if(toks[i] == "--rff"){
+        job.rff = true;
+      }else if(toks[i] == "--slice"){
+        job.slice = true;
+      }else if(toks[i] == "--cegar"){
+        job.cegar = true;
+      }else if((toks[i] == "-a" || toks[i] == "--abstraction") && has_arg){
+        job.abstraction = toks[++i];
+        if(abstractions.count(job.abstraction) == 0){
+          std::stringstream msg;
+          msg << "Unsupported abstraction '" << job.abstraction << "' at line " << line << " of manifest.";
+          throw new Error(msg.str());
+        }
+      }else if(toks[i] == "-k" && has_arg){
+        job.k = parse_int(toks[i+1],line,toks[i],1);
+        ++i;
+      }else if(toks[i] == "--job-timeout" && has_arg){
+        job.timeout = parse_int(toks[i+1],line,toks[i],0);
+        ++i;
+      }else if(toks[i] == "--job-memory" && has_arg){
+        job.max_memory = parse_int(toks[i+1],line,toks[i],0);
+        ++i;
+      }else{
+        std::stringstream msg;
+        msg << "Unknown or incomplete option '" << toks[i] << "' at line " << line << " of manifest.";
+        throw new Error(msg.str());
+      }
+    }
+    jobs.push_back(job);
+  }
+  return jobs;
+};
+
+void Batch::run(const std::vector<Job> &jobs, int concurrency,
+                std::function<bool(const Job&,std::string&)> worker,
+                std::function<bool(const Job&,const Outcome&)> done){
+  if(concurrency < 1){
+    throw new Error("Concurrency must be positive.");
+  }
+
+  struct Running{
+    unsigned job;
+    int fd;
+    Timer timer;
+  };
+  std::map<pid_t,Running> running;
+  unsigned next = 0;
+  bool cancelled = false;
+  /* Measures the grace period of cancelled workers */
+  Timer grace_timer;
+
+  while((!cancelled && next < jobs.size()) || running.size()){
+    /* Start workers */
+    while(!cancelled && next < jobs.size() && int(running.size()) < concurrency){
+      const Job &job = jobs[next];
+      int fds[2];
+      if(pipe(fds) != 0){
+        throw new Error(std::string("Failed to create pipe: ")+std::strerror(errno));
+      }
+      /* Do not let buffered output be printed by both processes. */
+      std::cout.flush();
+      std::cerr.flush();
+      pid_t pid = fork();
+      if(pid == -1){
+        close(fds[0]);
+        close(fds[1]);
+        throw new Error(std::string("Failed to fork worker: ")+std::strerror(errno));
+      }
+      if(pid == 0){
+        /* Worker */
+        close(fds[0]);
+        for(auto it = running.begin(); it != running.end(); ++it){
+          close(it->second.fd);
+        }
+        if(job.max_memory > 0){
+          struct rlimit rl;
+          rl.rlim_cur = rl.rlim_max = rlim_t(job.max_memory) * 1024 * 1024;
+          setrlimit(RLIMIT_AS,&rl);
+        }
+        if(job.timeout > 0){
+          signal(SIGALRM,SIG_DFL);
+          alarm(job.timeout);
+        }
+        std::string report;
+        int code;
+        try{
+          code = worker(job,report) ? WORKER_DONE : WORKER_ERROR;
+        }catch(std::bad_alloc &){
+          report = "";
+          code = WORKER_OUT_OF_MEMORY;
+        }catch(std::exception *exc){
+          report = exc->what();
+          code = WORKER_ERROR;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        if(report.size() > max_report_length) report.resize(max_report_length);
+        std::size_t written = 0;
+        while(written < report.size()){
+          ssize_t w = write(fds[1],report.data()+written,report.size()-written);
+          if(w <= 0 && errno != EINTR) break;
+          if(w > 0) written += w;
+        }
+        close(fds[1]);
+        _exit(code);
+      }
+      close(fds[1]);
+      Running &r = running[pid];
+      r.job = next;
+      r.fd = fds[0];
+      r.timer.start();
+      ++next;
+    }
+
+    /* Wait for some worker to terminate. During cancellation, poll
+     * so that workers overstaying the grace period can be killed. */
+    int status;
+    pid_t pid = waitpid(-1,&status,cancelled ? WNOHANG : 0);
+    if(pid == -1){
+      if(errno == EINTR) continue;
+      throw new Error(std::string("Failed to wait for worker: ")+std::strerror(errno));
+    }
+    if(pid == 0){
+      if(grace_timer.get_time() >= cancel_grace){
+        for(auto it = running.begin(); it != running.end(); ++it){
+          kill(it->first,SIGKILL);
+        }
+      }
+      usleep(10000);
+      continue;
+    }
+    auto it = running.find(pid);
+    if(it == running.end()) continue; // Not one of our workers
+
+    Outcome outcome;
+    it->second.timer.stop();
+    outcome.time = it->second.timer.get_time();
+    char buf[512];
+    ssize_t c;
+    while((c = read(it->second.fd,buf,sizeof(buf))) != 0){
+      if(c < 0){
+        if(errno == EINTR) continue;
+        break;
+      }
+      outcome.report.append(buf,c);
+    }
+    close(it->second.fd);
+
+    if(WIFEXITED(status)){
+      switch(WEXITSTATUS(status)){
+      case WORKER_DONE: outcome.status = Outcome::DONE; break;
+      case WORKER_ERROR: outcome.status = Outcome::ERROR; break;
+      case WORKER_OUT_OF_MEMORY: outcome.status = Outcome::OUT_OF_MEMORY; break;
+      default: outcome.status = Outcome::CRASHED;
+      }
+    }else if(WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM){
+      outcome.status = Outcome::TIMEOUT;
+    }else{
+      outcome.status = Outcome::CRASHED;
+    }
+
+    const Job &job = jobs[it->second.job];
+    running.erase(it);
+    if(cancelled){
+      outcome.status = Outcome::CANCELLED;
+      done(job,outcome);
+    }else if(!done(job,outcome)){
+      cancelled = true;
+      grace_timer.start();
+      for(auto it = running.begin(); it != running.end(); ++it){
+        kill(it->first,SIGTERM);
+      }
+    }
+  }
+};
+
+bool Batch::is_conclusive(const std::string &abstraction, const std::string &result){
+  static const std::set<std::string> proves_reachable{"sb","dual","tso"};
+  static const std::set<std::string> proves_unreachable{"sb","dual","hsb","pdual","pb"};
+  if(result == "reachable"){
+    return proves_reachable.count(abstraction);
+  }else if(result == "unreachable"){
+    return proves_unreachable.count(abstraction);
+  }
+  return false;
+};
+
+void Batch::test(){
+  /* Test 1: Manifest parsing */
+  {
+    std::stringstream ss;
+    ss << "# A comment\n"
+       << "\n"
+       << "a.rmm\n"
+       << "  b.rmm -a dual --rff --job-timeout 10\n"
+       << "c.rmm -a pb -k 2 --cegar --slice --job-memory 100\n";
+    Job defaults;
+    defaults.timeout = 5;
+    std::vector<Job> jobs = parse_manifest(ss,defaults);
+    Test::inner_test("Manifest parsing",
+                     jobs.size() == 3 &&
+                     jobs[0].line == 3 && jobs[0].file == "a.rmm" && jobs[0].abstraction == "sb" &&
+                     !jobs[0].rff && jobs[0].timeout == 5 &&
+                     jobs[1].line == 4 && jobs[1].file == "b.rmm" && jobs[1].abstraction == "dual" &&
+                     jobs[1].rff && jobs[1].timeout == 10 && jobs[1].max_memory == 0 &&
+                     !jobs[1].slice &&
+                     jobs[2].abstraction == "pb" && jobs[2].k == 2 && jobs[2].cegar && jobs[2].slice &&
+                     jobs[2].max_memory == 100);
+  }
+
+  /* Test 2: Syntax errors in manifest */
+  {
+    std::vector<std::string> bad = {"a.rmm -a foo\n", "a.rmm -k 0\n", "a.rmm -k\n", "a.rmm --bogus\n"};
+    bool all_rejected = true;
+    for(unsigned i = 0; i < bad.size(); ++i){
+      std::stringstream ss(bad[i]);
+      try{
+        parse_manifest(ss,Job());
+        all_rejected = false;
+      }catch(Error *e){
+        delete e;
+      }
+    }
+    Test::inner_test("Manifest syntax errors",all_rejected);
+  }
+
+  /* Test 3: Running workers */
+  {
+    std::vector<Job> jobs(4);
+    for(unsigned i = 0; i < jobs.size(); ++i) jobs[i].line = i;
+    jobs[2].timeout = 1;
+    std::map<int,Outcome> outcomes;
+    run(jobs,2,
+        [](const Job &j, std::string &report){
+          if(j.line == 1) return false;
+          if(j.line == 2) while(true) pause();
+          if(j.line == 3) throw std::bad_alloc();
+          std::stringstream ss;
+          ss << "job " << j.line;
+          report = ss.str();
+          return true;
+        },
+        [&outcomes](const Job &j, const Outcome &o){
+          outcomes[j.line] = o;
+          return true;
+        });
+    Test::inner_test("Running workers",
+                     outcomes.size() == 4 &&
+                     outcomes[0].status == Outcome::DONE && outcomes[0].report == "job 0" &&
+                     outcomes[1].status == Outcome::ERROR &&
+                     outcomes[2].status == Outcome::TIMEOUT &&
+                     outcomes[3].status == Outcome::OUT_OF_MEMORY);
+  }
+
+  /* Test 4: Cancelling workers */
+  {
+    std::vector<Job> jobs(4);
+    for(unsigned i = 0; i < jobs.size(); ++i) jobs[i].line = i;
+    std::map<int,Outcome> outcomes;
+    Timer t;
+    t.start();
+    run(jobs,3,
+        [](const Job &j, std::string &report){
+          if(j.line != 0) while(true) pause();
+          report = "job 0";
+          return true;
+        },
+        [&outcomes](const Job &j, const Outcome &o){
+          outcomes[j.line] = o;
+          return false;
+        });
+    t.stop();
+    Test::inner_test("Cancelling workers",
+                     outcomes.size() == 3 &&
+                     outcomes[0].status == Outcome::DONE &&
+                     outcomes[1].status == Outcome::CANCELLED &&
+                     outcomes[2].status == Outcome::CANCELLED &&
+                     t.get_time() < cancel_grace);
+  }
+
+  /* Test 5: Conclusive verdicts */
+  {
+    Test::inner_test("Conclusive verdicts",
+                     is_conclusive("sb","reachable") && is_conclusive("sb","unreachable") &&
+                     is_conclusive("dual","reachable") && is_conclusive("dual","unreachable") &&
+                     !is_conclusive("hsb","reachable") && is_conclusive("hsb","unreachable") &&
+                     !is_conclusive("pdual","reachable") && is_conclusive("pdual","unreachable") &&
+                     !is_conclusive("pb","reachable") && is_conclusive("pb","unreachable") &&
+                     is_conclusive("tso","reachable") && !is_conclusive("tso","unreachable") &&
+                     !is_conclusive("pso","reachable") && !is_conclusive("pso","unreachable") &&
+                     !is_conclusive("sb","failure") && !is_conclusive("vips","unreachable"));
+  }
+
+  /* Test 6: An inconclusive verdict does not cancel the other
+   * workers, as in a portfolio. */
+  {
+    std::vector<Job> jobs(3);
+    for(unsigned i = 0; i < jobs.size(); ++i) jobs[i].line = i;
+    jobs[0].abstraction = "tso";
+    jobs[1].abstraction = "sb";
+    jobs[2].abstraction = "dual";
+    std::map<int,Outcome> outcomes;
+    /* Job 1 finishes only after the outcome of job 0 has been
+     * handled. */
+    int handshake[2];
+    bool have_pipe = (pipe(handshake) == 0);
+    if(have_pipe){
+      run(jobs,3,
+          [&handshake](const Job &j, std::string &report){
+            if(j.line == 1){
+              char c;
+              while(read(handshake[0],&c,1) < 0 && errno == EINTR) ;
+            }
+            if(j.line == 2) while(true) pause();
+            report = "unreachable";
+            return true;
+          },
+          [&outcomes,&handshake](const Job &j, const Outcome &o){
+            outcomes[j.line] = o;
+            if(j.line == 0){
+              char c = 0;
+              while(write(handshake[1],&c,1) < 0 && errno == EINTR) ;
+            }
+            return !(o.status == Outcome::DONE && is_conclusive(j.abstraction,o.report));
+          });
+      close(handshake[0]);
+      close(handshake[1]);
+    }
+    Test::inner_test("Inconclusive verdicts do not cancel",
+                     have_pipe && outcomes.size() == 3 &&
+                     outcomes[0].status == Outcome::DONE &&
+                     outcomes[1].status == Outcome::DONE &&
+                     outcomes[2].status == Outcome::CANCELLED);
+  }
+
+  /* Test 7: Reports survive escaping and parsing */
+  {
+    std::string reason = "a \"quoted\", {braced} \\ reason\n\x01";
+    std::string report = "{\"result\":\"failure\", \"generated_constraints\":12, "
+      "\"failure_reason\":\"" + json_escape(reason) + "\"}";
+    std::map<std::string,std::string> fields = parse_report(report);
+    bool all_rejected = true;
+    std::vector<std::string> bad = {"", "{", "{\"a\":}", "{\"a\":\"b}", "{\"a\":1} x", "{\"a\":\"\\q\"}"};
+    for(unsigned i = 0; i < bad.size(); ++i){
+      try{
+        parse_report(bad[i]);
+        all_rejected = false;
+      }catch(Error *e){
+        delete e;
+      }
+    }
+    Test::inner_test("Report parsing",
+                     fields.size() == 3 && fields["result"] == "failure" &&
+                     fields["generated_constraints"] == "12" &&
+                     fields["failure_reason"] == reason &&
+                     parse_report(" { } ").empty() && all_rejected);
+  }
+};
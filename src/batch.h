@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <functional>
+#include <istream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Batch implements the job handling of the command "memorax batch".
+ *
+ * A batch is described by a manifest: a text file with one job per
+ * line. Each job line consists of the path to an .rmm file (or
+ * machine image) followed by options for that job:
+ *
+ *   <file> [-a <abstraction>] [-k <int>] [--rff] [--slice] [--cegar]
+ *          [--job-timeout <seconds>] [--job-memory <MiB>]
+ *
+ * Empty lines and lines starting with '#' are ignored. Options that
+ * are not given on a job line take their values from the defaults
+ * given to parse_manifest (i.e. from the command line).
+ *
+ * Jobs are executed by run, each in a forked worker process. At most
+ * a given number of workers run concurrently. Each worker is subject
+ * to the time and memory budget of its job. Since the workers are
+ * forked from the process running the batch, any data prepared
+ * before calling run (e.g. parsed machines) is shared with all
+ * workers without being copied or parsed again.
+ */
+class Batch{
+public:
+  class Error : public std::exception{
+  public:
+    Error(std::string m) : msg("Batch: "+m) {};
+    virtual ~Error() throw() {};
+    virtual const char *what() const throw() { return msg.c_str(); };
+  private:
+    std::string msg;
+  };
+
+  /* A single job in a batch. */
+  struct Job{
+    Job() : line(0), abstraction("sb"), k(1), rff(false), slice(false), cegar(false),
+            timeout(0), max_memory(0) {};
+    /* The line in the manifest where the job is described. */
+    int line;
+    /* The file containing the machine to analyse. */
+    std::string file;
+    std::string abstraction;
+    int k;
+    bool rff;
+    bool slice;
+    bool cegar;
+    /* Wall clock time budget in seconds. 0 means no limit. */
+    int timeout;
+    /* Address space budget in MiB. 0 means no limit. */
+    int max_memory;
+    /* The job represented as a JSON object. */
+    std::string to_json() const;
+  };
+
+  /* The outcome of a job. */
+  struct Outcome{
+    enum status_t {
+      /* The worker finished and produced a report */
+      DONE,
+      /* The worker ran out of its time budget */
+      TIMEOUT,
+      /* The worker ran out of its memory budget */
+      OUT_OF_MEMORY,
+      /* The worker reported an error (message in report) */
+      ERROR,
+      /* The worker terminated abnormally */
+      CRASHED,
+      /* The worker was cancelled before it finished */
+      CANCELLED
+    };
+    Outcome() : status(CRASHED), time(0) {};
+    status_t status;
+    /* The report written by the worker. */
+    std::string report;
+    /* Wall clock time consumed by the worker in seconds. */
+    double time;
+    static std::string status_to_string(status_t s);
+  };
+
+  /* Returns a json directive (for Log::json) describing the outcome o
+   * of job j. If o.status == DONE, then o.report is assumed to be a
+   * JSON value and is included verbatim. Otherwise o.report is
+   * included as a string. */
+  static std::string to_json(const Job &j, const Outcome &o);
+
+  /* Returns s escaped for use inside a JSON string literal. */
+  static std::string json_escape(const std::string &s);
+
+  /* Parses report, which should be a flat JSON object, as produced
+   * for reports of finished jobs. Returns a map from each key to its
+   * value. String values are unescaped, other values (numbers,
+   * booleans, null) are returned as written.
+   *
+   * Throws Error* if report is not such an object.
+   */
+  static std::map<std::string,std::string> parse_report(const std::string &report);
+
+  /* Parses the manifest in is. Job options not given in the manifest
+   * are copied from defaults.
+   *
+   * Throws Error* on syntax errors.
+   */
+  static std::vector<Job> parse_manifest(std::istream &is, const Job &defaults);
+
+  /* Executes the jobs in forked worker processes, with at most
+   * concurrency workers running at the same time.
+   *
+   * In the worker for job j, worker(j,report) is called with an
+   * empty string report. worker should execute the job, assign
+   * report a one line description of its result and return true, or
+   * assign report an error message and return false. If worker
+   * throws std::bad_alloc, the outcome is OUT_OF_MEMORY.
+   *
+   * When a worker terminates, done(j,outcome) is called in the
+   * calling process. The calls to done are made in the order in which
+   * the workers terminate.
+   *
+   * If done returns false, then the batch is cancelled: No more
+   * workers are started, and the running workers are sent SIGTERM. A
+   * worker that has not terminated after cancel_grace seconds is
+   * killed. done is called with status CANCELLED for each of them,
+   * and its return value is then ignored. Jobs that were never
+   * started are not passed to done.
+   */
+  static void run(const std::vector<Job> &jobs, int concurrency,
+                  std::function<bool(const Job&,std::string&)> worker,
+                  std::function<bool(const Job&,const Outcome&)> done);
+
+  /* Returns true iff result ("reachable" or "unreachable"), reported
+   * by a job using abstraction, is a conclusive verdict for TSO
+   * reachability. This is the case for both verdicts of sb and dual,
+   * which are exact for TSO, for the unreachable verdicts of hsb,
+   * pdual and pb, which overapproximate TSO, and for the reachable
+   * verdicts of tso, which only finds real TSO witnesses. Unreachable
+   * verdicts of tso and pso are never conclusive, since their
+   * searches are bounded and hash compacted. Returns false for any
+   * other abstraction or result.
+   */
+  static bool is_conclusive(const std::string &abstraction, const std::string &result);
+
+  /* The time in seconds that cancelled workers are given to
+   * terminate by themselves. */
+  static const double cancel_grace;
+
+  static void test();
+};
+
+#endif
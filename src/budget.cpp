@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "budget.h"
+#include "heartbeat.h"
+#include "test.h"
+
+#include <stdexcept>
+
+Budget::limits_t Budget::limits;
+volatile std::sig_atomic_t Budget::cancelled = 0;
+const long Budget::check_period = 256;
+
+Budget::Budget() : limited(!limits.is_unlimited()), iterations(0), charged(0) {
+  timer.start();
+};
+
+Budget::exhausted_t Budget::check_time_and_memory(){
+  if(limits.max_time > 0 && timer.get_time() >= limits.max_time){
+    return TIME;
+  }
+  if(limits.max_memory > 0){
+    long rss = Heartbeat::resident_set_size();
+    if(rss >= 0 && rss >= limits.max_memory){
+      return MEMORY;
+    }
+  }
+  return NOT_EXHAUSTED;
+};
+
+std::string Budget::to_string(exhausted_t e){
+  switch(e){
+  case NOT_EXHAUSTED: return "budget not exhausted";
+  case TIME: return "time budget exhausted";
+  case MEMORY: return "memory budget exhausted";
+  case CONSTRAINTS: return "constraint budget exhausted";
+  case CANCELLED: return "analysis cancelled";
+  }
+  throw new std::logic_error("Budget::to_string: Invalid value.");
+};
+
+void Budget::test(){
+  limits_t saved_limits = limits;
+
+  /* Test 1: No limits */
+  {
+    set_limits(limits_t());
+    Budget b;
+    bool exhausted = false;
+    for(long i = 0; i < 10*check_period; ++i){
+      exhausted = exhausted || b.check(i) != NOT_EXHAUSTED;
+    }
+    Test::inner_test("No limits",!exhausted);
+  }
+
+  /* Test 2: Constraint limit */
+  {
+    limits_t l;
+    l.max_constraints = 100;
+    set_limits(l);
+    Budget b;
+    Test::inner_test("Constraint limit",
+                     b.check(99) == NOT_EXHAUSTED && b.check(100) == CONSTRAINTS);
+  }
+
+  /* Test 3: Time limit. The timer of the budget is stopped and
+   * advanced by hand, so that the test does not depend on the wall
+   * clock. */
+  {
+    limits_t l;
+    l.max_time = 10;
+    set_limits(l);
+    Budget b;
+    b.timer.stop();
+    b.timer.reset();
+    bool early = false;
+    for(long i = 0; i < check_period; ++i){
+      early = early || b.check(i) != NOT_EXHAUSTED;
+    }
+    b.timer.add(9.5);
+    for(long i = 0; i < check_period; ++i){
+      early = early || b.check(i) != NOT_EXHAUSTED;
+    }
+    b.timer.add(1);
+    bool late = false;
+    for(long i = 0; i < check_period; ++i){
+      late = late || b.check(i) == TIME;
+    }
+    Test::inner_test("Time limit",!early && late);
+  }
+
+  /* Test 4: Memory limit */
+  {
+    limits_t l;
+    l.max_memory = 1;
+    set_limits(l);
+    Budget b;
+    bool exhausted = false;
+    for(long i = 0; i < check_period; ++i){
+      exhausted = exhausted || b.check(i) == MEMORY;
+    }
+    Test::inner_test("Memory limit",exhausted);
+  }
+
+  /* Test 5: Cancellation */
+  {
+    set_limits(limits_t());
+    Budget b;
+    bool early = b.check(0) != NOT_EXHAUSTED;
+    cancel();
+    bool late = b.check(1) == CANCELLED;
+    cancelled = 0;
+    Test::inner_test("Cancellation",!early && late && b.check(2) == NOT_EXHAUSTED);
+  }
+
+  /* Test 6: Constraints of finished analyses are charged */
+  {
+    limits_t l;
+    l.max_constraints = 100;
+    set_limits(l);
+    Budget b;
+    b.charge(60);
+    bool early = b.check(39) != NOT_EXHAUSTED;
+    b.charge(30);
+    Test::inner_test("Charged constraints",
+                     !early && b.check(10) == CONSTRAINTS && b.check_now(9) == NOT_EXHAUSTED);
+  }
+
+  /* Test 7: check_now checks the time at once */
+  {
+    limits_t l;
+    l.max_time = 10;
+    set_limits(l);
+    Budget b;
+    b.timer.stop();
+    b.timer.reset();
+    b.timer.add(11);
+    Test::inner_test("Immediate time check",b.check_now(0) == TIME && b.check(0) == NOT_EXHAUSTED);
+  }
+
+  set_limits(saved_limits);
+};
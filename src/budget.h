@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __BUDGET_H__
+#define __BUDGET_H__
+
+#include "timer.h"
+
+#include <csignal>
+#include <string>
+
+/* A Budget limits the resources that a reachability analysis may use
+ * (set by the flags --max-time, --max-memory and
+ * --max-constraints).
+ *
+ * An analysis creates a Budget when it starts, and calls check()
+ * once per iteration of its main loop. If check() reports that the
+ * budget is exhausted, the analysis should stop and return a Result
+ * with result FAILURE, carrying the statistics gathered so far.
+ *
+ * The limits are global, and set with set_limits. By default there
+ * are no limits. The time and constraint limits apply to each Budget
+ * separately, while the memory limit applies to the resident memory
+ * of the process. An analysis uses the Budget given in its
+ * Reachability::Arg if there is one, so that several analyses (e.g.
+ * the iterations of a CEGAR loop) can be charged to one Budget.
+ *
+ * An analysis can also be cancelled from outside, by calling cancel
+ * (e.g. from a signal handler). From then on check() reports
+ * CANCELLED.
+ */
+class Budget{
+public:
+  struct limits_t{
+    limits_t() : max_time(0), max_memory(0), max_constraints(0) {};
+    /* Wall clock time in seconds. 0 means no limit. */
+    double max_time;
+    /* Resident memory in bytes. 0 means no limit. */
+    long max_memory;
+    /* Number of generated constraints. 0 means no limit. */
+    long max_constraints;
+    bool is_unlimited() const{
+      return max_time <= 0 && max_memory <= 0 && max_constraints <= 0;
+    };
+  };
+
+  enum exhausted_t {
+    NOT_EXHAUSTED,
+    TIME,
+    MEMORY,
+    CONSTRAINTS,
+    CANCELLED
+  };
+
+  Budget();
+
+  /* Returns the first exhausted part of the budget, or NOT_EXHAUSTED.
+   *
+   * generated is the number of constraints generated so far by the
+   * analysis. Time and memory are only checked every check_period
+   * calls.
+   */
+  exhausted_t check(long generated){
+    if(cancelled) return CANCELLED;
+    if(!limited) return NOT_EXHAUSTED;
+    if(limits.max_constraints > 0 && charged + generated >= limits.max_constraints) return CONSTRAINTS;
+    if(++iterations % check_period) return NOT_EXHAUSTED;
+    return check_time_and_memory();
+  };
+
+  /* Same as check(generated), but always checks time and memory. */
+  exhausted_t check_now(long generated){
+    if(cancelled) return CANCELLED;
+    if(!limited) return NOT_EXHAUSTED;
+    if(limits.max_constraints > 0 && charged + generated >= limits.max_constraints) return CONSTRAINTS;
+    return check_time_and_memory();
+  };
+
+  /* Adds generated to the constraints counted against this budget
+   * by later checks. Used when an analysis charged to this budget
+   * has finished, and a new one, counting from zero, is started. */
+  void charge(long generated) { charged += generated; };
+
+  /* A human readable description of e. */
+  static std::string to_string(exhausted_t e);
+
+  static void set_limits(const limits_t &l) { limits = l; };
+  static const limits_t &get_limits() { return limits; };
+
+  /* Makes all budgets in this process report CANCELLED. Safe to call
+   * from a signal handler. */
+  static void cancel() { cancelled = 1; };
+  static bool is_cancelled() { return cancelled; };
+
+  static void test();
+private:
+  static limits_t limits;
+  static volatile std::sig_atomic_t cancelled;
+  static const long check_period;
+
+  bool limited;
+  long iterations;
+  /* The constraints generated by finished analyses (see charge) */
+  long charged;
+  Timer timer;
+
+  exhausted_t check_time_and_memory();
+};
+
+#endif
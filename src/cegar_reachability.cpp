@@ -18,7 +18,10 @@
  *
  */
 
+#include "budget.h"
 #include "cegar_reachability.h"
+#include "preprocessor.h"
+#include "test.h"
 
 std::string CegarReachability::Result::to_string() const{
   std::stringstream ss;
@@ -34,15 +37,28 @@ CegarReachability::Result *CegarReachability::reachability(Reachability::Arg *ar
 
   Reachability::Result *sub_result;
   Reachability::Arg *next_arg = cegarg->first_refinement;
+  /* All iterations are charged to one budget */
+  Budget own_budget;
+  Budget &budget = arg->budget ? *arg->budget : own_budget;
 
   bool done = false;
   while(!done && (cegarg->max_loop_count < 0 || result->loop_count < cegarg->max_loop_count)){
+    Budget::exhausted_t exhausted = budget.check_now(0);
+    if(exhausted != Budget::NOT_EXHAUSTED){
+      done = true;
+      result->result = Reachability::FAILURE;
+      result->failure_reason = Budget::to_string(exhausted);
+      delete next_arg;
+      break;
+    }
     Log::msg << "Refinement " << result->loop_count << ":\n" 
              << refinement_to_string(next_arg) << "\n" << std::flush;
     result->loop_count++;
+    next_arg->budget = &budget;
     sub_result = cegarg->abstract_reach->reachability(next_arg);
+    budget.charge(sub_result->generated_constraints);
     Log::msg << sub_result->to_string() << "\n";
-    Reachability::Arg *tmp_arg;
+    Reachability::Arg *tmp_arg = 0;
     switch(refine(sub_result,next_arg,cegarg,&tmp_arg)){
     case CORRECT:
       done = true;
@@ -61,6 +77,9 @@ CegarReachability::Result *CegarReachability::reachability(Reachability::Arg *ar
     case FAILURE:
       done = true;
       result->result = Reachability::FAILURE;
+      result->failure_reason = sub_result->failure_reason;
+      result->generated_constraints += sub_result->generated_constraints;
+      result->stored_constraints += sub_result->stored_constraints;
       break;
     }
     delete next_arg;
@@ -75,3 +94,77 @@ CegarReachability::Result *CegarReachability::reachability(Reachability::Arg *ar
   result->timer.stop();
   return result;
 };
+
+namespace{
+  /* Generates 40 constraints per run, charged to the budget of its
+   * argument, and reports every run as reachable. */
+  class TestReach : public Reachability{
+  public:
+    virtual Result *reachability(Arg *arg) const{
+      Result *result = new Result(arg->machine);
+      result->generated_constraints = 40;
+      Budget::exhausted_t exhausted = arg->budget ? arg->budget->check(40) : Budget::NOT_EXHAUSTED;
+      if(exhausted == Budget::NOT_EXHAUSTED){
+        result->result = REACHABLE;
+      }else{
+        result->result = FAILURE;
+        result->failure_reason = Budget::to_string(exhausted);
+      }
+      return result;
+    };
+  };
+
+  /* Refines every reachable result */
+  class TestCegar : public CegarReachability{
+  public:
+    virtual refinement_result_t refine(Reachability::Result *result,
+                                       Reachability::Arg *prev_arg,
+                                       CegarReachability::Arg *,
+                                       Reachability::Arg **next_arg) const{
+      if(result->result == Reachability::FAILURE) return FAILURE;
+      *next_arg = new Reachability::Arg(prev_arg->machine);
+      return REFINED;
+    };
+  };
+};
+
+void CegarReachability::test(){
+  std::stringstream ss("forbidden CS\n"
+                       "process\n"
+                       "text\n"
+                       "  CS: nop\n");
+  PPLexer lex(ss);
+  Machine m(Parser::p_test(lex));
+  Log::loglevel_t ll = Log::get_primary_loglevel();
+  Log::set_primary_loglevel(Log::loglevel_t(std::max(0,int(ll) - 1)));
+  Budget::limits_t saved_limits = Budget::get_limits();
+
+  /* Test 1: All iterations are charged to one budget */
+  {
+    Budget::limits_t l;
+    l.max_constraints = 100;
+    Budget::set_limits(l);
+    TestCegar cegar;
+    Arg arg(m,new TestReach(),new Reachability::Arg(m),10);
+    Result *res = cegar.reachability(&arg);
+    Test::inner_test("Shared budget",
+                     res->result == Reachability::FAILURE &&
+                     res->failure_reason == Budget::to_string(Budget::CONSTRAINTS) &&
+                     res->loop_count == 3 && res->generated_constraints == 120);
+    delete res;
+  }
+
+  /* Test 2: Without limits, the loop count limit applies */
+  {
+    Budget::set_limits(Budget::limits_t());
+    TestCegar cegar;
+    Arg arg(m,new TestReach(),new Reachability::Arg(m),10);
+    Result *res = cegar.reachability(&arg);
+    Test::inner_test("Loop count limit",
+                     res->result == Reachability::FAILURE && res->loop_count == 10);
+    delete res;
+  }
+
+  Budget::set_limits(saved_limits);
+  Log::set_primary_loglevel(ll);
+};
@@ -93,6 +93,8 @@ public:
   virtual std::string refinement_to_string(const Reachability::Arg *refinement) const{
     return ""; // Overload me!
   };
+
+  static void test();
 };
 
 #endif
@@ -136,8 +136,8 @@ Trace *ChannelBwd::convert_trace(Trace *trace, ChannelConstraint::Common *common
   return tso_trace;
 };
 
-void ChannelBwd::messages_lost(const std::vector<ChannelConstraint::Msg> &ch0,
-                               const std::vector<ChannelConstraint::Msg> &ch1,
+void ChannelBwd::messages_lost(const ChannelConstraint::Channel &ch0,
+                               const ChannelConstraint::Channel &ch1,
                                std::vector<int> *ch,
                                int w,
                                const ChannelConstraint::Common *common) const{
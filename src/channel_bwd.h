@@ -74,8 +74,8 @@ private:
    *
    * Afterwards, ch will correspond to ch1.
    */
-  void messages_lost(const std::vector<ChannelConstraint::Msg> &ch0,
-                     const std::vector<ChannelConstraint::Msg> &ch1,
+  void messages_lost(const ChannelConstraint::Channel &ch0,
+                     const ChannelConstraint::Channel &ch1,
                      std::vector<int> *ch,
                      int w,
                      const ChannelConstraint::Common *common) const;
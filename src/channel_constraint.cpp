@@ -65,6 +65,9 @@ std::string ChannelConstraint::Msg::to_short_string(const Common &common) const{
   return ss.str();
 };
 
+ChannelConstraint::Msg::Msg(Store s, int pid, NMLSet ms, const Common &common)
+  : store(s), wpid(pid), nmls(ms), nml_mask(common.nml_mask(nmls)) {};
+
 int ChannelConstraint::Msg::compare(const Msg &msg) const{
   if(wpid < msg.wpid){
     return -1;
@@ -156,7 +159,7 @@ ChannelConstraint::Store ChannelConstraint::Common::store_of_write(const Machine
 ChannelConstraint::ChannelConstraint(std::vector<int> pcs, const Common::MsgHdr &msg, Common &c)
   : common(c), pcs(pcs) {
   /* Initialize the channel with a single STAR filled message. */
-  channel.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls));
+  channel.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls,common));
   cpointers = std::vector<int>(pcs.size(),0);
   /* Initialize registers with STARs */
   for(unsigned p = 0; p < pcs.size(); p++){
@@ -237,9 +240,10 @@ void ChannelConstraint::process_to_string(int p, std::stringstream &ss) const no
 };
 
 int ChannelConstraint::index_of_read(Lang::NML nml, int pid) const{
+  NMLMask::mask_t bit = common.nml_bit(nml);
   int i = channel.size()-1;
   while(i > cpointers[pid]){
-    if(channel[i].wpid == pid && channel[i].nmls.count(nml)){
+    if(channel[i].wpid == pid && channel[i].writes(nml,bit)){
       return i;
     }
     i--;
@@ -257,16 +261,17 @@ std::vector<ChannelConstraint*> ChannelConstraint::channel_pop_back() const{
   if(channel.back().nmls.size() == 1){
     Lang::NML nml = channel.back().nmls[0];
     int nmli = common.index(nml);
+    NMLMask::mask_t bit = NMLMask::bit(nmli);
     int wpid = channel.back().wpid;
 
-    Msg new_msg(Store(channel.back().store.size()),wpid,VecSet<Lang::NML>::singleton(nml));
+    Msg new_msg(Store(channel.back().store.size()),wpid,VecSet<Lang::NML>::singleton(nml),common);
     std::vector<ChannelConstraint*> res;
     ChannelConstraint *chc;
     bool last_unifiable;
 
-    std::vector<Msg> ch0(channel);
+    Channel ch0(channel);
     ch0.pop_back();
-    ch0[ch0.size()-1].store = ch0[ch0.size()-1].store.unify(channel.back().store.assign(nmli,value_t::STAR),&last_unifiable);
+    ch0.modify(ch0.size()-1).store = ch0[ch0.size()-1].store.unify(channel.back().store.assign(nmli,value_t::STAR),&last_unifiable);
 
     if(last_unifiable){
       /* The case when there is no hidden message */
@@ -276,12 +281,8 @@ std::vector<ChannelConstraint*> ChannelConstraint::channel_pop_back() const{
 
       /* Guess a position to reinsert a hidden message. */
       for(int i = int(ch0.size())-1; i > 0; i--){
-        std::vector<Msg> ch1(ch0);
-        ch1.push_back(ch0.back());
-        for(int j = int(ch1.size()) - 2; j > i; j--){
-          ch1[j] = ch1[j-1];
-        }
-        ch1[i] = new_msg;
+        Channel ch1(ch0);
+        ch1.insert(ch1.begin()+i,new_msg);
         chc = this->clone();
         chc->channel = ch1;
         /* Update cpointers */
@@ -291,7 +292,7 @@ std::vector<ChannelConstraint*> ChannelConstraint::channel_pop_back() const{
           }
         }
         res.push_back(chc);
-        if(i > 0 && ch0[i-1].wpid == wpid && ch0[i-1].nmls.count(nml)){
+        if(i > 0 && ch0[i-1].wpid == wpid && ch0[i-1].writes(nml,bit)){
           break;
         }
       }
@@ -300,7 +301,7 @@ std::vector<ChannelConstraint*> ChannelConstraint::channel_pop_back() const{
     /* The case when the hidden message is the last of the new channel */
     {
       chc = this->clone();
-      chc->channel.back().store = chc->channel.back().store.assign(nmli,value_t::STAR);
+      chc->channel.modify(chc->channel.size()-1).store = chc->channel.back().store.assign(nmli,value_t::STAR);
       res.push_back(chc);
     }
 
@@ -442,8 +443,9 @@ bool ChannelConstraint::propagate_value_in_channel(const Lang::NML &nml, int nml
   return propagate_value_in_channel(&channel,nml,nmli);
 }
 
-bool ChannelConstraint::propagate_value_in_channel(std::vector<Msg> *ch, const Lang::NML &nml, int nmli){
+bool ChannelConstraint::propagate_value_in_channel(Channel *ch, const Lang::NML &nml, int nmli){
   value_t val = value_t::STAR;
+  NMLMask::mask_t bit = NMLMask::bit(nmli);
   int i;
   for(i = int(ch->size())-1; i >= 0; --i){
     if(val == value_t::STAR){
@@ -454,7 +456,7 @@ bool ChannelConstraint::propagate_value_in_channel(std::vector<Msg> *ch, const L
         return false;
       }
     }
-    if((*ch)[i].nmls.count(nml) > 0){
+    if((*ch)[i].writes(nml,bit)){
       /* Found the last write to nml */
       /* Stop searching */
       break;
@@ -465,7 +467,7 @@ bool ChannelConstraint::propagate_value_in_channel(std::vector<Msg> *ch, const L
     if(i == -1) i = 0;
     for( ; i < int(ch->size()); ++i){
       if((*ch)[i].store[nmli] == value_t::STAR){
-        (*ch)[i].store = (*ch)[i].store.assign(nmli,val);
+        ch->modify(i).store = (*ch)[i].store.assign(nmli,val);
       }
     }
   }
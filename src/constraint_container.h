@@ -25,6 +25,8 @@
 #include "machine.h"
 #include "trace.h"
 
+#include <stdexcept>
+
 /* A ConstraintContainer is meant to be used for state space
  * exploration.
  *
@@ -98,8 +100,36 @@ public:
    * that occur in the returned trace.
    */
   virtual Trace *clear_and_get_trace(Constraint *c) = 0;
+  /* Returns a trace starting at a root constraint and leading to c
+   * through F. The trace consists of copies of the constraints in F,
+   * and F and Q are left unchanged.
+   *
+   * Not supported by all implementations. The default implementation
+   * throws an exception.
+   */
+  virtual Trace *get_trace(Constraint *c){
+    throw new std::logic_error("ConstraintContainer::get_trace: Not supported.");
+  };
   /* Clears F and Q. Deallocates all Constraints in F. */
   virtual void clear() = 0;
+
+  /* Counters describing the work done by the container since its
+   * creation. Counters that are not supported by an implementation
+   * stay 0. */
+  struct counters_t{
+    counters_t() : subsumed(0), invalidated(0), max_weight(0) {};
+    /* The number of inserted constraints that were already present
+     * in F */
+    long subsumed;
+    /* The number of constraints removed from F because they were
+     * subsumed by an inserted constraint */
+    long invalidated;
+    /* The largest weight of any constraint inserted into F */
+    int max_weight;
+  };
+  const counters_t &get_counters() const { return counters; };
+protected:
+  counters_t counters;
 };
 
 #endif
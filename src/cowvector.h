@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __COW_VECTOR_H__
+#define __COW_VECTOR_H__
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/* A cowvector is a sequence with the same interface as a subset of
+ * std::vector, where the elements are shared between copies.
+ *
+ * Copying a cowvector copies only pointers to its elements. An
+ * element is copied first when it is modified through a cowvector
+ * that shares it with some other cowvector (copy-on-write). Hence
+ * modifying one element, pushing, popping or inserting an element in
+ * a copy of a cowvector copies at most one element.
+ *
+ * Elements can only be accessed through const references, except
+ * through modify, which unshares the element before returning it.
+ *
+ * Different cowvectors sharing elements may be used concurrently by
+ * different threads.
+ */
+template<class T> class cowvector{
+private:
+  typedef std::vector<std::shared_ptr<T> > spine_t;
+public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+
+  class const_iterator{
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef const T &reference;
+    const_iterator() {};
+    const T &operator*() const { return **it; };
+    const T *operator->() const { return it->get(); };
+    const T &operator[](difference_type n) const { return *it[n]; };
+    const_iterator &operator++() { ++it; return *this; };
+    const_iterator operator++(int) { const_iterator i = *this; ++it; return i; };
+    const_iterator &operator--() { --it; return *this; };
+    const_iterator operator--(int) { const_iterator i = *this; --it; return i; };
+    const_iterator &operator+=(difference_type n) { it += n; return *this; };
+    const_iterator &operator-=(difference_type n) { it -= n; return *this; };
+    const_iterator operator+(difference_type n) const { return const_iterator(it+n); };
+    const_iterator operator-(difference_type n) const { return const_iterator(it-n); };
+    difference_type operator-(const const_iterator &i) const { return it - i.it; };
+    bool operator==(const const_iterator &i) const { return it == i.it; };
+    bool operator!=(const const_iterator &i) const { return it != i.it; };
+    bool operator<(const const_iterator &i) const { return it < i.it; };
+  private:
+    const_iterator(typename spine_t::const_iterator it) : it(it) {};
+    typename spine_t::const_iterator it;
+    friend class cowvector<T>;
+  };
+  typedef const_iterator iterator;
+
+  /* Constructors */
+  cowvector() {};
+  cowvector(size_type n, const T &value);
+  template<class InputIterator> cowvector(InputIterator first, InputIterator last);
+
+  /* Iterators */
+  const_iterator begin() const { return const_iterator(spine.begin()); };
+  const_iterator end() const { return const_iterator(spine.end()); };
+
+  /* Capacity */
+  bool empty() const { return spine.empty(); };
+  size_type size() const { return spine.size(); };
+  /* Pre: sz <= size() */
+  void resize(size_type sz);
+
+  /* Element access */
+  const T &operator[](size_type i) const { return *spine[i]; };
+  const T &front() const { return *spine.front(); };
+  const T &back() const { return *spine.back(); };
+  /* Returns a reference to element i, which is not shared with any
+   * other cowvector. The reference is invalidated by any copying
+   * of, or modification to, this cowvector. */
+  T &modify(size_type i);
+
+  /* Modifiers */
+  void push_back(const T &x) { spine.push_back(std::make_shared<T>(x)); };
+  void pop_back() { spine.pop_back(); };
+  const_iterator insert(const_iterator position, const T &x);
+  const_iterator erase(const_iterator position);
+  void clear() { spine.clear(); };
+
+  /* Comparison
+   *
+   * Compares lexicographically, as std::vector. Elements shared by
+   * both cowvectors are equal without being compared. */
+  bool operator==(const cowvector &cv) const;
+  bool operator!=(const cowvector &cv) const { return !(*this == cv); };
+  bool operator<(const cowvector &cv) const;
+
+  static void test();
+private:
+  spine_t spine;
+};
+
+#include "cowvector.tcc"
+
+#endif // __COW_VECTOR_H__
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "test.h"
+
+#include <cassert>
+#include <string>
+
+template<class T> cowvector<T>::cowvector(size_type n, const T &value){
+  if(n){
+    std::shared_ptr<T> p = std::make_shared<T>(value);
+    spine.resize(n,p);
+  }
+};
+
+template<class T> template<class InputIterator>
+cowvector<T>::cowvector(InputIterator first, InputIterator last){
+  for(; first != last; ++first){
+    push_back(*first);
+  }
+};
+
+template<class T> void cowvector<T>::resize(size_type sz){
+  assert(sz <= spine.size());
+  spine.erase(spine.begin()+sz,spine.end());
+};
+
+template<class T> T &cowvector<T>::modify(size_type i){
+  assert(i < spine.size());
+  if(spine[i].use_count() > 1){
+    spine[i] = std::make_shared<T>(*spine[i]);
+  }
+  return *spine[i];
+};
+
+template<class T> typename cowvector<T>::const_iterator
+cowvector<T>::insert(const_iterator position, const T &x){
+  typename spine_t::iterator it =
+    spine.insert(spine.begin() + (position.it - spine.cbegin()),std::make_shared<T>(x));
+  return const_iterator(it);
+};
+
+template<class T> typename cowvector<T>::const_iterator
+cowvector<T>::erase(const_iterator position){
+  typename spine_t::iterator it =
+    spine.erase(spine.begin() + (position.it - spine.cbegin()));
+  return const_iterator(it);
+};
+
+template<class T> bool cowvector<T>::operator==(const cowvector &cv) const{
+  if(spine.size() != cv.spine.size()) return false;
+  for(unsigned i = 0; i < spine.size(); ++i){
+    if(spine[i] != cv.spine[i] && !(*spine[i] == *cv.spine[i])){
+      return false;
+    }
+  }
+  return true;
+};
+
+template<class T> bool cowvector<T>::operator<(const cowvector &cv) const{
+  for(unsigned i = 0; i < spine.size() && i < cv.spine.size(); ++i){
+    if(spine[i] == cv.spine[i]) continue;
+    if(*spine[i] < *cv.spine[i]) return true;
+    if(*cv.spine[i] < *spine[i]) return false;
+  }
+  return spine.size() < cv.spine.size();
+};
+
+template<class T> void cowvector<T>::test(){
+  /* Test 1: Copying shares the elements */
+  {
+    cowvector<std::string> a;
+    a.push_back("x");
+    a.push_back("y");
+    cowvector<std::string> b(a);
+    Test::inner_test("Copy shares elements",
+                     b == a && &b[0] == &a[0] && &b[1] == &a[1]);
+  }
+
+  /* Test 2: Writing to a copy does not change the other copy */
+  {
+    cowvector<std::string> a;
+    a.push_back("x");
+    a.push_back("y");
+    cowvector<std::string> b(a);
+    const std::string *a0 = &a[0];
+    b.modify(0) = "z";
+    b.push_back("w");
+    Test::inner_test("Write after copy",
+                     a.size() == 2 && a[0] == "x" && a[1] == "y" && &a[0] == a0 &&
+                     b.size() == 3 && b[0] == "z" && b[1] == "y" && b[2] == "w" &&
+                     &b[0] != a0 && &b[1] == &a[1] && a != b);
+  }
+
+  /* Test 3: Writing to an unshared element does not copy it */
+  {
+    cowvector<std::string> a;
+    a.push_back("x");
+    const std::string *a0 = &a[0];
+    std::string &r = a.modify(0);
+    r = "z";
+    bool ok = &r == a0 && a[0] == "z";
+    {
+      /* Once a copy is gone, the element is unshared again */
+      cowvector<std::string> b(a);
+    }
+    ok = ok && &a.modify(0) == a0;
+    Test::inner_test("Write while unshared",ok);
+  }
+
+  /* Test 4: Elements filled in by the constructor are shared, and are
+   * unshared one at a time */
+  {
+    cowvector<std::string> a(3,"x");
+    a.modify(1) = "y";
+    Test::inner_test("Filled elements",
+                     a[0] == "x" && a[1] == "y" && a[2] == "x" &&
+                     &a[0] == &a[2] && &a[0] != &a[1]);
+  }
+};
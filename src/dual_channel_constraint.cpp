@@ -44,6 +44,9 @@ std::string DualChannelConstraint::Msg::to_short_string(const Common &common) co
   return ss.str();
 }
 
+DualChannelConstraint::Msg::Msg(Store s, int pid, NMLSet ms, const Common &common)
+  : store(s), wpid(pid), nmls(ms), nml_mask(common.nml_mask(nmls)) {}
+
 int DualChannelConstraint::Msg::compare(const Msg &msg) const{
   if(wpid < msg.wpid){
     return -1;
@@ -158,9 +161,9 @@ DualChannelConstraint::Store DualChannelConstraint::Common::store_of_write(const
 DualChannelConstraint::DualChannelConstraint(std::vector<int> pcs, const Common::MsgHdr &msg, Common &c)
 : pcs(pcs), common(c) {
   for(int ci=0; ci<pcs.size(); ci++) {
-    std::vector<Msg> chni;
+    Channel chni;
     if(ci==msg.wpid) {
-      chni.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls));
+      chni.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls,common));
     }
     channels.push_back(chni);
   }
@@ -173,7 +176,7 @@ DualChannelConstraint::DualChannelConstraint(std::vector<int> pcs, const Common:
 DualChannelConstraint::DualChannelConstraint(std::vector<int> pcs, Common &c)
 : pcs(pcs), common(c) {
   for(int ci=0; ci<pcs.size(); ci++) {
-    std::vector<Msg> chni;
+    Channel chni;
     channels.push_back(chni);
   }
   mems.push_back(Store(common.mem_size));
@@ -295,16 +298,17 @@ void DualChannelConstraint::process_to_string(int p, std::stringstream &ss) cons
 // return number>=0 for newest element by own writing
 // return -2 for empty channel
 int DualChannelConstraint::index_of_read(Lang::NML nml, int pid) const{
+  NMLMask::mask_t bit = common.nml_bit(nml);
   int i = channels[pid].size()-1;
   while(i>=0) {
-    if(channels[pid][i].wpid == pid && channels[pid][i].nmls.count(nml)){
+    if(channels[pid][i].wpid == pid && channels[pid][i].writes(nml,bit)){
       return i;
     }
     i--;
   }
   
   if (channels[pid].size()>0) {
-    if(channels[pid][0].wpid == -1 && channels[pid][0].nmls.count(nml)!=0) {
+    if(channels[pid][0].wpid == -1 && channels[pid][0].writes(nml,bit)) {
       return -1;
     }
   }
@@ -371,7 +375,7 @@ Constraint::Comparison DualChannelConstraint::entailment_compare_channels(const
               }
               if(channels[ci][i].wpid == ci) {
                 has_written_this.insert(channels[ci][i].nmls);
-                if (channels[ci][i].nmls == dcc.channels[ci][j].nmls &&
+                if (channels[ci][i].same_nmls(dcc.channels[ci][j]) &&
                     !Constraint::comb_comp(Constraint::LESS,dcc.channels[ci][j].entailment_compare(channels[ci][i])) )
                 {
                   found = 1;
@@ -392,7 +396,7 @@ Constraint::Comparison DualChannelConstraint::entailment_compare_channels(const
               if(i < j) return Constraint::INCOMPARABLE;
               if(channels[ci][i].wpid == ci) has_written_this.insert(channels[ci][i].nmls);
               
-              if (channels[ci][i].nmls == dcc.channels[ci][j].nmls && channels[ci][i].wpid == dcc.channels[ci][j].wpid &&
+              if (channels[ci][i].same_nmls(dcc.channels[ci][j]) && channels[ci][i].wpid == dcc.channels[ci][j].wpid &&
                   !Constraint::comb_comp(Constraint::LESS,dcc.channels[ci][j].entailment_compare(channels[ci][i])) ) {
                 found = 1;
                 i--;
@@ -437,7 +441,7 @@ Constraint::Comparison DualChannelConstraint::entailment_compare_channels(const
               }
               if(dcc.channels[ci][j].wpid == ci) {
                 has_written_dcc.insert(dcc.channels[ci][j].nmls);
-                if (dcc.channels[ci][j].nmls == channels[ci][i].nmls &&
+                if (dcc.channels[ci][j].same_nmls(channels[ci][i]) &&
                     !Constraint::comb_comp(Constraint::LESS,channels[ci][i].entailment_compare(dcc.channels[ci][j])) )
                 {
                   found = 1;
@@ -458,7 +462,7 @@ Constraint::Comparison DualChannelConstraint::entailment_compare_channels(const
               if(j < i) return Constraint::INCOMPARABLE;
               if(dcc.channels[ci][j].wpid == ci) has_written_dcc.insert(dcc.channels[ci][j].nmls);
 
-              if (dcc.channels[ci][j].nmls == channels[ci][i].nmls && dcc.channels[ci][j].wpid == channels[ci][i].wpid &&
+              if (dcc.channels[ci][j].same_nmls(channels[ci][i]) && dcc.channels[ci][j].wpid == channels[ci][i].wpid &&
                   !Constraint::comb_comp(Constraint::LESS,channels[ci][i].entailment_compare(dcc.channels[ci][j])) ) {
                 found = 1;
                 j--;
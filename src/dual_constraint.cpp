@@ -130,6 +130,9 @@ DualConstraint::Common::Common(const Machine &m)
   for(unsigned i = 0; i < all_transitions.size(); ++i){
     transitions_by_pc[all_transitions[i].pid][all_transitions[i].target].push_back(&all_transitions[i]);
   }
+
+  /* Lower all transitions */
+  codes.init(all_transitions,[this](const Lang::NML &nml){ return index(nml); },mem_size);
 };
 
 template<class T>
@@ -192,14 +195,15 @@ std::list<const Machine::PTransition*> DualConstraint::partred() const{
 
 
 
-std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTransition &t, bool locked) const{
+std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const TransitionCode &c, bool locked) const{
   std::list<pre_constr_t> res;
+  const Machine::PTransition &t = c.transition;
   const Lang::Stmt<int> &s = t.instruction;
   if(pcs[t.pid] != t.target){
     return res;
   }
 
-  switch(s.get_type()){
+  switch(c.op){
       
   case Lang::NOP: // nop
   {    
@@ -222,7 +226,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                                               t.pid,
                                               s.get_expr(),
                                               reg_val);
-      std::set<int> regs = s.get_expr().get_registers();
+      const std::set<int> &regs = c.expr_regs;
       // get STAR registers that not in expr e and register r to STAR
       VecSet<Store> correct_rss;
       for (int rssi=0; rssi<rss.size(); rssi++) {
@@ -249,7 +253,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
   case Lang::ASSUME: // assume: e;
   {    
     VecSet<Store> rstores = possible_reg_stores(reg_stores[t.pid],t.pid,s.get_condition());
-    std::set<int> regs = s.get_condition().get_registers();
+    const std::set<int> &regs = c.expr_regs;
     // get STAR registers that not in expr from 0 to STAR
     VecSet<Store> correct_rstores;
     for (int rsi=0; rsi<rstores.size(); rsi++) {
@@ -274,8 +278,8 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
   case Lang::PROPAGATE: // propagate from mem to process t.pid
   {    
     bool ok_nmls = false;
-    Lang::NML nml(s.get_memloc(),t.pid);
-    int nmli = common.index(nml);
+    const Lang::NML &nml = c.nml;
+    int nmli = c.nmli;
     int relation = -1;
     
     if (channels[t.pid].size()>0) {
@@ -302,7 +306,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
     if(ok_nmls){
       DualConstraint *sbc = new DualConstraint(*this);
       sbc->pcs[t.pid] = t.source;
-      std::vector<Msg> ch0(sbc->channels[t.pid]);
+      Channel ch0(sbc->channels[t.pid]);
       ch0.pop_back();
       sbc->channels[t.pid] = ch0;
       if (relation == 1) { // set mems[0][nmli]
@@ -317,10 +321,9 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
   {    
     /* Check if the locked block contains writes.
      * If so, it is fencing. */
-    if(s.get_writes().size() == 0 || channels[t.pid].size() == 0){
-      for(int i = 0; i < s.get_statement_count(); ++i){ // s can only contain single or sequence
-        Machine::PTransition ti(t.source,*s.get_statement(i),t.target,t.pid);
-        std::list<pre_constr_t> v = pre(ti,true);
+    if(!c.has_writes() || channels[t.pid].size() == 0){
+      for(const TransitionCode &ci : c.children){ // s can only contain single or sequence
+        std::list<pre_constr_t> v = pre(ci,true);
         res.insert(res.end(),v.begin(),v.end());
       }
     }
@@ -329,10 +332,11 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
       
   case Lang::DELETEE:
   {    
-    Lang::NML nml(s.get_memloc(),t.pid);
+    const Lang::NML &nml = c.nml;
+    NMLMask::mask_t bit = common.nml_bit(nml);
     bool own_exist = false;
     for (int mi = 0; mi < channels[t.pid].size(); mi++) {
-      if (channels[t.pid][mi].nmls.count(nml)!=0 && channels[t.pid][mi].wpid == t.pid) {
+      if (channels[t.pid][mi].writes(nml,bit) && channels[t.pid][mi].wpid == t.pid) {
         own_exist = true;
         break;
       }
@@ -344,7 +348,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
       
       if (t.pid==s.get_writer()) { //insert an own message
         DualConstraint *sbc = new DualConstraint(*this);
-        Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml));
+        Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml),common);
         sbc->channels[t.pid].insert(sbc->channels[t.pid].begin(), msg);
         res.push_back(sbc);
       }
@@ -354,8 +358,8 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
       
   case Lang::READASSERT:  // read: x = e. Allow read from mem if empty buffer
   {
-    Lang::NML nml(s.get_memloc(),t.pid);
-    int nmli = common.index(nml);
+    const Lang::NML &nml = c.nml;
+    int nmli = c.nmli;
     int msgi = index_of_read(nml,t.pid);
     bool hidden = true;
     VecSet<Store> rss, correct_rss;
@@ -379,7 +383,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                                 s.get_expr(),
                                 val_nml);
       assert(rss.size());
-      std::set<int> regs = s.get_expr().get_registers();
+      const std::set<int> &regs = c.expr_regs;
       // get STAR registers that not in expr from 0 to STAR
       for (int rssi=0; rssi<rss.size(); rssi++) {
         Store st = rss[rssi];
@@ -413,7 +417,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                                                         t.pid,
                                                         s.get_expr(),
                                                         val_es[vei]);
-          std::set<int> regs = s.get_expr().get_registers();
+          const std::set<int> &regs = c.expr_regs;
           // get STAR registers that not in expr from 0 to STAR
           VecSet<Store> correct_val_regss;
           for (int vri=0; vri<val_regss.size(); vri++) {
@@ -432,10 +436,10 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
             sbc->reg_stores[t.pid] = correct_val_regss[vri];
             
             if(msgi==-1) { // restrict mem
-              sbc->channels[t.pid][0].store = sbc->channels[t.pid][0].store.assign(0,val_es[vei]);
+              sbc->channels[t.pid].modify(0).store = sbc->channels[t.pid][0].store.assign(0,val_es[vei]);
               res.push_back(sbc);
             } else if (msgi>=0) {
-              sbc->channels[t.pid][msgi].store = sbc->channels[t.pid][msgi].store.assign(0,val_es[vei]);
+              sbc->channels[t.pid].modify(msgi).store = sbc->channels[t.pid][msgi].store.assign(0,val_es[vei]);
               res.push_back(sbc);
             } else if (sbc->channels[t.pid].size()==0) { //only for an empty channel
               sbc->mems[0] = sbc->mems[0].assign(nmli,val_es[vei]);
@@ -457,7 +461,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                                                       s.get_expr(),
                                                       val_es[vei]);
         
-        std::set<int> regs = s.get_expr().get_registers();
+        const std::set<int> &regs = c.expr_regs;
         // get STAR registers that not in expr from 0 to STAR
         VecSet<Store> correct_val_regss;
         for (int vri=0; vri<val_regss.size(); vri++) {
@@ -475,7 +479,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
           sbc->pcs[t.pid] = t.source;
           sbc->reg_stores[t.pid] = correct_val_regss[vri];
 
-          Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml));
+          Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml),common);
           if (sbc->channels[t.pid].size()>0) {
             sbc->channels[t.pid].insert(sbc->channels[t.pid].begin(),msg);
           } else {
@@ -490,8 +494,8 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
       
   case Lang::READASSIGN: // read: r = x. Allow read from mem if empty buffer
   {    
-    Lang::NML nml(s.get_memloc(),t.pid);
-    int nmli = common.index(nml);
+    const Lang::NML &nml = c.nml;
+    int nmli = c.nmli;
     int msgi = index_of_read(nml,t.pid);
     
     int reg_val = reg_stores[t.pid][s.get_reg()].get_int();
@@ -525,10 +529,10 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
 
         if (is_star) { // restrict mem
           if(msgi==-1) {
-            sbc->channels[t.pid][0].store = sbc->channels[t.pid][0].store.assign(0,reg_val);
+            sbc->channels[t.pid].modify(0).store = sbc->channels[t.pid][0].store.assign(0,reg_val);
             res.push_back(sbc);
           } else if (msgi>=0) {
-            sbc->channels[t.pid][msgi].store = sbc->channels[t.pid][msgi].store.assign(0,reg_val);
+            sbc->channels[t.pid].modify(msgi).store = sbc->channels[t.pid][msgi].store.assign(0,reg_val);
             res.push_back(sbc);
           } else if (sbc->channels[t.pid].size()==0) { //only for an empty channel
             sbc->mems[0] = sbc->mems[0].assign(nmli,reg_val);
@@ -550,7 +554,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
         sbc->pcs[t.pid] = t.source;
         sbc->reg_stores[t.pid] = sbc->reg_stores[t.pid].assign(s.get_reg(), value_t::STAR);
 
-        Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml));
+        Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml),common);
         if (sbc->channels[t.pid].size()>0) {
           sbc->channels[t.pid].insert(sbc->channels[t.pid].begin(),msg);
         } else {
@@ -570,11 +574,11 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
   {    
     std::vector<pre_constr_t> v;
     v.push_back(pre_constr_t(new DualConstraint(*this)));
-    for(int i = s.get_statement_count()-1; i >= 0; --i){
+    for(int i = int(c.children.size())-1; i >= 0; --i){
       std::vector<pre_constr_t> w;
-      Machine::PTransition t2(t.target,*s.get_statement(i),t.target,t.pid);
+      const TransitionCode &c2 = c.children[i];
       for(unsigned j = 0; j < v.size(); ++j){
-        std::list<pre_constr_t> l = v[j].sbc->pre(t2,locked);
+        std::list<pre_constr_t> l = v[j].sbc->pre(c2,locked);
         for(auto it = l.begin(); it != l.end(); ++it){
           it->pop_back = it->pop_back || v[j].pop_back;
           it->written_nmls.insert(v[j].written_nmls);
@@ -596,8 +600,8 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
   
   case Lang::WRITE: // x = e
   {    
-    Lang::NML nml = Lang::NML(s.get_memloc(),t.pid);
-    int nmli = common.index(nml);
+    const Lang::NML &nml = c.nml;
+    int nmli = c.nmli;
     
     int relation = -1;
     bool conflict = false;
@@ -649,7 +653,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
           sbc->mems[0] = new_mem;
 
           if(!locked) {
-            std::vector<Msg> ch0(sbc->channels[t.pid]);
+            Channel ch0(sbc->channels[t.pid]);
             assert(ch0.size());
             ch0.pop_back();
             sbc->channels[t.pid] = ch0;
@@ -664,14 +668,14 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
             v.push_back(value_t::STAR);
             Store st = Store(v);
             
-            Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml));
+            Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml),common);
             
             //insert to the end of the channels
             DualConstraint *sbc = new DualConstraint(*this);
             sbc->pcs[t.pid] = t.source;
             sbc->mems[0] = new_mem;
           
-            std::vector<Msg> ch0(channels[t.pid]);
+            Channel ch0(channels[t.pid]);
             ch0.pop_back();
             ch0.push_back(msg);
             sbc->channels[t.pid] = ch0;
@@ -686,7 +690,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                 DualConstraint *sbc = new DualConstraint(*this);
                 sbc->pcs[t.pid] = t.source;
             
-                std::vector<Msg> ch0(channels[t.pid]);
+                Channel ch0(channels[t.pid]);
                 ch0.pop_back();
                 ch0.insert(ch0.begin()+it, msg);
                 sbc->mems[0] = new_mem;
@@ -700,7 +704,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
           }
       } else { // restrict registers
         VecSet<Store> rstores = possible_reg_stores(reg_stores[t.pid],t.pid,s.get_expr(),nml_val);
-        std::set<int> regs = s.get_expr().get_registers();
+        const std::set<int> &regs = c.expr_regs;
         // get STAR registers that not in expr e and register r to STAR
         VecSet<Store> correct_rstores;
         for (int rssi=0; rssi<rstores.size(); rssi++) {
@@ -723,7 +727,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
           sbc->reg_stores[t.pid] = correct_rstores[rssi];
         
           if(!locked) {
-            std::vector<Msg> ch0(sbc->channels[t.pid]);
+            Channel ch0(sbc->channels[t.pid]);
             assert(ch0.size()>0);
             ch0.pop_back();
             sbc->channels[t.pid] = ch0;
@@ -738,7 +742,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
             v.push_back(value_t::STAR);
             Store st = Store(v);
             
-            Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml));
+            Msg msg(st,t.pid,VecSet<Lang::NML>::singleton(nml),common);
             
             //insert to the end of the channels
             DualConstraint *sbc = new DualConstraint(*this);
@@ -746,7 +750,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
             sbc->mems[0] = new_mem;
             sbc->reg_stores[t.pid] = correct_rstores[rssi];
           
-            std::vector<Msg> ch0(channels[t.pid]);
+            Channel ch0(channels[t.pid]);
             ch0.pop_back();
             ch0.push_back(msg);
             sbc->channels[t.pid] = ch0;
@@ -761,7 +765,7 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
                 DualConstraint *sbc = new DualConstraint(*this);
                 sbc->pcs[t.pid] = t.source;
                 
-                std::vector<Msg> ch0(channels[t.pid]);
+                Channel ch0(channels[t.pid]);
                 ch0.pop_back();
                 ch0.insert(ch0.begin()+it, msg);
                 sbc->reg_stores[t.pid] = correct_rstores[rssi];
@@ -789,7 +793,8 @@ std::list<DualConstraint::pre_constr_t> DualConstraint::pre(const Machine::PTran
 
 std::list<Constraint*> DualConstraint::pre(const Machine::PTransition &t) const{
   std::list<Constraint*> res;
-  std::list<DualConstraint::pre_constr_t> r = pre(t,false);
+  std::unique_ptr<TransitionCode> tmp;
+  std::list<DualConstraint::pre_constr_t> r = pre(common.codes.get(t,tmp),false);
   for(auto it = r.begin(); it != r.end(); ++it){
     if(1){
       res.push_back(it->sbc);
@@ -852,6 +857,24 @@ void DualConstraint::Common::test(){
     }else{
       std::cout << "Test1: Failure\n";
     }
+
+    /* Test 2: Check NML masks of messages */
+    Msg mx(Store(common.mem_size),0,x,common);
+    Msg mxz(Store(common.mem_size),0,xz,common);
+    Msg myz(Store(common.mem_size),0,yz,common);
+    Msg mxz2(Store(common.mem_size),1,xz,common);
+    Lang::NML z = Lang::NML::local(0,0);
+    if(mx.writes(x[0],common.nml_bit(x[0])) && !mx.writes(z,common.nml_bit(z)) &&
+       mxz.writes(z,common.nml_bit(z)) && myz.writes(z,common.nml_bit(z)) &&
+       !myz.writes(x[0],common.nml_bit(x[0])) &&
+       mxz.same_nmls(mxz2) && !mxz.same_nmls(myz) && !mx.same_nmls(mxz) &&
+       NMLMask::may_be_subset(mx.nml_mask,mxz.nml_mask) &&
+       !NMLMask::may_be_subset(mxz.nml_mask,myz.nml_mask) &&
+       mxz.nml_mask == (common.nml_bit(x[0]) | common.nml_bit(z))){
+      std::cout << "Test2: Success!\n";
+    }else{
+      std::cout << "Test2: Failure\n";
+    }
   }
 }
 
@@ -1035,7 +1058,7 @@ void DualConstraint::test_pre(){
     DualConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::write(Lang::MemLoc<int>::global(0),
                                                     Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-    Msg msg(Store(1),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(1),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channels[0].push_back(msg);
     sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
     std::cout << "Initial:\n" << sbc.to_string() << "\n";
@@ -1054,7 +1077,7 @@ void DualConstraint::test_pre(){
     DualConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::locked_write(Lang::MemLoc<int>::global(0),
                                                             Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-    Msg msg(Store(1),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(1),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channels[0].push_back(msg);
     sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
     std::cout << "Initial:\n" << sbc.to_string() << "\n";
@@ -1123,7 +1146,7 @@ void DualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       DualConstraint sbc0(pcs,common);
       DualConstraint sbc1(pcs,common);
-      Msg msg0(Store(6),0,us);
+      Msg msg0(Store(6),0,us,common);
       //Msg msg1(Store(6),1,us);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg0);
@@ -1140,14 +1163,14 @@ void DualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       DualConstraint sbc0(pcs,common);
       DualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc1.channels[0][1].wpid = 1;
+      sbc1.channels[0].modify(1).wpid = 1;
       test("Test2a",sbc0.entailment_compare(sbc1) != Constraint::EQUAL);
       test("Test2b",sbc1.entailment_compare(sbc0) != Constraint::EQUAL);
       test("Test2c",sbc0.characterize_channels() == sbc1.characterize_channels());
@@ -1159,7 +1182,7 @@ void DualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       DualConstraint sbc0(pcs,common);
       DualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
@@ -1177,15 +1200,15 @@ void DualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       DualConstraint sbc0(pcs,common);
       DualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc0.channels[0][0].store = sbc0.channels[0][0].store.assign(0,0);
-      sbc1.channels[0][0].store = sbc1.channels[0][0].store.assign(0,0).assign(1,1);
+      sbc0.channels[0].modify(0).store = sbc0.channels[0][0].store.assign(0,0);
+      sbc1.channels[0].modify(0).store = sbc1.channels[0][0].store.assign(0,0).assign(1,1);
       test("Test4a",sbc0.entailment_compare(sbc1) == Constraint::LESS);
       test("Test4b",sbc1.entailment_compare(sbc0) == Constraint::GREATER);
       test("Test4c",sbc0.characterize_channels() == sbc1.characterize_channels());
@@ -1197,15 +1220,15 @@ void DualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       DualConstraint sbc0(pcs,common);
       DualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc0.channels[0][0].store = sbc0.channels[0][0].store.assign(0,0).assign(1,1);
-      sbc1.channels[0][0].store = sbc1.channels[0][0].store.assign(0,0);
+      sbc0.channels[0].modify(0).store = sbc0.channels[0][0].store.assign(0,0).assign(1,1);
+      sbc1.channels[0].modify(0).store = sbc1.channels[0][0].store.assign(0,0);
       test("Test5a",sbc0.entailment_compare(sbc1) == Constraint::INCOMPARABLE);
       test("Test5b",sbc1.entailment_compare(sbc0) == Constraint::INCOMPARABLE);
       test("Test5c",sbc0.characterize_channels() == sbc1.characterize_channels());
@@ -24,6 +24,7 @@
 #include "dual_channel_constraint.h"
 #include "constraint.h"
 #include "machine.h"
+#include "transition_code.h"
 #include "vecset.h"
 #include "dual_zstar.h"
 
@@ -57,6 +58,8 @@ public:
      * and has target state pc.
      */
     std::vector<std::vector<std::vector<const Machine::PTransition*> > > transitions_by_pc;
+    /* The lowered transitions of all_transitions */
+    TransitionTable codes;
     
     friend class DualConstraint;
     friend class DualTsoBwd;
@@ -95,7 +98,7 @@ private:
     VecSet<Lang::NML> written_nmls; // NML that were written
   };
 
-  virtual std::list<pre_constr_t> pre(const Machine::PTransition &, bool locked) const;
+  virtual std::list<pre_constr_t> pre(const TransitionCode &, bool locked) const;
 
   friend class Common;
   friend class DualTsoBwd;
@@ -126,7 +126,7 @@ template<class Z> inline DualZStar<Z>::Vector::Vector(const std::vector<Z> &v){
 
 template<class Z> inline DualZStar<Z>::Vector::Vector(const DualZStar<Z>::Vector &v){
   vec = v.vec;
-  vec[0] = vec[0] + DualZStar<Z>(1);
+  retain_vec();
   assert(int(vec[0]) > 1);
 };
 
@@ -146,7 +146,7 @@ DualZStar<Z>::Vector::operator=(const DualZStar<Z>::Vector &v){
     assert(int(v.vec[0]) > 0);
     release_vec();
     vec = v.vec;
-    vec[0] = vec[0] + DualZStar<Z>(1);
+    retain_vec();
     assert(int(vec[0]) > 1);
   }
   return *this;
@@ -234,13 +234,16 @@ template<class Z> inline int DualZStar<Z>::Vector::compare(const DualZStar<Z>::V
 template<class Z> inline void DualZStar<Z>::Vector::release_vec(){
   assert(vec != 0);
   assert(int(vec[0]) > 0);
-  vec[0] = vec[0] - DualZStar<Z>(1);
-  if(vec[0].get_int() == 0){
+  if(__atomic_sub_fetch(&vec[0].z,1,__ATOMIC_ACQ_REL) == 0){
     delete[] vec;
   }
   vec = 0;
 };
 
+template<class Z> inline void DualZStar<Z>::Vector::retain_vec(){
+  __atomic_add_fetch(&vec[0].z,1,__ATOMIC_RELAXED);
+};
+
 template<class Z> Constraint::Comparison 
 DualZStar<Z>::Vector::entailment_compare(const DualZStar<Z>::Vector &v) const{
   if(size() != v.size()){
@@ -272,50 +275,92 @@ template<class Z> std::string DualZStar<Z>::Vector::to_string() const throw(){
 };
 
 template<class Z>
-VecSet<typename DualZStar<Z>::Vector> 
-DualZStar<Z>::Vector::possible_regs(const Lang::Expr<int> &e, int value,
-                                const std::vector<Lang::VarDecl> &decls) const{
-  VecSet<Vector> res;
-  std::set<int> regs = e.get_registers();
-
-  std::vector<Z> v(size());
+void DualZStar<Z>::Vector::instance_domains(const std::vector<Lang::VarDecl> &decls,
+                                        const std::set<int> *regs,
+                                        std::vector<int> &fixed, std::vector<int> &wild,
+                                        std::vector<int> &lbs, std::vector<int> &ubs) const{
+  fixed.assign(size(),0);
+  wild.clear();
+  lbs.clear();
+  ubs.clear();
   for(int i = 0; i < size(); ++i){
     if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      if (regs.count(i)) {
-        v[i] = decls[i].domain.get_lower_bound();
+      if(regs == 0 || regs->count(i)){
+        assert(decls[i].domain.is_finite());
+        wild.push_back(i);
+        lbs.push_back(decls[i].domain.get_lower_bound());
+        ubs.push_back(decls[i].domain.get_upper_bound());
       }
     }else{
-      v[i] = (*this)[i].get_int();
+      fixed[i] = (*this)[i].get_int();
     }
   }
+};
 
-  while(true){
-    if(e.eval<std::vector<Z>,int*>(v,0) == value){
-      Vector tmp_v(size());
-      for(int i = 0; i < size(); ++i){
-        if((*this)[i].is_wild() && regs.count(i)==0){
-          tmp_v.vec[i+2] = STAR;
-        } else tmp_v.vec[i+2] = v[i];
+template<class Z>
+template<class E>
+void DualZStar<Z>::Vector::solve(const E &e, int value, const std::vector<Lang::VarDecl> &decls,
+                              VecSet<Vector> &res) const{
+  std::set<int> regs = e.get_registers();
+  std::vector<int> lbs(size(),0), ubs(size(),0);
+  for(int i = 0; i < size(); ++i){
+    if(!(*this)[i].is_wild()){
+      lbs[i] = ubs[i] = (*this)[i].get_int();
+    }else if(regs.count(i)){
+      assert(decls[i].domain.is_finite());
+      lbs[i] = decls[i].domain.get_lower_bound();
+      ubs[i] = decls[i].domain.get_upper_bound();
+    }
+  }
+
+  ExprSolver::emit_t add_box =
+    [this,&decls,&regs,&res](const std::vector<int> &bl, const std::vector<int> &bu){
+    /* A register is left STAR if it is STAR in this vector and the
+     * box covers its whole domain. Registers with a partial interval
+     * are enumerated. */
+    std::vector<DualZStar> v(size());
+    std::vector<int> enum_regs;
+    for(int i = 0; i < size(); ++i){
+      if(!(*this)[i].is_wild()){
+        v[i] = (*this)[i];
+      }else if(regs.count(i) == 0){
+        v[i] = STAR;
+      }else if(bl[i] == bu[i]){
+        v[i] = bl[i];
+      }else if(bl[i] == decls[i].domain.get_lower_bound() &&
+               bu[i] == decls[i].domain.get_upper_bound()){
+        v[i] = STAR;
+      }else{
+        enum_regs.push_back(i);
+        v[i] = bl[i];
       }
-      res.insert(tmp_v);
     }
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild() && regs.count(i)){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
+    while(true){
+      res.insert(Vector(v));
+      /* Increase enumerated values in v */
+      unsigned k = 0;
+      for(; k < enum_regs.size(); ++k){
+        int r = enum_regs[k];
+        if(v[r].get_int() < bu[r]){
+          v[r] = v[r].get_int() + 1;
           break;
         }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
+          v[r] = bl[r];
         }
       }
+      if(k >= enum_regs.size()) break;
     }
-    if(i >= size()) break;
-  }
+  };
+  ExprSolver::solve(e,value,lbs,ubs,add_box);
+};
+
 
+template<class Z>
+VecSet<typename DualZStar<Z>::Vector> 
+DualZStar<Z>::Vector::possible_regs(const Lang::Expr<int> &e, int value,
+                                const std::vector<Lang::VarDecl> &decls) const{
+  VecSet<Vector> res;
+  solve(e,value,decls,res);
   return res;
 };
 
@@ -394,46 +439,7 @@ VecSet<typename DualZStar<Z>::Vector>
 DualZStar<Z>::Vector::possible_regs(const Lang::BExpr<int> &b,
                                 const std::vector<Lang::VarDecl> &decls) const{
   VecSet<Vector> res;
-  std::set<int> regs = b.get_registers();
-
-  std::vector<Z> v(size());
-  for(int i = 0; i < size(); ++i){
-    if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      if (regs.count(i)) {
-        v[i] = decls[i].domain.get_lower_bound();
-      }
-    }else{
-      v[i] = (*this)[i].get_int();
-    }
-  }
-
-  while(true){
-    if(b.eval<std::vector<Z>,int*>(v,0)){
-      Vector tmp_v(size());
-      for(int i = 0; i < size(); ++i){
-        if((*this)[i].is_wild() && regs.count(i)==0){
-          tmp_v.vec[i+2] = STAR;
-        } else tmp_v.vec[i+2] = v[i];
-      }
-      res.insert(tmp_v);
-    }
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild() && regs.count(i)!=0){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
-          break;
-        }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
-        }
-      }
-    }
-    if(i >= size()) break;
-  }
-
+  solve(b,1,decls,res);
   return res;
 };
 
@@ -454,33 +460,17 @@ template<class Z>
 VecSet<Z> DualZStar<Z>::Vector::possible_values(const Lang::Expr<int> &e, 
                                             const std::vector<Lang::VarDecl> &decls) const{
   VecSet<Z> res;
+  std::set<int> regs = e.get_registers();
 
-  std::vector<Z> v(size());
-  for(int i = 0; i < size(); ++i){
-    if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      v[i] = decls[i].domain.get_lower_bound();
-    }else{
-      v[i] = (*this)[i].get_int();
-    }
-  }
-
-  while(true){
-    res.insert(e.eval<std::vector<Z>,int*>(v,0));
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild()){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
-          break;
-        }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
-        }
-      }
+  std::vector<int> fixed, wild, lbs, ubs;
+  instance_domains(decls,&regs,fixed,wild,lbs,ubs);
+  ValuationBatch vb(fixed,wild,lbs,ubs);
+  int vals[ValuationBatch::capacity];
+  while(vb.next()){
+    e.eval_batch(vb.columns(),vb.size(),vals);
+    for(int j = 0; j < vb.size(); ++j){
+      res.insert(vals[j]);
     }
-    if(i >= size()) break;
   }
 
   return res;
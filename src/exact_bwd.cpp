@@ -18,7 +18,11 @@
  *
  */
 
+#include "budget.h"
 #include "exact_bwd.h"
+#include "heartbeat.h"
+#include "pb_container2.h"
+#include "stats.h"
 
 Reachability::Result *ExactBwd::reachability(Reachability::Arg *arg) const{
   Arg *earg = static_cast<Arg*>(arg);
@@ -30,7 +34,7 @@ Reachability::Result *ExactBwd::reachability(Reachability::Arg *arg) const{
   ConstraintContainer &container = *earg->container;
 
   /* Check arg->bad_states and setup container */
-  if(earg->bad_states.empty()){
+  if(earg->bad_states.empty() && container.Q_size() == 0){
     result->result = Reachability::UNREACHABLE;
     result->timer.stop();
     return result;
@@ -57,12 +61,43 @@ Reachability::Result *ExactBwd::reachability(Reachability::Arg *arg) const{
 
   /* Start analysing */
   bool is_reachable = false;
+  Budget::exhausted_t exhausted = Budget::NOT_EXHAUSTED;
+  Heartbeat heartbeat("ExactBwd");
+  Budget own_budget;
+  Budget &budget = arg->budget ? *arg->budget : own_budget;
   while(!is_reachable && container.Q_size()){
-    Constraint *c = container.pop();
-    std::list<const Machine::PTransition*> ts = c->partred();
+    exhausted = budget.check(result->generated_constraints);
+    if(exhausted != Budget::NOT_EXHAUSTED){
+      break;
+    }
+    if(heartbeat.due()){
+      const ConstraintContainer::counters_t &cnt = container.get_counters();
+      Heartbeat::sample_t s;
+      s.generated = result->generated_constraints;
+      s.queued = container.Q_size();
+      s.stored = container.F_size();
+      s.max_weight = cnt.max_weight;
+      s.subsumed = cnt.subsumed;
+      s.invalidated = cnt.invalidated;
+      heartbeat.beat(s);
+    }
+    Constraint *c;
+    {
+      Stats::Probe probe(Stats::POP);
+      c = container.pop();
+    }
+    std::list<const Machine::PTransition*> ts;
+    {
+      Stats::Probe probe(Stats::PARTRED);
+      ts = c->partred();
+    }
 
     for(auto trans_it = ts.begin(); !is_reachable && trans_it != ts.end(); trans_it++){
-      std::list<Constraint*> new_consts = c->pre(**trans_it);
+      std::list<Constraint*> new_consts;
+      {
+        Stats::Probe probe(Stats::PRE);
+        new_consts = c->pre(**trans_it);
+      }
       result->generated_constraints += new_consts.size();
 
       for(auto c_it = new_consts.begin(); c_it != new_consts.end(); c_it++){
@@ -71,12 +106,23 @@ Reachability::Result *ExactBwd::reachability(Reachability::Arg *arg) const{
           delete *c_it;
         }else{
           c->abstract();
-          bool is_init = (*c_it)->is_init_state();
-          container.insert(c,*trans_it,*c_it);
+          bool is_init;
+          {
+            Stats::Probe probe(Stats::IS_INIT_STATE);
+            is_init = (*c_it)->is_init_state();
+          }
+          {
+            Stats::Probe probe(Stats::INSERT);
+            container.insert(c,*trans_it,*c_it);
+          }
           if(is_init){
             is_reachable = true;
             result->stored_constraints = container.F_size();
-            result->trace = container.clear_and_get_trace(*c_it);
+            if(earg->incremental){
+              result->trace = container.get_trace(*c_it);
+            }else{
+              result->trace = container.clear_and_get_trace(*c_it);
+            }
           }
         }
       }
@@ -87,21 +133,48 @@ Reachability::Result *ExactBwd::reachability(Reachability::Arg *arg) const{
     std::max(result->stored_constraints,container.F_size());
   if(is_reachable){
     result->result = Reachability::REACHABLE;
+  }else if(exhausted != Budget::NOT_EXHAUSTED){
+    result->result = Reachability::FAILURE;
+    result->failure_reason = Budget::to_string(exhausted);
   }else{
     result->result = Reachability::UNREACHABLE;
   }
   
-  container.clear();
+  if(!earg->incremental){
+    container.clear();
+  }
 
   result->timer.stop();
   return result;
 };
 
 ExactBwd::Arg::Arg(const Machine &m, PbConstraint::Common *common,ConstraintContainer *cont)
-  : Reachability::Arg(m), common(common), container(cont)
+  : Reachability::Arg(m), common(common), container(cont), incremental(false)
 {
   for(unsigned i = 0; i < m.forbidden.size(); i++){
     bad_states.push_back(new PbConstraint(m.forbidden[i],*common));
   }
 }
 
+Reachability::Arg *ExactBwd::pb_resume_arg(Reachability::Arg *prev_arg,
+                                           Reachability::Result *prev_result){
+  assert(dynamic_cast<Arg*>(prev_arg));
+  assert(dynamic_cast<Result*>(prev_result));
+  Arg *parg = static_cast<Arg*>(prev_arg);
+  Result *pres = static_cast<Result*>(prev_result);
+  assert(parg->incremental);
+  assert(dynamic_cast<PbContainer2*>(parg->container));
+  assert(dynamic_cast<PbConstraint::Common*>(pres->common));
+  PbContainer2 *cont = static_cast<PbContainer2*>(parg->container);
+  PbConstraint::Common *common = static_cast<PbConstraint::Common*>(pres->common);
+  parg->container = 0;
+  pres->common = 0;
+
+  cont->discard_dirty();
+  common->k++;
+
+  Arg *arg = new Arg(prev_arg->machine,std::list<Constraint*>(),common,cont);
+  arg->incremental = true;
+  return arg;
+}
+
@@ -44,7 +44,7 @@ public:
      * entailment checking and priority.
      */
     Arg(const Machine &m, std::list<Constraint*> bad, Constraint::Common *common, ConstraintContainer *cont)
-      : Reachability::Arg(m), bad_states(bad), common(common), container(cont) {};
+      : Reachability::Arg(m), bad_states(bad), common(common), container(cont), incremental(false) {};
     /* Same as Arg(m,b,common,cont), where b are newly allocated bad states
      * based on m.forbidden and common. */
     Arg(const Machine &m, PbConstraint::Common *common, ConstraintContainer *cont);
@@ -66,6 +66,15 @@ public:
     Constraint::Common *common;
     /* The container that should be used. */
     ConstraintContainer *container;
+    /* If set, the analysis leaves F and Q of container in place when
+     * it finishes, so that a later analysis may resume from
+     * them. Traces are then built from copies of the constraints in
+     * F (see ConstraintContainer::get_trace).
+     *
+     * An analysis may be started with empty bad_states, in which case
+     * it resumes from the constraints in Q.
+     */
+    bool incremental;
   };
 
   /* pb_init_arg(a,c) returns a new Arg object with the same machine
@@ -80,9 +89,26 @@ public:
     assert(dynamic_cast<Arg*>(prev_arg));
     ConstraintContainer *c = static_cast<Arg*>(prev_arg)->container;
     static_cast<Arg*>(prev_arg)->container = 0;
-    return new Arg(prev_arg->machine,common,c);
+    c->clear(); // In case prev_arg was incremental
+    Arg *arg = new Arg(prev_arg->machine,common,c);
+    arg->incremental = static_cast<Arg*>(prev_arg)->incremental;
+    return arg;
   };
 
+  /* pb_resume_arg(a,r) returns a new Arg object which resumes the
+   * analysis of a, with the bound k of its Common object increased
+   * by one. r should be the result of the analysis of a.
+   *
+   * The clean constraints found by the analysis of a are kept and the
+   * dirty ones are discarded (see PbContainer2::discard_dirty). The
+   * Common object is moved from r to the returned Arg.
+   *
+   * Pre: a is incremental and has a PbContainer2. r is an
+   * ExactBwd::Result.
+   */
+  static Reachability::Arg *pb_resume_arg(Reachability::Arg *prev_arg,
+                                          Reachability::Result *prev_result);
+
   class Result : public Reachability::Result{
   public:
     Result(const Machine &m) : Reachability::Result(m), common(0) {};
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __EXPR_SOLVER_H__
+#define __EXPR_SOLVER_H__
+
+#include <functional>
+#include <vector>
+
+/* ExprSolver finds the register valuations under which an expression
+ * takes a given value, by interval propagation.
+ *
+ * The search space is a box, which bounds each register to an
+ * interval. The solver evaluates the expression over the box with
+ * interval arithmetic. If the value is outside the resulting
+ * interval, the box is discarded; if the interval is exactly the
+ * value, the whole box is a solution. Otherwise the interval of the
+ * first register which is not fixed is split in two and the halves
+ * are solved separately. When only a
+ * single register remains unfixed in a box, its interval is instead
+ * evaluated point by point with batch evaluation.
+ *
+ * The solutions are reported as boxes, so a register which does not
+ * affect the value is reported with its whole interval, rather than
+ * once for every value in it.
+ */
+class ExprSolver{
+public:
+  /* Called once for each box of solutions. lbs and ubs have the same
+   * meaning as in solve. */
+  typedef std::function<void(const std::vector<int>&,const std::vector<int>&)> emit_t;
+
+  /* Reports to emit a set of disjoint boxes, which together contain
+   * exactly those valuations within the box [lbs,ubs] under which e
+   * evaluates to value. Register r is bounded to the interval
+   * [lbs[r],ubs[r]].
+   *
+   * E should be Lang::Expr<int> or Lang::BExpr<int>. For a BExpr,
+   * value should be 1 (true) or 0 (false).
+   */
+  template<class E>
+  static void solve(const E &e, int value,
+                    const std::vector<int> &lbs, const std::vector<int> &ubs,
+                    const emit_t &emit);
+private:
+  template<class E>
+  static void solve_box(const E &e, int value,
+                        std::vector<int> &lbs, std::vector<int> &ubs,
+                        const emit_t &emit);
+  /* Solve the box [lbs,ubs] where r is the only register which is not
+   * fixed to a single value. */
+  template<class E>
+  static void enumerate(const E &e, int value, int r,
+                        std::vector<int> &lbs, std::vector<int> &ubs,
+                        const emit_t &emit);
+};
+
+#include "expr_solver.tcc"
+
+#endif
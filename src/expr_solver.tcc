@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "valuation_batch.h"
+
+#include <cassert>
+#include <cstdint>
+
+template<class E>
+void ExprSolver::solve(const E &e, int value,
+                       const std::vector<int> &lbs, const std::vector<int> &ubs,
+                       const emit_t &emit){
+  assert(lbs.size() == ubs.size());
+  std::vector<int> l = lbs, u = ubs;
+  solve_box(e,value,l,u,emit);
+};
+
+template<class E>
+void ExprSolver::solve_box(const E &e, int value,
+                           std::vector<int> &lbs, std::vector<int> &ubs,
+                           const emit_t &emit){
+  long lo, hi;
+  e.eval_interval(lbs.data(),ubs.data(),&lo,&hi);
+  if(value < lo || hi < value){
+    return;
+  }
+  if(lo == hi){
+    emit(lbs,ubs);
+    return;
+  }
+
+  /* Split the first register which is not fixed. Splitting one
+   * register at a time, rather than e.g. the widest one, keeps the
+   * intervals of the other registers whole for as long as possible,
+   * so that solutions which do not depend on them are found as a
+   * single box. */
+  int split = -1;
+  int unfixed = 0;
+  for(unsigned r = 0; r < lbs.size(); ++r){
+    if(lbs[r] < ubs[r]){
+      ++unfixed;
+      if(split < 0) split = r;
+    }
+  }
+  /* Interval evaluation is exact when all registers are fixed. */
+  assert(split >= 0);
+
+  if(unfixed == 1){
+    enumerate(e,value,split,lbs,ubs,emit);
+    return;
+  }
+
+  int lb = lbs[split], ub = ubs[split];
+  int mid = int(lb + (long(ub) - lb) / 2);
+  ubs[split] = mid;
+  solve_box(e,value,lbs,ubs,emit);
+  ubs[split] = ub;
+  lbs[split] = mid+1;
+  solve_box(e,value,lbs,ubs,emit);
+  lbs[split] = lb;
+};
+
+template<class E>
+void ExprSolver::enumerate(const E &e, int value, int r,
+                           std::vector<int> &lbs, std::vector<int> &ubs,
+                           const emit_t &emit){
+  int lb = lbs[r], ub = ubs[r];
+  ValuationBatch vb(lbs,std::vector<int>(1,r),
+                    std::vector<int>(1,lb),std::vector<int>(1,ub));
+  uint64_t mask[ValuationBatch::capacity/64];
+  /* Consecutive solutions are emitted together as one interval. */
+  bool in_run = false;
+  int run_start = lb, last = lb;
+  while(vb.next()){
+    e.eval_batch_mask(vb.columns(),vb.size(),value,mask);
+    for(int j = 0; j < vb.size(); ++j){
+      last = vb.value(r,j);
+      bool sat = mask[j/64] & (uint64_t(1) << (j%64));
+      if(sat && !in_run){
+        in_run = true;
+        run_start = last;
+      }else if(!sat && in_run){
+        in_run = false;
+        lbs[r] = run_start;
+        ubs[r] = last-1;
+        emit(lbs,ubs);
+      }
+    }
+  }
+  if(in_run){
+    lbs[r] = run_start;
+    ubs[r] = last;
+    emit(lbs,ubs);
+  }
+  lbs[r] = lb;
+  ubs[r] = ub;
+};
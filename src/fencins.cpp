@@ -19,6 +19,7 @@
  */
 
 #include "fencins.h"
+#include "budget.h"            // for testing
 #include "log.h"
 #include "min_coverage.h"
 #include "preprocessor.h"      // for testing
@@ -35,6 +36,12 @@
 
 namespace Fencins{
 
+  bool prune_candidates = false;
+  int discharged_count = 0;
+  std::string failure_reason;
+  VerdictCache *verdict_cache = 0;
+  WitnessLibrary *witness_library = 0;
+
   void add_disj_to_cnf(const VecSet<Sync*> &disj, std::set<VecSet<Sync*> > *cnf){
     for(auto it = cnf->begin(); it != cnf->end(); ){
       if(std::includes(it->begin(),it->end(),
@@ -116,6 +123,23 @@ namespace Fencins{
     return SS2;
   };
 
+  /* Returns true iff mc includes some set in safe.
+   *
+   * There is no corresponding check against insufficient sets: When
+   * a set U is shown insufficient, the fences of its witness are
+   * added to syncs, and U covers none of them. Hence no later min
+   * coverage set of syncs is included in U.
+   */
+  bool discharged(const VecSet<Sync*> &mc,
+                  const std::vector<VecSet<Sync*> > &safe){
+    for(unsigned i = 0; i < safe.size(); ++i){
+      if(std::includes(mc.begin(),mc.end(),safe[i].begin(),safe[i].end())){
+        return true;
+      }
+    }
+    return false;
+  };
+
   Machine *insert_syncs(const Machine &m,
                         const VecSet<Sync*> syncs,
                         std::vector<const Sync::InsInfo*> *m_infos){
@@ -170,6 +194,13 @@ namespace Fencins{
      */
     std::set<VecSet<Sync*> > fence_sets;
     std::set<VecSet<Sync*> > fence_sets_uncloned;
+    /* If prune_candidates is set, then safe_sets contains the
+     * candidates which have been shown sufficient. Sync pointers are
+     * pointers into syncs.
+     */
+    std::vector<VecSet<Sync*> > safe_sets;
+    discharged_count = 0;
+    failure_reason = "";
 
     Reachability::Result *prev_result = 0;
     bool done = false;
@@ -208,6 +239,10 @@ namespace Fencins{
         // Otherwise find one which is not in fence_sets
         for(; mcs.first != mcs.second; ++mcs.first){
           if(fence_sets_uncloned.count(*mcs.first) == 0){
+            if(prune_candidates && discharged(*mcs.first,safe_sets)){
+              ++discharged_count;
+              continue;
+            }
             // Try this one
             try{
               mc = *mcs.first;
@@ -224,7 +259,7 @@ namespace Fencins{
         }
         if(mcs.first == mcs.second){
           /* There are no more fence sets. */
-          assert(fence_sets.size());
+          assert(fence_sets.size() || prune_candidates);
           break;
         }
       }
@@ -240,15 +275,30 @@ namespace Fencins{
       Log::msg << "\n";
 
       Log::msg << "Current solution count: " << fence_sets.size() << "\n";
-      Reachability::Arg *rarg = reach_arg_init(*m_synced,prev_result);
-      Reachability::Result *res = r.reachability(rarg);
-      if(prev_result) delete prev_result;
-      prev_result = res;
-
-      Log::msg << res->to_string() << "\n";
+      Reachability::result_t verdict;
+      Reachability::Arg *rarg = 0;
+      Reachability::Result *res = 0;
+      Trace *replayed = 0; // Witness found by witness_library
+      if(verdict_cache && verdict_cache->lookup(*m_synced,&verdict) && verdict == Reachability::UNREACHABLE){
+        Log::msg << "Unreachable according to verdict cache.\n\n";
+      }else if(witness_library && (replayed = witness_library->replay(*m_synced))){
+        verdict = Reachability::REACHABLE;
+        if(verdict_cache) verdict_cache->insert(*m_synced,verdict);
+        Log::msg << "Reachable by replaying an earlier witness.\n\n";
+      }else{
+        rarg = reach_arg_init(*m_synced,prev_result);
+        res = r.reachability(rarg);
+        if(prev_result) delete prev_result;
+        prev_result = res;
+        verdict = res->result;
+        if(verdict_cache && verdict != Reachability::FAILURE) verdict_cache->insert(*m_synced,verdict);
+
+        Log::msg << res->to_string() << "\n";
+      }
 
-      if(res->result == Reachability::REACHABLE){
-        if(!res->trace){
+      const Trace *witness = replayed ? replayed : (res ? res->trace : 0);
+      if(verdict == Reachability::REACHABLE){
+        if(!witness){
           delete m_synced;
           delete rarg;
           delete res;
@@ -257,7 +307,10 @@ namespace Fencins{
           delete_and_clear(&m_infos);
           throw new std::logic_error("Fencins: Received no trace from underlying reachability analysis.");
         }
-        std::set<std::set<Sync*> > new_syncs = tf.fence(*res->trace,m_infos);
+        if(witness_library){
+          witness_library->add(*witness);
+        }
+        std::set<std::set<Sync*> > new_syncs = tf.fence(*witness,m_infos);
         if(new_syncs.empty()){
           /* There is no solution for m */
           assert(fence_sets.empty());
@@ -278,7 +331,7 @@ namespace Fencins{
           mcs_up_to_date = false;
         }
         deep_delete(new_syncs);
-      }else if(res->result == Reachability::UNREACHABLE){
+      }else if(verdict == Reachability::UNREACHABLE){
         /* mc is a solution for m */
         /* Clone mc */
         Log::msg << "Synchronization set shown to be a solution.\n\n";
@@ -288,28 +341,35 @@ namespace Fencins{
         }
         fence_sets.insert(fs);
         fence_sets_uncloned.insert(mc);
+        if(prune_candidates){
+          safe_sets.push_back(mc);
+        }
         assert(max_solutions == 0 || int(fence_sets.size()) <= max_solutions);
         if(int(fence_sets.size()) == max_solutions){
           done = true;
         }
       }else{
-        assert(res->result == Reachability::FAILURE);
-        delete m_synced;
-        delete rarg;
-        delete res;
-        deep_delete(fence_sets);
-        deep_delete(syncs);
-        delete_and_clear(&m_infos);
-        throw new std::logic_error("Fencins: FAILURE from underlying reachability analysis.");
+        assert(verdict == Reachability::FAILURE);
+        /* Stop, and return the solutions found so far */
+        failure_reason = res->failure_reason.size() ? res->failure_reason : "analysis failed";
+        Log::msg << "Reachability analysis failed (" << failure_reason << "). Stopping.\n\n";
+        done = true;
       }
 
       delete_and_clear(&m_infos);
       delete m_synced;
       delete rarg;
+      if(replayed) delete replayed;
     }while(!done);
 
-    assert(prev_result);
-    delete prev_result;
+    if(prune_candidates){
+      Log::msg << "Candidates discharged without reachability analysis: " << discharged_count << "\n";
+    }
+    if(witness_library){
+      Log::msg << "Candidates refuted by replaying witnesses: " << witness_library->get_hits() << "\n";
+    }
+
+    if(prev_result) delete prev_result;
 
     deep_delete(syncs);
 
@@ -740,6 +800,82 @@ namespace Fencins{
                                    "L21 L22 | L21 L22",
                                    SUBSET,
                                    0));
+
+      prune_candidates = true;
+      Test::inner_test("fencins all #13 (pruned candidates)",
+                       test_sb_all(rmm,
+                                   "L1 | L1\n"
+                                   "L21 L22 | L21 L22",
+                                   SUBSET,
+                                   0));
+      prune_candidates = false;
+    }
+
+    /* Test 14: Only candidates including a sufficient set are
+     * discharged */
+    {
+      TsoFenceSync a(0,1,FenceSync::TSet(),FenceSync::TSet());
+      TsoFenceSync b(0,2,FenceSync::TSet(),FenceSync::TSet());
+      TsoFenceSync c(1,1,FenceSync::TSet(),FenceSync::TSet());
+      std::vector<VecSet<Sync*> > safe(1,VecSet<Sync*>({&a,&b}));
+      Test::inner_test("discharged",
+                       discharged(VecSet<Sync*>({&a,&b}),safe) &&
+                       discharged(VecSet<Sync*>({&a,&b,&c}),safe) &&
+                       !discharged(VecSet<Sync*>({&a}),safe) &&
+                       !discharged(VecSet<Sync*>({&b,&c}),safe) &&
+                       !discharged(VecSet<Sync*>({&a,&b}),std::vector<VecSet<Sync*> >()));
+    }
+
+    /* Test 15: An exhausted budget stops fence insertion without
+     * throwing */
+    {
+      Machine *m = get_machine("forbidden CS CS\n"
+                               "data\n"
+                               "  x = 0 : [0:1]\n"
+                               "  y = 0 : [0:1]\n"
+                               "process\n"
+                               "text\n"
+                               "  write: x := 1;\n"
+                               "  read: y = 0;\n"
+                               "  CS: nop\n"
+                               "process\n"
+                               "text\n"
+                               "  write: y := 1;\n"
+                               "  read: x = 0;\n"
+                               "  CS: nop\n");
+      SbTsoBwd reach;
+      reach_arg_init_t arg_init =
+        [](const Machine &m, const Reachability::Result *)->Reachability::Arg*{
+        SbConstraint::Common *common = new SbConstraint::Common(m);
+        return new ExactBwd::Arg(m,common->get_bad_states(),common,new ChannelContainer());
+      };
+      TsoSimpleFencer fencer(*m,TsoSimpleFencer::FENCE);
+      Budget::limits_t saved_limits = Budget::get_limits();
+      Budget::limits_t limits;
+      limits.max_constraints = 10;
+      Budget::set_limits(limits);
+      Log::loglevel_t ll = Log::get_primary_loglevel();
+      Log::set_primary_loglevel(Log::loglevel_t(std::max(0,int(ll) - 1)));
+      bool threw = false;
+      std::set<std::set<Sync*> > fence_sets;
+      try{
+        fence_sets = fencins(*m,reach,arg_init,fencer,COST,0);
+      }catch(std::exception *exc){
+        threw = true;
+        delete exc;
+      }
+      Log::set_primary_loglevel(ll);
+      Budget::set_limits(saved_limits);
+      Test::inner_test("fencins stops on exhausted budget",
+                       !threw && fence_sets.empty() &&
+                       failure_reason == Budget::to_string(Budget::CONSTRAINTS));
+      deep_delete(fence_sets);
+      /* The next call starts afresh */
+      fence_sets = fencins(*m,reach,arg_init,fencer,COST,1);
+      Test::inner_test("fencins after exhausted budget",
+                       fence_sets.size() == 1 && failure_reason == "");
+      deep_delete(fence_sets);
+      delete m;
     }
   };
 
@@ -25,9 +25,12 @@
 #include "reachability.h"
 #include "sync.h"
 #include "trace_fencer.h"
+#include "verdict_cache.h"
+#include "witness_library.h"
 
 #include <functional>
 #include <set>
+#include <string>
 
 namespace Fencins{
   /* A cost_fn_t object gives the cost of a particular piece of
@@ -75,6 +78,49 @@ namespace Fencins{
    * Pre: max_solutions >= 0.
    */
   typedef std::function<Reachability::Arg*(const Machine&,const Reachability::Result*)> reach_arg_init_t;
+  /* If prune_candidates is set, then fencins remembers the candidate
+   * synchronization sets that have been shown sufficient. Later
+   * candidates which include such a set are then discharged without
+   * calling the reachability analysis.
+   *
+   * Since a candidate which includes a sufficient set is not
+   * minimal, such candidates are skipped rather than reported as
+   * solutions. Candidates are never included in a set shown
+   * insufficient, since the fences refuting that set are added to the
+   * requirements before the next candidate is chosen.
+   *
+   * Default: false.
+   */
+  extern bool prune_candidates;
+  /* The number of candidates discharged by prune_candidates during
+   * the latest call to fencins.
+   */
+  extern int discharged_count;
+  /* If the latest call to fencins was stopped by a failed
+   * reachability analysis (e.g. because its budget was exhausted),
+   * then failure_reason describes the failure. Otherwise it is
+   * empty.
+   *
+   * A stopped call returns the solutions found before the failure,
+   * which need not be all solutions.
+   */
+  extern std::string failure_reason;
+  /* If non-null, fencins consults and updates verdict_cache around
+   * every reachability analysis. Candidates whose machines are known
+   * to be unreachable are not analysed again.
+   *
+   * Default: 0.
+   */
+  extern VerdictCache *verdict_cache;
+  /* If non-null, fencins stores the witness of every reachable
+   * candidate in witness_library, and tries to replay the stored
+   * witnesses on each new candidate before analysing it. A candidate
+   * on which a witness is replayed is not analysed. Should only be
+   * set when r is a TSO analysis.
+   *
+   * Default: 0.
+   */
+  extern WitnessLibrary *witness_library;
   std::set<std::set<Sync*> > fencins(const Machine &m,
                                      Reachability &r,
                                      reach_arg_init_t reach_arg_init,
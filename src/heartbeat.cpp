@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "heartbeat.h"
+#include "log.h"
+#include "test.h"
+
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+double Heartbeat::interval = 0;
+const long Heartbeat::check_period = 64;
+
+Heartbeat::Heartbeat(std::string engine)
+  : engine(engine), iterations(0), next_beat(interval), last_time(0) {
+  timer.start();
+};
+
+void Heartbeat::beat(const sample_t &s){
+  double now = timer.get_time();
+  double dt = now - last_time;
+  long generated = s.generated - last.generated;
+  double rate = (dt > 0) ? double(generated) / dt : 0;
+  /* Fractions of the constraints generated since the last heartbeat */
+  double subsumed = generated ? double(s.subsumed - last.subsumed) / double(generated) : 0;
+  double invalidated = generated ? double(s.invalidated - last.invalidated) / double(generated) : 0;
+  long rss = resident_set_size();
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1)
+     << "Heartbeat (" << engine << ", " << now << " s): "
+     << s.generated << " generated (" << std::setprecision(0) << rate << "/s), "
+     << "Q: " << s.queued << ", F: " << s.stored << ", "
+     << "max weight: " << s.max_weight << ", "
+     << std::setprecision(1)
+     << "subsumed: " << 100*subsumed << "%, "
+     << "invalidated: " << 100*invalidated << "%, "
+     << "RSS: ";
+  if(rss >= 0){
+    ss << double(rss) / (1024*1024) << " MiB";
+  }else{
+    ss << "?";
+  }
+  Log::msg << ss.str() << "\n" << std::flush;
+
+  Log::json << "json: {\"action\":\"Heartbeat\", \"engine\":\"" << engine << "\""
+            << ", \"time\":" << now
+            << ", \"generated\":" << s.generated
+            << ", \"rate\":" << rate
+            << ", \"Q_size\":" << s.queued
+            << ", \"F_size\":" << s.stored
+            << ", \"max_weight\":" << s.max_weight
+            << ", \"subsumption_rate\":" << subsumed
+            << ", \"invalidation_rate\":" << invalidated
+            << ", \"rss\":" << rss << "}\n" << std::flush;
+
+  last = s;
+  last_time = now;
+  while(next_beat <= now) next_beat += interval;
+};
+
+long Heartbeat::resident_set_size(){
+  std::ifstream statm("/proc/self/statm");
+  long size, resident;
+  if(!(statm >> size >> resident)){
+    return -1;
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+};
+
+void Heartbeat::test(){
+  double saved_interval = interval;
+
+  /* Test 1: Disabled heartbeat */
+  {
+    set_interval(0);
+    Heartbeat hb("test");
+    bool any_due = false;
+    for(int i = 0; i < 10*check_period; ++i){
+      any_due = any_due || hb.due();
+    }
+    Test::inner_test("Disabled heartbeat",!any_due);
+  }
+
+  /* Test 2: Heartbeats are emitted, but not more often than
+   * requested. The timer of the heartbeat is stopped and advanced
+   * by hand, so that the test does not depend on the wall clock. */
+  {
+    set_interval(1);
+    Heartbeat hb("test");
+    hb.timer.stop();
+    hb.timer.reset();
+    /* due(hb) calls hb.due() for one full check period */
+    std::function<bool(Heartbeat&)> due = [](Heartbeat &hb){
+      bool d = false;
+      for(int i = 0; i < check_period; ++i){
+        d = hb.due() || d;
+      }
+      return d;
+    };
+    bool first_due = due(hb);
+    hb.timer.add(0.5);
+    bool early_due = due(hb);
+    hb.timer.add(0.75);
+    bool later_due = due(hb);
+    hb.beat(sample_t());
+    bool after_beat_due = due(hb);
+    hb.timer.add(1);
+    bool next_due = due(hb);
+    Test::inner_test("Heartbeat interval",
+                     !first_due && !early_due && later_due &&
+                     !after_beat_due && next_due);
+  }
+
+  /* Test 3: RSS */
+  {
+    Test::inner_test("Resident set size",resident_set_size() > 0);
+  }
+
+  set_interval(saved_interval);
+};
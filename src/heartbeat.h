@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __HEARTBEAT_H__
+#define __HEARTBEAT_H__
+
+#include "timer.h"
+
+#include <string>
+
+/* A Heartbeat periodically reports the progress of a running
+ * reachability analysis (enabled by the flag --heartbeat).
+ *
+ * An analysis creates a Heartbeat when it starts, and calls due()
+ * once per iteration of its main loop. When due() returns true, the
+ * analysis describes its current state in a sample_t and passes it
+ * to beat(), which prints a progress line to Log::msg and a json
+ * directive to Log::json.
+ *
+ * The interval between heartbeats is global, and set with
+ * set_interval. When the interval is 0 (the default) due() always
+ * returns false.
+ */
+class Heartbeat{
+public:
+  /* A description of the current state of an analysis. */
+  struct sample_t{
+    sample_t() : generated(0), queued(0), stored(0), max_weight(0),
+                 subsumed(0), invalidated(0) {};
+    /* The number of generated constraints */
+    long generated;
+    /* The number of constraints waiting to be explored (Q_size) */
+    long queued;
+    /* The number of visited constraints (F_size) */
+    long stored;
+    /* The largest weight of any stored constraint */
+    int max_weight;
+    /* The number of generated constraints that were subsumed by
+     * visited constraints */
+    long subsumed;
+    /* The number of visited constraints invalidated by generated
+     * constraints */
+    long invalidated;
+  };
+
+  /* engine is the name of the analysis, used in the output. */
+  Heartbeat(std::string engine);
+
+  /* Returns true iff a heartbeat should be emitted now. Cheap enough
+   * to call once per iteration of the main loop of an analysis. */
+  bool due(){
+    if(interval <= 0) return false;
+    if(++iterations % check_period) return false;
+    return timer.get_time() >= next_beat;
+  };
+
+  /* Report the state described by s. */
+  void beat(const sample_t &s);
+
+  /* Set the time between heartbeats to secs seconds. 0 disables
+   * heartbeats. */
+  static void set_interval(double secs) { interval = secs; };
+  static double get_interval() { return interval; };
+
+  /* The resident set size of this process in bytes, or -1 if it
+   * cannot be determined. */
+  static long resident_set_size();
+
+  static void test();
+private:
+  static double interval;
+  /* The time is checked only every check_period calls to due. */
+  static const long check_period;
+
+  std::string engine;
+  Timer timer;
+  long iterations;
+  double next_beat;
+  /* The previous sample, and its time */
+  sample_t last;
+  double last_time;
+};
+
+#endif
@@ -456,8 +456,9 @@ std::list<HsbConstraint::pre_constr_t> HsbConstraint::pre(const Machine::PTransi
        * run. We find the next message that contains nml or is under the
        * cpointer. */
       assert(msgi == int(channel.size()) - 1);
+      NMLMask::mask_t bit = common.nml_bit(nml);
       while(--msgi > cpointers[t.pid]) {
-        if (channel[msgi].wpid == t.pid && channel[msgi].nmls.count(nml))
+        if (channel[msgi].wpid == t.pid && channel[msgi].writes(nml,bit))
           break;
       }
     }
@@ -479,7 +480,7 @@ std::list<HsbConstraint::pre_constr_t> HsbConstraint::pre(const Machine::PTransi
         hsbc->pcs[t.pid] = t.source;
         if (buffer_size > 0) hsbc->write_buffers[t.pid][nmli] =
                              hsbc->write_buffers[t.pid][nmli].assign(buffer_size - 1, val);
-        else hsbc->channel[msgi].store = hsbc->channel[msgi].store.assign(nmli, val);
+        else hsbc->channel.modify(msgi).store = hsbc->channel[msgi].store.assign(nmli, val);
         hsbc->reg_stores[t.pid] = stores[j];
         res.push_back(hsbc);
       }
@@ -516,7 +517,7 @@ std::list<HsbConstraint::pre_constr_t> HsbConstraint::pre(const Machine::PTransi
         for (const Store &rstore : rstores) {
           HsbConstraint *hsbc = this->clone();
           hsbc->pcs[pid] = t.source;
-          if (locked) hsbc->channel.back().store = hsbc->channel.back().store.assign(nmli, val);
+          if (locked) hsbc->channel.modify(hsbc->channel.size()-1).store = hsbc->channel.back().store.assign(nmli, val);
           else         hsbc->write_buffers[pid][nmli].assign(hsbc->write_buffers[pid][nmli].size() - 1, val);
           hsbc->reg_stores[pid] = rstore;
           res.push_back(pre_constr_t(hsbc, locked, !locked, VecSet<Lang::NML>::singleton(nml)));
@@ -566,7 +567,7 @@ std::list<HsbConstraint::pre_constr_t> HsbConstraint::pre(const Machine::PTransi
         /* Need to insert a fresh message. */
         for (const Common::MsgHdr &hdr : common.messages) {
           HsbConstraint *hsbc = this->clone();
-          Msg msg(Store(common.mem_size), hdr.wpid, hdr.nmls);
+          Msg msg(Store(common.mem_size), hdr.wpid, hdr.nmls, common);
           hsbc->channel.insert(hsbc->channel.begin(), msg);
           for (int p = 0; p < int(hsbc->cpointers.size()); p++) {
             if (p != t.pid) hsbc->cpointers[p]++;
@@ -663,7 +664,7 @@ std::list<HsbConstraint::pre_constr_t> HsbConstraint::pre(const Machine::PTransi
         hsbc->pcs[t.pid] = t.source;
         if (buffer_size > 0) hsbc->write_buffers[t.pid][nmli] =
                                hsbc->write_buffers[t.pid][nmli].assign(buffer_size - 1, reg_val);
-        else hsbc->channel[msgi].store = hsbc->channel[msgi].store.assign(nmli, reg_val);
+        else hsbc->channel.modify(msgi).store = hsbc->channel[msgi].store.assign(nmli, reg_val);
         res.push_back(hsbc);
       }
     }
@@ -813,7 +814,7 @@ bool HsbConstraint::unreachable() {
           if (possible_pending != value_t::STAR) {
             int nmli = common.index(nml);
             if (channel[ci].store[nmli] == value_t::STAR)
-              channel[ci].store = channel[ci].store.assign(nmli, possible_pending);
+              channel.modify(ci).store = channel[ci].store.assign(nmli, possible_pending);
             else if (channel[ci].store[nmli] != possible_pending)
               return true;
           }
@@ -960,7 +961,7 @@ bool HsbConstraint::unreachable() {
             write_buffers[pid][nmli] =
               write_buffers[pid][nmli].assign(write_buffers[pid][nmli].size() - 1, value);
           } else {
-            channel[pair.second].store = channel[pair.second].store.assign(nmli, value);
+            channel.modify(pair.second).store = channel[pair.second].store.assign(nmli, value);
           }
         }
       }
@@ -64,7 +64,7 @@ Trace *HsbPsoBwd::convert_trace(Trace *trace, ChannelConstraint::Common *cmn) co
       assert(hsbc1.write_buffers[pid][nmli].size() == hsbc2.write_buffers[pid][nmli].size() + 1);
       for (ZStar<int> lost_value : lost_values[p(pid, nmli)].front()) {
         std::unique_ptr<HsbConstraint> clone(hsbc2.clone());
-        clone->channel.back().store = clone->channel.back().store.assign(nmli, lost_value);
+        clone->channel.modify(clone->channel.size()-1).store = clone->channel.back().store.assign(nmli, lost_value);
         temp->push_back(*trans, clone.release());
       }
       lost_values[p(pid, nmli)].pop_front();
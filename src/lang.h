@@ -38,6 +38,8 @@ namespace Predicates {
   template<class Var> class Predicate;
 };
 
+class MachineImage;
+
 namespace Lang {
 
   class Exception : public std::exception{
@@ -84,7 +86,7 @@ namespace Lang {
     class Domain{
     public:
       // Z
-      Domain() : dom_is_int(true) {};
+      Domain() : dom_is_int(true), lb(0), ub(0) {};
       // [lb,ub]
       Domain(int lb, int ub) : dom_is_int(false), lb(lb), ub(ub) {
         if(ub < lb) throw new std::logic_error("Lang::Domain: Invalid interval.");
@@ -217,6 +219,17 @@ namespace Lang {
     template<typename C, typename A> int eval(C c, A a) const{
       return SyntaxString<RegId>::eval(c,a);
     };
+    /* Batch evaluation. See SyntaxString::eval_batch. */
+    template<typename C> void eval_batch(C cols, int n, int *out) const{
+      SyntaxString<RegId>::eval_batch(cols,n,out);
+    };
+    template<typename C> void eval_batch_mask(C cols, int n, int value, uint64_t *mask) const{
+      SyntaxString<RegId>::eval_batch_mask(cols,n,value,mask);
+    };
+    /* Interval evaluation. See SyntaxString::eval_interval. */
+    template<typename C> void eval_interval(C lbs, C ubs, long *lo, long *hi) const{
+      SyntaxString<RegId>::eval_interval(lbs,ubs,lo,hi);
+    };
 
     std::set<RegId> get_registers() const throw();
     /* Compares *this to e. Returns -1 if *this is smaller than e, 0
@@ -244,6 +257,7 @@ namespace Lang {
     template<class RegId2> friend class Expr;
     template<class RegId2> friend class BExpr;
     template<class Var> friend class Predicates::Term;
+    friend class ::MachineImage;
   };
 
   template<class RegId> Expr<RegId> operator+(const Expr<RegId> &a, const Expr<RegId> &b){
@@ -278,6 +292,17 @@ namespace Lang {
     template<typename C, typename A> bool eval(C c, A a) const{
       return SyntaxString<RegId>::eval(c,a);
     };
+    /* Batch evaluation. Bit j%64 of mask[j/64] is set iff this
+     * expression evaluates to value (1 for true, 0 for false) under
+     * valuation j. See SyntaxString::eval_batch_mask. */
+    template<typename C> void eval_batch_mask(C cols, int n, int value, uint64_t *mask) const{
+      SyntaxString<RegId>::eval_batch_mask(cols,n,value,mask);
+    };
+    /* Interval evaluation, where true is 1 and false is 0. See
+     * SyntaxString::eval_interval. */
+    template<typename C> void eval_interval(C lbs, C ubs, long *lo, long *hi) const{
+      SyntaxString<RegId>::eval_interval(lbs,ubs,lo,hi);
+    };
 
     /* Constructors */
     static BExpr tt(){
@@ -319,6 +344,7 @@ namespace Lang {
     BExpr(const SyntaxString<RegId> &ss) : SyntaxString<RegId>(ss) {};
     template<class RegId2> friend class BExpr;
     template<class Var> friend class Predicates::Predicate;
+    friend class ::MachineImage;
   };
 
   template<class RegId> BExpr<RegId> operator!(const BExpr<RegId> &a){
@@ -378,6 +404,7 @@ namespace Lang {
      */
     int owner;
     int ptr;
+    friend class ::MachineImage;
   };
 
   template<class RegId> inline std::ostream &operator<<(std::ostream &os,
@@ -946,6 +973,7 @@ namespace Lang {
     std::vector<Lexer::Token> lex_symbols;
 
     template<class RegId2> friend class Stmt;
+    friend class ::MachineImage;
 
     /* Delete all owned objects */
     void self_destruct();
@@ -249,7 +249,7 @@ inline bool Lang::NML::operator<(const NML &nml) const throw(){
 
 template<class RegId> Lang::Stmt<RegId>::Stmt(const Lexer::TokenPos &p,
                                               std::vector<Lexer::Token> symbs) :
-  type(NOP), e0(0), e1(0), b(0),
+  type(NOP), reg(), e0(0), e1(0), b(0),
   stmts(0), fence(false), lbl(""),
   writer(-1), stmt_count(0), pos(p), lex_symbols(symbs)
 {
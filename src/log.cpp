@@ -21,9 +21,48 @@
 #include "log.h"
 
 #include <fstream>
+#include <memory>
+#include <vector>
 
 namespace Log{
 
+  std::mutex stream_mutex;
+
+  /* The statement buffers of the calling thread. Statements may
+   * nest (e.g. when an operand of << logs by itself), so
+   * statement_buffers[i] is used by the statement at nesting depth
+   * i. */
+  thread_local std::vector<std::unique_ptr<std::ostringstream> > statement_buffers;
+  thread_local unsigned statement_depth = 0;
+
+  redirection_stream::statement::statement(redirection_stream *rs)
+    : rs(rs), buf(0), flush(false) {
+    if(rs){
+      if(statement_buffers.size() <= statement_depth){
+        statement_buffers.emplace_back(new std::ostringstream());
+      }
+      static const std::ostringstream pristine;
+      buf = statement_buffers[statement_depth++].get();
+      buf->str("");
+      buf->clear();
+      buf->copyfmt(pristine);
+    }
+  };
+
+  redirection_stream::statement::~statement(){
+    if(rs){
+      std::string s = buf->str();
+      if(s.size() || flush){
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        if(*rs->os){
+          **rs->os << s;
+          if(flush) **rs->os << std::flush;
+        }
+      }
+      --statement_depth;
+    }
+  };
+
   std::ostream *primary_stream = &std::cout;
   bool own_primary_stream = false; // True if Log has ownership of *primary_stream
   std::ostream *secondary_stream = 0;
@@ -22,22 +22,74 @@
 #define __LOG_H__
 
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 
 namespace Log{
 
+  /* Serialises the output of all redirection_streams to their
+   * underlying streams, so that threads may log concurrently.
+   */
+  extern std::mutex stream_mutex;
+
+  /* A redirection_stream collects the output of each statement (a
+   * chain of << operations) in a buffer of the calling thread, and
+   * passes it on to the underlying stream at the end of the statement
+   * (while holding stream_mutex). Hence statements executed
+   * concurrently by different threads are never interleaved. If the
+   * statement contains a manipulator such as std::endl or std::flush,
+   * the underlying stream is also flushed.
+   *
+   * Formatting state (e.g. std::setprecision) does not carry over
+   * from one statement to the next.
+   *
+   * Output operations to a silent stream are ignored.
+   */
   class redirection_stream{
   public:
     redirection_stream(std::ostream **os) : os(os) {};
 
+    /* The output of one statement. Passed on to the underlying stream
+     * when destroyed. */
+    class statement{
+    public:
+      /* If rs is null, then all output is ignored. */
+      statement(redirection_stream *rs);
+      statement(statement &&s) : rs(s.rs), buf(s.buf), flush(s.flush) {
+        s.rs = 0;
+        s.buf = 0;
+      };
+      ~statement();
+      statement &operator<< (std::ostream& ( *pf )(std::ostream&)){
+        if(rs){
+          *buf << pf;
+          flush = true;
+        }
+        return *this;
+      };
+      template<typename T> statement &operator<< (const T &t){
+        if(rs) *buf << t;
+        return *this;
+      };
+    private:
+      statement(const statement&) = delete;
+      statement &operator=(const statement&) = delete;
+      redirection_stream *rs;
+      std::ostringstream *buf;
+      bool flush;
+    };
+
     /* Stream operations */
-    redirection_stream& operator<< (std::ostream& ( *pf )(std::ostream&)){
-      if(*os) **os << pf;
-      return *this;
+    statement operator<< (std::ostream& ( *pf )(std::ostream&)){
+      statement s(*os ? this : 0);
+      s << pf;
+      return s;
     };
-    template<typename T> redirection_stream& operator<< (const T &t){
-      if(*os) **os << t;
-      return *this;
+    template<typename T> statement operator<< (const T &t){
+      statement s(*os ? this : 0);
+      s << t;
+      return s;
     };
 
     std::ostream **os;
@@ -25,6 +25,7 @@
 #include <cassert>
 #include <functional>
 #include <queue>
+#include <set>
 #include <sstream>
 #include <utility>
 
@@ -149,6 +150,11 @@ Machine &Machine::operator=(const Machine &m){
   forbidden = m.forbidden;
   pretty_string_nml = m.pretty_string_nml;
   pretty_string_reg = m.pretty_string_reg;
+  {
+    std::lock_guard<std::mutex> lock(possible_writes_mutex);
+    possible_writes_computed = false;
+    possible_writes.clear();
+  }
   return *this;
 }
 
@@ -243,18 +249,17 @@ void Machine::init_forbidden(const Parser::forbidden_t &fb)
 }
 
 const std::list<std::pair<int,Lang::MemLoc<int> > > &Machine::get_possible_writes() const{
-  static std::list<std::pair<int,Lang::MemLoc<int> > > writes; // Cache result
-  static bool computed = false; // Cache result
-  if(!computed){
+  std::lock_guard<std::mutex> lock(possible_writes_mutex);
+  if(!possible_writes_computed){
     for(int p = 0; p < proc_count(); p++){
       std::list<Lang::MemLoc<int> > mls = automata[p].get_possible_writes();
       for(std::list<Lang::MemLoc<int> >::iterator it = mls.begin(); it != mls.end(); it++){
-        writes.push_back(std::pair<int,Lang::MemLoc<int> >(p,*it));
+        possible_writes.push_back(std::pair<int,Lang::MemLoc<int> >(p,*it));
       }
     }
-    computed = true;
+    possible_writes_computed = true;
   }
-  return writes;
+  return possible_writes;
 }
 
 int Machine::get_transition_count() const{
@@ -432,7 +437,7 @@ Machine::remove_registers(const Lang::Stmt<int> &stmt,
     break;
   case Lang::ASSIGNMENT:
     {
-      int val = stmt.get_expr().eval<std::vector<int>,int*>(v,0);
+      int val = stmt.get_expr().eval<const std::vector<int>&,int*>(v,0);
       if(regs[pid][stmt.get_reg()].domain.member(val)){
         std::vector<int> v2 = v;
         v2[stmt.get_reg()] = val;
@@ -441,13 +446,13 @@ Machine::remove_registers(const Lang::Stmt<int> &stmt,
       break;
     }
   case Lang::ASSUME:
-    if(stmt.get_condition().eval<std::vector<int>,int*>(v,0)){
+    if(stmt.get_condition().eval<const std::vector<int>&,int*>(v,0)){
       s.insert(pr_t(Lang::Stmt<int>::nop(pos),v));
     } // else insert nothing
     break;
   case Lang::READASSERT:
     {
-      int val = stmt.get_expr().eval<std::vector<int>,int*>(v,0);
+      int val = stmt.get_expr().eval<const std::vector<int>&,int*>(v,0);
       if(get_var_decl(Lang::NML(stmt.get_memloc(),pid)).domain.member(val)){
         s.insert(pr_t(Lang::Stmt<int>::read_assert(stmt.get_memloc(),Lang::Expr<int>::integer(val),pos),v));
       }
@@ -455,7 +460,7 @@ Machine::remove_registers(const Lang::Stmt<int> &stmt,
     }
   case Lang::SYNCRDASSERT:
     {
-      int val = stmt.get_expr().eval<std::vector<int>,int*>(v,0);
+      int val = stmt.get_expr().eval<const std::vector<int>&,int*>(v,0);
       if(get_var_decl(Lang::NML(stmt.get_memloc(),pid)).domain.member(val)){
         s.insert(pr_t(Lang::Stmt<int>::syncrd_assert(stmt.get_memloc(),Lang::Expr<int>::integer(val),pos),v));
       }
@@ -487,7 +492,7 @@ Machine::remove_registers(const Lang::Stmt<int> &stmt,
     }
   case Lang::WRITE:
     {
-      int val = stmt.get_expr().eval<std::vector<int>,int*>(v,0);
+      int val = stmt.get_expr().eval<const std::vector<int>&,int*>(v,0);
       if(get_var_decl(Lang::NML(stmt.get_memloc(),pid)).domain.member(val)){
         s.insert(pr_t(Lang::Stmt<int>::write(stmt.get_memloc(),Lang::Expr<int>::integer(val),pos),v));
       }
@@ -495,7 +500,7 @@ Machine::remove_registers(const Lang::Stmt<int> &stmt,
     }
   case Lang::SYNCWR:
     {
-      int val = stmt.get_expr().eval<std::vector<int>,int*>(v,0);
+      int val = stmt.get_expr().eval<const std::vector<int>&,int*>(v,0);
       if(get_var_decl(Lang::NML(stmt.get_memloc(),pid)).domain.member(val)){
         s.insert(pr_t(Lang::Stmt<int>::syncwr(stmt.get_memloc(),Lang::Expr<int>::integer(val),pos),v));
       }
@@ -873,6 +878,244 @@ Machine *Machine::forbidden_shave() const{
   return m;
 };
 
+Machine *Machine::slice() const{
+  /* Slicing requires that every memory location that is accessed by
+   * an instruction is known statically. */
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    const std::vector<Automaton::State> &states = automata[pid].get_states();
+    for(unsigned i = 0; i < states.size(); ++i){
+      for(auto trit = states[i].fwd_transitions.begin(); trit != states[i].fwd_transitions.end(); ++trit){
+        const Lang::Stmt<int> &s = (*trit)->instruction;
+        for(const std::vector<Lang::MemLoc<int> > *mls : {&s.get_reads(),&s.get_writes()}){
+          for(const Lang::MemLoc<int> &ml : *mls){
+            if(ml.get_type() != Lang::MemLoc<int>::GLOBAL_ID &&
+               ml.get_type() != Lang::MemLoc<int>::LOCAL){
+              Log::msg << "Not slicing machine with pointer dereferences.\n";
+              return new Machine(*this);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Log::msg << "Slicing machine.\n";
+
+  /* Returns true iff the instruction s of process pid may be removed
+   * if the memory location or register it writes is not relevant. */
+  std::function<bool(const Lang::Stmt<int>&,int)> sliceable =
+    [this](const Lang::Stmt<int> &s, int pid){
+    switch(s.get_type()){
+    case Lang::WRITE:
+      return expr_always_in_domain(s.get_expr(),pid,get_declaration(s.get_memloc(),pid).domain);
+    case Lang::ASSIGNMENT:
+      return expr_always_in_domain(s.get_expr(),pid,regs[pid][s.get_reg()].domain);
+    case Lang::READASSIGN:
+      {
+        const Lang::VarDecl::Domain &rdom = regs[pid][s.get_reg()].domain;
+        const Lang::VarDecl::Domain vdom = get_declaration(s.get_memloc(),pid).domain;
+        return rdom.is_int() ||
+          (vdom.is_finite() &&
+           rdom.get_lower_bound() <= vdom.get_lower_bound() &&
+           vdom.get_upper_bound() <= rdom.get_upper_bound());
+      }
+    default:
+      return false;
+    }
+  };
+
+  /* Compute the kept transitions as a fixpoint. */
+  std::set<Lang::NML> rel_nml;
+  std::vector<std::set<int> > rel_reg(automata.size());
+  std::set<const Automaton::Transition*> kept;
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(unsigned pid = 0; pid < automata.size(); ++pid){
+      const std::vector<Automaton::State> &states = automata[pid].get_states();
+      for(unsigned i = 0; i < states.size(); ++i){
+        for(auto trit = states[i].fwd_transitions.begin(); trit != states[i].fwd_transitions.end(); ++trit){
+          if(kept.count(*trit)) continue;
+          const Lang::Stmt<int> &s = (*trit)->instruction;
+          bool keep;
+          switch(s.get_type()){
+          case Lang::NOP: case Lang::GOTO:
+            keep = false;
+            break;
+          case Lang::WRITE:
+            keep = rel_nml.count(Lang::NML(s.get_memloc(),pid)) || !sliceable(s,pid);
+            break;
+          case Lang::ASSIGNMENT: case Lang::READASSIGN:
+            keep = rel_reg[pid].count(s.get_reg()) || !sliceable(s,pid);
+            break;
+          default:
+            keep = true;
+          }
+          if(keep){
+            kept.insert(*trit);
+            changed = true;
+            for(const Lang::MemLoc<int> &ml : s.get_reads()){
+              rel_nml.insert(Lang::NML(ml,pid));
+            }
+            std::set<int> rs = s.get_registers();
+            rel_reg[pid].insert(rs.begin(),rs.end());
+          }
+        }
+      }
+    }
+  }
+
+  /* Replace the instructions that are not kept by nops. */
+  Machine *m0 = new Machine(*this);
+  int sliced_count = 0;
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    const std::vector<Automaton::State> &states = automata[pid].get_states();
+    for(unsigned i = 0; i < states.size(); ++i){
+      for(auto trit = states[i].fwd_transitions.begin(); trit != states[i].fwd_transitions.end(); ++trit){
+        const Lang::Stmt<int> &s = (*trit)->instruction;
+        if(kept.count(*trit) || s.get_type() == Lang::NOP || s.get_type() == Lang::GOTO) continue;
+        m0->automata[pid].del_transition(**trit);
+        m0->automata[pid].add_transition(Automaton::Transition((*trit)->source,
+                                                               Lang::Stmt<int>::nop(s.get_pos()),
+                                                               (*trit)->target));
+        ++sliced_count;
+      }
+    }
+  }
+  Machine *m = m0->remove_superfluous_nops();
+  delete m0;
+
+  /* Remove memory locations and registers that no longer occur. The
+   * predicates refer to memory locations by their ids, so they are
+   * kept as they are if there are any predicates. */
+  if(predicates.size()){
+    Log::msg << "Sliced away " << sliced_count << " instructions.\n";
+    return m;
+  }
+
+  std::vector<int> gmap(gvars.size(),-1);
+  std::vector<std::vector<int> > lmap(automata.size());
+  std::vector<std::vector<int> > rmap(automata.size());
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    lmap[pid].resize(lvars[pid].size(),-1);
+    rmap[pid].resize(regs[pid].size(),-1);
+  }
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    const std::vector<Automaton::State> &states = m->automata[pid].get_states();
+    for(unsigned i = 0; i < states.size(); ++i){
+      for(auto trit = states[i].fwd_transitions.begin(); trit != states[i].fwd_transitions.end(); ++trit){
+        const Lang::Stmt<int> &s = (*trit)->instruction;
+        for(const std::vector<Lang::MemLoc<int> > *mls : {&s.get_reads(),&s.get_writes()}){
+          for(const Lang::MemLoc<int> &ml : *mls){
+            Lang::NML nml(ml,pid);
+            if(nml.is_global()){
+              gmap[nml.get_id()] = 0;
+            }else{
+              lmap[nml.get_owner()][nml.get_id()] = 0;
+            }
+          }
+        }
+        std::set<int> rs = s.get_registers();
+        for(int r : rs){
+          rmap[pid][r] = 0;
+        }
+      }
+    }
+  }
+
+  int removed_nmls = 0, removed_regs = 0;
+  std::vector<Lang::VarDecl> new_gvars;
+  std::vector<std::vector<Lang::VarDecl> > new_lvars(automata.size());
+  std::vector<std::vector<Lang::VarDecl> > new_regs(automata.size());
+  std::map<Lang::NML,std::string> new_pretty_string_nml;
+  std::map<std::pair<int,int>,std::string> new_pretty_string_reg;
+  for(unsigned i = 0; i < gvars.size(); ++i){
+    if(gmap[i] < 0){
+      ++removed_nmls;
+      continue;
+    }
+    gmap[i] = new_gvars.size();
+    new_gvars.push_back(gvars[i]);
+    if(pretty_string_nml.count(Lang::NML::global(i))){
+      new_pretty_string_nml[Lang::NML::global(gmap[i])] = pretty_string_nml.at(Lang::NML::global(i));
+    }
+  }
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    for(unsigned i = 0; i < lvars[pid].size(); ++i){
+      if(lmap[pid][i] < 0){
+        ++removed_nmls;
+        continue;
+      }
+      lmap[pid][i] = new_lvars[pid].size();
+      new_lvars[pid].push_back(lvars[pid][i]);
+      if(pretty_string_nml.count(Lang::NML::local(i,pid))){
+        new_pretty_string_nml[Lang::NML::local(lmap[pid][i],pid)] =
+          pretty_string_nml.at(Lang::NML::local(i,pid));
+      }
+    }
+    for(unsigned r = 0; r < regs[pid].size(); ++r){
+      if(rmap[pid][r] < 0){
+        ++removed_regs;
+        continue;
+      }
+      rmap[pid][r] = new_regs[pid].size();
+      new_regs[pid].push_back(regs[pid][r]);
+      if(pretty_string_reg.count(std::pair<int,int>(r,pid))){
+        new_pretty_string_reg[std::pair<int,int>(rmap[pid][r],pid)] =
+          pretty_string_reg.at(std::pair<int,int>(r,pid));
+      }
+    }
+  }
+
+  Log::msg << "Sliced away " << sliced_count << " instructions, "
+           << removed_nmls << " memory locations and "
+           << removed_regs << " registers.\n";
+
+  if(removed_nmls == 0 && removed_regs == 0){
+    return m;
+  }
+
+  for(unsigned pid = 0; pid < automata.size(); ++pid){
+    /* Stmt::convert also converts the register field of statements
+     * that do not use any register, so r need not be mapped. */
+    std::function<int(const int&)> rc =
+      [&rmap,pid](const int &r){
+      return (0 <= r && r < int(rmap[pid].size()) && rmap[pid][r] >= 0) ? rmap[pid][r] : r;
+    };
+    std::function<Lang::MemLoc<int>(const Lang::MemLoc<int>&)> mlc =
+      [&gmap,&lmap,pid](const Lang::MemLoc<int> &ml){
+      Lang::NML nml(ml,pid);
+      if(nml.is_global()){
+        return Lang::MemLoc<int>::global(gmap[nml.get_id()]);
+      }
+      return Lang::NML::local(lmap[nml.get_owner()][nml.get_id()],nml.get_owner()).localize(pid);
+    };
+    /* Delete all transitions before adding the converted ones, so
+     * that converted and unconverted transitions are never
+     * confused. The control states are kept. */
+    std::vector<Automaton::Transition> ts;
+    const std::vector<Automaton::State> &states = m->automata[pid].get_states();
+    for(unsigned i = 0; i < states.size(); ++i){
+      for(auto trit = states[i].fwd_transitions.begin(); trit != states[i].fwd_transitions.end(); ++trit){
+        ts.push_back(**trit);
+      }
+    }
+    for(const Automaton::Transition &t : ts){
+      m->automata[pid].del_transition(t);
+    }
+    for(const Automaton::Transition &t : ts){
+      m->automata[pid].add_transition(Automaton::Transition(t.source,t.instruction.convert(rc,mlc),t.target));
+    }
+  }
+  m->gvars = new_gvars;
+  m->lvars = new_lvars;
+  m->regs = new_regs;
+  m->pretty_string_nml = new_pretty_string_nml;
+  m->pretty_string_reg = new_pretty_string_reg;
+
+  return m;
+};
+
 Machine *Machine::add_domain_assumes() const{
   Machine *m = new Machine(*this);
 
@@ -1426,4 +1669,70 @@ void Machine::test(){
       delete m;
     }
   }
+
+  /* Test slice */
+  {
+    /* Test 1: A counter and a register that do not influence the
+     * forbidden state are sliced away. */
+    {
+      Machine *m = get_machine
+        ("forbidden BAD *\n"
+         "data\n"
+         "  c = 0 : [0:3]\n"
+         "  x = 0 : [0:1]\n"
+         "  y = 0 : [0:1]\n"
+         "process\n"
+         "registers\n"
+         "  $r = 0 : [0:1]\n"
+         "  $s = 0 : [0:3]\n"
+         "text\n"
+         "  write: c := 1;\n"
+         "  read: $s := c;\n"
+         "  read: $r := y;\n"
+         "  if $r = 1 then\n"
+         "    BAD: nop\n"
+         "process\n"
+         "text\n"
+         "  write: x := 1;\n"
+         "  write: y := 1;\n"
+         "  write: c := 2\n");
+      Machine *m2 = m->slice();
+
+      Test::inner_test("slice #1",
+                       m2->gvars.size() == 1 && m2->regs[0].size() == 1 &&
+                       m2->pretty_string_nml.at(Lang::NML::global(0)) == "y" &&
+                       m2->pretty_string_reg.at(std::pair<int,int>(0,0)) == "$r" &&
+                       m2->automata[0].get_transition_count() == 4 &&
+                       m2->automata[1].get_transition_count() == 1 &&
+                       m2->forbidden.size() == 2 &&
+                       m2->forbidden[0][0] == cs(m2,0,"BAD"));
+
+      delete m;
+      delete m2;
+    }
+
+    /* Test 2: Writes that may violate the domain of their memory
+     * location are kept. */
+    {
+      Machine *m = get_machine
+        ("forbidden BAD\n"
+         "data\n"
+         "  x = 0 : [0:1]\n"
+         "process\n"
+         "registers\n"
+         "  $r = 0 : [0:3]\n"
+         "text\n"
+         "  $r := 2;\n"
+         "  write: x := $r;\n"
+         "  BAD: nop\n");
+      Machine *m2 = m->slice();
+
+      Test::inner_test("slice #2",
+                       m2->gvars.size() == 1 && m2->regs[0].size() == 1 &&
+                       m2->automata[0].get_transition_count() == 2);
+
+      delete m;
+      delete m2;
+    }
+  }
 }
@@ -25,6 +25,7 @@
 #include "parser.h"
 #include "lang.h"
 #include "predicates.h"
+#include <mutex>
 #include <vector>
 #include <sstream>
 #include "vecset.h"
@@ -183,7 +184,10 @@ public:
   Machine &operator=(const Machine&); // Deep copy
   /* Returns a list with distinct elements (p,ml) such that process
    * p has a transition that writes to the memory location (from the
-   * perspective of p) ml. */
+   * perspective of p) ml.
+   *
+   * The result is computed on the first call, and cached in this
+   * machine. It is safe to call get_possible_writes concurrently. */
   const std::list<std::pair<int,Lang::MemLoc<int> > > &get_possible_writes() const;
   /* Returns the total number of transitions in the automata of this machine */
   int get_transition_count() const;
@@ -229,6 +233,27 @@ public:
    */
   Machine *forbidden_shave() const;
 
+  /* Returns a new machine where all instructions that cannot
+   * influence whether a forbidden state is reached have been
+   * replaced by nops, superfluous nops have been removed, and (unless
+   * there are predicates) memory locations and registers that no
+   * longer occur have been removed.
+   *
+   * Instructions other than writes, assignments and assigning reads
+   * are always kept. A memory location or register is relevant if it
+   * is read or used by a kept instruction. A write (assignment,
+   * assigning read) is kept if the memory location (register) that
+   * it writes is relevant, or if it may violate the domain of that
+   * memory location (register). Hence control dependence through
+   * assumes and data dependence through registers and shared memory
+   * are both preserved, and the returned machine reaches a forbidden
+   * state iff this machine does.
+   *
+   * If this machine contains any pointer dereferences, then it is
+   * returned unsliced.
+   */
+  Machine *slice() const;
+
   /* Returns a machine that has precisely the same behaviour as this
    * one. The returned machine is augmented with assume statements
    * that ensure that no instruction violates the domain of a memory
@@ -287,6 +312,15 @@ public:
   static void test();
 protected:
 private:
+  /* An empty machine without processes or variables.
+   * Used when decoding a MachineImage. */
+  Machine() {};
+  friend class MachineImage;
+
+  /* Cache for get_possible_writes. Not copied with the machine. */
+  mutable std::mutex possible_writes_mutex;
+  mutable bool possible_writes_computed = false;
+  mutable std::list<std::pair<int,Lang::MemLoc<int> > > possible_writes;
 
   /* Initializes this->forbidden from fb. 
    * Pre: this->automata is fully populated. */
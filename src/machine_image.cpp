@@ -0,0 +1,893 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "machine_image.h"
+#include "preprocessor.h"
+#include "test.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  const char image_magic[8] = {'M','M','X','I','M','G','\0','\0'};
+  const uint32_t image_bom = 0x01020304;
+  /* magic, version, bom, flags, reserved, size, checksum */
+  const std::size_t header_size = 8 + 4*4 + 8 + 8;
+}
+
+const uint32_t MachineImage::format_version = 1;
+
+/* Appends binary data to a string buffer. */
+class MachineImage::Writer{
+public:
+  void put_raw(const void *p, std::size_t n){
+    buf.append(static_cast<const char*>(p),n);
+  };
+  void put_int(int32_t i){ put_raw(&i,sizeof(i)); };
+  void put_bool(bool b){ put_int(b ? 1 : 0); };
+  void put_string(const std::string &s){
+    put_int(s.size());
+    put_raw(s.data(),s.size());
+  };
+  std::string buf;
+};
+
+/* Reads binary data from a memory range. Throws Error* on attempts to
+ * read beyond the end of the range. */
+class MachineImage::Reader{
+public:
+  Reader(const char *begin, const char *end) : cur(begin), end(end) {};
+  void get_raw(void *p, std::size_t n){
+    if(std::size_t(end - cur) < n){
+      throw new Error("Unexpected end of image.");
+    }
+    std::memcpy(p,cur,n);
+    cur += n;
+  };
+  int32_t get_int(){
+    int32_t i;
+    get_raw(&i,sizeof(i));
+    return i;
+  };
+  /* Reads a non-negative integer, used for sizes and counts. */
+  int get_count(){
+    int32_t i = get_int();
+    if(i < 0) throw new Error("Corrupt image: negative count.");
+    return i;
+  };
+  bool get_bool(){ return get_int() != 0; };
+  std::string get_string(){
+    int n = get_count();
+    if(end - cur < n){
+      throw new Error("Unexpected end of image.");
+    }
+    std::string s(cur,n);
+    cur += n;
+    return s;
+  };
+  bool at_end() const { return cur == end; };
+private:
+  const char *cur;
+  const char *end;
+};
+
+uint64_t MachineImage::checksum(const char *data, std::size_t len){
+  uint64_t h = 14695981039346656037ULL;
+  for(std::size_t i = 0; i < len; ++i){
+    h ^= uint64_t(static_cast<unsigned char>(data[i]));
+    h *= 1099511628211ULL;
+  }
+  return h;
+};
+
+/*****************************************/
+/*               Writing                 */
+/*****************************************/
+
+std::string MachineImage::to_string(const Machine &m, uint32_t flags){
+  Writer payload;
+  write_machine(payload,m);
+
+  Writer img;
+  uint32_t reserved = 0;
+  uint64_t size = payload.buf.size();
+  uint64_t sum = checksum(payload.buf.data(),payload.buf.size());
+  img.put_raw(image_magic,sizeof(image_magic));
+  img.put_raw(&format_version,sizeof(format_version));
+  img.put_raw(&image_bom,sizeof(image_bom));
+  img.put_raw(&flags,sizeof(flags));
+  img.put_raw(&reserved,sizeof(reserved));
+  img.put_raw(&size,sizeof(size));
+  img.put_raw(&sum,sizeof(sum));
+  assert(img.buf.size() == header_size);
+  img.buf += payload.buf;
+  return img.buf;
+};
+
+std::string MachineImage::canonical_string(const Machine &m){
+  Writer w;
+  /* canon[pid][q] is the canonical number of control state q of
+   * process pid */
+  std::vector<std::vector<int> > canon(m.automata.size());
+  w.put_int(m.automata.size());
+  for(unsigned pid = 0; pid < m.automata.size(); ++pid){
+    const std::vector<Automaton::State> &states = m.automata[pid].get_states();
+    /* Encode the instructions */
+    std::vector<std::vector<std::pair<std::string,int> > > succ(states.size());
+    for(unsigned q = 0; q < states.size(); ++q){
+      for(const Automaton::Transition *t : states[q].fwd_transitions){
+        Writer iw;
+        write_stmt(iw,t->instruction,false);
+        succ[q].push_back(std::pair<std::string,int>(iw.buf,t->target));
+      }
+    }
+    /* Colour the states by iterated refinement of their outgoing
+     * transitions, so that successors with equal instructions can be
+     * ordered independently of the original state numbering. */
+    std::vector<int> col(states.size(),0);
+    int col_count = 1;
+    for(;;){
+      typedef std::pair<int,std::vector<std::pair<std::string,int> > > sig_t;
+      std::vector<sig_t> sigs(states.size());
+      std::map<sig_t,int> sig_col;
+      for(unsigned q = 0; q < states.size(); ++q){
+        sigs[q].first = (q == 0) ? -1 : col[q];
+        for(const auto &pr : succ[q]){
+          sigs[q].second.push_back(std::pair<std::string,int>(pr.first,col[pr.second]));
+        }
+        std::sort(sigs[q].second.begin(),sigs[q].second.end());
+        sig_col[sigs[q]] = 0;
+      }
+      int c = 0;
+      for(auto &sc : sig_col) sc.second = c++;
+      for(unsigned q = 0; q < states.size(); ++q) col[q] = sig_col[sigs[q]];
+      if(c == col_count) break;
+      col_count = c;
+    }
+    for(unsigned q = 0; q < states.size(); ++q){
+      std::sort(succ[q].begin(),succ[q].end(),
+                [&col](const std::pair<std::string,int> &a,
+                       const std::pair<std::string,int> &b){
+                  return a.first < b.first ||
+                    (a.first == b.first && col[a.second] < col[b.second]);
+                });
+    }
+    /* Number the states in breadth first order. States which are
+     * not reachable from the initial state are numbered last, in
+     * order of colour. */
+    std::vector<int> roots(states.size());
+    for(unsigned q = 0; q < states.size(); ++q) roots[q] = q;
+    std::stable_sort(roots.begin()+(roots.empty() ? 0 : 1),roots.end(),
+                     [&col](int a, int b){ return col[a] < col[b]; });
+    std::vector<int> &num = canon[pid];
+    num.assign(states.size(),-1);
+    int next = 0;
+    for(int root : roots){
+      if(num[root] >= 0) continue;
+      std::vector<int> queue(1,root);
+      num[root] = next++;
+      for(unsigned i = 0; i < queue.size(); ++i){
+        for(const auto &pr : succ[queue[i]]){
+          if(num[pr.second] < 0){
+            num[pr.second] = next++;
+            queue.push_back(pr.second);
+          }
+        }
+      }
+    }
+    /* Write the transitions in canonical order */
+    std::vector<std::string> ts;
+    for(unsigned q = 0; q < states.size(); ++q){
+      for(const auto &pr : succ[q]){
+        Writer tw;
+        tw.put_int(num[q]);
+        tw.put_int(num[pr.second]);
+        tw.buf += pr.first;
+        ts.push_back(tw.buf);
+      }
+    }
+    std::sort(ts.begin(),ts.end());
+    w.put_int(states.size());
+    w.put_int(ts.size());
+    for(const std::string &t : ts) w.put_string(t);
+  }
+  w.put_int(m.lvars.size());
+  for(const auto &pvars : m.lvars){
+    w.put_int(pvars.size());
+    for(const Lang::VarDecl &d : pvars) write_decl(w,d);
+  }
+  w.put_int(m.gvars.size());
+  for(const Lang::VarDecl &d : m.gvars) write_decl(w,d);
+  w.put_int(m.regs.size());
+  for(const auto &pregs : m.regs){
+    w.put_int(pregs.size());
+    for(const Lang::VarDecl &d : pregs) write_decl(w,d);
+  }
+  std::vector<std::vector<int> > forbidden;
+  for(const std::vector<int> &f : m.forbidden){
+    std::vector<int> f2(f.size());
+    for(unsigned pid = 0; pid < f.size(); ++pid){
+      bool in_range = pid < canon.size() && f[pid] >= 0 && f[pid] < int(canon[pid].size());
+      f2[pid] = in_range ? canon[pid][f[pid]] : f[pid];
+    }
+    forbidden.push_back(f2);
+  }
+  std::sort(forbidden.begin(),forbidden.end());
+  w.put_int(forbidden.size());
+  for(const std::vector<int> &f : forbidden){
+    w.put_int(f.size());
+    for(int q : f) w.put_int(q);
+  }
+  w.put_int(m.predicates.size());
+  for(const auto &p : m.predicates){
+    write_syntax_string(w,static_cast<const SyntaxString<Predicates::DummyVar>&>(p));
+  }
+  return w.buf;
+};
+
+void MachineImage::write(const Machine &m, uint32_t flags, const std::string &filename){
+  std::string img = to_string(m,flags);
+  std::ofstream os(filename.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+  if(!os){
+    throw new Error("Unable to open '"+filename+"' for writing.");
+  }
+  os.write(img.data(),img.size());
+  if(!os){
+    throw new Error("Failed to write image to '"+filename+"'.");
+  }
+};
+
+void MachineImage::write_machine(Writer &w, const Machine &m){
+  w.put_int(m.automata.size());
+  for(const Automaton &a : m.automata){
+    write_automaton(w,a);
+  }
+  w.put_int(m.lvars.size());
+  for(const auto &pvars : m.lvars){
+    w.put_int(pvars.size());
+    for(const Lang::VarDecl &d : pvars) write_decl(w,d);
+  }
+  w.put_int(m.gvars.size());
+  for(const Lang::VarDecl &d : m.gvars) write_decl(w,d);
+  w.put_int(m.regs.size());
+  for(const auto &pregs : m.regs){
+    w.put_int(pregs.size());
+    for(const Lang::VarDecl &d : pregs) write_decl(w,d);
+  }
+  w.put_int(m.forbidden.size());
+  for(const std::vector<int> &f : m.forbidden){
+    w.put_int(f.size());
+    for(int q : f) w.put_int(q);
+  }
+  w.put_int(m.predicates.size());
+  for(const auto &p : m.predicates){
+    write_syntax_string(w,static_cast<const SyntaxString<Predicates::DummyVar>&>(p));
+  }
+  w.put_int(m.pretty_string_nml.size());
+  for(const auto &pr : m.pretty_string_nml){
+    w.put_int(pr.first.get_owner());
+    w.put_int(pr.first.get_id());
+    w.put_string(pr.second);
+  }
+  w.put_int(m.pretty_string_reg.size());
+  for(const auto &pr : m.pretty_string_reg){
+    w.put_int(pr.first.first);
+    w.put_int(pr.first.second);
+    w.put_string(pr.second);
+  }
+};
+
+void MachineImage::write_automaton(Writer &w, const Automaton &a){
+  const std::vector<Automaton::State> &states = a.get_states();
+  w.put_int(states.size());
+  w.put_int(a.get_transition_count());
+  for(unsigned q = 0; q < states.size(); ++q){
+    for(const Automaton::Transition *t : states[q].fwd_transitions){
+      w.put_int(t->source);
+      w.put_int(t->target);
+      write_stmt(w,t->instruction);
+    }
+  }
+  w.put_int(a.get_labels().size());
+  for(const auto &pr : a.get_labels()){
+    w.put_string(pr.first);
+    w.put_int(pr.second);
+  }
+};
+
+void MachineImage::write_decl(Writer &w, const Lang::VarDecl &d){
+  w.put_string(d.name);
+  w.put_bool(d.value.is_wild());
+  w.put_int(d.value.get_value());
+  w.put_bool(d.domain.is_int());
+  if(d.domain.is_finite()){
+    w.put_int(d.domain.get_lower_bound());
+    w.put_int(d.domain.get_upper_bound());
+  }
+};
+
+void MachineImage::write_pos(Writer &w, const Lexer::TokenPos &pos){
+  w.put_int(pos.pos.size());
+  for(const Lexer::TokenPos::LineChar &lc : pos.pos){
+    w.put_int(lc.lineno);
+    w.put_int(lc.charno);
+  }
+};
+
+void MachineImage::write_memloc(Writer &w, const Lang::MemLoc<int> &ml){
+  w.put_int(ml.type);
+  w.put_int(ml.id);
+  w.put_int(ml.owner);
+  w.put_int(ml.ptr);
+};
+
+void MachineImage::write_memlocs(Writer &w, const VecSet<Lang::MemLoc<int> > &mls){
+  w.put_int(mls.size());
+  for(int i = 0; i < mls.size(); ++i){
+    write_memloc(w,mls[i]);
+  }
+};
+
+/* Constants of syntax strings are stored by write_var and restored by
+ * read_var. Only register constants (int) can be stored. Predicates
+ * of a machine are generalised, and have no constants. */
+namespace {
+  template<class W> void write_var(W &w, const int &v){ w.put_int(v); };
+  template<class W> void write_var(W &, const Predicates::DummyVar &){
+    throw new MachineImage::Error("Cannot store predicate with constants.");
+  };
+  template<class R> void read_var(R &r, int *v){ *v = r.get_int(); };
+  template<class R> void read_var(R &, Predicates::DummyVar *){
+    throw new MachineImage::Error("Corrupt image: predicate with constants.");
+  };
+}
+
+template<class Var>
+void MachineImage::write_syntax_string(Writer &w, const SyntaxString<Var> &ss){
+  w.put_int(ss.symbol_count);
+  w.put_int(ss.const_count);
+  w.put_int(ss.arg_count);
+  for(int i = 0; i < ss.symbol_count; ++i){
+    w.put_int(ss.symbols[i]);
+  }
+  for(int i = 0; i < ss.const_count; ++i){
+    write_var(w,ss.consts[i]);
+  }
+};
+
+void MachineImage::write_stmt(Writer &w, const Lang::Stmt<int> &s, bool pretty){
+  w.put_int(s.type);
+  w.put_int(s.reg);
+  write_memlocs(w,s.writes);
+  write_memlocs(w,s.reads);
+  w.put_bool(s.e0);
+  if(s.e0) write_syntax_string(w,static_cast<const SyntaxString<int>&>(*s.e0));
+  w.put_bool(s.e1);
+  if(s.e1) write_syntax_string(w,static_cast<const SyntaxString<int>&>(*s.e1));
+  w.put_bool(s.b);
+  if(s.b) write_syntax_string(w,static_cast<const SyntaxString<int>&>(*s.b));
+  w.put_bool(s.fence);
+  if(pretty) w.put_string(s.lbl);
+  w.put_int(s.writer);
+  w.put_int(s.stmt_count);
+  for(int i = 0; i < s.stmt_count; ++i){
+    if(pretty) w.put_string(s.stmts[i].lbl);
+    write_stmt(w,s.stmts[i].stmt,pretty);
+  }
+  if(!pretty) return;
+  write_pos(w,s.pos);
+  w.put_int(s.lex_symbols.size());
+  for(const Lexer::Token &tok : s.lex_symbols){
+    w.put_int(tok.type);
+    w.put_string(tok.value);
+    write_pos(w,tok.pos);
+  }
+};
+
+/*****************************************/
+/*               Reading                 */
+/*****************************************/
+
+bool MachineImage::is_image(const std::string &filename){
+  std::ifstream is(filename.c_str(),std::ios::in | std::ios::binary);
+  char magic[sizeof(image_magic)];
+  if(!is.read(magic,sizeof(magic))) return false;
+  return std::memcmp(magic,image_magic,sizeof(magic)) == 0;
+};
+
+Machine *MachineImage::load(const std::string &filename, uint32_t *flags){
+  int fd = open(filename.c_str(),O_RDONLY);
+  if(fd == -1){
+    throw new Error("Unable to open '"+filename+"': "+std::strerror(errno));
+  }
+  struct stat st;
+  if(fstat(fd,&st) == -1){
+    std::string err = std::strerror(errno);
+    close(fd);
+    throw new Error("Unable to stat '"+filename+"': "+err);
+  }
+  std::size_t len = st.st_size;
+  if(len < header_size){
+    close(fd);
+    throw new Error("'"+filename+"' is too short to be a machine image.");
+  }
+  void *data = mmap(0,len,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(data == MAP_FAILED){
+    throw new Error("Unable to map '"+filename+"': "+std::strerror(errno));
+  }
+  Machine *m = 0;
+  try{
+    m = from_buffer(static_cast<const char*>(data),len,flags);
+  }catch(...){
+    munmap(data,len);
+    throw;
+  }
+  munmap(data,len);
+  return m;
+};
+
+Machine *MachineImage::from_buffer(const char *data, std::size_t len, uint32_t *flags){
+  Reader hdr(data,data+len);
+  char magic[sizeof(image_magic)];
+  uint32_t version, bom, img_flags, reserved;
+  uint64_t size, sum;
+  hdr.get_raw(magic,sizeof(magic));
+  if(std::memcmp(magic,image_magic,sizeof(magic)) != 0){
+    throw new Error("Not a machine image.");
+  }
+  hdr.get_raw(&version,sizeof(version));
+  hdr.get_raw(&bom,sizeof(bom));
+  hdr.get_raw(&img_flags,sizeof(img_flags));
+  hdr.get_raw(&reserved,sizeof(reserved));
+  hdr.get_raw(&size,sizeof(size));
+  hdr.get_raw(&sum,sizeof(sum));
+  if(bom != image_bom){
+    throw new Error("Image was written on a host with different byte order.");
+  }
+  if(version != format_version){
+    std::stringstream ss;
+    ss << "Unsupported image version " << version << " (expected " << format_version
+       << "). Recompile the machine with memorax compile.";
+    throw new Error(ss.str());
+  }
+  if(size != len - header_size){
+    throw new Error("Corrupt image: payload size mismatch.");
+  }
+  const char *payload = data + header_size;
+  if(checksum(payload,size) != sum){
+    throw new Error("Corrupt image: checksum mismatch.");
+  }
+  Reader r(payload,payload+size);
+  std::unique_ptr<Machine> m(read_machine(r));
+  if(!r.at_end()){
+    throw new Error("Corrupt image: trailing data.");
+  }
+  if(flags) *flags = img_flags;
+  return m.release();
+};
+
+Machine *MachineImage::read_machine(Reader &r){
+  std::unique_ptr<Machine> m(new Machine());
+  m->automata.resize(r.get_count());
+  for(Automaton &a : m->automata){
+    read_automaton(r,a);
+  }
+  m->lvars.resize(r.get_count());
+  for(auto &pvars : m->lvars){
+    int n = r.get_count();
+    pvars.reserve(n);
+    for(int i = 0; i < n; ++i) pvars.push_back(read_decl(r));
+  }
+  {
+    int n = r.get_count();
+    m->gvars.reserve(n);
+    for(int i = 0; i < n; ++i) m->gvars.push_back(read_decl(r));
+  }
+  m->regs.resize(r.get_count());
+  for(auto &pregs : m->regs){
+    int n = r.get_count();
+    pregs.reserve(n);
+    for(int i = 0; i < n; ++i) pregs.push_back(read_decl(r));
+  }
+  m->forbidden.resize(r.get_count());
+  for(std::vector<int> &f : m->forbidden){
+    f.resize(r.get_count());
+    if(f.size() != m->automata.size()){
+      throw new Error("Corrupt image: wrong number of control states in forbidden.");
+    }
+    for(unsigned pid = 0; pid < f.size(); ++pid){
+      f[pid] = r.get_int();
+      if(f[pid] < 0 || f[pid] >= int(m->automata[pid].get_states().size())){
+        throw new Error("Corrupt image: forbidden refers to non-existing state.");
+      }
+    }
+  }
+  {
+    int n = r.get_count();
+    for(int i = 0; i < n; ++i){
+      m->predicates.push_back(Predicates::Predicate<Predicates::DummyVar>
+                              (read_syntax_string<Predicates::DummyVar>(r)));
+    }
+  }
+  {
+    int n = r.get_count();
+    for(int i = 0; i < n; ++i){
+      int owner = r.get_int();
+      int id = r.get_int();
+      Lang::NML nml = (owner == -1) ? Lang::NML::global(id) : Lang::NML::local(id,owner);
+      m->pretty_string_nml[nml] = r.get_string();
+    }
+  }
+  {
+    int n = r.get_count();
+    for(int i = 0; i < n; ++i){
+      int reg = r.get_int();
+      int pid = r.get_int();
+      m->pretty_string_reg[std::pair<int,int>(reg,pid)] = r.get_string();
+    }
+  }
+  return m.release();
+};
+
+void MachineImage::read_automaton(Reader &r, Automaton &a){
+  int state_count = r.get_count();
+  int trans_count = r.get_count();
+  a.get_states().resize(std::max(state_count,1));
+  for(int i = 0; i < trans_count; ++i){
+    int src = r.get_count();
+    int tgt = r.get_count();
+    if(src >= state_count || tgt >= state_count){
+      throw new Error("Corrupt image: transition refers to non-existing state.");
+    }
+    a.add_transition(Automaton::Transition(src,read_stmt(r),tgt));
+  }
+  int label_count = r.get_count();
+  for(int i = 0; i < label_count; ++i){
+    std::string lbl = r.get_string();
+    a.set_label(lbl,r.get_count());
+  }
+};
+
+Lang::VarDecl MachineImage::read_decl(Reader &r){
+  std::string name = r.get_string();
+  bool wild = r.get_bool();
+  int value = r.get_int();
+  bool dom_is_int = r.get_bool();
+  Lang::VarDecl::Domain dom;
+  if(!dom_is_int){
+    int lb = r.get_int();
+    int ub = r.get_int();
+    if(ub < lb) throw new Error("Corrupt image: invalid domain.");
+    dom = Lang::VarDecl::Domain(lb,ub);
+  }
+  return Lang::VarDecl(name, wild ? Lang::Value() : Lang::Value(value), dom);
+};
+
+Lexer::TokenPos MachineImage::read_pos(Reader &r){
+  Lexer::TokenPos pos;
+  pos.pos.resize(r.get_count());
+  for(Lexer::TokenPos::LineChar &lc : pos.pos){
+    lc.lineno = r.get_int();
+    lc.charno = r.get_int();
+  }
+  return pos;
+};
+
+Lang::MemLoc<int> MachineImage::read_memloc(Reader &r){
+  Lang::MemLoc<int> ml = Lang::MemLoc<int>::global(0);
+  int type = r.get_int();
+  if(type < Lang::MemLoc<int>::GLOBAL_ID || type > Lang::MemLoc<int>::LOCAL){
+    throw new Error("Corrupt image: invalid memory location type.");
+  }
+  ml.type = static_cast<Lang::MemLoc<int>::Type>(type);
+  ml.id = r.get_int();
+  ml.owner = r.get_int();
+  ml.ptr = r.get_int();
+  return ml;
+};
+
+VecSet<Lang::MemLoc<int> > MachineImage::read_memlocs(Reader &r){
+  int n = r.get_count();
+  std::vector<Lang::MemLoc<int> > v;
+  v.reserve(n);
+  for(int i = 0; i < n; ++i){
+    v.push_back(read_memloc(r));
+  }
+  return VecSet<Lang::MemLoc<int> >(v);
+};
+
+template<class Var>
+SyntaxString<Var> MachineImage::read_syntax_string(Reader &r){
+  int sc = r.get_count();
+  int cc = r.get_count();
+  int ac = r.get_count();
+  if(sc < 2 || sc % 2 != 0){
+    throw new Error("Corrupt image: invalid syntax string.");
+  }
+  SyntaxString<Var> ss(sc,cc,ac);
+  for(int i = 0; i < sc; ++i){
+    ss.symbols[i] = r.get_int();
+  }
+  for(int i = 0; i < cc; ++i){
+    read_var(r,&ss.consts[i]);
+  }
+#ifndef NDEBUG
+  if(!ss.check_invariant()){
+    throw new Error("Corrupt image: invalid syntax string.");
+  }
+#endif
+  return ss;
+};
+
+Lang::Stmt<int> MachineImage::read_stmt(Reader &r){
+  Lang::Stmt<int> s;
+  int type = r.get_int();
+  if(type < Lang::NOP || type > Lang::SEQUENCE){
+    throw new Error("Corrupt image: invalid statement type.");
+  }
+  s.type = static_cast<Lang::stmt_t>(type);
+  s.reg = r.get_int();
+  s.writes = read_memlocs(r);
+  s.reads = read_memlocs(r);
+  if(r.get_bool()) s.e0 = new Lang::Expr<int>(read_syntax_string<int>(r));
+  if(r.get_bool()) s.e1 = new Lang::Expr<int>(read_syntax_string<int>(r));
+  if(r.get_bool()) s.b = new Lang::BExpr<int>(read_syntax_string<int>(r));
+  s.fence = r.get_bool();
+  s.lbl = r.get_string();
+  s.writer = r.get_int();
+  int stmt_count = r.get_count();
+  if(stmt_count > 0){
+    s.stmts = new Lang::Stmt<int>::labeled_stmt_t[stmt_count];
+    s.stmt_count = stmt_count;
+    for(int i = 0; i < stmt_count; ++i){
+      s.stmts[i].lbl = r.get_string();
+      s.stmts[i].stmt = read_stmt(r);
+    }
+  }
+  s.pos = read_pos(r);
+  int symb_count = r.get_count();
+  s.lex_symbols.resize(symb_count);
+  for(Lexer::Token &tok : s.lex_symbols){
+    tok.type = static_cast<Lexer::TokenType>(r.get_int());
+    tok.value = r.get_string();
+    tok.pos = read_pos(r);
+  }
+  return s;
+};
+
+/*****************************************/
+/*                Tests                  */
+/*****************************************/
+
+void MachineImage::test(){
+  std::function<Machine*(std::string)> get_machine =
+    [](std::string rmm){
+    std::stringstream ss(rmm);
+    PPLexer lex(ss);
+    return new Machine(Parser::p_test(lex));
+  };
+
+  std::function<bool(const std::vector<Lang::VarDecl>&,const std::vector<Lang::VarDecl>&)> same_decls =
+    [](const std::vector<Lang::VarDecl> &a, const std::vector<Lang::VarDecl> &b){
+    if(a.size() != b.size()) return false;
+    for(unsigned i = 0; i < a.size(); ++i){
+      if(a[i].name != b[i].name ||
+         a[i].value.to_string() != b[i].value.to_string() ||
+         a[i].domain.to_string() != b[i].domain.to_string()){
+        return false;
+      }
+    }
+    return true;
+  };
+
+  /* Note: Machine::to_string is not compared, since the order in
+   * which transitions are printed depends on their addresses. */
+  std::function<bool(const Machine&,const Machine&)> same_machine =
+    [&same_decls](const Machine &a, const Machine &b){
+    if(a.automata.size() != b.automata.size()) return false;
+    for(unsigned p = 0; p < a.automata.size(); ++p){
+      if(!a.automata[p].same_automaton(b.automata[p],true)) return false;
+      if(a.automata[p].get_states().size() != b.automata[p].get_states().size()) return false;
+    }
+    if(!same_decls(a.gvars,b.gvars)) return false;
+    if(a.lvars.size() != b.lvars.size() || a.regs.size() != b.regs.size()) return false;
+    for(unsigned p = 0; p < a.lvars.size(); ++p){
+      if(!same_decls(a.lvars[p],b.lvars[p])) return false;
+    }
+    for(unsigned p = 0; p < a.regs.size(); ++p){
+      if(!same_decls(a.regs[p],b.regs[p])) return false;
+    }
+    if(a.forbidden != b.forbidden) return false;
+    if(a.pretty_string_nml != b.pretty_string_nml) return false;
+    if(a.pretty_string_reg != b.pretty_string_reg) return false;
+    if(a.predicates.size() != b.predicates.size()) return false;
+    for(unsigned i = 0; i < a.predicates.size(); ++i){
+      if(a.predicates[i] != b.predicates[i]) return false;
+    }
+    return true;
+  };
+
+  const std::string rmm = R"(
+forbidden
+  CS CS
+
+predicates
+  $r0 = 0;
+  $r0 < 2
+
+data
+  x = 0 : [0:1]
+  y = 0 : [0:1]
+  z = * : Z
+
+process
+registers
+  $r0 = 0 : [0:1]
+text
+  L0: write: x := 1;
+  either{
+    read: $r0 := y;
+    assume: $r0 = 0
+  or
+    locked{
+      read: z = 3;
+      write: z := 4
+    }
+  };
+  fence;
+  CS: nop
+
+process
+data
+  w = 1 : [0:2]
+registers
+  $r0 = * : [0:1]
+text
+  write: y := 1;
+  cas(w[my],1,2);
+  locked write: w[my] := 0;
+  read: $r0 := x;
+  if $r0 = 0 then
+    CS: write: w[my] := $r0 + 1
+)";
+
+  /* Test 1: Round trip of a parsed machine */
+  {
+    Machine *m = get_machine(rmm);
+    std::string img = to_string(*m,0);
+    uint32_t flags = 1234;
+    Machine *m2 = from_buffer(img.data(),img.size(),&flags);
+    Test::inner_test("Round trip of parsed machine",same_machine(*m,*m2) && flags == 0);
+    delete m2;
+    delete m;
+  }
+
+  /* Test 2: Round trip of a machine in register free form, through a file */
+  {
+    Machine *m0 = get_machine(rmm);
+    Machine *m1 = m0->remove_registers();
+    Machine *m = m1->remove_superfluous_nops();
+    char tmp_file_name[] = "mmximgtestXXXXXX";
+    int fd = mkstemp(tmp_file_name);
+    bool ok = false;
+    if(fd != -1){
+      close(fd);
+      write(*m,REGISTER_FREE,tmp_file_name);
+      uint32_t flags = 0;
+      Machine *m2 = 0;
+      if(is_image(tmp_file_name)){
+        m2 = load(tmp_file_name,&flags);
+      }
+      ok = m2 && same_machine(*m,*m2) && flags == REGISTER_FREE;
+      delete m2;
+      unlink(tmp_file_name);
+    }
+    Test::inner_test("Round trip of register free machine through file",ok);
+    delete m;
+    delete m1;
+    delete m0;
+  }
+
+  /* Test 3: Corrupt images are rejected */
+  {
+    Machine *m = get_machine(rmm);
+    std::string img = to_string(*m,0);
+    std::string bad = img;
+    bad[bad.size()-5] ^= 0x5a;
+    bool rejected_checksum = false;
+    try{
+      delete from_buffer(bad.data(),bad.size());
+    }catch(Error *e){
+      rejected_checksum = true;
+      delete e;
+    }
+    bool rejected_truncated = false;
+    try{
+      delete from_buffer(img.data(),img.size()-3);
+    }catch(Error *e){
+      rejected_truncated = true;
+      delete e;
+    }
+    bool rejected_version = false;
+    bad = img;
+    bad[8] += 1;
+    try{
+      delete from_buffer(bad.data(),bad.size());
+    }catch(Error *e){
+      rejected_version = true;
+      delete e;
+    }
+    bool rejected_forbidden = true;
+    std::vector<std::vector<int> > bad_forbidden =
+      {std::vector<int>(1,0), {0,int(m->automata[1].get_states().size())}};
+    for(const std::vector<int> &f : bad_forbidden){
+      m->forbidden.push_back(f);
+      img = to_string(*m,0);
+      m->forbidden.pop_back();
+      try{
+        delete from_buffer(img.data(),img.size());
+        rejected_forbidden = false;
+      }catch(Error *e){
+        delete e;
+      }
+    }
+    Test::inner_test("Corrupt images are rejected",
+                     rejected_checksum && rejected_truncated && rejected_version &&
+                     rejected_forbidden);
+    delete m;
+  }
+
+  /* Test 4: Canonical strings ignore labels and state numbering */
+  {
+    std::function<std::string(std::string,std::string)> branches =
+      [](std::string b0, std::string b1){
+      return
+        "forbidden CS\n"
+        "data\n"
+        "  x = 0 : [0:1]\n"
+        "  y = 0 : [0:1]\n"
+        "process\n"
+        "text\n"
+        "  either{\n" + b0 + "\n  or\n" + b1 + "\n  };\n"
+        "  CS: nop\n";
+    };
+    std::string b0 = "    write: x := 1;\n    L0: write: y := 1";
+    std::string b1 = "    write: y := 1;\n    L1: read: x = 1";
+    std::string b2 = "    write: y := 1;\n    read: x = 0";
+    Machine *m0 = get_machine(branches(b0,b1));
+    Machine *m1 = get_machine(branches(b1,b0));
+    Machine *m2 = get_machine(branches(b0,b2));
+    Test::inner_test("Canonical strings",
+                     canonical_string(*m0) == canonical_string(*m1) &&
+                     canonical_string(*m0) != canonical_string(*m2));
+    delete m0;
+    delete m1;
+    delete m2;
+  }
+};
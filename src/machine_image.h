@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MACHINE_IMAGE_H__
+#define __MACHINE_IMAGE_H__
+
+#include "machine.h"
+
+#include <cstdint>
+#include <string>
+
+/* A MachineImage is a compiled, binary representation of a fully
+ * processed Machine (automata, declarations, forbidden states,
+ * predicates and pretty printing information).
+ *
+ * Images are produced by the command "memorax compile" and can be
+ * given instead of an .rmm file to the commands reach and
+ * fencins. Loading an image maps the file into memory and decodes
+ * the machine directly, which skips lexing, macro expansion, parsing,
+ * automaton construction and (if recorded in the image) the register
+ * free form transformation.
+ *
+ * The file layout is a fixed header followed by a payload:
+ *
+ *   magic    (8 bytes) "MMXIMG\0\0"
+ *   version  (uint32)  format_version
+ *   bom      (uint32)  0x01020304 in the byte order of the writer
+ *   flags    (uint32)  bitwise or of flag_t
+ *   reserved (uint32)  0
+ *   size     (uint64)  payload length in bytes
+ *   checksum (uint64)  FNV-1a hash of the payload
+ *   payload
+ *
+ * The payload is a sequence of 32-bit integers and length-prefixed
+ * strings in the byte order of the writer. Images are not portable
+ * between hosts of different byte order; such images are rejected
+ * when loaded.
+ */
+class MachineImage{
+public:
+  class Error : public std::exception{
+  public:
+    Error(std::string m) : msg("MachineImage: "+m) {};
+    virtual ~Error() throw() {};
+    virtual const char *what() const throw() { return msg.c_str(); };
+  private:
+    std::string msg;
+  };
+
+  /* Describes which transformations have been applied to the machine
+   * stored in an image. */
+  enum flag_t {
+    /* The machine is in register free form (--rff) */
+    REGISTER_FREE = 1,
+    /* Locked writes have been converted to fences (as for -a hsb) */
+    LOCKS_TO_FENCES = 2,
+    /* The machine has been sliced (--slice) */
+    SLICED = 4
+  };
+
+  /* The version of the image format written by this build. Images of
+   * other versions are rejected. */
+  static const uint32_t format_version;
+
+  /* Serializes m into an image with the given flags and writes it to
+   * the file filename. Throws Error* on failure. */
+  static void write(const Machine &m, uint32_t flags, const std::string &filename);
+  /* Returns the image representation of m. */
+  static std::string to_string(const Machine &m, uint32_t flags);
+  /* Returns a string which identifies m up to the numbering of the
+   * control states, and up to labels, source positions and other
+   * information used only for printing. Machines with equal
+   * canonical strings have the same behaviour.
+   *
+   * Control states are numbered in breadth first order from the
+   * initial state, so machines which differ only in the order in
+   * which their states were created usually get equal canonical
+   * strings.
+   */
+  static std::string canonical_string(const Machine &m);
+  /* The FNV-1a hash of [data,data+len). */
+  static uint64_t checksum(const char *data, std::size_t len);
+
+  /* Returns true iff the file filename exists and starts with the
+   * image magic. */
+  static bool is_image(const std::string &filename);
+
+  /* Maps the image file filename into memory and decodes the machine
+   * stored in it. If flags is non-null, *flags is assigned the flags
+   * of the image. The returned machine is allocated on heap, and
+   * ownership is given to the caller.
+   *
+   * Throws Error* if the file is not a valid image of the current
+   * format version.
+   */
+  static Machine *load(const std::string &filename, uint32_t *flags = 0);
+  /* Same as load, but decodes the image given in the buffer
+   * [data,data+len). */
+  static Machine *from_buffer(const char *data, std::size_t len, uint32_t *flags = 0);
+
+  static void test();
+private:
+  class Writer;
+  class Reader;
+
+  static void write_machine(Writer &w, const Machine &m);
+  static void write_automaton(Writer &w, const Automaton &a);
+  /* If pretty is false, then labels, positions and lexical symbols
+   * are omitted. */
+  static void write_stmt(Writer &w, const Lang::Stmt<int> &s, bool pretty = true);
+  static void write_memloc(Writer &w, const Lang::MemLoc<int> &ml);
+  static void write_memlocs(Writer &w, const VecSet<Lang::MemLoc<int> > &mls);
+  static void write_pos(Writer &w, const Lexer::TokenPos &pos);
+  static void write_decl(Writer &w, const Lang::VarDecl &d);
+  template<class Var> static void write_syntax_string(Writer &w, const SyntaxString<Var> &ss);
+
+  static Machine *read_machine(Reader &r);
+  static void read_automaton(Reader &r, Automaton &a);
+  static Lang::Stmt<int> read_stmt(Reader &r);
+  static Lang::MemLoc<int> read_memloc(Reader &r);
+  static VecSet<Lang::MemLoc<int> > read_memlocs(Reader &r);
+  static Lexer::TokenPos read_pos(Reader &r);
+  static Lang::VarDecl read_decl(Reader &r);
+  template<class Var> static SyntaxString<Var> read_syntax_string(Reader &r);
+
+};
+
+#endif
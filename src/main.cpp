@@ -18,17 +18,25 @@
  *
  */
 
+#include "batch.h"
+#include "budget.h"
 #include "constraint.h"
+#include "cowvector.h"
 #include "exact_bwd.h"
 #include "fence_sync.h"
 #include "fencins.h"
+#include "heartbeat.h"
 #include "lexer.h"
 #include "machine.h"
+#include "machine_image.h"
 #include "min_coverage.h"
+#include "nml_mask.h"
 #include "pb_cegar.h"
 #include "pb_constraint.h"
 #include "tso_fencins.h"
 #include "pso_fencins.h"
+#include "verdict_cache.h"
+#include "witness_library.h"
 #include <cerrno>
 #include "pb_container2.h"
 #include "predicates.h"
@@ -46,14 +54,21 @@
 #include "pdual_channel_container.h"
 #include "pdual_tso_bwd.h"
 #include "shellcmd.h"
+#include "smallvector.h"
+#include "stats.h"
 #include "sync_set_printer.h"
+#include "syntax_string.h"
 #include "test.h"
+#include "test_concurrency.h"
 #include "test_vips_fencins.h"
 #include "timer.h"
+#include "transition_code.h"
+#include "tso_bit_reachability.h"
 #include "tso_fence_sync.h"
 #include "tso_fencins.h"
 #include "tso_lock_sync.h"
 #include "tso_simple_fencer.h"
+#include "valuation_batch.h"
 #include "vips_bit_constraint.h"
 #include "vips_bit_reachability.h"
 #include "vips_simple_fencer.h"
@@ -61,8 +76,10 @@
 #include "vips_syncrd_sync.h"
 #include "zstar.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <config.h>
+#include <csignal>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
@@ -102,33 +119,72 @@ template<typename ITER> void inform_ignore(ITER begin, ITER end,
 }
 
 /* Read and return a machine from input_stream.
+ *
+ * If flags["image"] is present, then the machine is instead loaded
+ * from the compiled machine image flags["image"].argument, and
+ * input_stream is ignored. Transformations that are recorded as
+ * already applied in the image are not applied again.
+ *
+ * If flags["slice"], then slice the machine (see Machine::slice)
+ * before returning it.
  *
  * If flags["rff"], then convert the machine to register free form
  * before returning it.
  *
  * If flags["a"].argument is "hsb", additionaly convert locks to
  * fences before returning.
+ * Images where locks have been converted to fences are rejected
+ * (by throwing a MachineImage::Error*) for all other abstractions.
+ *
+ * If img_flags is non-null, then *img_flags is assigned the
+ * MachineImage::flag_t flags describing the transformations that
+ * have been applied to the returned machine.
  */
-Machine *get_machine(const std::map<std::string,Flag> flags, std::istream &input_stream){
-  PPLexer lex(input_stream);
-  std::unique_ptr<Machine> machine(new Machine(Parser::p_test(lex)));
+Machine *get_machine(const std::map<std::string,Flag> flags, std::istream &input_stream,
+                     uint32_t *img_flags = 0){
+  std::unique_ptr<Machine> machine;
+  uint32_t applied = 0;
+  if(flags.count("image")){
+    machine = std::unique_ptr<Machine>(MachineImage::load(flags.at("image").argument,&applied));
+  }else{
+    PPLexer lex(input_stream);
+    machine = std::unique_ptr<Machine>(new Machine(Parser::p_test(lex)));
+  }
 
   std::set<std::string> abstractions_requiring_fences{"hsb"};
   std::set<std::string> finite_bounds{"sb", "hsb", "dual", "pdual"};
   int reg_count = 0;
   for (const auto &pregs : machine->regs) reg_count += pregs.size();
 
+  if(flags.count("slice") && !(applied & MachineImage::SLICED)){
+    machine = std::unique_ptr<Machine>(machine->slice());
+    applied |= MachineImage::SLICED;
+  }
   if(flags.count("rff")){
-    machine = std::unique_ptr<Machine>(machine->remove_registers());
-    machine = std::unique_ptr<Machine>(machine->remove_superfluous_nops());
-  } else if (flags.count("a") && finite_bounds.count(flags.at("a").argument) && reg_count > 0) {
+    if(!(applied & MachineImage::REGISTER_FREE)){
+      machine = std::unique_ptr<Machine>(machine->remove_registers());
+      machine = std::unique_ptr<Machine>(machine->remove_superfluous_nops());
+      applied |= MachineImage::REGISTER_FREE;
+    }
+  } else if (flags.count("a") && finite_bounds.count(flags.at("a").argument) && reg_count > 0 &&
+             !(applied & MachineImage::REGISTER_FREE)) {
     Log::msg << "Warning: You are using an abstraction for finite data bounds without register "
              << "free form (--rff). Performance is commonly much better with register free "
              << "form." << std::endl;
   }
-  if(flags.count("a") && abstractions_requiring_fences.count(flags.at("a").argument)){
+  if(flags.count("a") && !abstractions_requiring_fences.count(flags.at("a").argument) &&
+     (applied & MachineImage::LOCKS_TO_FENCES)){
+    /* The locked blocks of the machine have been replaced by fences,
+     * so it is not the same program for this abstraction. */
+    throw new MachineImage::Error("The image has locks converted to fences, which is only "
+                                  "valid for abstraction hsb, not '"+flags.at("a").argument+"'.");
+  }
+  if(flags.count("a") && abstractions_requiring_fences.count(flags.at("a").argument) &&
+     !(applied & MachineImage::LOCKS_TO_FENCES)){
     machine = std::unique_ptr<Machine>(machine->convert_locks_to_fences());
+    applied |= MachineImage::LOCKS_TO_FENCES;
   }
+  if(img_flags) *img_flags = applied;
   return machine.release();
 };
 
@@ -148,10 +204,40 @@ void print_fence_sets(const Machine &machine, const std::list<FenceSet> &fence_s
   }
 };
 
+/* Parse the integer argument of flags[flag] into *i. Returns true if
+ * the flag is not given, or has an integer argument >= lb. Otherwise
+ * prints a warning and returns false. */
+bool get_int_flag(const std::map<std::string,Flag> &flags, std::string flag, int lb, int *i){
+  if(flags.count(flag) == 0) return true;
+  std::stringstream ss(flags.at(flag).argument);
+  if(!(ss >> *i) || !ss.eof() || *i < lb){
+    Log::warning << "Invalid value '" << flags.at(flag).argument << "' given for "
+                 << flags.at(flag).given_name << ".\n";
+    return false;
+  }
+  return true;
+}
+
+/* If failure_reason is non-empty, reports that fence insertion was
+ * stopped by a failed reachability analysis after finding found
+ * synchronization sets. Returns true iff the found sets should be
+ * printed. */
+bool report_fencins_failure(const std::string &failure_reason, std::size_t found){
+  if(failure_reason.empty()) return true;
+  Log::result << "Fence insertion stopped early: " << failure_reason << ".\n";
+  if(found == 0){
+    Log::result << "No synchronization set was found before that.\n";
+    return false;
+  }
+  Log::result << "The synchronization sets below were found before that, and need not be all solutions.\n";
+  return true;
+}
+
 int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
   std::set<std::string> used_flags =
-    {"a","k","cegar","max-refinements","max-solutions","rff","fmin","fence-cost",
-     "dismiss-fence","fence-full-branch-only"};
+    {"a","k","cegar","max-refinements","max-solutions","rff","slice","fmin","fence-cost",
+     "dismiss-fence","fence-full-branch-only","prune-candidates","verdict-cache","replay-witnesses","j",
+     "cegar-resume"};
   inform_ignore(used_flags.begin(),used_flags.end(),flags);
   std::unique_ptr<Machine> machine(get_machine(flags,input_stream));
   int max_refinements = -1;
@@ -171,6 +257,44 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
     }
   }
 
+  Fencins::prune_candidates = flags.count("prune-candidates");
+
+  /* Verdicts depend on the analysis and its parameters. Flags such as
+   * --rff are reflected in the machine itself. */
+  std::stringstream analysis;
+  analysis << "a=" << flags.find("a")->second.argument
+           << " k=" << (flags.count("k") ? flags.find("k")->second.argument : "1")
+           << " cegar=" << flags.count("cegar")
+           << " max-refinements=" << max_refinements;
+  VerdictCache verdict_cache(analysis.str());
+  if(flags.count("verdict-cache")){
+    verdict_cache.load(flags.find("verdict-cache")->second.argument);
+    Log::msg << "Loaded " << verdict_cache.size() << " verdicts from verdict cache.\n";
+  }
+  WitnessLibrary witness_library;
+  /* The global pointers below refer to the locals above. Reset them
+   * however this function is left. */
+  struct GlobalsReset{
+    ~GlobalsReset(){
+      Fencins::verdict_cache = 0;
+      TsoFencins::verdict_cache = 0;
+      Fencins::witness_library = 0;
+    };
+  } globals_reset;
+  Fencins::verdict_cache = &verdict_cache;
+  TsoFencins::verdict_cache = &verdict_cache;
+
+  /* Witnesses are replayed under TSO */
+  if(flags.count("replay-witnesses")){
+    const std::string &a = flags.find("a")->second.argument;
+    if(a == "pb" || a == "sb"){
+      Fencins::witness_library = &witness_library;
+    }else{
+      Log::warning << "Warning: Witness replay is not supported for abstraction '" << a
+                   << "'. Ignoring flag --replay-witnesses.\n";
+    }
+  }
+
   int retval;
 
   Timer fencins_timer;
@@ -191,6 +315,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
     Reachability *reach = 0;
     TsoFencins::reach_arg_init_t *arg_init = 0;
     if(flags.count("cegar")){
+      if(!get_int_flag(flags,"j",1,&PbCegar::thread_count)){
+        return 1;
+      }
       preds.clear();
       if(machine->predicates.size()){
         Log::msg << "Starting CEGAR from predicates given in .rmm file.\n";
@@ -202,8 +329,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
           preds.push_back(new Predicates::Predicate<TsoVar>(machine->predicates[i].convert(cv)));
         }
       }
+      bool resume = flags.count("cegar-resume");
       reach = new PbCegar();
-      arg_init = new TsoFencins::reach_arg_init_t([&preds,k,max_refinements](const Machine &m,const Reachability::Result *prev_res)->Reachability::Arg*{
+      arg_init = new TsoFencins::reach_arg_init_t([&preds,k,max_refinements,resume](const Machine &m,const Reachability::Result *prev_res)->Reachability::Arg*{
           if(prev_res){
             const PbCegar::Result *pres = static_cast<const PbCegar::Result*>(prev_res);
             const ExactBwd::Result *eres = static_cast<const ExactBwd::Result*>(pres->last_result);
@@ -226,8 +354,13 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
             preds_copy.push_back(new Predicates::Predicate<TsoVar>(*preds[i]));
           }
           PbConstraint::Common *common = new PbConstraint::Common(k,m,preds_copy,true);
-          return new PbCegar::Arg(m,new ExactBwd(),new ExactBwd::Arg(m,common,new PbContainer2(m)),
-                                  max_refinements,ExactBwd::pb_init_arg);
+          ExactBwd::Arg *earg = new ExactBwd::Arg(m,common,new PbContainer2(m));
+          if(!resume){
+            return new PbCegar::Arg(m,new ExactBwd(),earg,max_refinements,ExactBwd::pb_init_arg);
+          }
+          earg->incremental = true;
+          return new PbCegar::Arg(m,new ExactBwd(),earg,max_refinements,
+                                  ExactBwd::pb_init_arg,ExactBwd::pb_resume_arg);
         });
     }else{
       reach = new ExactBwd();
@@ -252,7 +385,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
       }
       std::list<TsoFencins::FenceSet> fence_sets =
         TsoFencins::fencins(*machine,*reach,*arg_init,max_solutions == 1);
-      print_fence_sets(*machine,fence_sets);
+      if(report_fencins_failure(TsoFencins::failure_reason,fence_sets.size())){
+        print_fence_sets(*machine,fence_sets);
+      }
       retval = 0;
     }else if(fmin == "subset" || fmin == "cost"){
       Fencins::min_aspect_t min_aspect;
@@ -265,7 +400,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
       }
       TsoSimpleFencer fencer(*machine,TsoSimpleFencer::LOCKED);
       auto sync_sets = Fencins::fencins(*machine,*reach,*arg_init,fencer,min_aspect,max_solutions);
-      SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+      if(report_fencins_failure(Fencins::failure_reason,sync_sets.size())){
+        SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+      }
       for(auto ss : sync_sets){
         for(auto s : ss){
           delete s;
@@ -300,7 +437,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
       }
       std::list<TsoFencins::FenceSet> fence_sets =
         TsoFencins::fencins(*machine,reach,arg_init,max_solutions == 1);
-      print_fence_sets(*machine,fence_sets);
+      if(report_fencins_failure(TsoFencins::failure_reason,fence_sets.size())){
+        print_fence_sets(*machine,fence_sets);
+      }
       retval = 0;
     }else if(fmin == "subset" || fmin == "cost"){
       Fencins::min_aspect_t min_aspect;
@@ -313,7 +452,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
       }
       TsoSimpleFencer fencer(*machine,TsoSimpleFencer::LOCKED);
       auto sync_sets = Fencins::fencins(*machine,reach,arg_init,fencer,min_aspect,max_solutions);
-      SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+      if(report_fencins_failure(Fencins::failure_reason,sync_sets.size())){
+        SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+      }
       for(auto ss : sync_sets){
         for(auto s : ss){
           delete s;
@@ -391,7 +532,9 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
     }
     VipsSimpleFencer fencer(*machine,flags.count("fence-full-branch-only"),accept);
     auto sync_sets = Fencins::fencins(*machine,reach,reach_arg_init,fencer,min_aspect,max_solutions,cost);
-    SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+    if(report_fencins_failure(Fencins::failure_reason,sync_sets.size())){
+      SyncSetPrinter::print(sync_sets,*machine,Log::result,Log::json);
+    }
     for(auto ss : sync_sets){
       for(auto s : ss){
         delete s;
@@ -407,12 +550,20 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
       return new ExactBwd::Arg(m,common->get_bad_states(),common,new HsbContainer());
     };
     fence_sets = PsoFencins::fencins(*machine,reach,arg_init,flags.count("only-one"));
-    print_fence_sets(*machine,fence_sets);
+    if(report_fencins_failure(PsoFencins::failure_reason,fence_sets.size())){
+      print_fence_sets(*machine,fence_sets);
+    }
     retval = 0;  }else{
     Log::warning << "Abstraction '" << flags.find("a")->second.argument << "' is not supported.\nSorry.\n";
     return 1;
   }
 
+  Log::msg << "Verdict cache: " << verdict_cache.get_hits() << " hits, "
+           << verdict_cache.get_misses() << " misses.\n";
+  if(flags.count("verdict-cache")){
+    verdict_cache.save(flags.find("verdict-cache")->second.argument);
+  }
+
   {
     fencins_timer.stop();
     std::stringstream ss;
@@ -424,11 +575,16 @@ int fencins(const std::map<std::string,Flag> flags, std::istream &input_stream){
   return retval;
 }
 
-int reachability(const std::map<std::string,Flag> flags, std::istream &input_stream){
-  std::string used_flags[] = {"a","k","cegar","rff"};
-  inform_ignore(used_flags,used_flags+4,flags);
-  std::unique_ptr<Machine> machine(get_machine(flags,input_stream));
-
+/* Set up the reachability analysis requested by flags (-a, -k,
+ * --cegar) for machine. On success, *reach and *rarg are assigned
+ * heap allocated objects, the ownership of which is given to the
+ * caller, and true is returned. On failure a warning is printed and
+ * false is returned.
+ *
+ * machine may be replaced by a transformed machine (e.g. for -a pb).
+ */
+bool setup_reachability(const std::map<std::string,Flag> flags, std::unique_ptr<Machine> &machine,
+                        Reachability **reach_out, Reachability::Arg **rarg_out){
   Reachability *reach = 0;
   Reachability::Arg *rarg = 0;
 
@@ -437,10 +593,19 @@ int reachability(const std::map<std::string,Flag> flags, std::istream &input_str
     machine = std::unique_ptr<Machine>(tmp_machine->add_domain_assumes());
     delete tmp_machine;
     if(flags.count("cegar") > 0){
+      if(!get_int_flag(flags,"j",1,&PbCegar::thread_count)){
+        return false;
+      }
       PbConstraint::Common *common = new PbConstraint::Common(1,*machine,PbConstraint::pred_set(),true);
+      ExactBwd::Arg *earg = new ExactBwd::Arg(*machine,common,new PbContainer2(*machine));
       reach = new PbCegar();
-      rarg = new PbCegar::Arg(*machine,new ExactBwd(),new ExactBwd::Arg(*machine,common,new PbContainer2(*machine)),
-                              -1,ExactBwd::pb_init_arg);
+      if(flags.count("cegar-resume")){
+        earg->incremental = true;
+        rarg = new PbCegar::Arg(*machine,new ExactBwd(),earg,-1,
+                                ExactBwd::pb_init_arg,ExactBwd::pb_resume_arg);
+      }else{
+        rarg = new PbCegar::Arg(*machine,new ExactBwd(),earg,-1,ExactBwd::pb_init_arg);
+      }
     }else{
       PbConstraint::pred_set preds;
       if(machine->predicates.size()){
@@ -463,7 +628,7 @@ int reachability(const std::map<std::string,Flag> flags, std::istream &input_str
         std::stringstream ss(flags.find("k")->second.argument);
         if(!(ss >> k) || !ss.eof() || k < 1){
           std::cerr << "Invalid value '" << flags.find("k")->second.argument << "' given for k.\n";
-          return 1;
+          return false;
         }
       }
       Log::msg  << "Abstraction: pb\n"
@@ -488,6 +653,22 @@ int reachability(const std::map<std::string,Flag> flags, std::istream &input_str
   }else if(flags.find("a")->second.argument == "vips"){
     reach = new VipsBitReachability();
     rarg = new Reachability::Arg(*machine);
+  }else if(flags.find("a")->second.argument == "tso" ||
+           flags.find("a")->second.argument == "pso"){
+    int k = 1;
+    if(flags.count("k")){
+      std::stringstream ss(flags.find("k")->second.argument);
+      if(!(ss >> k) || !ss.eof() || k < 1){
+        std::cerr << "Invalid value '" << flags.find("k")->second.argument << "' given for k.\n";
+        return false;
+      }
+    }
+    TsoBitReachability::model_t model =
+      (flags.find("a")->second.argument == "tso") ? TsoBitReachability::TSO : TsoBitReachability::PSO;
+    Log::msg << "Abstraction: " << flags.find("a")->second.argument << "\n"
+             << "k: " << k << "\n";
+    reach = new TsoBitReachability();
+    rarg = new TsoBitReachability::Arg(*machine,model,k);
   }else if(flags.find("a")->second.argument == "hsb"){
     HsbConstraint::Common *common = new HsbConstraint::Common(*machine);
     reach = new HsbPsoBwd();
@@ -502,6 +683,22 @@ int reachability(const std::map<std::string,Flag> flags, std::istream &input_str
     rarg = new ExactBwd::Arg(*machine,common->get_bad_states(),common,new PDualChannelContainer());
   }else{
     Log::warning << "Abstraction '" << flags.find("a")->second.argument << "' is not supported.\nSorry.\n";
+    return false;
+  }
+
+  *reach_out = reach;
+  *rarg_out = rarg;
+  return true;
+}
+
+int reachability(const std::map<std::string,Flag> flags, std::istream &input_stream){
+  std::string used_flags[] = {"a","k","cegar","cegar-resume","rff","slice","j"};
+  inform_ignore(used_flags,used_flags+7,flags);
+  std::unique_ptr<Machine> machine(get_machine(flags,input_stream));
+
+  Reachability *reach = 0;
+  Reachability::Arg *rarg = 0;
+  if(!setup_reachability(flags,machine,&reach,&rarg)){
     return 1;
   }
 
@@ -527,10 +724,308 @@ int reachability(const std::map<std::string,Flag> flags, std::istream &input_str
   return 0;
 }
 
+/* The flags that describe job to setup_reachability and get_machine. */
+std::map<std::string,Flag> job_flags(const Batch::Job &job){
+  std::map<std::string,Flag> jf;
+  std::stringstream k;
+  k << job.k;
+  jf["a"] = Flag("a","-a",false,job.abstraction);
+  jf["k"] = Flag("k","-k",false,k.str());
+  if(job.rff) jf["rff"] = Flag("rff","--rff",false);
+  if(job.slice) jf["slice"] = Flag("slice","--slice",false);
+  if(job.cegar) jf["cegar"] = Flag("cegar","--cegar",false);
+  if(MachineImage::is_image(job.file)) jf["image"] = Flag("image",job.file,false,job.file);
+  return jf;
+}
+
+/* Run the reachability analysis described by job on a copy of
+ * machine, in a worker process started by Batch::run. On success,
+ * assigns report a JSON object describing the result and returns
+ * true. */
+bool run_job(const Machine &machine, const Batch::Job &job, std::string &report){
+  /* Only the results are reported, by the parent process. */
+  Log::set_primary_stream(0);
+  Log::set_secondary_stream(0);
+  Log::set_tertiary_stream(0);
+  Log::set_json_stream(0);
+  std::unique_ptr<Machine> m(new Machine(machine));
+  Reachability *reach = 0;
+  Reachability::Arg *rarg = 0;
+  if(!setup_reachability(job_flags(job),m,&reach,&rarg)){
+    report = "Invalid job.";
+    return false;
+  }
+  Reachability::Result *result = reach->reachability(rarg);
+  std::stringstream ss;
+  ss << "{\"result\":\"";
+  switch(result->result){
+  case Reachability::REACHABLE: ss << "reachable"; break;
+  case Reachability::UNREACHABLE: ss << "unreachable"; break;
+  case Reachability::FAILURE: ss << "failure"; break;
+  }
+  ss << "\", \"generated_constraints\":" << result->generated_constraints
+     << ", \"stored_constraints\":" << result->stored_constraints
+     << ", \"time\":" << result->timer.get_time();
+  if(result->result == Reachability::FAILURE){
+    ss << ", \"failure_reason\":\"" << Batch::json_escape(result->failure_reason) << "\"";
+  }
+  ss << "}";
+  report = ss.str();
+  delete result;
+  delete reach;
+  delete rarg;
+  return true;
+}
+
+/* Returns the wall clock time t of a job formatted for the batch and
+ * portfolio reports. Formatted separately, so that the stream
+ * manipulators do not affect the log stream. */
+std::string job_time_string(double t){
+  std::stringstream ss;
+  ss << std::setprecision(1) << std::fixed << t << " s";
+  return ss.str();
+}
+
+/* Run the reachability jobs described by the batch manifest inputted
+ * on cin. See batch.h for the manifest format.
+ *
+ * Each machine is parsed (and transformed) once, and then shared by
+ * all jobs using the same file and transformations. The jobs are
+ * executed in forked worker processes, at most -j at a time. The
+ * analysis engines keep global state (e.g. caches and scratch
+ * buffers), so separate processes are used rather than threads. This
+ * also allows the time and memory budgets of the jobs to be strictly
+ * enforced.
+ */
+int batch(const std::map<std::string,Flag> flags, std::istream &input_stream){
+  std::string used_flags[] = {"a","k","cegar","rff","slice","j","job-timeout","job-memory"};
+  inform_ignore(used_flags,used_flags+8,flags);
+
+  Batch::Job defaults;
+  int concurrency = 1;
+  defaults.abstraction = flags.at("a").argument;
+  defaults.rff = flags.count("rff");
+  defaults.slice = flags.count("slice");
+  defaults.cegar = flags.count("cegar");
+  if(!get_int_flag(flags,"k",1,&defaults.k) ||
+     !get_int_flag(flags,"j",1,&concurrency) ||
+     !get_int_flag(flags,"job-timeout",0,&defaults.timeout) ||
+     !get_int_flag(flags,"job-memory",0,&defaults.max_memory)){
+    return 1;
+  }
+
+  std::vector<Batch::Job> jobs = Batch::parse_manifest(input_stream,defaults);
+
+  std::function<std::string(const Batch::Job&)> machine_key =
+    [](const Batch::Job &job){
+    return job.file + (job.rff ? "|rff" : "|") + (job.slice ? "|slice" : "|") + (job.abstraction == "hsb" ? "|hsb" : "|");
+  };
+
+  /* Parse all machines before starting any workers. */
+  std::map<std::string,std::unique_ptr<Machine> > machines;
+  std::map<std::string,std::string> machine_errors;
+  for(const Batch::Job &job : jobs){
+    std::string key = machine_key(job);
+    if(machines.count(key) || machine_errors.count(key)) continue;
+    std::map<std::string,Flag> jf = job_flags(job);
+    std::ifstream fs(job.file);
+    if(jf.count("image") == 0 && !fs.good()){
+      machine_errors[key] = "Unable to open file '" + job.file + "' for reading.";
+      continue;
+    }
+    try{
+      machines[key] = std::unique_ptr<Machine>(get_machine(jf,fs));
+    }catch(Parser::SyntaxError *exc){
+      machine_errors[key] = exc->what();
+      delete exc;
+    }catch(std::exception *exc){
+      machine_errors[key] = exc->what();
+      delete exc;
+    }
+  }
+
+  int done_count = 0;
+  int failed_count = 0;
+  std::function<bool(const Batch::Job&,const Batch::Outcome&)> report_outcome =
+    [&done_count,&failed_count](const Batch::Job &job, const Batch::Outcome &outcome){
+    Log::result << job.file << " (line " << job.line << ", -a " << job.abstraction << "): ";
+    if(outcome.status == Batch::Outcome::DONE){
+      Log::result << Batch::parse_report(outcome.report)["result"];
+      ++done_count;
+    }else{
+      Log::result << Batch::Outcome::status_to_string(outcome.status);
+      if(outcome.report.size()) Log::result << " (" << outcome.report << ")";
+      ++failed_count;
+    }
+    Log::result << ", " << job_time_string(outcome.time) << "\n" << std::flush;
+    Log::json << Batch::to_json(job,outcome) << std::flush;
+    return true;
+  };
+
+  std::vector<Batch::Job> runnable;
+  for(const Batch::Job &job : jobs){
+    if(machine_errors.count(machine_key(job))){
+      Batch::Outcome outcome;
+      outcome.status = Batch::Outcome::ERROR;
+      outcome.report = machine_errors[machine_key(job)];
+      report_outcome(job,outcome);
+    }else{
+      runnable.push_back(job);
+    }
+  }
+
+  Batch::run(runnable,concurrency,
+             [&machines,&machine_key](const Batch::Job &job, std::string &report){
+               return run_job(*machines[machine_key(job)],job,report);
+             },
+             report_outcome);
+
+  Log::result << "Batch summary: " << jobs.size() << " jobs, " << done_count << " completed, "
+              << failed_count << " failed\n";
+  return (failed_count == 0) ? 0 : 1;
+}
+
+/* Run several reachability analyses (the portfolio) concurrently on
+ * the machine inputted on cin, and report the first conclusive
+ * verdict together with the analysis that produced it.
+ *
+ * The machine is parsed, sliced if --slice is given, and converted to
+ * register free form if --rff is given, once before the analyses are started in forked
+ * worker processes (see Batch::run). At most -j analyses run at the
+ * same time (by default all of them). When a conclusive verdict
+ * arrives, the other analyses are cancelled through Budget::cancel.
+ *
+ * Which verdicts are conclusive is decided by Batch::is_conclusive.
+ */
+int portfolio(const std::map<std::string,Flag> flags, std::istream &input_stream){
+  std::string used_flags[] = {"a","k","cegar","rff","slice","j","portfolio"};
+  inform_ignore(used_flags,used_flags+7,flags);
+
+  /* The analyses that may be used in a portfolio. */
+  static const std::set<std::string> portfolio_abstractions =
+    {"sb","dual","tso","hsb","pdual","pso","pb"};
+
+  std::vector<std::string> engines = {"sb","dual","tso"};
+  if(flags.count("portfolio")){
+    engines.clear();
+    std::stringstream ss(flags.at("portfolio").argument);
+    std::string e;
+    while(std::getline(ss,e,',')){
+      if(portfolio_abstractions.count(e) == 0 ||
+         std::find(engines.begin(),engines.end(),e) != engines.end()){
+        Log::warning << "Invalid analysis '" << e << "' given for --portfolio.\n";
+        return 1;
+      }
+      engines.push_back(e);
+    }
+    if(engines.empty()){
+      Log::warning << "No analysis given for --portfolio.\n";
+      return 1;
+    }
+  }
+
+  std::vector<Batch::Job> jobs;
+  int concurrency = engines.size();
+  Batch::Job defaults;
+  defaults.rff = flags.count("rff");
+  defaults.slice = flags.count("slice");
+  defaults.cegar = flags.count("cegar");
+  if(!get_int_flag(flags,"k",1,&defaults.k) ||
+     !get_int_flag(flags,"j",1,&concurrency)){
+    return 1;
+  }
+  for(unsigned i = 0; i < engines.size(); ++i){
+    Batch::Job job = defaults;
+    job.line = i;
+    job.abstraction = engines[i];
+    jobs.push_back(job);
+  }
+
+  std::unique_ptr<Machine> machine(get_machine(flags,input_stream));
+  /* hsb requires locked blocks to be converted into fences. */
+  std::unique_ptr<Machine> fenced_machine;
+  if(std::find(engines.begin(),engines.end(),"hsb") != engines.end()){
+    fenced_machine = std::unique_ptr<Machine>(machine->convert_locks_to_fences());
+  }
+
+  Log::msg << "Running portfolio:";
+  for(const std::string &e : engines) Log::msg << " " << e;
+  Log::msg << "\n" << std::flush;
+
+  const Batch::Job *winner = 0;
+  Batch::Outcome winner_outcome;
+  Batch::run(jobs,concurrency,
+             [&machine,&fenced_machine](const Batch::Job &job, std::string &report){
+               signal(SIGTERM,[](int){ Budget::cancel(); });
+               const Machine &m = (job.abstraction == "hsb") ? *fenced_machine : *machine;
+               return run_job(m,job,report);
+             },
+             [&winner,&winner_outcome](const Batch::Job &job, const Batch::Outcome &outcome){
+               Log::msg << "  " << job.abstraction << ": ";
+               bool conclusive = false;
+               if(outcome.status == Batch::Outcome::DONE){
+                 std::string res = Batch::parse_report(outcome.report)["result"];
+                 Log::msg << res;
+                 conclusive = Batch::is_conclusive(job.abstraction,res);
+               }else{
+                 Log::msg << Batch::Outcome::status_to_string(outcome.status);
+                 if(outcome.status == Batch::Outcome::ERROR && outcome.report.size()){
+                   Log::msg << " (" << outcome.report << ")";
+                 }
+               }
+               Log::msg << ", " << job_time_string(outcome.time) << "\n" << std::flush;
+               if(conclusive && !winner){
+                 winner = &job;
+                 winner_outcome = outcome;
+                 return false;
+               }
+               return true;
+             });
+
+  Reachability::Result result(*machine);
+  if(winner){
+    std::map<std::string,std::string> fields = Batch::parse_report(winner_outcome.report);
+    result.result = (fields["result"] == "reachable") ?
+      Reachability::REACHABLE : Reachability::UNREACHABLE;
+    std::stringstream(fields["generated_constraints"]) >> result.generated_constraints;
+    std::stringstream(fields["stored_constraints"]) >> result.stored_constraints;
+    result.timer.add(winner_outcome.time);
+    Log::result << "Verdict by abstraction: " << winner->abstraction << "\n";
+    if(result.result == Reachability::REACHABLE){
+      Log::msg << "Run with -a " << winner->abstraction << " to obtain a witness trace.\n";
+    }
+  }else{
+    result.result = Reachability::FAILURE;
+    result.failure_reason = "no conclusive verdict";
+  }
+  Log::result << result.to_string() << "\n";
+  return 0;
+}
+
+/* Write a compiled machine image of the machine inputted on cin to
+ * the file given by -o. */
+int compile(const std::map<std::string,Flag> flags, std::istream &input_stream){
+  std::string used_flags[] = {"o","rff","slice","a"};
+  inform_ignore(used_flags,used_flags+4,flags);
+  if(flags.count("o") == 0){
+    Log::warning << "For command compile. Specify an output file using the flag -o.\n";
+    return 1;
+  }
+
+  std::string outputfile = flags.find("o")->second.argument;
+
+  uint32_t img_flags;
+  std::unique_ptr<Machine> m(get_machine(flags,input_stream,&img_flags));
+  MachineImage::write(*m,img_flags,outputfile);
+  Log::result << "Wrote machine image to " << outputfile << std::endl;
+
+  return 0;
+}
+
 /* Produce a pdf showing the automata generated from the code inputted on cin. */
 int dotify(const std::map<std::string,Flag> flags, std::istream &input_stream){
-  std::string used_flags[] = {"o","rff","a"};
-  inform_ignore(used_flags,used_flags+3,flags);
+  std::string used_flags[] = {"o","rff","slice","a"};
+  inform_ignore(used_flags,used_flags+4,flags);
   if(flags.count("o") == 0){
     Log::warning << "For command dotify. Specify an output file.pdf using the flag -o.\n";
     return 1;
@@ -584,6 +1079,15 @@ void print_help(int argc, char *argv[]){
             << "    reach            - Read a rmm specification on stdin. Check reachability.\n"
             << "    fencins          - Read a rmm specification on stdin. Insert fences.\n"
             << "    dotify           - Produce a pdf file representing the compiled automata.\n"
+            << "    compile          - Read a rmm specification on stdin. Write a compiled\n"
+            << "                       machine image to the file given by -o. The image\n"
+            << "                       can be given instead of a rmm file to reach and fencins.\n"
+            << "    batch            - Read a batch manifest on stdin. Run the reachability\n"
+            << "                       analysis described on each line of the manifest.\n"
+            << "                       Each line has the form:\n"
+            << "                         <file> [-a <abs>] [-k <int>] [--rff] [--slice]\n"
+            << "                                [--cegar] [--job-timeout <int>]\n"
+            << "                                [--job-memory <int>]\n"
             << std::endl
             << "  Options:\n"
             << "    -o <filename> / --output <filename>\n"
@@ -591,9 +1095,12 @@ void print_help(int argc, char *argv[]){
             << "    -a <abstraction> / --abstraction <abstraction>\n"
             << "        Use abstraction <abstraction>.\n"
             << "    -k <int>\n"
-            << "        Use k as buffer bound. (Used only for abstraction pb.)\n"
+            << "        Use k as buffer bound. (Used only for abstractions pb, tso and pso.)\n"
             << "    --cegar\n"
             << "        Use CEGAR refinement in reachability analysis.\n"
+            << "    --cegar-resume\n"
+            << "        With --cegar, resume the analysis instead of restarting it\n"
+            << "        when a refinement only increases k.\n"
             << "    --dismiss-fence <regex>\n"
             << "        For fence insertion, ignore all synchronizations that\n"
             << "        match <regex>. Uses ECMAScript regex syntax.\n"
@@ -610,6 +1117,27 @@ void print_help(int argc, char *argv[]){
             << "    --max-solutions <int>\n"
             << "        During fence insertion, stop searching after finding <int>\n"
             << "        sufficient, minimal fence sets.\n"
+            << "    --verdict-cache <filename>\n"
+            << "        During fence insertion, reuse the reachability verdicts stored\n"
+            << "        in <filename>, and store new verdicts there.\n"
+            << "    --prune-candidates\n"
+            << "        During fence insertion, skip candidate synchronization sets\n"
+            << "        which include a set shown sufficient, without analysing them.\n"
+            << "    --replay-witnesses\n"
+            << "        During fence insertion, before analysing a candidate, try to\n"
+            << "        refute it by replaying witnesses of earlier candidates.\n"
+            << "        (Used only with -a pb and -a sb.)\n"
+            << "    -j <int> / --jobs <int>\n"
+            << "        Run at most <int> jobs in parallel. (Used only in batch and\n"
+            << "        by abstraction portfolio.) With -a pb --cegar, use <int>\n"
+            << "        threads for the solver queries of refinement.\n"
+            << "    --portfolio <abs>,<abs>,...\n"
+            << "        The abstractions raced by abstraction portfolio, in order of\n"
+            << "        priority. Default: sb,dual,tso.\n"
+            << "    --job-timeout <int>\n"
+            << "        Abort each job after <int> seconds. (Used only in batch.)\n"
+            << "    --job-memory <int>\n"
+            << "        Limit the memory of each job to <int> MiB. (Used only in batch.)\n"
             << "    --fencins-minimality <M> / --fmin <M>\n"
             << "        Use minimality criterion <M> for fence insertion.\n"
             << "        Possible values are cheap, cost, subset.\n"
@@ -621,6 +1149,20 @@ void print_help(int argc, char *argv[]){
             << "        Print output very very verbosely.\n"
             << "    --rff\n"
             << "        Convert machine to Register Free Form before using it.\n"
+            << "    --slice\n"
+            << "        Remove instructions, variables and registers that cannot influence\n"
+            << "        whether a forbidden state is reached before using the machine.\n"
+            << "    --max-time <secs>\n"
+            << "        Give up a reachability analysis after <secs> seconds.\n"
+            << "    --max-memory <MiB>\n"
+            << "        Give up a reachability analysis when the resident memory exceeds <MiB> MiB.\n"
+            << "    --max-constraints <int>\n"
+            << "        Give up a reachability analysis after generating <int> constraints.\n"
+            << "    --heartbeat <secs>\n"
+            << "        During reachability analysis, report progress every <secs> seconds.\n"
+            << "    --stats\n"
+            << "        Profile the analysis. Print the number of calls and the time\n"
+            << "        spent in each of its main operations.\n"
             << "    --version / -V\n"
             << "        Print version and quit.\n"
             << std::endl
@@ -649,6 +1191,19 @@ void print_help(int argc, char *argv[]){
             << "    vips\n"
             << "      VIPS-M. Explicit state forward analysis.\n"
             << "      Sound and complete for finite data domains.\n"
+            << "    tso\n"
+            << "      TSO with at most k writes in the buffer of each process.\n"
+            << "      Explicit state forward analysis. Requires finite data domains.\n"
+            << "      Every witness is a TSO witness. Never proves unreachability:\n"
+            << "      states are hash compacted, so when no witness is found the\n"
+            << "      result is a failure (probably unreachable, or no witness\n"
+            << "      within buffer bound k).\n"
+            << "    pso\n"
+            << "      As tso, but PSO with at most k writes per process and variable.\n"
+            << "    portfolio\n"
+            << "      Run several abstractions in parallel (see --portfolio and -j).\n"
+            << "      Reports the first conclusive verdict for TSO, and which\n"
+            << "      abstraction produced it.\n"
             << std::endl
             << "  Fencins minimality criteria:\n"
             << "    subset\n"
@@ -664,13 +1219,15 @@ void print_help(int argc, char *argv[]){
 }
 
 int main(int argc, char *argv[]){
-  enum command { UNDEF, DOTIFY, TEST, REACHABILITY, FENCINS };
+  enum command { UNDEF, DOTIFY, TEST, REACHABILITY, FENCINS, COMPILE, BATCH };
   command cmd = UNDEF;
   std::map<std::string,Flag> flags;
   std::set<int> needs_input_stream; // Set of all commands that require an input stream
   needs_input_stream.insert(REACHABILITY);
   needs_input_stream.insert(DOTIFY);
   needs_input_stream.insert(FENCINS);
+  needs_input_stream.insert(COMPILE);
+  needs_input_stream.insert(BATCH);
   std::istream *input_stream = &std::cin;
   if(argc > 1){
     for(int i = 1; i < argc; i++){
@@ -698,6 +1255,22 @@ int main(int argc, char *argv[]){
           print_help(argc, argv);
           return 1;
         }
+      }else if(argv[i] == std::string("compile")){
+        if(cmd == UNDEF){
+          cmd = COMPILE;
+        }else{
+          Log::warning << "Can't specify more than one command.\n";
+          print_help(argc, argv);
+          return 1;
+        }
+      }else if(argv[i] == std::string("batch")){
+        if(cmd == UNDEF){
+          cmd = BATCH;
+        }else{
+          Log::warning << "Can't specify more than one command.\n";
+          print_help(argc, argv);
+          return 1;
+        }
       }else if(argv[i] == std::string("test")){
         if(cmd == UNDEF){
           cmd = TEST;
@@ -708,6 +1281,8 @@ int main(int argc, char *argv[]){
         }
       }else if(argv[i] == std::string("--cegar")){
         flags["cegar"] = Flag("cegar",argv[i],true);
+      }else if(argv[i] == std::string("--cegar-resume")){
+        flags["cegar-resume"] = Flag("cegar-resume",argv[i],true);
       }else if(argv[i] == std::string("--dismiss-fence")){
         if(flags.count("dismiss-fence")){
           Log::warning << "Flag --dismiss-fence specified twice.\n";
@@ -723,6 +1298,10 @@ int main(int argc, char *argv[]){
         }
       }else if(argv[i] == std::string("--fence-full-branch-only") || argv[i] == std::string("--ffbo")){
         flags["fence-full-branch-only"] = Flag("fence-full-branch-only",argv[i],true);
+      }else if(argv[i] == std::string("--prune-candidates")){
+        flags["prune-candidates"] = Flag("prune-candidates",argv[i],true);
+      }else if(argv[i] == std::string("--replay-witnesses")){
+        flags["replay-witnesses"] = Flag("replay-witnesses",argv[i],true);
       }else if(argv[i] == std::string("--max-solutions")){
         if(flags.count("max-solutions")){
           Log::warning << "Flag --max-solutions specified twice.\n";
@@ -736,6 +1315,19 @@ int main(int argc, char *argv[]){
           print_help(argc,argv);
           return 1;
         }
+      }else if(argv[i] == std::string("--verdict-cache")){
+        if(flags.count("verdict-cache")){
+          Log::warning << "Flag --verdict-cache specified twice.\n";
+          print_help(argc,argv);
+          return 1;
+        }else if(i < argc-1){
+          flags["verdict-cache"] = Flag("verdict-cache",argv[i],true,argv[i+1]);
+          i++; // Do not account for the next argv twice.
+        }else{
+          Log::warning << "--verdict-cache must have an argument.\n";
+          print_help(argc,argv);
+          return 1;
+        }
       }else if(argv[i] == std::string("--fence-cost")){
         if(flags.count("fence-cost")){
           Log::warning << "Flag --fence-cost specified twice.\n";
@@ -773,6 +1365,51 @@ int main(int argc, char *argv[]){
         }
       }else if(argv[i] == std::string("--rff")){
         flags["rff"] = Flag("rff",argv[i],true);
+      }else if(argv[i] == std::string("--slice")){
+        flags["slice"] = Flag("slice",argv[i],true);
+      }else if(argv[i] == std::string("--stats")){
+        flags["stats"] = Flag("stats",argv[i],true);
+      }else if(argv[i] == std::string("--max-time") || argv[i] == std::string("--max-memory") ||
+               argv[i] == std::string("--max-constraints")){
+        std::string name = std::string(argv[i]+2);
+        if(flags.count(name)){
+          Log::warning << "Flag " << argv[i] << " specified twice.\n";
+          print_help(argc,argv);
+          return 1;
+        }else if(i < argc-1){
+          flags[name] = Flag(name,argv[i],true,argv[i+1]);
+          i++; // Do not account for the next argv twice.
+        }else{
+          Log::warning << argv[i] << " must have an argument.\n";
+          print_help(argc,argv);
+          return 1;
+        }
+      }else if(argv[i] == std::string("--heartbeat")){
+        if(flags.count("heartbeat")){
+          Log::warning << "Flag " << argv[i] << " specified twice.\n";
+          print_help(argc,argv);
+          return 1;
+        }else if(i < argc-1){
+          flags["heartbeat"] = Flag("heartbeat",argv[i],true,argv[i+1]);
+          i++; // Do not account for the next argv twice.
+        }else{
+          Log::warning << argv[i] << " must have an argument.\n";
+          print_help(argc,argv);
+          return 1;
+        }
+      }else if(argv[i] == std::string("--portfolio")){
+        if(flags.count("portfolio")){
+          Log::warning << "Flag " << argv[i] << " specified twice.\n";
+          print_help(argc,argv);
+          return 1;
+        }else if(i < argc-1){
+          flags["portfolio"] = Flag("portfolio",argv[i],true,argv[i+1]);
+          i++; // Do not account for the next argv twice.
+        }else{
+          Log::warning << argv[i] << " must have an argument.\n";
+          print_help(argc,argv);
+          return 1;
+        }
       }else if(argv[i] == std::string("--max-refinements")){
         if(flags.count("max-refinements")){
           Log::warning << "Flag " << argv[i] << " specified twice.\n";
@@ -799,6 +1436,21 @@ int main(int argc, char *argv[]){
           print_help(argc,argv);
           return 1;
         }
+      }else if(argv[i] == std::string("-j") || argv[i] == std::string("--jobs") ||
+               argv[i] == std::string("--job-timeout") || argv[i] == std::string("--job-memory")){
+        std::string name = (argv[i][1] == 'j') ? "j" : std::string(argv[i]+2);
+        if(flags.count(name)){
+          Log::warning << "Flag " << argv[i] << " specified twice.\n";
+          print_help(argc,argv);
+          return 1;
+        }else if(i < argc-1){
+          flags[name] = Flag(name,argv[i],true,argv[i+1]);
+          i++; // Do not account for the next argv twice.
+        }else{
+          Log::warning << argv[i] << " must have an argument.\n";
+          print_help(argc,argv);
+          return 1;
+        }
       }else if(argv[i] == std::string("--fencins-minimality") || argv[i] == std::string("--fmin")){
         if(flags.count("fmin")){
           Log::warning << "Flag " << argv[i] << " specified twice.\n";
@@ -823,7 +1475,10 @@ int main(int argc, char *argv[]){
              argv[i+1] == std::string("hsb") ||
              argv[i+1] == std::string("dual") ||
              argv[i+1] == std::string("pdual") ||
-             argv[i+1] == std::string("vips")){
+             argv[i+1] == std::string("vips") ||
+             argv[i+1] == std::string("tso") ||
+             argv[i+1] == std::string("pso") ||
+             argv[i+1] == std::string("portfolio")){
             flags["a"] = Flag("a",argv[i],true,argv[i+1]);
             i++;
           }else{
@@ -841,6 +1496,8 @@ int main(int argc, char *argv[]){
       }else if(argv[i] == std::string("--json")){
         // Activate printing of json directives
         Log::set_json_stream(&std::cout);
+      }else if(i == argc-1 && needs_input_stream.count(cmd) && MachineImage::is_image(argv[i])){
+        flags["image"] = Flag("image",argv[i],false,argv[i]);
       }else if(i == argc-1 && needs_input_stream.count(cmd)){
         errno = 0;
         input_stream = new std::ifstream(argv[i]);
@@ -882,11 +1539,56 @@ int main(int argc, char *argv[]){
   flags.erase("very-verbose");
   flags.erase("very-very-verbose");
 
+  if(flags.count("stats")){
+    Stats::set_enabled(true);
+  }
+  flags.erase("stats");
+  if(flags.count("heartbeat")){
+    std::stringstream ss(flags["heartbeat"].argument);
+    double secs;
+    if(!(ss >> secs) || !ss.eof() || secs <= 0){
+      Log::warning << "Invalid value '" << flags["heartbeat"].argument << "' given for --heartbeat.\n";
+      return 1;
+    }
+    Heartbeat::set_interval(secs);
+    /* Heartbeats are printed as messages. */
+    if(Log::get_primary_loglevel() < Log::MSG){
+      Log::set_primary_loglevel(Log::MSG);
+    }
+  }
+  flags.erase("heartbeat");
+  {
+    Budget::limits_t limits;
+    std::string budget_flags[] = {"max-time","max-memory","max-constraints"};
+    for(const std::string &f : budget_flags){
+      if(flags.count(f) == 0) continue;
+      std::stringstream ss(flags[f].argument);
+      double v;
+      if(!(ss >> v) || !ss.eof() || v <= 0){
+        Log::warning << "Invalid value '" << flags[f].argument << "' given for " << flags[f].given_name << ".\n";
+        return 1;
+      }
+      if(f == "max-time"){
+        limits.max_time = v;
+      }else if(f == "max-memory"){
+        limits.max_memory = long(v * 1024 * 1024);
+      }else{
+        limits.max_constraints = long(v);
+      }
+      flags.erase(f);
+    }
+    Budget::set_limits(limits);
+  }
+
   int retval = 1;
   try{
     switch(cmd){
     case REACHABILITY:
-      retval = reachability(flags,*input_stream);
+      if(flags.at("a").argument == "portfolio"){
+        retval = portfolio(flags,*input_stream);
+      }else{
+        retval = reachability(flags,*input_stream);
+      }
       break;
     case FENCINS:
       retval = fencins(flags,*input_stream);
@@ -894,18 +1596,43 @@ int main(int argc, char *argv[]){
     case DOTIFY:
       retval = dotify(flags,*input_stream);
       break;
+    case COMPILE:
+      retval = compile(flags,*input_stream);
+      break;
+    case BATCH:
+      retval = batch(flags,*input_stream);
+      break;
     case TEST:
       Test::add_test("Automaton",Automaton::test);
+      Test::add_test("Batch",Batch::test);
+      Test::add_test("Budget",Budget::test);
+      Test::add_test("CegarReachability",CegarReachability::test);
+      Test::add_test("Concurrency",TestConcurrency::test);
+      Test::add_test("cowvector",cowvector<int>::test);
       Test::add_test("Fencins",Fencins::test);
       Test::add_test("FenceSync",FenceSync::test);
+      Test::add_test("Heartbeat",Heartbeat::test);
       Test::add_test("Machine",Machine::test);
+      Test::add_test("MachineImage",MachineImage::test);
       Test::add_test("MinCoverage",MinCoverage::test);
+      Test::add_test("NMLMask",NMLMask::test);
+      Test::add_test("PbCegar",PbCegar::test);
+      Test::add_test("PbConstraint",PbConstraint::test);
+      Test::add_test("PbContainer2",PbContainer2::test);
       Test::add_test("SbTsoBwd",SbTsoBwd::test);
+      Test::add_test("SmallVector",SmallVector<int,2>::test);
+      Test::add_test("SyntaxString",SyntaxString<int>::test);
+      Test::add_test("Stats",Stats::test);
       Test::add_test("Test",Test::test_testing);
       Test::add_test("TestVipsFencins",TestVipsFencins::test);
+      Test::add_test("TransitionCode",TransitionCode::test);
+      Test::add_test("TsoBitReachability",TsoBitReachability::test);
       Test::add_test("TsoFenceSync",TsoFenceSync::test);
       Test::add_test("TsoLockSync",TsoLockSync::test);
       Test::add_test("TsoSimpleFencer",TsoSimpleFencer::test);
+      Test::add_test("ValuationBatch",ValuationBatch::test);
+      Test::add_test("VerdictCache",VerdictCache::test);
+      Test::add_test("WitnessLibrary",WitnessLibrary::test);
       Test::add_test("VIPS-M Bit",VipsBitConstraint::test);
       Test::add_test("VIPS-M Bit Reachability",VipsBitReachability::test);
       Test::add_test("VipsFenceSync",VipsFenceSync::test);
@@ -932,6 +1659,9 @@ int main(int argc, char *argv[]){
     retval = 1;
     delete exc;
   }
+  if(Stats::enabled){
+    Stats::print();
+  }
   if(input_stream != &std::cin){
     delete input_stream;
   }
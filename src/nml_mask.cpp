@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "lang.h"
+#include "nml_mask.h"
+#include "test.h"
+#include "vecset.h"
+
+void NMLMask::test(){
+  /* Indices as given by ChannelConstraint::Common::index for a
+   * machine with gvar_count global variables, and max_lvar_count
+   * local variables in each process. */
+  auto indexer = [](int gvar_count, int max_lvar_count){
+    return [gvar_count,max_lvar_count](const Lang::NML &nml){
+      if(nml.is_global()){
+        return nml.get_id();
+      }else{
+        return gvar_count + nml.get_owner()*max_lvar_count + nml.get_id();
+      }
+    };
+  };
+
+  /* Test 1-4: Two global variables x, y and the local variables z
+   * and w of each of three processes. */
+  {
+    auto index = indexer(2,2);
+    Lang::NML x = Lang::NML::global(0);
+    Lang::NML y = Lang::NML::global(1);
+    Lang::NML z0 = Lang::NML::local(0,0), w0 = Lang::NML::local(1,0);
+    Lang::NML z1 = Lang::NML::local(0,1), w1 = Lang::NML::local(1,1);
+    Lang::NML z2 = Lang::NML::local(0,2);
+    std::vector<Lang::NML> all = {x,y,z0,w0,z1,w1,z2};
+
+    /* Every location has a bit of its own. */
+    bool distinct = true;
+    for(unsigned i = 0; i < all.size(); ++i){
+      for(unsigned j = 0; j < all.size(); ++j){
+        if((i == j) != (bit(index(all[i])) == bit(index(all[j])))){
+          distinct = false;
+        }
+      }
+    }
+    Test::inner_test("NMLMask #1 (distinct bits)",distinct);
+
+    /* Set and test */
+    VecSet<Lang::NML> s0; s0.insert(x); s0.insert(z0);
+    VecSet<Lang::NML> s1; s1.insert(z1); s1.insert(w1);
+    mask_t m0 = of(s0.begin(),s0.end(),index);
+    mask_t m1 = of(s1.begin(),s1.end(),index);
+    Test::inner_test("NMLMask #2 (set and test)",
+                     may_contain(m0,bit(index(x))) && may_contain(m0,bit(index(z0))) &&
+                     !may_contain(m0,bit(index(z1))) && !may_contain(m0,bit(index(y))) &&
+                     may_contain(m1,bit(index(z1))) && may_contain(m1,bit(index(w1))) &&
+                     !may_contain(m1,bit(index(z0))) && !may_contain(m1,bit(index(w0))) &&
+                     !may_contain(m1,bit(index(z2))));
+
+    /* Union: the mask of the union is the union of the masks. */
+    VecSet<Lang::NML> s01 = s0; s01.insert(s1);
+    mask_t m01 = of(s01.begin(),s01.end(),index);
+    bool union_contains = true;
+    for(const Lang::NML &nml : all){
+      if(may_contain(m01,bit(index(nml))) != (s01.count(nml) > 0)){
+        union_contains = false;
+      }
+    }
+    Test::inner_test("NMLMask #3 (union)",
+                     m01 == (m0 | m1) && union_contains);
+
+    /* Subsets */
+    VecSet<Lang::NML> s2; s2.insert(z0); s2.insert(z1);
+    mask_t m2 = of(s2.begin(),s2.end(),index);
+    Test::inner_test("NMLMask #4 (subset)",
+                     may_be_subset(m0,m01) && may_be_subset(m1,m01) &&
+                     may_be_subset(m2,m01) && !may_be_subset(m2,m0) &&
+                     !may_be_subset(m2,m1) && !may_be_subset(m01,m0) &&
+                     may_be_subset(0,m0));
+  }
+
+  /* Test 5-6: More locations than bits. The local variables of
+   * process 2 share bits with the global variables, but masks still
+   * never exclude a member. */
+  {
+    auto index = indexer(width/2,width/4);
+    Lang::NML x = Lang::NML::global(0);
+    Lang::NML y = Lang::NML::global(1);
+    Lang::NML z0 = Lang::NML::local(0,0);
+    Lang::NML z2 = Lang::NML::local(0,2), w2 = Lang::NML::local(1,2);
+    Test::inner_test("NMLMask #5 (shared bits)",
+                     bit(index(z2)) == bit(index(x)) &&
+                     bit(index(w2)) == bit(index(y)) &&
+                     bit(index(z0)) != bit(index(x)) &&
+                     bit(index(z0)) != bit(index(z2)));
+
+    VecSet<Lang::NML> s0 = VecSet<Lang::NML>::singleton(x);
+    VecSet<Lang::NML> s1; s1.insert(z0); s1.insert(z2);
+    mask_t m0 = of(s0.begin(),s0.end(),index);
+    mask_t m1 = of(s1.begin(),s1.end(),index);
+    Test::inner_test("NMLMask #6 (may contain, may be subset)",
+                     may_contain(m1,bit(index(z0))) && may_contain(m1,bit(index(z2))) &&
+                     may_contain(m1,bit(index(x))) && s1.count(x) == 0 &&
+                     !may_contain(m1,bit(index(w2))) &&
+                     may_be_subset(m0,m1) && !may_be_subset(m1,m0));
+  }
+};
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NML_MASK_H__
+#define __NML_MASK_H__
+
+#include <cstdint>
+
+/* An NMLMask is a fixed-width bitmask representing a set of memory
+ * locations (Lang::NML) of a machine.
+ *
+ * Each memory location is given the bit of its index in a memory
+ * location store (see e.g. ChannelConstraint::Common::index). If the
+ * machine has at most width memory locations, then every memory
+ * location has a bit of its own, and the mask represents the set
+ * exactly. Otherwise memory locations whose indices are equal modulo
+ * width share a bit.
+ *
+ * Masks are kept alongside sorted sets of memory locations, and are
+ * used to decide most membership, equality and subset queries with a
+ * single bitwise operation, before falling back on comparing the
+ * sets themselves.
+ */
+class NMLMask{
+public:
+  typedef std::uint64_t mask_t;
+  static const int width = 64;
+  /* The bit of the memory location with index index. */
+  static mask_t bit(int index) { return mask_t(1) << (index % width); };
+  /* The mask of the set [begin,end) of memory locations, where
+   * index(nml) is the index of nml. */
+  template<typename ITER, typename INDEX>
+  static mask_t of(ITER begin, ITER end, const INDEX &index){
+    mask_t m = 0;
+    for(; begin != end; ++begin){
+      m |= bit(index(*begin));
+    }
+    return m;
+  };
+  /* Returns false if a set with mask m certainly does not contain the
+   * memory location with bit b. */
+  static bool may_contain(mask_t m, mask_t b) { return (m & b) != 0; };
+  /* Returns false if a set with mask m0 is certainly not a subset of
+   * a set with mask m1. */
+  static bool may_be_subset(mask_t m0, mask_t m1) { return (m0 & ~m1) == 0; };
+  static void test();
+};
+
+#endif
@@ -19,9 +19,22 @@
  */
 
 #include "pb_cegar.h"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include "ap_list.h"
 #include "exact_bwd.h"
+#include "lexer.h"
+#include "parser.h"
+#include "pb_container2.h"
+#include "test.h"
+
+int PbCegar::thread_count = 1;
 
 CegarReachability::refinement_result_t 
 PbCegar::refine(Reachability::Result *result, 
@@ -33,6 +46,12 @@ PbCegar::refine(Reachability::Result *result,
   switch(result->result){
   case Reachability::REACHABLE:
     {
+      if(pbcegarg->resume_arg && is_dirty(*result->trace)){
+        Log::debug << " *** (Dirty) Trace: ***\n\n";
+        Log::debug << result->trace->to_string(prev_arg->machine);
+        *next_arg = pbcegarg->resume_arg(prev_arg,result);
+        return CegarReachability::REFINED;
+      }
       PbConstraint::Common *common = cegar(*result->trace);
       if(common){
         *next_arg = pbcegarg->init_arg(prev_arg,common);
@@ -50,26 +69,53 @@ PbCegar::refine(Reachability::Result *result,
   }
 };
 
-PbConstraint::Common *PbCegar::cegar(const Trace &trace){  
-  const PbConstraint::Common &c = static_cast<const PbConstraint*>(trace.constraint(0))->common;
-
-  /* Is the trace dirty? */
-  bool is_dirty = false;
+bool PbCegar::is_dirty(const Trace &trace){
   for(int i = 0; i <= trace.size(); i++){
     if(static_cast<const PbConstraint*>(trace.constraint(i))->dirty_bit){
-      is_dirty = true;
-      break;
+      return true;
+    }
+  }
+  return false;
+}
+
+PbCegar::location_set PbCegar::trace_locations(const Trace &trace){
+  location_set locs;
+  for(int i = 0; i <= trace.size(); i++){
+    const std::vector<int> &pcs = trace.constraint(i)->get_control_states();
+    for(unsigned pid = 0; pid < pcs.size(); pid++){
+      locs.insert(std::pair<int,int>(pid,pcs[pid]));
     }
   }
+  return locs;
+}
 
-  if(is_dirty){
+void PbCegar::add_predicate(PbConstraint::pred_set &preds, std::vector<location_set> &locations,
+                            const Predicate &p, const location_set &locs){
+  for(unsigned i = 0; i < preds.size(); i++){
+    if(*preds[i] == p){
+      if(!locations[i].empty()){ // Otherwise preds[i] is already used everywhere
+        locations[i].insert(locs.begin(),locs.end());
+      }
+      return;
+    }
+  }
+  preds.push_back(new Predicate(p));
+  locations.push_back(locs);
+}
+
+PbConstraint::Common *PbCegar::cegar(const Trace &trace){  
+  const PbConstraint::Common &c = static_cast<const PbConstraint*>(trace.constraint(0))->common;
+
+  if(is_dirty(trace)){
     Log::debug << " *** (Dirty) Trace: ***\n\n";
     Log::debug << trace.to_string(c.machine);
     PbConstraint::pred_set new_preds;
+    std::vector<location_set> new_locs;
     for(unsigned i = 0; i < c.predicates.size(); i++){
       new_preds.push_back(new Predicate(*c.predicates[i]));
+      new_locs.push_back(c.get_locations(i));
     }
-    PbConstraint::Common *common = new PbConstraint::Common(c.k+1,c.machine,new_preds,c.auto_abstract);
+    PbConstraint::Common *common = new PbConstraint::Common(c.k+1,c.machine,new_preds,new_locs,c.auto_abstract);
     return common;
   }else{
     Log::debug << " *** Interpolating. ***\n\n";
@@ -87,16 +133,21 @@ PbConstraint::Common *PbCegar::cegar(const Trace &trace){
                                                              { return c.machine.pretty_string_reg.at(std::pair<int,int>(r,p)); },
                                                              [&c](Lang::NML nml)
                                                              { return c.machine.pretty_string_nml.at(nml); }) << "\n";
+      /* The new predicates are used only at the locations of the trace */
+      location_set locs = trace_locations(trace);
       PbConstraint::pred_set new_preds_2;
-      PbConstraint::pred_set new_preds_copy;
+      std::vector<location_set> new_locs;
       for(unsigned i = 0; i < c.predicates.size(); i++){
         new_preds_2.push_back(new Predicate(*c.predicates[i]));
-        new_preds_copy.push_back(new Predicate(*c.predicates[i]));
+        new_locs.push_back(c.get_locations(i));
+      }
+      add_predicate(new_preds_2,new_locs,interpolant,locs);
+      PbConstraint::pred_set new_preds_copy;
+      for(unsigned i = 0; i < new_preds_2.size(); i++){
+        new_preds_copy.push_back(new Predicate(*new_preds_2[i]));
       }
-      new_preds_2.push_back(new Predicate(interpolant));
-      new_preds_copy.push_back(new Predicate(interpolant));
     
-      PbConstraint::Common *new_common = new PbConstraint::Common(c.k,c.machine,new_preds_copy,c.auto_abstract);
+      PbConstraint::Common *new_common = new PbConstraint::Common(c.k,c.machine,new_preds_copy,new_locs,c.auto_abstract);
       if(can_simulate(*new_common,trace)){
 
         std::list<Predicate> interpolant_helpers = get_interpolant_helpers(trace,*ctrace,orig_interpolant);
@@ -109,19 +160,11 @@ PbConstraint::Common *PbCegar::cegar(const Trace &trace){
         Log::debug << "]\n";
 
         for(std::list<Predicate>::iterator it = interpolant_helpers.begin(); it != interpolant_helpers.end(); it++){
-          bool exists = false;
-          for(unsigned i = 0; i < new_preds_2.size(); i++){
-            if(*new_preds_2[i] == *it){
-              exists = true;
-              break;
-            }
-          }
-          if(!exists)
-            new_preds_2.push_back(new Predicate(*it));
+          add_predicate(new_preds_2,new_locs,*it,locs);
         }
       }
       delete new_common;
-      new_common = new PbConstraint::Common(c.k,c.machine,new_preds_2,c.auto_abstract);
+      new_common = new PbConstraint::Common(c.k,c.machine,new_preds_2,new_locs,c.auto_abstract);
       delete ctrace;
       delete ctrace_common;
       return new_common;
@@ -160,26 +203,38 @@ std::list<PbCegar::Predicate> PbCegar::least_inconsistent(const std::list<Applie
   bool found_inconsistent = false;
   std::list<Predicate> the_subset; // Collect the result here
   while(!found_inconsistent && !task_queue.empty()){
-    task_t t = task_queue.front();
-    task_queue.pop();
-    while(!t.second.empty()){
-      task_t t_next;
-      t_next.first = t.first;
-      t_next.first.push_front(t.second.front());
-      t.second.pop_front();
-      t_next.second = t.second;
-
-      std::list<AppliedPredicate> l(ap_list1.begin(),ap_list1.end());
-      
-      for(std::list<Predicate>::const_iterator it = t_next.first.begin();
-          it != t_next.first.end(); it++){
-        l.push_back(AppliedPredicate(&*it,std::vector<TsoVar>()));
+    /* Collect candidate subsets in the order in which they are to be
+     * checked, until there is work for every thread. Choosing the
+     * first inconsistent candidate in this order makes the result
+     * independent of thread_count. */
+    std::vector<task_t> batch;
+    while(!task_queue.empty() && (batch.empty() || int(batch.size()) < thread_count)){
+      task_t t = task_queue.front();
+      task_queue.pop();
+      while(!t.second.empty()){
+        task_t t_next;
+        t_next.first = t.first;
+        t_next.first.push_front(t.second.front());
+        t.second.pop_front();
+        t_next.second = t.second;
+        batch.push_back(t_next);
       }
-      if(!APList<TsoVar>::is_consistent(l)){
-        found_inconsistent = true;
-        the_subset = t_next.first;
-      }else{
-        task_queue.push(t_next);
+    }
+
+    int i = parallel_find(batch.size(),[&ap_list1,&batch](int i){
+        std::list<AppliedPredicate> l(ap_list1.begin(),ap_list1.end());
+        for(std::list<Predicate>::const_iterator it = batch[i].first.begin();
+            it != batch[i].first.end(); it++){
+          l.push_back(AppliedPredicate(&*it,std::vector<TsoVar>()));
+        }
+        return !APList<TsoVar>::is_consistent(l);
+      });
+    if(i >= 0){
+      found_inconsistent = true;
+      the_subset = batch[i].first;
+    }else{
+      for(unsigned j = 0; j < batch.size(); j++){
+        task_queue.push(batch[j]);
       }
     }
   }
@@ -357,22 +412,29 @@ std::list<PbCegar::Predicate> PbCegar::get_interpolant_helpers(const Trace &trac
       }
       for(std::list<Constraint*>::iterator it = empty_pres.begin(); it != empty_pres.end(); it++) delete *it;
 
-      /* Build conj_src */
-      for(std::list<Predicate>::iterator conj_it = after_conjs.begin(); conj_it != after_conjs.end(); conj_it++){
-        tmp_pbc.ap_list.push_back(AppliedPredicate(&*conj_it,std::vector<TsoVar>()));
-        std::list<Constraint*> pres = tmp_pbc.pre(trans);
-        assert(!empty_pres.empty());
-        PbConstraint *p = static_cast<PbConstraint*>(pres.front());
-        for(std::list<AppliedPredicate>::iterator it = p->ap_list.begin(); it != p->ap_list.end(); it++){
-          std::list<Predicate> conjs = it->get_predicate()->bind(it->get_argv()).conjuncts();
-          for(std::list<Predicate>::iterator it = conjs.begin(); it != conjs.end(); it++){
-            if(added.count(*it) == 0){
-              conj_src.insert(std::pair<Predicate,Predicate>(*it,*conj_it));
-            }
+      /* Build conj_src. The pre-images of the conjuncts are
+       * independent, and are computed in parallel. */
+      std::vector<Predicate> after_conj_vec(after_conjs.begin(),after_conjs.end());
+      std::vector<std::list<Predicate> > pre_conjs(after_conj_vec.size());
+      parallel_for(after_conj_vec.size(),[&](int i){
+          PbConstraint conj_pbc(cpbc->dirty_bit,cpbc->channels,cpbc->pcs,cpbc->cycle_locks,exact_common);
+          conj_pbc.ap_list.push_back(AppliedPredicate(&after_conj_vec[i],std::vector<TsoVar>()));
+          std::list<Constraint*> pres = conj_pbc.pre(trans);
+          assert(!pres.empty());
+          PbConstraint *p = static_cast<PbConstraint*>(pres.front());
+          for(std::list<AppliedPredicate>::iterator it = p->ap_list.begin(); it != p->ap_list.end(); it++){
+            std::list<Predicate> conjs = it->get_predicate()->bind(it->get_argv()).conjuncts();
+            std::copy(conjs.begin(),conjs.end(),std::back_inserter(pre_conjs[i]));
+          }
+          for(std::list<Constraint*>::iterator it = pres.begin(); it != pres.end(); it++) delete *it;
+          conj_pbc.ap_list.clear();
+        });
+      for(unsigned i = 0; i < after_conj_vec.size(); i++){
+        for(std::list<Predicate>::iterator it = pre_conjs[i].begin(); it != pre_conjs[i].end(); it++){
+          if(added.count(*it) == 0){
+            conj_src.insert(std::pair<Predicate,Predicate>(*it,after_conj_vec[i]));
           }
         }
-        for(std::list<Constraint*>::iterator it = pres.begin(); it != pres.end(); it++) delete *it;
-        tmp_pbc.ap_list.clear();
       }
     }
 
@@ -404,6 +466,67 @@ std::list<PbCegar::Predicate> PbCegar::get_interpolant_helpers(const Trace &trac
 }
 
 
+int PbCegar::parallel_find(int n, const std::function<bool(int)> &pred){
+  int tc = std::min(thread_count,n);
+  if(tc <= 1){
+    for(int i = 0; i < n; i++){
+      if(pred(i)) return i;
+    }
+    return -1;
+  }
+
+  /* Indices are handed out in increasing order. A thread stops when
+   * it is handed an index which is not smaller than the smallest
+   * index found so far. */
+  std::atomic<int> next(0);
+  std::atomic<int> found(n);
+  std::vector<std::exception_ptr> errors(n);
+  auto work = [&](){
+    for(int i = next++; i < found; i = next++){
+      try{
+        if(pred(i)){
+          int f = found;
+          while(i < f && !found.compare_exchange_weak(f,i)){}
+        }
+      }catch(...){
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> ts;
+  for(int t = 1; t < tc; t++){
+    ts.push_back(std::thread(work));
+  }
+  work();
+  for(unsigned t = 0; t < ts.size(); t++){
+    ts[t].join();
+  }
+
+  std::exception_ptr error;
+  for(int i = 0; i < n; i++){
+    if(!errors[i]) continue;
+    if(!error && i < found){
+      error = errors[i];
+    }else{
+      /* Discarded */
+      try{
+        std::rethrow_exception(errors[i]);
+      }catch(std::exception *exc){
+        delete exc;
+      }catch(...){
+      }
+    }
+  }
+  if(error){
+    std::rethrow_exception(error);
+  }
+  return (found < n) ? int(found) : -1;
+}
+
+void PbCegar::parallel_for(int n, const std::function<void(int)> &f){
+  parallel_find(n,[&f](int i){ f(i); return false; });
+}
+
 std::string PbCegar::refinement_to_string(const Reachability::Arg *refinement) const{
   if(dynamic_cast<const ExactBwd::Arg*>(refinement)){
     return static_cast<const ExactBwd::Arg*>(refinement)->common->to_string();
@@ -411,3 +534,172 @@ std::string PbCegar::refinement_to_string(const Reachability::Arg *refinement) c
     return "  (Refinement)\n";
   }
 };
+
+void PbCegar::test(){
+  int saved_thread_count = thread_count;
+
+  /* Test 1-2: Smallest index is found */
+  for(int tc = 1; tc <= 4; tc += 3){
+    thread_count = tc;
+    std::stringstream ss;
+    ss << "parallel_find smallest (" << tc << " threads)";
+    int i = parallel_find(1000,[](int i){ return i > 200 && i % 97 == 13; });
+    int j = parallel_find(1000,[](int){ return false; });
+    Test::inner_test(ss.str(),i == 207 && j == -1);
+  }
+
+  /* Test 3: All smaller indices are checked */
+  {
+    thread_count = 4;
+    std::vector<std::atomic<bool> > called(1000);
+    for(unsigned i = 0; i < called.size(); i++) called[i] = false;
+    int i = parallel_find(1000,[&called](int i){ called[i] = true; return i == 700 || i == 800; });
+    bool all_called = true;
+    for(int j = 0; j <= 700; j++){
+      all_called = all_called && called[j];
+    }
+    Test::inner_test("parallel_find checks smaller indices",i == 700 && all_called);
+  }
+
+  /* Test 4-5: Exceptions */
+  {
+    /* Counts its live instances. */
+    class TestException : public std::logic_error{
+    public:
+      TestException(int i, std::atomic<int> &live)
+        : std::logic_error("Test exception"), i(i), live(live) { ++live; };
+      virtual ~TestException() throw() { --live; };
+      int i;
+    private:
+      std::atomic<int> &live;
+    };
+    std::atomic<int> live(0);
+
+    thread_count = 4;
+    int i = parallel_find(100,[&live](int i)->bool{
+        if(i == 60) throw new TestException(i,live);
+        return i == 50;
+      });
+    int thrown = -1;
+    try{
+      parallel_find(100,[&live](int i)->bool{
+          if(i == 5) throw new TestException(i,live);
+          return i == 50;
+        });
+    }catch(TestException *exc){
+      thrown = exc->i;
+      delete exc;
+    }
+    Test::inner_test("parallel_find exceptions",i == 50 && thrown == 5 && live == 0);
+
+    /* Every worker throws, for many indices at once */
+    thrown = -1;
+    try{
+      parallel_find(1000,[&live](int i)->bool{
+          if(i % 10 == 3) throw new TestException(i,live);
+          return i == 500;
+        });
+    }catch(TestException *exc){
+      thrown = exc->i;
+      delete exc;
+    }
+    Test::inner_test("parallel_find simultaneous exceptions",thrown == 3 && live == 0);
+  }
+
+  /* Test 6: parallel_for */
+  {
+    thread_count = 4;
+    std::vector<int> v(1000,0);
+    parallel_for(v.size(),[&v](int i){ v[i] = i*i; });
+    bool ok = true;
+    for(unsigned i = 0; i < v.size(); i++){
+      ok = ok && v[i] == int(i*i);
+    }
+    Test::inner_test("parallel_for",ok);
+  }
+
+#if HAVE_LIBMATHSAT == 1
+  /* Test 7: Resuming the analysis when k is increased gives the same
+   * verdicts as restarting it. */
+  {
+    thread_count = 1;
+    /* Returns the verdict of CEGAR on the machine rmm, with or
+     * without resuming. */
+    std::function<Reachability::result_t(std::string,bool)> verdict =
+      [](std::string rmm, bool resume){
+      std::stringstream ss(rmm);
+      Lexer lex(ss);
+      Machine m0(Parser::p_test(lex));
+      std::unique_ptr<Machine> m(m0.add_domain_assumes());
+      PbConstraint::Common *common = new PbConstraint::Common(1,*m,PbConstraint::pred_set(),true);
+      ExactBwd::Arg *earg = new ExactBwd::Arg(*m,common,new PbContainer2(*m));
+      Arg *arg;
+      if(resume){
+        earg->incremental = true;
+        arg = new Arg(*m,new ExactBwd(),earg,20,ExactBwd::pb_init_arg,ExactBwd::pb_resume_arg);
+      }else{
+        arg = new Arg(*m,new ExactBwd(),earg,20,ExactBwd::pb_init_arg);
+      }
+      PbCegar cegar;
+      Reachability::Result *res = cegar.reachability(arg);
+      Reachability::result_t r = res->result;
+      delete res;
+      delete arg;
+      return r;
+    };
+    std::vector<std::pair<std::string,Reachability::result_t> > machines =
+      {{"forbidden CS CS\n"
+        "data\n"
+        "  x = 0 : [0:1]\n"
+        "  y = 0 : [0:1]\n"
+        "process\n"
+        "text\n"
+        "  write: x := 1;\n"
+        "  read: y = 0;\n"
+        "CS: nop\n"
+        "process\n"
+        "text\n"
+        "  write: y := 1;\n"
+        "  read: x = 0;\n"
+        "CS: nop\n",
+        Reachability::REACHABLE},
+       {"forbidden CS CS\n"
+        "data\n"
+        "  x = 0 : [0:1]\n"
+        "  y = 0 : [0:1]\n"
+        "process\n"
+        "text\n"
+        "  locked write: x := 1;\n"
+        "  read: y = 0;\n"
+        "CS: nop\n"
+        "process\n"
+        "text\n"
+        "  locked write: y := 1;\n"
+        "  read: x = 0;\n"
+        "CS: nop\n",
+        Reachability::UNREACHABLE},
+       {"forbidden END BAD\n"
+        "data\n"
+        "  x = 0 : [0:2]\n"
+        "process\n"
+        "text\n"
+        "  write: x := 1;\n"
+        "  write: x := 1;\n"
+        "END: nop\n"
+        "process\n"
+        "text\n"
+        "  read: x = 2;\n"
+        "BAD: nop\n",
+        Reachability::UNREACHABLE}};
+    bool same = true;
+    for(unsigned i = 0; i < machines.size(); i++){
+      Reachability::result_t r0 = verdict(machines[i].first,false);
+      Reachability::result_t r1 = verdict(machines[i].first,true);
+      same = same && r0 == machines[i].second && r1 == r0;
+    }
+    Test::inner_test("Resumed and restarted CEGAR agree",same);
+  }
+#endif
+
+  thread_count = saved_thread_count;
+}
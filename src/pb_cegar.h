@@ -51,17 +51,53 @@ public:
     Arg(const Machine &m,Reachability *abstract_reach, Reachability::Arg *first,int max_loop_count,
         init_arg_t init_arg)
       : CegarReachability::Arg(m,abstract_reach,first,max_loop_count), init_arg(init_arg) {};
+    typedef std::function<Reachability::Arg*(Reachability::Arg*,Reachability::Result*)> resume_arg_t;
+    /* Same as Arg(m,abstract_reach,first,max_loop_count,init_arg),
+     * but refinements that only increase k are made incrementally:
+     *
+     * The function resume_arg should compose the previous argument
+     * and result of the underlying reachability algorithm into an
+     * argument which resumes the previous analysis with k increased
+     * by one. (See ExactBwd::pb_resume_arg.)
+     */
+    Arg(const Machine &m,Reachability *abstract_reach, Reachability::Arg *first,int max_loop_count,
+        init_arg_t init_arg, resume_arg_t resume_arg)
+      : CegarReachability::Arg(m,abstract_reach,first,max_loop_count), init_arg(init_arg),
+        resume_arg(resume_arg) {};
     virtual ~Arg() {};
     init_arg_t init_arg;
+    /* Empty if k refinements should restart the analysis. */
+    resume_arg_t resume_arg;
   };
 
   virtual std::string refinement_to_string(const Reachability::Arg *refinement) const;
+  /* The number of threads used for independent solver queries during
+   * refinement. Each query uses its own solver environment. The
+   * default is 1.
+   */
+  static int thread_count;
+
+  static void test();
 private:
   typedef Predicates::Term<TsoVar> Term;
   typedef Predicates::Predicate<TsoVar> Predicate;
   typedef Predicates::AppliedPredicate<TsoVar> AppliedPredicate;
 
 
+  typedef PbConstraint::Common::location_set location_set;
+  /* Returns the set of control locations (pid,pc) visited by some
+   * process in trace. */
+  static location_set trace_locations(const Trace &trace);
+  /* Adds (a copy of) p to preds, to be used at the locations locs,
+   * where locations[i] are the locations of preds[i] (see
+   * PbConstraint::Common::get_locations). If preds already contains a
+   * predicate equal to p, then its locations are extended by locs
+   * instead.
+   */
+  static void add_predicate(PbConstraint::pred_set &preds, std::vector<location_set> &locations,
+                            const Predicate &p, const location_set &locs);
+  /* Returns true iff some constraint in trace is dirty. */
+  static bool is_dirty(const Trace &trace);
   /* Analyzes the trace trace. If the trace is a valid trace under
    * TSO, null is returned. Otherwise a Common object is returned,
    * which refines the abstraction used in trace.
@@ -116,6 +152,21 @@ private:
   static std::list<Predicate> get_interpolant_helpers(const Trace &trace,
                                                       const Trace &ctrace,
                                                       Predicate interpolant);
+  /* Returns the smallest i in [0,n) such that pred(i) is true, or -1
+   * if there is no such i. The calls to pred are distributed over at
+   * most thread_count threads, and may be made in any order. pred(i)
+   * is called for every i smaller than the returned value, but not
+   * necessarily for greater values.
+   *
+   * If pred throws an exception for some i smaller than the returned
+   * value, then the exception for the smallest such i is rethrown
+   * instead. Other exceptions thrown by pred are discarded, and those
+   * of type std::exception* are deleted.
+   */
+  static int parallel_find(int n, const std::function<bool(int)> &pred);
+  /* Calls f(i) for every i in [0,n), distributed over at most
+   * thread_count threads. */
+  static void parallel_for(int n, const std::function<void(int)> &f);
 
 };
 
@@ -18,11 +18,32 @@
  *
  */
 
+#include "exact_bwd.h"
 #include "pb_constraint.h"
+#include "pb_container2.h"
+#include "test.h"
+#include <memory>
 #include <sstream>
 
 PbConstraint::Common::Common(int k, const Machine &m, pred_set preds, bool auto_abstract)
-  : machine(m), predicates(preds), k(k), auto_abstract(auto_abstract), is_init(build_is_init(m)) {
+  : Common(k,m,preds,std::vector<location_set>(),auto_abstract) {};
+
+PbConstraint::Common::Common(int k, const Machine &m, pred_set preds,
+                             const std::vector<location_set> &locs, bool auto_abstract)
+  : machine(m), predicates(preds), k(k), auto_abstract(auto_abstract), is_init(build_is_init(m)),
+    locations(locs), localised(false) {
+
+  /* Setup locations and local_preds */
+  locations.resize(predicates.size());
+  for(int pid = 0; pid < machine.proc_count(); pid++){
+    local_preds.push_back(std::vector<std::vector<int> >(machine.automata[pid].get_states().size()));
+  }
+  for(unsigned i = 0; i < predicates.size(); i++){
+    for(location_set::const_iterator it = locations[i].begin(); it != locations[i].end(); it++){
+      local_preds[it->first][it->second].push_back(i);
+      localised = true;
+    }
+  }
 
 #ifndef NDEBUG
   abstraction_cache_calls = abstraction_cache_hits = 0;
@@ -193,7 +214,14 @@ std::string PbConstraint::Common::to_string() const throw(){
     ss << "    " << predicates[i]->to_string([this](int r, int p)->std::string
                                              { return this->machine.pretty_string_reg.at(std::pair<int,int>(r,p)); },
                                              [this](Lang::NML nml)->std::string
-                                             { return this->machine.pretty_string_nml.at(nml); }) << "\n";
+                                             { return this->machine.pretty_string_nml.at(nml); });
+    if(!locations[i].empty()){
+      ss << "  @";
+      for(location_set::const_iterator it = locations[i].begin(); it != locations[i].end(); it++){
+        ss << " P" << it->first << ":Q" << it->second;
+      }
+    }
+    ss << "\n";
   }
   return ss.str();
 }
@@ -267,46 +295,156 @@ PbConstraint::Common::~Common(){
   }
 }
 
-PbConstraint::Common::AbstractionResult PbConstraint::Common::abstract(const std::list<AppliedPredicate> &apl){
-#ifndef NDEBUG
-  abstraction_cache_calls++;
-#endif
-
-  std::map<std::list<AppliedPredicate>, AbstractionResult>::iterator aplit = abstraction_cache.find(apl);
-  if(aplit == abstraction_cache.end()){
-    Predicate pred = Predicate::tt();
-    std::list<AppliedPredicate> apl_copy;
-    for(std::list<AppliedPredicate>::const_iterator it = apl.begin();
-        it != apl.end(); it++){
-      pred = pred && it->get_predicate()->bind(it->get_argv());
-      if(ap_is_abstract(*it)){
-        apl_copy.push_back(*it);
-      }else{
-        Predicate *pcopy = new Predicate(*it->get_predicate());
-        apl_copy.push_back(AppliedPredicate(pcopy,it->get_argv()));
-        abstraction_cache_predicates.push_back(pcopy);
+std::vector<bool> PbConstraint::Common::predicate_mask(const std::vector<int> &pcs) const{
+  std::vector<bool> mask;
+  if(localised){
+    mask.resize(predicates.size(),false);
+    for(unsigned i = 0; i < predicates.size(); i++){
+      mask[i] = locations[i].empty();
+    }
+    for(unsigned pid = 0; pid < pcs.size(); pid++){
+      const std::vector<int> &lp = local_preds[pid][pcs[pid]];
+      for(unsigned i = 0; i < lp.size(); i++){
+        mask[lp[i]] = true;
       }
     }
+  }
+  return mask;
+}
+
+int PbConstraint::Common::var_id(const TsoVar &v){
+  std::lock_guard<std::mutex> lock(id_mutex);
+  return var_id_locked(v);
+}
+
+int PbConstraint::Common::var_id_locked(const TsoVar &v){
+  std::map<TsoVar,int>::iterator it = var_ids.find(v);
+  if(it != var_ids.end()){
+    return it->second;
+  }
+  int id = var_msg_pid.size();
+  var_ids[v] = id;
+  var_msg_pid.push_back(v.get_type() == TsoVar::MSG ? v.get_process() : -1);
+  return id;
+}
+
+const std::vector<int> &PbConstraint::Common::ap_var_ids(const AppliedPredicate &ap, std::vector<int> &buf){
+  if(ap.get_var_ids()){
+    return *ap.get_var_ids();
+  }
+  std::lock_guard<std::mutex> lock(id_mutex);
+  if(ap_is_abstract(ap)){
+    return *abstract_var_ids_locked(ap);
+  }
+  buf.clear();
+  std::set<TsoVar> vs = ap.get_variables();
+  for(std::set<TsoVar>::const_iterator vit = vs.begin(); vit != vs.end(); vit++){
+    buf.push_back(var_id_locked(*vit));
+  }
+  std::sort(buf.begin(),buf.end());
+  return buf;
+}
+
+const std::vector<int> *PbConstraint::Common::abstract_var_ids_locked(const AppliedPredicate &ap){
+  std::pair<const Predicate*,std::vector<TsoVar> > key(ap.get_predicate(),ap.get_argv());
+  /* Only abstract predicates are keys, and they live as long as this
+   * Common, so a hit cannot be a reused address. */
+  std::map<std::pair<const Predicate*,std::vector<TsoVar> >,int>::iterator it = ap_ids.find(key);
+  if(it != ap_ids.end()){
+    return &ap_vars[it->second];
+  }
+  std::vector<int> ids;
+  std::set<TsoVar> vs = ap.get_variables();
+  for(std::set<TsoVar>::const_iterator vit = vs.begin(); vit != vs.end(); vit++){
+    ids.push_back(var_id_locked(*vit));
+  }
+  std::sort(ids.begin(),ids.end());
+  ap_ids[key] = ap_vars.size();
+  ap_vars.push_back(ids);
+  return &ap_vars.back();
+}
+
+bool PbConstraint::Common::mentions_msg_of(const std::vector<int> &vars, int pid){
+  std::lock_guard<std::mutex> lock(id_mutex);
+  for(unsigned i = 0; i < vars.size(); i++){
+    if(var_msg_pid[vars[i]] == pid) return true;
+  }
+  return false;
+}
 
-    AbstractionResult ar;
-    if(APList<TsoVar>::is_consistent(pred)){
-      ar.consistent = true;
-      std::list<AppliedPredicate> exp = APList<TsoVar>::expand(pred,predicates);
-      for(std::list<AppliedPredicate>::const_iterator it = exp.begin(); it != exp.end(); it++){
-        ar.abstract.push_back(*it);
+PbConstraint::Common::AbstractionResult PbConstraint::Common::abstract(const std::list<AppliedPredicate> &apl,
+                                                                       const std::vector<int> &pcs){
+  std::vector<bool> mask = predicate_mask(pcs);
+  local_cache_t *cache;
+  {
+    std::lock_guard<std::mutex> lock(abstraction_cache_mutex);
+#ifndef NDEBUG
+    abstraction_cache_calls++;
+#endif
+    std::map<std::vector<bool>, local_cache_t>::iterator cit = abstraction_cache.find(mask);
+    if(cit == abstraction_cache.end()){
+      cache = &abstraction_cache[mask];
+      for(unsigned i = 0; i < predicates.size(); i++){
+        if(mask.empty() || mask[i]){
+          cache->preds.push_back(predicates[i]);
+        }
       }
-      ar.abstract.sort();
     }else{
-      ar.consistent = false;
+      cache = &cit->second;
     }
-    abstraction_cache[apl_copy] = ar;
-    return ar;
-  }else{
+    std::map<std::list<AppliedPredicate>, AbstractionResult>::iterator aplit = cache->results.find(apl);
+    if(aplit != cache->results.end()){
 #ifndef NDEBUG
-    abstraction_cache_hits++;
+      abstraction_cache_hits++;
 #endif
-    return aplit->second;
+      return aplit->second;
+    }
+  }
+
+  /* Compute the abstraction without holding the lock, so that other
+   * threads may use the cache meanwhile. */
+  Predicate pred = Predicate::tt();
+  for(std::list<AppliedPredicate>::const_iterator it = apl.begin();
+      it != apl.end(); it++){
+    pred = pred && it->get_predicate()->bind(it->get_argv());
+  }
+
+  AbstractionResult ar;
+  if(APList<TsoVar>::is_consistent(pred)){
+    ar.consistent = true;
+    std::list<AppliedPredicate> exp = APList<TsoVar>::expand(pred,cache->preds);
+    for(std::list<AppliedPredicate>::const_iterator it = exp.begin(); it != exp.end(); it++){
+      ar.abstract.push_back(*it);
+    }
+    ar.abstract.sort();
+    /* Store the variable ids on the new entries, so that ap_var_ids
+     * can later read them without locking. */
+    std::lock_guard<std::mutex> lock(id_mutex);
+    for(std::list<AppliedPredicate>::iterator it = ar.abstract.begin(); it != ar.abstract.end(); it++){
+      it->set_var_ids(abstract_var_ids_locked(*it));
+    }
+  }else{
+    ar.consistent = false;
   }
+
+  std::lock_guard<std::mutex> lock(abstraction_cache_mutex);
+  if(cache->results.count(apl)){
+    /* Another thread computed the same abstraction meanwhile */
+    return ar;
+  }
+  std::list<AppliedPredicate> apl_copy;
+  for(std::list<AppliedPredicate>::const_iterator it = apl.begin();
+      it != apl.end(); it++){
+    if(ap_is_abstract(*it)){
+      apl_copy.push_back(*it);
+    }else{
+      Predicate *pcopy = new Predicate(*it->get_predicate());
+      apl_copy.push_back(AppliedPredicate(pcopy,it->get_argv()));
+      abstraction_cache_predicates.push_back(pcopy);
+    }
+  }
+  cache->results[apl_copy] = ar;
+  return ar;
 }
 
 PbConstraint::PbConstraint(const std::vector<int> &pcs, Common &c) 
@@ -364,7 +502,7 @@ const std::vector<int> &PbConstraint::get_control_states() const throw(){
 void PbConstraint::abstract(){
   if(!is_abstracted()){
     assert(ap_list_is_sorted());
-    abstract(common.abstract(ap_list));
+    abstract(common.abstract(ap_list,pcs));
     assert(ap_list_is_abstract());
   }
 }
@@ -393,6 +531,25 @@ bool PbConstraint::is_init_state() const{
   return APList<TsoVar>::is_consistent(l);
 }
 
+bool PbConstraint::is_saturated() const{
+  for(unsigned pid = 0; pid < channels.size(); pid++){
+    for(sharinglist<Lang::MemLoc<int> >::const_iterator it = channels[pid].begin();
+        it != channels[pid].end(); it++){
+      int act_k = 0;
+      for(sharinglist<Lang::MemLoc<int> >::const_iterator it2 = channels[pid].begin();
+          it2 != channels[pid].end(); it2++){
+        if(*it2 == *it){
+          act_k++;
+        }
+      }
+      if(act_k >= common.k){
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 Constraint::Comparison PbConstraint::entailment_compare(const Constraint &c) const{
   if(const PbConstraint *pc = dynamic_cast<const PbConstraint*>(&c)){
     return entailment_compare(*pc);
@@ -575,9 +732,11 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
         std::list<AppliedPredicate> apl;
         std::list<Predicate*> tmp_preds;
         std::function<TsoVar(const TsoVar&)> trans = Predicates::subst_translator(v,TsoVar::reg(s.get_reg(),pid));
+        int vid = common.var_id(r);
+        std::vector<int> buf;
         for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin();
             it != this->ap_list.end(); it++){
-          if(it->get_variables().count(r)){
+          if(Common::mentions(common.ap_var_ids(*it,buf),vid)){
             Predicate *ppred = new Predicate(it->get_predicate()->substitute(Term::variable(v),r));
             tmp_preds.push_back(ppred);
             AppliedPredicate ap(ppred,it->get_argv());
@@ -613,9 +772,11 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
             TsoVar v = TsoVar(Lang::NML(s.get_memloc(),pid));
             std::list<AppliedPredicate> apl;
             std::list<Predicate*> tmp_preds;
+            int vid = common.var_id(v);
+            std::vector<int> buf;
             for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin();
                 it != this->ap_list.end(); it++){
-              if(it->get_variables().count(v)){
+              if(Common::mentions(common.ap_var_ids(*it,buf),vid)){
                 Predicate *ppred = new Predicate(it->get_predicate()->bind(it->get_argv()).substitute(t,v));
                 tmp_preds.push_back(ppred);
                 apl.push_back(AppliedPredicate(ppred,std::vector<TsoVar>()));
@@ -652,8 +813,10 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
           if(p->ok_last_msg(pid,next_pc)){
             std::list<AppliedPredicate> apl;
             std::list<Predicate*> tmp_preds;
+            int vid = common.var_id(v);
+            std::vector<int> buf;
             for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin(); it != this->ap_list.end(); it++){
-              if(it->get_variables().count(v)){
+              if(Common::mentions(common.ap_var_ids(*it,buf),vid)){
                 Predicate *ppred = new Predicate(it->get_predicate()->bind(it->get_argv()).substitute(t,v));
                 tmp_preds.push_back(ppred);
                 apl.push_back(AppliedPredicate(ppred,std::vector<TsoVar>()));
@@ -715,15 +878,10 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
                 };
                 std::list<AppliedPredicate> apl;
                 std::list<Predicate*> tmp_preds;
+                std::vector<int> buf;
                 for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin(); it != this->ap_list.end(); it++){
-                  std::set<TsoVar> vars = it->get_variables();
-                  bool modify = false;
-                  for(std::set<TsoVar>::iterator vit = vars.begin(); vit != vars.end(); vit++){
-                    if(*vit == v || (vit->get_type() == TsoVar::MSG && vit->get_process() == pid)){
-                      modify = true;
-                      break;
-                    }
-                  }
+                  /* v is itself a message of pid */
+                  bool modify = common.mentions_msg_of(common.ap_var_ids(*it,buf),pid);
                   if(modify){
                     Predicate *ppred = new Predicate(it->get_predicate()->bind(it->get_argv()).substitute(t,v));
                     ppred->translate(trans);
@@ -764,8 +922,10 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
         TsoVar v = TsoVar::reg(s.get_reg(),pid);
         std::list<AppliedPredicate> apl;
         std::list<Predicate*> tmp_preds;
+        int vid = common.var_id(v);
+        std::vector<int> buf;
         for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin(); it != this->ap_list.end(); it++){
-          if(it->get_variables().count(v)){
+          if(Common::mentions(common.ap_var_ids(*it,buf),vid)){
             Predicate *ppred = new Predicate(it->get_predicate()->bind(it->get_argv()).substitute(t,v));
             tmp_preds.push_back(ppred);
             apl.push_back(AppliedPredicate(ppred,std::vector<TsoVar>()));
@@ -911,9 +1071,10 @@ std::list<Constraint*> PbConstraint::pre(const Machine::PTransition &t,bool lock
             PbConstraint *p = new PbConstraint(this->dirty_bit,this->channels,this->pcs,
                                                this->cycle_locks,this->common);
             p->last_trans = last_trans_t(false,pid);
-            TsoVar to_remove(Lang::NML(s.get_memloc(),pid));
+            int to_remove = common.var_id(TsoVar(Lang::NML(s.get_memloc(),pid)));
+            std::vector<int> buf;
             for(std::list<AppliedPredicate>::const_iterator it = this->ap_list.begin(); it != this->ap_list.end(); it++){
-              if(!(it->get_variables().count(to_remove))){
+              if(!Common::mentions(common.ap_var_ids(*it,buf),to_remove)){
                 p->ap_list.push_back(*it);
               }
             }
@@ -1087,43 +1248,39 @@ template<class E> void PbConstraint::sorted_insert(std::list<E> *l, const E &e)
   l->insert(it,e);
 }
 
-template<class E> bool PbConstraint::set_intersects(const std::set<E> &a, const std::set<E> &b) throw(){
-  const std::set<E> *x, *y;
-  /* Set up x and y such that x->size() <= y->size(). */
-  if(a.size() < b.size()){
-    x = &a;
-    y = &b;
-  }else{
-    x = &b;
-    y = &a;
-  }
-
-  for(typename std::set<E>::const_iterator it = x->begin(); it != x->end(); it++){
-    if(y->count(*it))
-      return true;
-  }
-  return false;
-}
-
-void PbConstraint::transfer_related(std::list<AppliedPredicate> *src, std::list<AppliedPredicate> *dst) throw(){
-  std::set<TsoVar> vars;
+void PbConstraint::transfer_related(std::list<AppliedPredicate> *src, std::list<AppliedPredicate> *dst) const{
+  /* vars[i] is true iff the variable with id i occurs in dst */
+  std::vector<bool> vars;
+  int vars_sz = 0;
+  std::function<void(const std::vector<int>&)> insert_vars =
+    [&vars,&vars_sz](const std::vector<int> &ids){
+    for(unsigned i = 0; i < ids.size(); i++){
+      if(ids[i] >= int(vars.size())) vars.resize(ids[i]+1,false);
+      if(!vars[ids[i]]){
+        vars[ids[i]] = true;
+        vars_sz++;
+      }
+    }
+  };
+  std::vector<int> buf;
   for(std::list<AppliedPredicate>::iterator it = dst->begin(); it != dst->end(); it++){
-    std::set<TsoVar> vars2 = it->get_variables();
-    for(std::set<TsoVar>::iterator it2 = vars2.begin(); it2 != vars2.end(); it2++)
-      vars.insert(*it2);
+    insert_vars(common.ap_var_ids(*it,buf));
   }
-  unsigned vars_sz = vars.size();
+  int prev_vars_sz = vars_sz;
   std::list<AppliedPredicate>::iterator it = src->begin();
   while(it != src->end()){
-    std::set<TsoVar> vars2 = it->get_variables();
-    if(set_intersects(vars,vars2)){
-      for(std::set<TsoVar>::iterator it2 = vars2.begin(); it2 != vars2.end(); it2++)
-        vars.insert(*it2);
+    const std::vector<int> &vars2 = common.ap_var_ids(*it,buf);
+    bool intersects = false;
+    for(unsigned i = 0; !intersects && i < vars2.size(); i++){
+      intersects = vars2[i] < int(vars.size()) && vars[vars2[i]];
+    }
+    if(intersects){
+      insert_vars(vars2);
       dst->push_back(*it);
       it = src->erase(it);
-      if(vars_sz != vars.size()) /* New variables added, recheck earlier applied predicates */
+      if(prev_vars_sz != vars_sz) /* New variables added, recheck earlier applied predicates */
         it = src->begin();
-      vars_sz = vars.size();
+      prev_vars_sz = vars_sz;
     }else{
       it++;
     }
@@ -1135,7 +1292,7 @@ bool PbConstraint::add_to_ap_list(std::list<AppliedPredicate> *apl, std::list<Pr
   if(common.auto_abstract){
     assert(is_abstracted());
     transfer_related(&ap_list,apl);
-    ar = common.abstract(*apl);
+    ar = common.abstract(*apl,pcs);
     apl->clear();
     for(std::list<Predicate*>::iterator it = tmp_preds->begin(); it != tmp_preds->end(); it++){
       delete *it;
@@ -1147,7 +1304,7 @@ bool PbConstraint::add_to_ap_list(std::list<AppliedPredicate> *apl, std::list<Pr
     apl->sort();
     ap_list.merge(*apl);
     std::copy(tmp_preds->begin(),tmp_preds->end(),std::back_inserter(temporary_predicates));
-    ar = common.abstract(ap_list);
+    ar = common.abstract(ap_list,pcs);
   }
   apl->clear();
   tmp_preds->clear();
@@ -1472,8 +1629,8 @@ std::list<const Machine::PTransition*> PbConstraint::partred() const{
 
   /* Remove transitions which are locked by a cycle lock */
 #ifdef USE_TSO_CYCLE_LOCKS  
-  static std::vector<bool> has_cycle_lock(pcs.size());
-  static std::vector<bool> is_cycle_locked(pcs.size()); // Has at least one cycle lock, and all cycle locks are locked.
+  std::vector<bool> has_cycle_lock(pcs.size());
+  std::vector<bool> is_cycle_locked(pcs.size()); // Has at least one cycle lock, and all cycle locks are locked.
   for(unsigned i = 0; i < has_cycle_lock.size(); i++){
     has_cycle_lock[i] = false;
     is_cycle_locked[i] = true;
@@ -1517,8 +1674,8 @@ std::list<const Machine::PTransition*> PbConstraint::partred() const{
 #ifdef USE_CYCLE_LOCKS
   throw new std::logic_error("PbConstraint::partred(): CycleLocks are not supported!");
 
-  static std::vector<bool> has_cycle_lock(pcs.size());
-  static std::vector<bool> is_cycle_locked(pcs.size()); // Has at least one cycle lock, and all cycle locks are locked.
+  std::vector<bool> has_cycle_lock(pcs.size());
+  std::vector<bool> is_cycle_locked(pcs.size()); // Has at least one cycle lock, and all cycle locks are locked.
   if(pcs.size() != 2){
     // TODO: Fix this
     Log::warning << "Warning: Only 2 processes are supported!\n";
@@ -1648,3 +1805,200 @@ const Machine::PTransition *PbConstraint::Common::find_transition(const Machine:
     return 0;
   }
 }
+
+void PbConstraint::test(){
+  std::stringstream rmm;
+  rmm << "forbidden L0 L0\n"
+      << "data\n"
+      << "  x = 0 : [0:1]\n"
+      << "  y = 0 : [0:1]\n"
+      << "process\n"
+      << "registers\n"
+      << "  $r0 = 0 : [0:1]\n"
+      << "text\n"
+      << "L0:\n"
+      << "  write: x := $r0\n"
+      << "process\n"
+      << "text\n"
+      << "L0:\n"
+      << "  write: y := 1\n";
+  Lexer lex(rmm);
+  Machine machine(Parser::p_test(lex));
+
+  TsoVar x(Lang::NML::global(0));
+  TsoVar y(Lang::NML::global(1));
+  TsoVar r0 = TsoVar::reg(0,0);
+  TsoVar m1 = TsoVar::msg(1,0);
+
+  /* p0(a) is (a == $r0) */
+  Predicate *p0 = new Predicate(Predicate::eq(Term::argument(0),Term::variable(r0)));
+  Common common(1,machine,pred_set(1,p0),false);
+
+  /* Test 1: Variable ids are dense and stable */
+  {
+    int ix = common.var_id(x), iy = common.var_id(y);
+    Test::inner_test("var_id dense",
+                     ix == 0 && iy == 1 && common.var_id(x) == 0 && common.var_id(r0) == 2);
+  }
+
+  /* Test 2: Abstract applied predicates are memoised */
+  {
+    std::vector<int> buf;
+    AppliedPredicate ap(p0,std::vector<TsoVar>(1,m1));
+    const std::vector<int> &ids = common.ap_var_ids(ap,buf);
+    std::vector<int> expected;
+    expected.push_back(common.var_id(r0));
+    expected.push_back(common.var_id(m1));
+    std::sort(expected.begin(),expected.end());
+    const std::vector<int> &ids2 = common.ap_var_ids(AppliedPredicate(p0,std::vector<TsoVar>(1,m1)),buf);
+    Test::inner_test("ap_var_ids abstract",
+                     ids == expected && &ids == &ids2 && &ids != &buf &&
+                     common.mentions_msg_of(ids,0) && !common.mentions_msg_of(ids,1) &&
+                     Common::mentions(ids,common.var_id(r0)) && !Common::mentions(ids,common.var_id(x)));
+  }
+
+  /* Test 2b: Stored variable ids are returned as is, and dropped by translate_args */
+  {
+    std::vector<int> buf;
+    std::vector<int> stored(1,common.var_id(y));
+    AppliedPredicate ap(p0,std::vector<TsoVar>(1,m1));
+    ap.set_var_ids(&stored);
+    AppliedPredicate ap2(ap);
+    bool shared = &common.ap_var_ids(ap2,buf) == &stored;
+    std::function<TsoVar(const TsoVar&)> t = [](const TsoVar &v){ return v; };
+    ap2.translate_args(t);
+    Test::inner_test("ap_var_ids stored",
+                     shared && ap2.get_var_ids() == 0 && &common.ap_var_ids(ap2,buf) != &stored);
+  }
+
+  /* Test 3: Non-abstract applied predicates are computed into buf */
+  {
+    std::vector<int> buf;
+    Predicate p(Predicate::eq(Term::variable(x),Term::variable(y)));
+    const std::vector<int> &ids = common.ap_var_ids(AppliedPredicate(&p,std::vector<TsoVar>()),buf);
+    std::vector<int> expected;
+    expected.push_back(common.var_id(x));
+    expected.push_back(common.var_id(y));
+    Test::inner_test("ap_var_ids non-abstract",&ids == &buf && ids == expected);
+  }
+
+  /* Test 4: transfer_related follows chains of shared variables */
+  {
+    TsoVar r1 = TsoVar::reg(1,0);
+    Predicate pxy(Predicate::eq(Term::variable(x),Term::variable(y)));
+    Predicate pyr(Predicate::eq(Term::variable(y),Term::variable(r1)));
+    Predicate pr0(Predicate::eq(Term::variable(r0),Term::integer(0)));
+    Predicate pr1(Predicate::eq(Term::variable(r1),Term::integer(1)));
+    std::list<AppliedPredicate> src, dst;
+    src.push_back(AppliedPredicate(&pxy,std::vector<TsoVar>()));
+    src.push_back(AppliedPredicate(&pr0,std::vector<TsoVar>()));
+    src.push_back(AppliedPredicate(&pyr,std::vector<TsoVar>()));
+    dst.push_back(AppliedPredicate(&pr1,std::vector<TsoVar>()));
+    PbConstraint pbc(std::vector<int>(2,0),common);
+    pbc.transfer_related(&src,&dst);
+    Test::inner_test("transfer_related",
+                     src.size() == 1 && src.front().get_predicate() == &pr0 && dst.size() == 3);
+  }
+
+  /* Predicates px: x == 0, used only when process 0 is at control
+   * location 1, and py: y == 1, used everywhere. */
+  std::function<pred_set()> pxy =
+    [&x,&y](){
+    return pred_set({new Predicate(Predicate::eq(Term::variable(x),Term::integer(0))),
+                     new Predicate(Predicate::eq(Term::variable(y),Term::integer(1)))});
+  };
+  std::vector<Common::location_set> pxy_locs(1);
+  pxy_locs[0].insert(std::pair<int,int>(0,1));
+
+  /* Test 5: predicate_mask */
+  {
+    Common lcommon(1,machine,pxy(),pxy_locs,false);
+    Test::inner_test("predicate_mask",
+                     lcommon.predicate_mask({0,0}) == std::vector<bool>({false,true}) &&
+                     lcommon.predicate_mask({0,1}) == std::vector<bool>({false,true}) &&
+                     lcommon.predicate_mask({1,0}) == std::vector<bool>({true,true}) &&
+                     lcommon.predicate_mask({1,1}) == std::vector<bool>({true,true}) &&
+                     common.predicate_mask({0,0}).empty());
+  }
+
+#if HAVE_LIBMATHSAT == 1
+  /* Test 6: Where the mask excludes px, abstraction gives the same
+   * result as without px. Elsewhere it gives the same result as
+   * with px everywhere. */
+  {
+    std::function<std::string(const Common::AbstractionResult&)> str =
+      [&machine](const Common::AbstractionResult &ar){
+      std::stringstream ss;
+      ss << ar.consistent;
+      for(const AppliedPredicate &ap : ar.abstract){
+        ss << " " << ap.to_string([&machine](int r, int p){ return machine.pretty_string_reg.at(std::pair<int,int>(r,p)); },
+                                  [&machine](Lang::NML nml){ return machine.pretty_string_nml.at(nml); });
+      }
+      return ss.str();
+    };
+    Predicate xy = Predicate::eq(Term::variable(x),Term::integer(0)) &&
+      Predicate::eq(Term::variable(y),Term::integer(1));
+    std::list<AppliedPredicate> l(1,AppliedPredicate(&xy,std::vector<TsoVar>()));
+    Common lcommon(1,machine,pxy(),pxy_locs,false);
+    Common all_common(1,machine,pxy(),false);
+    pred_set py = pxy();
+    delete py[0];
+    py.erase(py.begin());
+    Common py_common(1,machine,py,false);
+    std::string excluded = str(lcommon.abstract(l,{0,0}));
+    std::string included = str(lcommon.abstract(l,{1,0}));
+    Test::inner_test("abstract with localised predicates",
+                     excluded == str(py_common.abstract(l,{0,0})) &&
+                     included == str(all_common.abstract(l,{1,0})) &&
+                     excluded != included);
+  }
+
+  /* Test 7: Localising a predicate to some control locations does
+   * not change the verdict. */
+  {
+    std::stringstream dekker;
+    dekker << "forbidden CS CS\n"
+           << "data\n"
+           << "  x = 0 : [0:1]\n"
+           << "  y = 0 : [0:1]\n"
+           << "  z = 0 : [0:1]\n"
+           << "process\n"
+           << "text\n"
+           << "  locked write: x := 1;\n"
+           << "  read: y = 0;\n"
+           << "CS: nop\n"
+           << "process\n"
+           << "text\n"
+           << "  locked write: y := 1;\n"
+           << "  read: x = 0;\n"
+           << "CS: nop\n";
+    Lexer dlex(dekker);
+    Machine m0(Parser::p_test(dlex));
+    std::unique_ptr<Machine> m(m0.add_domain_assumes());
+    /* x == 0, y == 0, and z == 0, which is irrelevant */
+    std::function<pred_set()> preds =
+      [](){
+      pred_set ps;
+      for(int i = 0; i < 3; i++){
+        ps.push_back(new Predicate(Predicate::eq(Term::variable(TsoVar(Lang::NML::global(i))),
+                                                 Term::integer(0))));
+      }
+      return ps;
+    };
+    std::vector<Common::location_set> locs(3);
+    locs[2].insert(std::pair<int,int>(0,1));
+    std::function<Reachability::result_t(Common*)> verdict =
+      [&m](Common *c){
+      ExactBwd::Arg arg(*m,c,new PbContainer2(*m));
+      ExactBwd reach;
+      Reachability::Result *res = reach.reachability(&arg);
+      Reachability::result_t r = res->result;
+      delete res;
+      return r;
+    };
+    Reachability::result_t lr = verdict(new Common(1,*m,preds(),locs,true));
+    Reachability::result_t ur = verdict(new Common(1,*m,preds(),true));
+    Test::inner_test("localised verdict",lr == ur);
+  }
+#endif
+}
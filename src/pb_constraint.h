@@ -29,6 +29,11 @@
 #include "tso_var.h"
 #include "tso_cycle_lock.h"
 
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <set>
+
 class PbConstraint : public Constraint{
 public:
   typedef Predicates::Term<TsoVar> Term;
@@ -37,17 +42,42 @@ public:
   typedef APList<TsoVar>::pred_set pred_set;
   class Common : public Constraint::Common{
   public:
+    /* A set of control locations (pid,pc). */
+    typedef std::set<std::pair<int,int> > location_set;
     /* Note: Common takes ownership of all predicates in preds. */
     Common(int k, const Machine &m, pred_set preds, bool auto_abstract);
+    /* Same as Common(k,m,preds,auto_abstract), but predicates[i] is
+     * used only when abstracting constraints where, for some (pid,pc)
+     * in locations[i], process pid is at control location pc. If
+     * locations[i] is empty, or i >= locations.size(), predicates[i]
+     * is used for all constraints.
+     */
+    Common(int k, const Machine &m, pred_set preds, const std::vector<location_set> &locations,
+           bool auto_abstract);
     ~Common();
     const Machine &machine;
     /* The predicates which are allowed in ap_set when the constraint is
-     * abstracted.
+     * abstracted. (Restricted to control locations by
+     * get_locations.)
      */
     pred_set predicates;
+    /* Returns the locations at which predicates[i] is used for
+     * abstraction. An empty set means all locations.
+     */
+    const location_set &get_locations(int i) const { return locations[i]; };
+    /* Returns a mask m such that m[i] is true iff predicates[i] is
+     * used at the control locations pcs. If no predicate is
+     * restricted to any locations, the empty mask is returned.
+     */
+    std::vector<bool> predicate_mask(const std::vector<int> &pcs) const;
     /* The maximum number of messages to keep in the channel for each
-     * combination (writer,location). */
-    const int k;
+     * combination (writer,location).
+     *
+     * k may be increased while constraints using this Common are
+     * alive (see ExactBwd::pb_resume_arg). Only the pre-images of
+     * saturated constraints (see PbConstraint::is_saturated) depend
+     * on k. */
+    int k;
     /* last_msg[p][q] is a vector containing all the possible messages
      * which can be the rightmost message in the channel of process p
      * when process p is at control state q.
@@ -61,15 +91,18 @@ public:
       std::list<AppliedPredicate> abstract;
       bool consistent;
     };
-    /* If l is a key in abstraction_cache then the corresponding value
-     * is returned. Otherwise an AbstractionResult ar is calculated
-     * and returned, and (l maps to ar) is inserted into
-     * abstraction_cache and abstraction_cache_predicates. This will
-     * not claim ownership of any predicates. Copies will be made.
+    /* Abstracts l using the predicates which are used at the control
+     * locations pcs.
+     *
+     * If l is a key in abstraction_cache for those predicates then the
+     * corresponding value is returned. Otherwise an AbstractionResult
+     * ar is calculated and returned, and (l maps to ar) is inserted
+     * into abstraction_cache and abstraction_cache_predicates. This
+     * will not claim ownership of any predicates. Copies will be made.
      *
      * Pre: l is sorted.
      */
-    AbstractionResult abstract(const std::list<AppliedPredicate> &l);
+    AbstractionResult abstract(const std::list<AppliedPredicate> &l, const std::vector<int> &pcs);
     bool predicate_is_abstract(const Predicate *p) const throw(){
       for(unsigned i = 0; i < predicates.size(); i++){
         if(predicates[i] == p) return true;
@@ -77,6 +110,30 @@ public:
       return false;
     };
     bool ap_is_abstract(const AppliedPredicate &ap) const throw() { return predicate_is_abstract(ap.get_predicate()); };
+    /* Returns a dense integer id for v. Ids are assigned on first
+     * use, and are never reused within this Common.
+     */
+    int var_id(const TsoVar &v);
+    /* Returns the sorted vector of the ids (see var_id) of the
+     * variables in ap.get_variables().
+     *
+     * The applied predicates produced by abstract carry their ids
+     * (see AppliedPredicate::get_var_ids), which are then returned
+     * without locking. Other abstract applied predicates get their
+     * vector computed once and memoised. In both cases the returned
+     * reference stays valid as long as this Common. For non-abstract
+     * applied predicates the vector is computed into buf, and buf is
+     * returned.
+     */
+    const std::vector<int> &ap_var_ids(const AppliedPredicate &ap, std::vector<int> &buf);
+    /* Returns true iff the sorted id vector vars contains vid. */
+    static bool mentions(const std::vector<int> &vars, int vid){
+      return std::binary_search(vars.begin(),vars.end(),vid);
+    };
+    /* Returns true iff the sorted id vector vars contains the id of
+     * some message variable of process pid.
+     */
+    bool mentions_msg_of(const std::vector<int> &vars, int pid);
     /* An applied predicate which states that each variable has the
      * value required at the initial state of machine.
      */
@@ -128,16 +185,61 @@ public:
     /* Initializes trans_to_pc. 
      * Should be called after init_all_transitions() */
     void init_trans_to_pc();
-    /* Maps lists of applied predicates to the result of their
-     * abstraction.  The key list must be sorted. All non-abstract
-     * predicates pointed to by some applied predicate in the key list
-     * should occur in abstraction_cache_predicates, and nowhere else.
-     */
-    std::map<std::list<AppliedPredicate>, AbstractionResult> abstraction_cache;
+    /* locations[i] is the set of control locations at which
+     * predicates[i] is used. Empty means all locations. */
+    std::vector<location_set> locations;
+    /* True iff some predicate is restricted to some locations. */
+    bool localised;
+    /* local_preds[pid][pc] contains the indices i of the predicates
+     * for which (pid,pc) is in locations[i]. */
+    std::vector<std::vector<std::vector<int> > > local_preds;
+    /* The abstraction cache for one subset of the predicates. */
+    struct local_cache_t{
+      /* The predicates in the subset */
+      pred_set preds;
+      /* Maps lists of applied predicates to the result of their
+       * abstraction.  The key list must be sorted. All non-abstract
+       * predicates pointed to by some applied predicate in the key list
+       * should occur in abstraction_cache_predicates, and nowhere else.
+       */
+      std::map<std::list<AppliedPredicate>, AbstractionResult> results;
+    };
+    /* Maps the predicate masks (see predicate_mask) to the
+     * abstraction caches for the corresponding subset of
+     * predicates. */
+    std::map<std::vector<bool>, local_cache_t> abstraction_cache;
     /* Contains the predicates which are owned by
      * abstraction_cache. They are the ones that have to be deleted.
      */
     std::list<Predicate*> abstraction_cache_predicates;
+    /* Guards abstraction_cache, abstraction_cache_predicates and the
+     * statistics below, so that abstract may be called concurrently.
+     */
+    std::mutex abstraction_cache_mutex;
+    /* Maps each variable to its id (see var_id). */
+    std::map<TsoVar,int> var_ids;
+    /* var_msg_pid[i] is the process of the variable with id i if it
+     * is a message variable, and -1 otherwise. A deque, so that
+     * growing it does not move existing elements. */
+    std::deque<int> var_msg_pid;
+    /* Maps abstract applied predicates, identified by predicate
+     * pointer and arguments, to the dense id of the applied
+     * predicate. */
+    std::map<std::pair<const Predicate*,std::vector<TsoVar> >,int> ap_ids;
+    /* ap_vars[i] is the sorted vector of variable ids of the applied
+     * predicate with id i. A deque, so that references returned by
+     * ap_var_ids remain valid when new ids are assigned. */
+    std::deque<std::vector<int> > ap_vars;
+    /* Guards var_ids, var_msg_pid, ap_ids and ap_vars. */
+    std::mutex id_mutex;
+    /* Pre: id_mutex is held by the caller. */
+    int var_id_locked(const TsoVar &v);
+    /* Returns the memoised id vector of the abstract applied
+     * predicate ap, computing it if necessary.
+     *
+     * Pre: id_mutex is held by the caller. ap_is_abstract(ap).
+     */
+    const std::vector<int> *abstract_var_ids_locked(const AppliedPredicate &ap);
 #ifndef NDEBUG
     /* Statistics about the usage of the abstraction cache */
     int abstraction_cache_calls;
@@ -179,7 +281,13 @@ public:
   bool intersects(const PbConstraint &c) const;
   std::list<Constraint*> range(const Machine::PTransition &trans) const;
   bool is_dirty() const throw() { return dirty_bit; };
+  /* Returns true iff some channel contains common.k messages to the
+   * same memory location. Only for such constraints does the result
+   * of pre depend on common.k.
+   */
+  bool is_saturated() const;
   std::list<const Machine::PTransition*> partred() const;
+  static void test();
 private:
   PbConstraint(bool dirty_bit, std::vector<sharinglist<Lang::MemLoc<int> > > channels, 
                std::vector<int> pcs, const std::list<TsoCycleLock> &cls, Common &c);
@@ -274,7 +382,7 @@ private:
    * src will remain sorted if it is sorted from the start. No
    * guarantees for dst.
    */
-  static void transfer_related(std::list<AppliedPredicate> *src, std::list<AppliedPredicate> *dst) throw();
+  void transfer_related(std::list<AppliedPredicate> *src, std::list<AppliedPredicate> *dst) const;
 
   /* Inserts e into l such that l remains sorted.
    *
@@ -282,11 +390,6 @@ private:
    */
   template<class E> static void sorted_insert(std::list<E> *l, const E &e) throw();
 
-  /* Returns true if there is an element which occurs in both a and b,
-   * false otherwise.
-   */
-  template<class E> static bool set_intersects(const std::set<E> &a, const std::set<E> &b) throw();
-
   /* If common.auto_abstract == false, then apl and tmp_preds are
    * merged with ap_list and temporary predicates. If
    * common.auto_abstract == true, then apl is abstracted and then
@@ -18,7 +18,14 @@
  *
  */
 
+#include "lexer.h"
+#include "parser.h"
 #include "pb_container2.h"
+#include "stats.h"
+#include "test.h"
+
+#include <algorithm>
+#include <sstream>
 
 PbContainer2::PbContainer2(const Machine &m)
 : f_size(0), 
@@ -53,10 +60,19 @@ inline PbContainer2::wrapper_t *PbContainer2::insert_in_f(PbConstraint *c){
   std::vector<wrapper_t*> &v = pcs_to_f[pci][c];
   bool subsumed = false;
   for(unsigned i = 0; !subsumed && i < v.size(); i++){
-    switch(c->entailment_compare(*v[i]->constraint)){
+    Constraint::Comparison cmp;
+    {
+      Stats::Probe probe(Stats::ENTAILMENT_COMPARE);
+      cmp = c->entailment_compare(*v[i]->constraint);
+    }
+    switch(cmp){
     case Constraint::LESS:
       /* v[i] is subsumed */
-      remove_from_q(v[i]);
+      {
+        Stats::Probe probe(Stats::INVALIDATE);
+        remove_from_q(v[i]);
+        ++counters.invalidated;
+      }
       break;
     case Constraint::GREATER: case Constraint::EQUAL:
       subsumed = true;
@@ -67,6 +83,7 @@ inline PbContainer2::wrapper_t *PbContainer2::insert_in_f(PbConstraint *c){
     }
   }
   if(subsumed){
+    ++counters.subsumed;
     delete c;
     return 0;
   }else{
@@ -164,6 +181,94 @@ Trace *PbContainer2::clear_and_get_trace(Constraint *cc){
   return trace;
 };
 
+Trace *PbContainer2::get_trace(Constraint *cc){
+  assert(dynamic_cast<PbConstraint*>(cc));
+  PbConstraint *c = static_cast<PbConstraint*>(cc);
+  assert(pointer_in_f(c));
+  wrapper_t *w = get_wrapper(c);
+  Trace *trace = new Trace(new PbConstraint(*c));
+  while(w->parent.target){
+    trace->push_back(*w->parent.transition,new PbConstraint(*w->parent.target->constraint));
+    w = w->parent.target;
+  }
+
+  Log::msg << "Trace length: " << trace->size() << "\n";
+
+  return trace;
+};
+
+void PbContainer2::discard_dirty(){
+  /* Detach dirty children from clean constraints. Since pre
+   * preserves the dirty bit, the parent of a clean constraint is
+   * always clean, and dirty constraints form subtrees of F. */
+  for(unsigned i = 0; i < pcs_to_f.size(); i++){
+    for(auto it = pcs_to_f[i].begin(); it != pcs_to_f[i].end(); it++){
+      std::vector<wrapper_t*> &v = it->second;
+      for(unsigned j = 0; j < v.size(); j++){
+        if(!v[j]->constraint->dirty_bit){
+          std::vector<wrapper_t::trans_t> &ch = v[j]->children;
+          ch.erase(std::remove_if(ch.begin(),ch.end(),
+                                  [](const wrapper_t::trans_t &t){ return t.target->constraint->dirty_bit; }),
+                   ch.end());
+        }
+      }
+    }
+  }
+
+  /* Remove dirty constraints, and collect the clean constraints that
+   * should be (re-)explored. The map of each entry in pcs_to_f is
+   * rebuilt, since its keys may be dirty constraints. */
+  std::vector<wrapper_t*> requeue;
+  for(unsigned i = 0; i < pcs_to_f.size(); i++){
+    std::map<PbConstraint*,std::vector<wrapper_t*>,pbcmp> clean_map;
+    for(auto it = pcs_to_f[i].begin(); it != pcs_to_f[i].end(); it++){
+      std::vector<wrapper_t*> clean;
+      for(unsigned j = 0; j < it->second.size(); j++){
+        wrapper_t *w = it->second[j];
+        if(w->constraint->dirty_bit){
+          delete w->constraint;
+          delete w;
+          f_size--;
+        }else{
+          clean.push_back(w);
+        }
+      }
+      for(unsigned j = 0; j < clean.size(); j++){
+        wrapper_t *w = clean[j];
+        bool in_q = clean_q.in_queue(w->q_index) && clean_q.at(w->q_index) == w;
+        /* prev_popped may not have been fully explored */
+        bool explore = in_q || w == prev_popped;
+        if(!explore && w->constraint->is_saturated()){
+          explore = true;
+          for(unsigned l = 0; explore && l < clean.size(); l++){
+            if(l != j && w->constraint->entailment_compare(*clean[l]->constraint) == Constraint::GREATER){
+              explore = false;
+            }
+          }
+        }
+        if(explore){
+          requeue.push_back(w);
+        }
+      }
+      if(clean.size()){
+        clean_map[clean[0]->constraint] = clean;
+      }
+    }
+    pcs_to_f[i].swap(clean_map);
+  }
+
+  /* Rebuild Q, keeping the original order */
+  std::sort(requeue.begin(),requeue.end(),
+            [](wrapper_t *a, wrapper_t *b){ return a->q_index < b->q_index; });
+  clean_q.clear();
+  dirty_q.clear();
+  q_size = 0;
+  prev_popped = &dummy_wrapper;
+  for(unsigned i = 0; i < requeue.size(); i++){
+    insert_in_q(requeue[i]);
+  }
+};
+
 void PbContainer2::clear(){
   for(unsigned i = 0; i < pcs_to_f.size(); i++){
     for(auto it = pcs_to_f[i].begin(); it != pcs_to_f[i].end(); it++){
@@ -223,3 +328,84 @@ void PbContainer2::remove_from_q(wrapper_t *w){
     }
   }
 }
+
+void PbContainer2::test(){
+  /* Test 1-3: discard_dirty */
+  {
+    std::stringstream rmm;
+    rmm << "forbidden L0 L0\n"
+        << "data\n"
+        << "  x = 0 : [0:1]\n"
+        << "process\n"
+        << "text\n"
+        << "L0: write: x := 1;\n"
+        << "L1: nop;\n"
+        << "L2: nop\n"
+        << "process\n"
+        << "text\n"
+        << "L0: write: x := 1;\n"
+        << "L1: nop;\n"
+        << "L2: nop\n";
+    Lexer lex(rmm);
+    Machine machine(Parser::p_test(lex));
+    TsoVar x(Lang::NML::global(0));
+    PbConstraint::Predicate *p0 =
+      new PbConstraint::Predicate(PbConstraint::Predicate::eq(PbConstraint::Term::argument(0),
+                                                              PbConstraint::Term::integer(0)));
+    PbConstraint::Common common(1,machine,PbConstraint::pred_set(1,p0),false);
+    PbContainer2 cont(machine);
+
+    /* A constraint with control states pcs, where the channel of
+     * process wpid contains a message to x (none if wpid < 0). */
+    std::function<PbConstraint*(std::vector<int>,int,bool)> pbc =
+      [&common](std::vector<int> pcs, int wpid, bool dirty){
+      std::vector<sharinglist<Lang::MemLoc<int> > > chans(2);
+      if(wpid >= 0) chans[wpid].push_back(Lang::MemLoc<int>::global(0));
+      return new PbConstraint(dirty,chans,pcs,std::list<TsoCycleLock>(),common);
+    };
+
+    PbConstraint *r = pbc({0,0},-1,false);
+    PbConstraint *a = pbc({1,0},0,false);  // saturated
+    PbConstraint *e1 = pbc({2,0},1,false); // saturated, subsumed by e2
+    e1->ap_list.push_back(PbConstraint::AppliedPredicate(p0,std::vector<TsoVar>(1,x)));
+    PbConstraint *e2 = pbc({2,0},1,false); // saturated
+    PbConstraint *b = pbc({0,1},-1,false); // not saturated
+    PbConstraint *d = pbc({1,1},0,true);
+    PbConstraint *f = pbc({0,2},-1,true);
+
+    cont.insert_root(r);
+    bool ok = cont.pop() == r;
+    cont.insert(r,0,a);
+    cont.insert(r,0,e1);
+    cont.insert(r,0,e2);
+    cont.insert(r,0,b);
+    cont.insert(r,0,d);
+    ok = ok && cont.pop() == a && cont.pop() == e2 && cont.pop() == b && cont.pop() == d;
+    cont.insert(d,0,f);
+    ok = ok && cont.F_size() == 7 && cont.Q_size() == 1;
+
+    cont.discard_dirty();
+
+    bool clean = true;
+    for(unsigned i = 0; i < cont.pcs_to_f.size(); i++){
+      for(auto it = cont.pcs_to_f[i].begin(); it != cont.pcs_to_f[i].end(); it++){
+        for(wrapper_t *w : it->second){
+          clean = clean && !w->constraint->dirty_bit;
+        }
+      }
+    }
+    Test::inner_test("discard_dirty drops dirty constraints",
+                     ok && clean && cont.F_size() == 5 &&
+                     cont.get_wrapper(r)->children.size() == 4 &&
+                     cont.pointer_in_f(a) && cont.pointer_in_f(b) &&
+                     cont.pointer_in_f(e1) && cont.pointer_in_f(e2));
+
+    Test::inner_test("discard_dirty requeues saturated constraints",
+                     cont.Q_size() == 2 && cont.pop() == a && cont.pop() == e2 &&
+                     cont.pop() == 0);
+
+    Test::inner_test("discard_dirty respects subsumption",
+                     e1->is_saturated() && e1->entailment_compare(*e2) == Constraint::GREATER &&
+                     !b->is_saturated());
+  }
+};
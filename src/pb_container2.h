@@ -45,7 +45,23 @@ public:
   virtual int Q_size() const { return q_size; };
   virtual int F_size() const { return f_size; };
   virtual Trace *clear_and_get_trace(Constraint *c);
+  virtual Trace *get_trace(Constraint *c);
   virtual void clear();
+  /* Prepares F and Q for resuming the analysis after the bound k of
+   * the Common object of the constraints has been increased.
+   *
+   * Deallocates and removes all dirty constraints from F and Q. The
+   * clean constraints are kept: they were derived without exceeding
+   * the bound and remain valid for a greater k. Q is set to contain
+   * the clean constraints that were in Q, together with the clean
+   * constraints whose pre-images depend on k (the saturated ones,
+   * see PbConstraint::is_saturated) unless they are subsumed by some
+   * other constraint in F.
+   *
+   * Must be called *before* k is increased.
+   */
+  void discard_dirty();
+  static void test();
 private:
   /* A constraint in F is kept in a wrapper. */
   struct wrapper_t{
@@ -44,6 +44,9 @@ std::string PDualChannelConstraint::Msg::to_short_string(const Common &common) c
   return ss.str();
 }
 
+PDualChannelConstraint::Msg::Msg(Store s, int pid, NMLSet ms, const Common &common)
+  : store(s), wpid(pid), nmls(ms), nml_mask(common.nml_mask(nmls)) {}
+
 int PDualChannelConstraint::Msg::compare(const Msg &msg) const{
   if(wpid < msg.wpid){
     return -1;
@@ -166,9 +169,9 @@ PDualChannelConstraint::PDualChannelConstraint(std::vector<int> pcs, const Commo
   }
   
   for(int ci=0; ci<pcs.size(); ci++) {
-    std::vector<Msg> chni;
+    Channel chni;
     if(ci==msg.wpid) {
-      chni.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls));
+      chni.push_back(Msg(Store(common.mem_size),msg.wpid,msg.nmls,common));
     }
     channels.push_back(chni);
   }
@@ -186,7 +189,7 @@ PDualChannelConstraint::PDualChannelConstraint(std::vector<int> pcs, Common &c)
   }
   
   for(int ci=0; ci<pcs.size(); ci++) {
-    std::vector<Msg> chni;
+    Channel chni;
     channels.push_back(chni);
   }
   mems.push_back(Store(common.mem_size));
@@ -313,16 +316,17 @@ void PDualChannelConstraint::process_to_string(int p, std::stringstream &ss) con
 // return number>=0 for newest element by own writing
 // return -2 for empty channel
 int PDualChannelConstraint::index_of_read(Lang::NML nml, int pid) const{
+  NMLMask::mask_t bit = common.nml_bit(nml);
   int i = channels[pid].size()-1;
   while(i>0) {
-    if(channels[pid][i].wpid == pid && channels[pid][i].nmls.count(nml)){
+    if(channels[pid][i].wpid == pid && channels[pid][i].writes(nml,bit)){
       return i;
     }
     i--;
   }
   
   if (channels[pid].size()>0) {
-    if(channels[pid][0].wpid == -1 && channels[pid][0].nmls.count(nml)!=0) {
+    if(channels[pid][0].wpid == -1 && channels[pid][0].writes(nml,bit)) {
       return -1;
     }
   }
@@ -600,7 +604,7 @@ Constraint::Comparison PDualChannelConstraint::entailment_compare_channels(const
                 }
                 if(dcc.channels[cand[ci]][j].wpid == ci) {
                   has_written_dcc.insert(dcc.channels[cand[ci]][j].nmls);
-                  if (dcc.channels[cand[ci]][j].nmls == channels[ci][i].nmls &&
+                  if (dcc.channels[cand[ci]][j].same_nmls(channels[ci][i]) &&
                       !Constraint::comb_comp(Constraint::LESS,channels[ci][i].entailment_compare(dcc.channels[cand[ci]][j])) )
                   {
                     found = 1;
@@ -621,7 +625,7 @@ Constraint::Comparison PDualChannelConstraint::entailment_compare_channels(const
                 if(j < i) return Constraint::INCOMPARABLE;
                 if(dcc.channels[cand[ci]][j].wpid == ci) has_written_dcc.insert(dcc.channels[cand[ci]][j].nmls);
 
-                if (dcc.channels[cand[ci]][j].nmls == channels[ci][i].nmls && dcc.channels[cand[ci]][j].wpid == channels[ci][i].wpid &&
+                if (dcc.channels[cand[ci]][j].same_nmls(channels[ci][i]) && dcc.channels[cand[ci]][j].wpid == channels[ci][i].wpid &&
                     !Constraint::comb_comp(Constraint::LESS,channels[ci][i].entailment_compare(dcc.channels[cand[ci]][j])) ) {
                   found = 1;
                   j--;
@@ -679,7 +683,7 @@ Constraint::Comparison PDualChannelConstraint::entailment_compare_channels(const
                 }
                 if(channels[cand[ci]][i].wpid == ci) {
                   has_written_this.insert(channels[cand[ci]][i].nmls);
-                  if (channels[cand[ci]][i].nmls == dcc.channels[ci][j].nmls &&
+                  if (channels[cand[ci]][i].same_nmls(dcc.channels[ci][j]) &&
                       !Constraint::comb_comp(Constraint::LESS,dcc.channels[ci][j].entailment_compare(channels[cand[ci]][i])) )
                   {
                     found = 1;
@@ -700,7 +704,7 @@ Constraint::Comparison PDualChannelConstraint::entailment_compare_channels(const
                 if(i < j) return Constraint::INCOMPARABLE;
                 if(channels[cand[ci]][i].wpid == ci) has_written_this.insert(channels[cand[ci]][i].nmls);
 
-                if (channels[cand[ci]][i].nmls == dcc.channels[ci][j].nmls && channels[cand[ci]][i].wpid == dcc.channels[ci][j].wpid &&
+                if (channels[cand[ci]][i].same_nmls(dcc.channels[ci][j]) && channels[cand[ci]][i].wpid == dcc.channels[ci][j].wpid &&
                     !Constraint::comb_comp(Constraint::LESS,dcc.channels[ci][j].entailment_compare(channels[cand[ci]][i])) ) {
                   found = 1;
                   i--;
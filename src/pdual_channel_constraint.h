@@ -22,7 +22,10 @@
 #define __PDUAL_CHANNEL_CONSTRAINT_H__
 
 #include "constraint.h"
+#include "cowvector.h"
 #include "machine.h"
+#include "nml_mask.h"
+#include "smallvector.h"
 #include "vecset.h"
 #include "dual_zstar.h"
 
@@ -36,16 +39,36 @@ private:
     typedef DualZStar<int>::Vector Store;
     
 protected:
+    /* A set of written memory locations. A message nearly always
+     * carries one or two memory locations, which are then stored
+     * inside the message itself. */
+    typedef VecSet<Lang::NML,SmallVector<Lang::NML,2> > NMLSet;
+
     /* The class of PDUAL channel messages. */
     class Msg{
     public:
-        Msg(Store s, int pid, VecSet<Lang::NML> ms)
-        : store(s), wpid(pid), nmls(ms) {};
+        /* The mask of the message is computed using the memory
+         * location indices of common. */
+        Msg(Store s, int pid, NMLSet ms, const Common &common);
         
         Store store;
         int wpid;      // The pid of the process that wrote
         /* A distinct, sorted vector of all the written memory locations. */
-        VecSet<Lang::NML> nmls;
+        NMLSet nmls;
+        /* The NMLMask of nmls. */
+        NMLMask::mask_t nml_mask;
+        /* Returns true iff nml is in nmls.
+         *
+         * bit should be Common::nml_bit(nml).
+         */
+        bool writes(const Lang::NML &nml, NMLMask::mask_t bit) const{
+            return NMLMask::may_contain(nml_mask,bit) && nmls.count(nml);
+        };
+        /* Returns true iff this message and msg have written the
+         * same memory locations. */
+        bool same_nmls(const Msg &msg) const{
+            return nml_mask == msg.nml_mask && nmls == msg.nmls;
+        };
         std::string to_short_string(const Common &common) const;
         /* A total order on messages */
         int compare(const Msg &) const;
@@ -56,14 +79,17 @@ protected:
         bool operator!=(const Msg &msg) const { return compare(msg) != 0; };
         bool operator>=(const Msg &msg) const { return compare(msg) >= 0; };
         Constraint::Comparison entailment_compare(const Msg &msg) const{
-            if(wpid != msg.wpid || nmls != msg.nmls){
+            if(wpid != msg.wpid || !same_nmls(msg)){
                 return Constraint::INCOMPARABLE;
             }else{
                 return store.entailment_compare(msg.store);
             }
         };
     };
-    
+
+    /* A channel. Copies of a channel share their messages. */
+    typedef cowvector<Msg> Channel;
+
 public:
     class Common : public Constraint::Common{
     public:
@@ -95,6 +121,15 @@ public:
                 return gvar_count + nml.get_owner()*max_lvar_count + nml.get_id();
             }
         };
+        // The bit of nml in an NMLMask
+        NMLMask::mask_t nml_bit(const Lang::NML &nml) const{
+            return NMLMask::bit(index(nml));
+        };
+        // The NMLMask of the memory locations in s
+        template<class C>
+        NMLMask::mask_t nml_mask(const VecSet<Lang::NML,C> &s) const{
+            return NMLMask::of(s.begin(),s.end(),[this](const Lang::NML &nml){ return index(nml); });
+        };
         // reg_count[pid] is the number of registers of process pid
         std::vector<int> reg_count;
         
@@ -217,7 +252,7 @@ protected:
     /* The PDUAL channels
      *
      * Messages at lower indices are older. */
-    std::vector<std::vector<Msg>> channels;
+    std::vector<Channel> channels;
     
     std::vector<Store> mems;
     
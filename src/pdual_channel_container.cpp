@@ -19,6 +19,7 @@
  */
 
 #include "pdual_channel_container.h"
+#include "stats.h"
 
 const bool PDualChannelContainer::print_every_state_on_clear = false;
 const bool PDualChannelContainer::use_genealogy = false;
@@ -57,7 +58,12 @@ bool PDualChannelContainer::insert(CWrapper *cw){
    * the existing constraints */
   for(unsigned i = 0; i < v.size(); ++i){
     assert(v[i]->valid);
-    switch(cw->sbc->entailment_compare(*v[i]->sbc)){
+    Constraint::Comparison cmp;
+    {
+      Stats::Probe probe(Stats::ENTAILMENT_COMPARE);
+      cmp = cw->sbc->entailment_compare(*v[i]->sbc);
+    }
+    switch(cmp){
     case Constraint::LESS:
       /* The new constraint subsumes an old one. */
       invalidate(v[i],&v);
@@ -66,6 +72,7 @@ bool PDualChannelContainer::insert(CWrapper *cw){
     case Constraint::GREATER: case Constraint::EQUAL:
       /* The new constraint is subsumed by an old one. */
       Log::extreme << " *** Smaller state \n" << (*v[i]->sbc).to_string() << "***\n";
+      ++counters.subsumed;
       delete cw;
       return false;
     case Constraint::INCOMPARABLE:
@@ -77,6 +84,7 @@ bool PDualChannelContainer::insert(CWrapper *cw){
   v.push_back(cw);
   update_longest_comparable_array(v);
   update_longest_channel(cw->sbc->get_weight());
+  counters.max_weight = std::max(counters.max_weight,cw->sbc->get_weight());
   ptr_to_F[cw->sbc] = cw;
   cw->Q_ticket = Q.push(cw);
   ++q_size;
@@ -85,6 +93,8 @@ bool PDualChannelContainer::insert(CWrapper *cw){
 };
 
 void PDualChannelContainer::invalidate(CWrapper *cw, std::vector<CWrapper*> *Fv){
+  Stats::Probe probe(Stats::INVALIDATE);
+  ++counters.invalidated;
   if(Fv == 0){
     Fv = &get_F_set(cw);
   }
@@ -422,7 +422,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
       if(ok_nmls){
         PDualConstraint *sbc = new PDualConstraint(*this);
         sbc->pcs[proc] = t.source;
-        std::vector<Msg> ch0(sbc->channels[proc]);
+        Channel ch0(sbc->channels[proc]);
         ch0.pop_back();
         sbc->channels[proc] = ch0;
         if (relation == 1) { // set mems[0][nmli]
@@ -449,7 +449,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
         PDualConstraint *sbc = new PDualConstraint(*this);
         sbc->pcs.push_back(t.target);
         sbc->ptypes.push_back(t.pid);
-        std::vector<Msg> ch0;
+        Channel ch0;
         sbc->channels.push_back(ch0);
         Store reg_stores_proc =  Store(common.reg_count[t.pid]);
         sbc->reg_stores.push_back(reg_stores_proc);
@@ -467,9 +467,10 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
     case Lang::DELETEE:
     {      
       Lang::NML nml(s.get_memloc(),proc);
+      NMLMask::mask_t bit = common.nml_bit(nml);
       bool own_exist = false;
       for (int mi = 0; mi < channels[proc].size(); mi++) {
-        if (channels[proc][mi].nmls.count(nml)!=0 && channels[proc][mi].wpid == proc) {
+        if (channels[proc][mi].writes(nml,bit) && channels[proc][mi].wpid == proc) {
           own_exist = true;
           break;
         }
@@ -481,7 +482,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
         
         if (t.pid==s.get_writer()) { //insert an own message
           PDualConstraint *sbc = new PDualConstraint(*this);
-          Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml));
+          Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml),common);
           sbc->channels[proc].insert(sbc->channels[proc].begin(), msg);
           res.push_back(sbc);
         }
@@ -568,10 +569,10 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
               sbc->reg_stores[proc] = correct_val_regss[vri];
               
               if(msgi==-1) { // restrict mem
-                sbc->channels[proc][0].store = sbc->channels[proc][0].store.assign(0,val_es[vei]);
+                sbc->channels[proc].modify(0).store = sbc->channels[proc][0].store.assign(0,val_es[vei]);
                 res.push_back(sbc);
               } else if (msgi>=0){
-                sbc->channels[proc][msgi].store = sbc->channels[proc][msgi].store.assign(0,val_es[vei]);
+                sbc->channels[proc].modify(msgi).store = sbc->channels[proc][msgi].store.assign(0,val_es[vei]);
                 res.push_back(sbc);
               } else if (sbc->channels[t.pid].size()==0) { //only for an empty channel
                 sbc->mems[0] = sbc->mems[0].assign(nmli,val_es[vei]);
@@ -611,7 +612,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
             sbc->pcs[proc] = t.source;
             sbc->reg_stores[proc] = correct_val_regss[vri];
 
-            Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml));
+            Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml),common);
             if (sbc->channels[proc].size()>0) {
               sbc->channels[proc].insert(sbc->channels[proc].begin(),msg);
             } else {
@@ -662,10 +663,10 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
 
           if (is_star) { // restrict mem
             if(msgi==-1) {
-              sbc->channels[proc][0].store = sbc->channels[proc][0].store.assign(0,reg_val);
+              sbc->channels[proc].modify(0).store = sbc->channels[proc][0].store.assign(0,reg_val);
               res.push_back(sbc);
             } else if (msgi>=0){
-              sbc->channels[proc][msgi].store = sbc->channels[proc][msgi].store.assign(0,reg_val);
+              sbc->channels[proc].modify(msgi).store = sbc->channels[proc][msgi].store.assign(0,reg_val);
               res.push_back(sbc);
             } else if (sbc->channels[t.pid].size()==0) { //only for an empty channel
               sbc->mems[0] = sbc->mems[0].assign(nmli,reg_val);
@@ -687,7 +688,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
           sbc->pcs[proc] = t.source;
           sbc->reg_stores[proc] = sbc->reg_stores[proc].assign(s.get_reg(), value_t::STAR);
 
-          Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml));
+          Msg msg(st,-1,VecSet<Lang::NML>::singleton(nml),common);
           if (sbc->channels[proc].size()>0) {
             sbc->channels[proc].insert(sbc->channels[proc].begin(),msg);
           } else {
@@ -783,7 +784,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
               sbc->mems[0] = new_mem;
             
               if(!locked) {
-                std::vector<Msg> ch0(sbc->channels[proc]);
+                Channel ch0(sbc->channels[proc]);
                 assert(ch0.size());
                 ch0.pop_back();
                 sbc->channels[proc] = ch0;
@@ -798,14 +799,14 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
                 v.push_back(value_t::STAR);
                 Store st = Store(v);
                 
-                Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml));
+                Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml),common);
                 
                 //insert to the end of the channels
                 PDualConstraint *sbc = new PDualConstraint(*this);
                 sbc->pcs[proc] = t.source;
                 sbc->mems[0] = new_mem;
               
-                std::vector<Msg> ch0(channels[proc]);
+                Channel ch0(channels[proc]);
                 ch0.pop_back();
                 ch0.push_back(msg);
                 sbc->channels[proc] = ch0;
@@ -820,7 +821,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
                     PDualConstraint *sbc = new PDualConstraint(*this);
                     sbc->pcs[proc] = t.source;
                     
-                    std::vector<Msg> ch0(channels[proc]);
+                    Channel ch0(channels[proc]);
                     ch0.pop_back();
                     ch0.insert(ch0.begin()+it, msg);
                     sbc->mems[0] = new_mem;
@@ -859,7 +860,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
               if(!locked) {
                 assert(channels[proc].size());
 
-                std::vector<Msg> ch0(sbc->channels[proc]);
+                Channel ch0(sbc->channels[proc]);
                 assert(ch0.size()>0);
                 ch0.pop_back();
                 sbc->channels[proc] = ch0;
@@ -872,7 +873,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
                 v.push_back(value_t::STAR);
                 Store st = Store(v);
                 
-                Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml));
+                Msg msg(st,proc,VecSet<Lang::NML>::singleton(nml),common);
                 
                 //insert to the end of the channels
                 PDualConstraint *sbc = new PDualConstraint(*this);
@@ -880,7 +881,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
                 sbc->mems[0] = new_mem;
                 sbc->reg_stores[proc] = correct_rstores[rssi];
               
-                std::vector<Msg> ch0(channels[proc]);
+                Channel ch0(channels[proc]);
                 ch0.push_back(msg);
                 sbc->channels[proc] = ch0;
                 
@@ -894,7 +895,7 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
                     PDualConstraint *sbc = new PDualConstraint(*this);
                     sbc->pcs[proc] = t.source;
                     
-                    std::vector<Msg> ch0(channels[proc]);
+                    Channel ch0(channels[proc]);
                     ch0.pop_back();
                     ch0.insert(ch0.begin()+it, msg);
                     sbc->reg_stores[proc] = correct_rstores[rssi];
@@ -940,8 +941,8 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
         
           Store new_mem = mems[0].assign(nmli,value_t::STAR);
           std::vector<Lang::NML> pnmls = common.nmls_by_proc[t.pid];
-          std::vector<Msg> empty_chn;
-          std::vector<std::vector<Msg>> chns;
+          Channel empty_chn;
+          std::vector<Channel> chns;
           chns.push_back(empty_chn);
           
           if (!locked) { // generating all possible sequences in the new channel
@@ -949,11 +950,11 @@ std::list<PDualConstraint::pre_constr_t> PDualConstraint::pre(const Machine::PTr
               std::vector<value_t> v;
               v.push_back(value_t::STAR);
               Store st = Store(v);
-              Msg msg(st,proc,VecSet<Lang::NML>::singleton(pnmls[pnmli]));
+              Msg msg(st,proc,VecSet<Lang::NML>::singleton(pnmls[pnmli]),common);
               
               int size = chns.size();
               for (int chni=0; chni<size; chni++) {
-                std::vector<Msg> chn = chns[chni];
+                Channel chn = chns[chni];
                 chn.push_back(msg);
                 chns.push_back(chn);
               }
@@ -1233,7 +1234,7 @@ void PDualConstraint::test_pre(){
    PDualConstraint sbc(pcs,common.messages[0],common);
    Machine::PTransition t(0,Lang::Stmt<int>::write(Lang::MemLoc<int>::global(0),
                                                    Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
    sbc.channels[0].push_back(msg);
    sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
 
@@ -1253,7 +1254,7 @@ void PDualConstraint::test_pre(){
    PDualConstraint sbc(pcs,common.messages[0],common);
    Machine::PTransition t(0,Lang::Stmt<int>::write(Lang::MemLoc<int>::global(0),
                                                    Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(1)));
+   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(1)),common);
    sbc.channels[0].push_back(msg);
    sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
 
@@ -1273,7 +1274,7 @@ void PDualConstraint::test_pre(){
    PDualConstraint sbc(pcs,common.messages[0],common);
    Machine::PTransition t(0,Lang::Stmt<int>::locked_write(Lang::MemLoc<int>::global(0),
                                                           Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+   Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
    sbc.channels[0].push_back(msg);
    sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
    std::cout << "Initial:\n" << sbc.to_string() << "\n";
@@ -1342,7 +1343,7 @@ void PDualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       PDualConstraint sbc0(pcs,common);
       PDualConstraint sbc1(pcs,common);
-      Msg msg0(Store(6),0,us);
+      Msg msg0(Store(6),0,us,common);
       //Msg msg1(Store(6),1,us);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg0);
@@ -1360,14 +1361,14 @@ void PDualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       PDualConstraint sbc0(pcs,common);
       PDualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc1.channels[0][1].wpid = 1;
+      sbc1.channels[0].modify(1).wpid = 1;
       test("Test2a",sbc0.entailment_compare(sbc1) != Constraint::EQUAL);
       test("Test2b",sbc1.entailment_compare(sbc0) != Constraint::EQUAL);
       test("Test2c",sbc0.characterize_channel(0) == sbc1.characterize_channel(0));
@@ -1379,7 +1380,7 @@ void PDualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       PDualConstraint sbc0(pcs,common);
       PDualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
@@ -1397,15 +1398,15 @@ void PDualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       PDualConstraint sbc0(pcs,common);
       PDualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc0.channels[0][0].store = sbc0.channels[0][0].store.assign(0,0);
-      sbc1.channels[0][0].store = sbc1.channels[0][0].store.assign(0,0).assign(1,1);
+      sbc0.channels[0].modify(0).store = sbc0.channels[0][0].store.assign(0,0);
+      sbc1.channels[0].modify(0).store = sbc1.channels[0][0].store.assign(0,0).assign(1,1);
       test("Test4a",sbc0.entailment_compare(sbc1) == Constraint::LESS);
       test("Test4b",sbc1.entailment_compare(sbc0) == Constraint::GREATER);
       test("Test4c",sbc0.characterize_channel(0) == sbc1.characterize_channel(0));
@@ -1417,15 +1418,15 @@ void PDualConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       PDualConstraint sbc0(pcs,common);
       PDualConstraint sbc1(pcs,common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channels[0].clear(); sbc1.channels[0].clear();
       sbc0.channels[0].push_back(msg);
       sbc0.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
       sbc1.channels[0].push_back(msg);
-      sbc0.channels[0][0].store = sbc0.channels[0][0].store.assign(0,0).assign(1,1);
-      sbc1.channels[0][0].store = sbc1.channels[0][0].store.assign(0,0);
+      sbc0.channels[0].modify(0).store = sbc0.channels[0][0].store.assign(0,0).assign(1,1);
+      sbc1.channels[0].modify(0).store = sbc1.channels[0][0].store.assign(0,0);
       test("Test5a",sbc0.entailment_compare(sbc1) == Constraint::INCOMPARABLE);
       test("Test5b",sbc1.entailment_compare(sbc0) == Constraint::INCOMPARABLE);
       test("Test5c",sbc0.characterize_channel(0) == sbc1.characterize_channel(0));
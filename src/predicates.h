@@ -255,6 +255,7 @@ namespace Predicates {
     Predicate(const SyntaxString<Var> &ss) : SyntaxString<Var>(ss) {};
     template<class V> friend class AppliedPredicate;
     template<class V> friend class Predicate;
+    friend class ::MachineImage;
   };
 
   template<class Var> inline Predicate<Var> operator&&(const Predicate<Var> &a, const Predicate<Var> &b){
@@ -292,9 +293,18 @@ namespace Predicates {
      * an argument in this applied predicate.
      */
     void translate_args(std::function<Var(const Var&)> &t);
+    /* The sorted ids of get_variables() under a numbering chosen by
+     * the user of this applied predicate, or null if the user has
+     * not set them. Copies share the ids. translate_args resets them
+     * to null. The ids are not compared by == or <.
+     */
+    const std::vector<int> *get_var_ids() const throw() { return var_ids; };
+    /* Pre: ids outlives this applied predicate and all its copies. */
+    void set_var_ids(const std::vector<int> *ids) throw() { var_ids = ids; };
   private:
     const Predicate<Var>  *pred; // Not owned
     std::vector<Var> argv;
+    const std::vector<int> *var_ids; // Not owned
   };
 
 };
@@ -91,7 +91,7 @@ namespace Predicates{
 
   template<class Var> AppliedPredicate<Var>::AppliedPredicate(const Predicate<Var> *p, const std::vector<Var> &av) 
     throw(ArgcError*) :
-    pred(p), argv(av) {
+    pred(p), argv(av), var_ids(0) {
     if(pred->get_argc() != int(argv.size()))
       throw new ArgcError();
   }
@@ -99,6 +99,7 @@ namespace Predicates{
   template<class Var> void AppliedPredicate<Var>::translate_args(std::function<Var(const Var&)> &t){
     for(unsigned i = 0; i < argv.size(); i++)
       argv[i] = t(argv[i]);
+    var_ids = 0;
   }
 
   template<class Var> bool AppliedPredicate<Var>::operator==(const AppliedPredicate<Var> &ap) const throw(){
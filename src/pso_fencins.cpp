@@ -45,6 +45,8 @@ namespace PsoFencins{
                         [&fs](const FenceSet &fs2){ return fs.includes(fs2); }) != end;
   }
 
+  std::string failure_reason;
+
   std::list<FenceSet> fencins(const Machine &m, Reachability &r,
                               TsoFencins::reach_arg_init_t reach_arg_init,
                               bool only_one){
@@ -52,6 +54,7 @@ namespace PsoFencins{
     std::list<FenceSet> queue;
     queue.push_back(FenceSet(m));
     std::list<FenceSet> complete;
+    failure_reason = "";
 
     Reachability::Result *result = 0;
     while(!queue.empty()){
@@ -106,7 +109,11 @@ namespace PsoFencins{
         }
         break;
       case Reachability::FAILURE:
-        throw new std::logic_error("TsoFencins::fencins: FAILURE in underlying reachability analysis.");
+        /* Stop, and return the fence sets found so far */
+        failure_reason = result->failure_reason.size() ? result->failure_reason : "analysis failed";
+        Log::msg << "Reachability analysis failed (" << failure_reason << "). Stopping.\n";
+        queue.clear();
+        continue;
       }
       queue.pop_front();
     }
@@ -116,6 +116,8 @@ namespace PsoFencins{
     std::set<Machine::PTransition> slocks, mlocks;
   };
 
+  /* Same as TsoFencins::failure_reason, for PsoFencins::fencins. */
+  extern std::string failure_reason;
   std::list<FenceSet> fencins(const Machine &m, Reachability &r,
                               TsoFencins::reach_arg_init_t reach_arg_init,
                               bool only_one);
@@ -31,7 +31,9 @@ std::string Reachability::Result::to_string() const{
   switch(result){
   case REACHABLE: reach = "Yes"; break;
   case UNREACHABLE: reach = "No"; break;
-  case FAILURE: reach = "(Failure)"; break;
+  case FAILURE:
+    reach = failure_reason.empty() ? "(Failure)" : "(Failure: " + failure_reason + ")";
+    break;
   }
   ss << "Reachability analysis results:\n" 
      << "  Reachable:             " << reach << "\n"
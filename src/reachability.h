@@ -25,6 +25,8 @@
 #include "machine.h"
 #include "timer.h"
 
+class Budget;
+
 /* Reachability is an abstract class that should be inherited by
  * classes implementing reachability analysis.
  */
@@ -51,6 +53,9 @@ public:
     };
     /* The outcome */
     result_t result;
+    /* In case result == FAILURE, a human-readable explanation of the
+     * failure. May be empty. */
+    std::string failure_reason;
     /* In case result == REACHABLE, trace will contain a witnessing
      * trace.
      *
@@ -75,10 +80,13 @@ public:
    */
   class Arg{
   public:
-    Arg(const Machine &m) : machine(m) {};
+    Arg(const Machine &m) : machine(m), budget(0) {};
     virtual ~Arg(){};
     /* The machine that should be analysed. */
     const Machine &machine;
+    /* If non-null, the analysis is charged to budget instead of to a
+     * Budget of its own. Not owned. */
+    Budget *budget;
   };
 
   /* Performs the reachability analysis on the problem defined by arg.
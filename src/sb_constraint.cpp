@@ -103,6 +103,9 @@ SbConstraint::Common::Common(const Machine &m)
     transitions_by_pc[all_transitions[i].pid][all_transitions[i].target].push_back(&all_transitions[i]);
   }
 
+  /* Lower all transitions */
+  codes.init(all_transitions,[this](const Lang::NML &nml){ return index(nml); },mem_size);
+
   /* Setup last_msgs */
   for(unsigned p = 0; p < machine.automata.size(); ++p){
   Log::extreme << "Last messages:\n";
@@ -111,7 +114,7 @@ SbConstraint::Common::Common(const Machine &m)
     can_have_pending.push_back(std::vector<bool>(machine.automata[p].get_states().size(),false));
   }
   /* Make sure the dummy message is available at the start control state */
-  last_msgs[0][0].insert(Msg(Store(mem_size),0,VecSet<Lang::NML>()));
+  last_msgs[0][0].insert(Msg(Store(mem_size),0,VecSet<Lang::NML>(),*this));
   for(unsigned p = 0; p < machine.automata.size(); ++p){
     /* Populate */
     const std::vector<Automaton::State> &states = machine.automata[p].get_states();
@@ -125,7 +128,7 @@ SbConstraint::Common::Common(const Machine &m)
             for(int j = 0; j < wit->size(); ++j){
               S.insert(Lang::NML((*wit)[j],p));
             }
-            last_msgs[p][i].insert(Msg(store_of_write(Machine::PTransition(**it,p)),p,S));
+            last_msgs[p][i].insert(Msg(store_of_write(Machine::PTransition(**it,p)),p,S,*this));
             if(!(*it)->instruction.is_fence()){
               can_have_pending[p][i] = true;
             }
@@ -168,12 +171,12 @@ SbConstraint::Common::Common(const Machine &m)
   /* Setup last_msgs_vec */
   for(unsigned p = 0; p < machine.automata.size(); ++p){
     const std::vector<Automaton::State> &states = machine.automata[p].get_states();
-    last_msgs_vec.push_back(std::vector<VecSet<std::vector<Msg> > >(states.size(),
-                                                                    VecSet<std::vector<Msg> >::singleton(std::vector<Msg>())));
+    last_msgs_vec.push_back(std::vector<VecSet<Channel> >(states.size(),
+                                                          VecSet<Channel>::singleton(Channel())));
     if(p == 0){
       /* Add dummy message */
-      std::vector<Msg> v;
-      v.push_back(Msg(Store(mem_size),0,VecSet<Lang::NML>()));
+      Channel v;
+      v.push_back(Msg(Store(mem_size),0,VecSet<Lang::NML>(),*this));
       last_msgs_vec[0][0].insert(v);
     }
     bool changed = true;
@@ -182,8 +185,8 @@ SbConstraint::Common::Common(const Machine &m)
       for(unsigned i = 0; i < states.size(); ++i){
         for(auto trit = states[i].bwd_transitions.begin(); trit != states[i].bwd_transitions.end(); ++trit){
           int src = (*trit)->source;
-          VecSet<std::vector<Msg> > old_set = last_msgs_vec[p][i];
-          VecSet<std::vector<Msg> > new_set = last_msgs_vec[p][i];
+          VecSet<Channel> old_set = last_msgs_vec[p][i];
+          VecSet<Channel> new_set = last_msgs_vec[p][i];
           if((*trit)->instruction.get_writes().size()){
             VecSet<VecSet<Lang::MemLoc<int> > > wsets = (*trit)->instruction.get_write_sets();
             for(auto wsit = wsets.begin(); wsit != wsets.end(); ++wsit){
@@ -194,17 +197,14 @@ SbConstraint::Common::Common(const Machine &m)
               /* Modify all old channels */
               for(auto vit = last_msgs_vec[p][src].begin(); vit != last_msgs_vec[p][src].end(); ++vit){
                 /* Add new message */
-                std::vector<Msg> v = *vit;
-                v.push_back(Msg(store_of_write(Machine::PTransition(**trit,p)),p,nmls));
+                Channel v = *vit;
+                v.push_back(Msg(store_of_write(Machine::PTransition(**trit,p)),p,nmls,*this));
                 /* Remove messages that are no longer rightmost */
                 VecSet<Lang::NML> covered = nmls;
                 for(int j = int(v.size())-2; j >= 0; --j){
                   if(v[j].nmls.size() > 0 && v[j].nmls.subset_of(covered)){
                     /* remove v[j] */
-                    for(int k = j; k < int(v.size())-1; ++k){
-                      v[k] = v[k+1];
-                    }
-                    v.resize(int(v.size())-1,v[0]); // Note: v[0] is just to make gcc happy, it will not be copied
+                    v.erase(v.begin()+j);
                   }else{
                     covered.insert(v[j].nmls);
                   }
@@ -254,8 +254,8 @@ SbConstraint::Common::Common(const Machine &m)
   }
 };
 
-template<class T>
-bool SbConstraint::Common::vector_is_suffix(const std::vector<T> &a, const std::vector<T> &b) const{
+template<class V>
+bool SbConstraint::Common::vector_is_suffix(const V &a, const V &b) const{
   if(a.size() > b.size()){
     return false;
   }
@@ -552,7 +552,7 @@ void SbConstraint::test_pre(){
     SbConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::write(Lang::MemLoc<int>::global(0),
                                                     Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-    Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channel.push_back(msg);
     sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
 
@@ -572,7 +572,7 @@ void SbConstraint::test_pre(){
     SbConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::locked_write(Lang::MemLoc<int>::global(0),
                                                            Lang::Expr<int>::reg(0) + Lang::Expr<int>::reg(1)),1,0);
-    Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(3),0,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channel.push_back(msg);
     sbc.reg_stores[0] = sbc.reg_stores[0].assign(0,0).assign(1,10);
     sbc.cpointers[0] = 1;
@@ -592,8 +592,8 @@ void SbConstraint::test_pre(){
     pcs.push_back(1); pcs.push_back(3);
     SbConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::update(1,VecSet<Lang::MemLoc<int> >::singleton(Lang::MemLoc<int>::global(0))),1,0);
-    sbc.channel[0].wpid = 1;
-    sbc.channel[0].nmls = VecSet<Lang::NML>::singleton(Lang::NML::global(0));
+    sbc.channel.modify(0).wpid = 1;
+    sbc.channel.modify(0).nmls = VecSet<Lang::NML>::singleton(Lang::NML::global(0));
     std::cout << "Initial:\n" << sbc.to_string() << "\n";
     std::list<Constraint*> res = sbc.pre(t);
     std::cout << "Pre:\n";
@@ -609,7 +609,7 @@ void SbConstraint::test_pre(){
     pcs.push_back(1); pcs.push_back(3);
     SbConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::update(1,VecSet<Lang::MemLoc<int> >::singleton(Lang::MemLoc<int>::global(0))),1,0);
-    Msg msg(Store(3),1,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(3),1,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channel.push_back(msg);
     sbc.cpointers[0] = 1;
     std::cout << "Initial:\n" << sbc.to_string() << "\n";
@@ -627,7 +627,7 @@ void SbConstraint::test_pre(){
     pcs.push_back(1); pcs.push_back(3);
     SbConstraint sbc(pcs,common.messages[0],common);
     Machine::PTransition t(0,Lang::Stmt<int>::update(1,VecSet<Lang::MemLoc<int> >::singleton(Lang::MemLoc<int>::global(1))),1,0);
-    Msg msg(Store(3),1,VecSet<Lang::NML>::singleton(Lang::NML::global(0)));
+    Msg msg(Store(3),1,VecSet<Lang::NML>::singleton(Lang::NML::global(0)),common);
     sbc.channel.push_back(msg);
     sbc.cpointers[0] = 1;
     std::cout << "Initial:\n" << sbc.to_string() << "\n";
@@ -641,14 +641,15 @@ void SbConstraint::test_pre(){
   
 };
 
-std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransition &t, bool locked) const{
+std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const TransitionCode &c, bool locked) const{
   std::list<pre_constr_t> res;
+  const Machine::PTransition &t = c.transition;
   const Lang::Stmt<int> &s = t.instruction;
   if(pcs[t.pid] != t.target){
     return res;
   }
 
-  switch(s.get_type()){
+  switch(c.op){
   case Lang::NOP:
     {
       SbConstraint *sbc = new SbConstraint(*this);
@@ -675,8 +676,8 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
     }
   case Lang::READASSERT:
     {
-      Lang::NML nml(s.get_memloc(),t.pid);
-      int nmli = common.index(nml);
+      const Lang::NML &nml = c.nml;
+      int nmli = c.nmli;
       int msgi = index_of_read(nml,t.pid);
       VecSet<int> val_nml = possible_values(channel[msgi].store,nml);
       for(int i = 0; i < val_nml.size(); i++){
@@ -687,7 +688,7 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
         for(int j = 0; j < stores.size(); ++j){
           SbConstraint *sbc = new SbConstraint(*this);
           sbc->pcs[t.pid] = t.source;
-          sbc->channel[msgi].store = channel[msgi].store.assign(nmli,val_nml[i]);
+          sbc->channel.modify(msgi).store = channel[msgi].store.assign(nmli,val_nml[i]);
           sbc->reg_stores[t.pid] = stores[j];
           res.push_back(sbc);
         }
@@ -701,15 +702,15 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
         sbc->pcs[t.pid] = t.source;
         res.push_back(sbc);
       }else{
-        Lang::NML nml(s.get_memloc(),t.pid);
-        int nmli = common.index(nml);
+        const Lang::NML &nml = c.nml;
+        int nmli = c.nmli;
         int msgi = index_of_read(nml,t.pid);
         VecSet<int> val_nml = possible_values(channel[msgi].store,nml);
         if(val_nml.count(reg_stores[t.pid][s.get_reg()].get_int()) > 0){
           SbConstraint *sbc = new SbConstraint(*this);
           sbc->pcs[t.pid] = t.source;
           if(sbc->channel[msgi].store[nmli] == value_t::STAR){
-            sbc->channel[msgi].store = sbc->channel[msgi].store.assign(nmli,reg_stores[t.pid][s.get_reg()]);
+            sbc->channel.modify(msgi).store = sbc->channel[msgi].store.assign(nmli,reg_stores[t.pid][s.get_reg()]);
           }
           res.push_back(sbc);
         }
@@ -734,8 +735,8 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
       }
 
       if(ok_cpointers){
-        Lang::NML nml = Lang::NML(s.get_memloc(),t.pid);
-        int nmli = common.index(nml);
+        const Lang::NML &nml = c.nml;
+        int nmli = c.nmli;
         /* Check that the rightmost message in the channel matches the
          * write, and produce matching reg_stores */
         bool ok_nmls = true;
@@ -751,7 +752,7 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
             for(int regi = 0; regi < rstores.size(); ++regi){
               SbConstraint *sbc = new SbConstraint(*this);
               sbc->pcs[t.pid] = t.source;
-              sbc->channel.back().store = sbc->channel.back().store.assign(nmli,val_nml[vali]);
+              sbc->channel.modify(sbc->channel.size()-1).store = sbc->channel.back().store.assign(nmli,val_nml[vali]);
               sbc->reg_stores[t.pid] = rstores[regi];
               res.push_back(pre_constr_t(sbc,true,VecSet<Lang::NML>::singleton(nml)));
             }
@@ -765,11 +766,11 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
       assert(locked);
       std::vector<pre_constr_t> v;
       v.push_back(pre_constr_t(new SbConstraint(*this)));
-      for(int i = s.get_statement_count()-1; i >= 0; --i){
+      for(int i = int(c.children.size())-1; i >= 0; --i){
         std::vector<pre_constr_t> w;
-        Machine::PTransition t2(t.target,*s.get_statement(i),t.target,t.pid);
+        const TransitionCode &c2 = c.children[i];
         for(unsigned j = 0; j < v.size(); ++j){
-          std::list<pre_constr_t> l = v[j].sbc->pre(t2,locked);
+          std::list<pre_constr_t> l = v[j].sbc->pre(c2,locked);
           for(auto it = l.begin(); it != l.end(); ++it){
             it->pop_back = it->pop_back || v[j].pop_back;
             it->written_nmls.insert(v[j].written_nmls);
@@ -789,10 +790,9 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
     {
       /* Check if the locked block contains writes.
        * If so, it is fencing. */
-      if(s.get_writes().size() == 0 || cpointers[t.pid] == int(channel.size())-1){
-        for(int i = 0; i < s.get_statement_count(); ++i){
-          Machine::PTransition ti(t.source,*s.get_statement(i),t.target,t.pid);
-          std::list<pre_constr_t> v = pre(ti,true);
+      if(!c.has_writes() || cpointers[t.pid] == int(channel.size())-1){
+        for(const TransitionCode &ci : c.children){
+          std::list<pre_constr_t> v = pre(ci,true);
           res.insert(res.end(),v.begin(),v.end());
         }
       }
@@ -801,10 +801,7 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
   case Lang::UPDATE:
     {
       assert(!locked);
-      VecSet<Lang::NML> snmls;
-      for(unsigned i = 0; i < s.get_writes().size(); ++i){
-        snmls.insert(Lang::NML(s.get_writes()[i],t.pid));
-      }
+      const VecSet<Lang::NML> &snmls = c.write_nmls;
       /* Check that the message matches the update */
       if(channel[cpointers[t.pid]].wpid == s.get_writer() &&
          channel[cpointers[t.pid]].nmls == snmls){
@@ -812,7 +809,7 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
           /* Need to insert a fresh message */
           for(auto msgit = common.messages.begin(); msgit != common.messages.end(); ++msgit){
             SbConstraint *sbc = new SbConstraint(*this);
-            Msg msg(Store(common.mem_size),msgit->wpid,msgit->nmls);
+            Msg msg(Store(common.mem_size),msgit->wpid,msgit->nmls,common);
             sbc->channel.insert(sbc->channel.begin(),msg);
             for(unsigned p = 0; p < sbc->cpointers.size(); ++p){
               if(int(p) != t.pid){
@@ -850,7 +847,8 @@ std::list<SbConstraint::pre_constr_t> SbConstraint::pre(const Machine::PTransiti
 
 std::list<Constraint*> SbConstraint::pre(const Machine::PTransition &t) const{
   std::list<Constraint*> res;
-  std::list<SbConstraint::pre_constr_t> r = pre(t,false);
+  std::unique_ptr<TransitionCode> tmp;
+  std::list<SbConstraint::pre_constr_t> r = pre(common.codes.get(t,tmp),false);
   for(auto it = r.begin(); it != r.end(); ++it){
     if(it->pop_back){
       /* Check that all NMLs that are associated with the message really were written */
@@ -982,7 +980,7 @@ void SbConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       SbConstraint sbc0(pcs,common.messages[0],common);
       SbConstraint sbc1(pcs,common.messages[0],common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channel.clear(); sbc1.channel.clear();
       sbc0.channel.push_back(msg);
       sbc0.channel.push_back(msg);
@@ -1002,14 +1000,14 @@ void SbConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       SbConstraint sbc0(pcs,common.messages[0],common);
       SbConstraint sbc1(pcs,common.messages[0],common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channel.clear(); sbc1.channel.clear();
       sbc0.channel.push_back(msg);
       sbc0.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
-      sbc1.channel[1].wpid = 1;
+      sbc1.channel.modify(1).wpid = 1;
       sbc0.cpointers[0] = 0;
       sbc0.cpointers[1] = 1;
       sbc1.cpointers[0] = 0;
@@ -1023,7 +1021,7 @@ void SbConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       SbConstraint sbc0(pcs,common.messages[0],common);
       SbConstraint sbc1(pcs,common.messages[0],common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channel.clear(); sbc1.channel.clear();
       sbc0.channel.push_back(msg);
       sbc0.channel.push_back(msg);
@@ -1043,15 +1041,15 @@ void SbConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       SbConstraint sbc0(pcs,common.messages[0],common);
       SbConstraint sbc1(pcs,common.messages[0],common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channel.clear(); sbc1.channel.clear();
       sbc0.channel.push_back(msg);
       sbc0.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
-      sbc0.channel[0].store = sbc0.channel[0].store.assign(0,0);
-      sbc1.channel[0].store = sbc1.channel[0].store.assign(0,0).assign(1,1);
+      sbc0.channel.modify(0).store = sbc0.channel[0].store.assign(0,0);
+      sbc1.channel.modify(0).store = sbc1.channel[0].store.assign(0,0).assign(1,1);
       sbc0.cpointers[0] = 0;
       sbc0.cpointers[1] = 1;
       sbc1.cpointers[0] = 0;
@@ -1065,15 +1063,15 @@ void SbConstraint::test_comparison(){
       std::vector<int> pcs(2,0);
       SbConstraint sbc0(pcs,common.messages[0],common);
       SbConstraint sbc1(pcs,common.messages[0],common);
-      Msg msg(Store(6),0,us);
+      Msg msg(Store(6),0,us,common);
       sbc0.channel.clear(); sbc1.channel.clear();
       sbc0.channel.push_back(msg);
       sbc0.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
       sbc1.channel.push_back(msg);
-      sbc0.channel[0].store = sbc0.channel[0].store.assign(0,0).assign(1,1);
-      sbc1.channel[0].store = sbc1.channel[0].store.assign(0,0);
+      sbc0.channel.modify(0).store = sbc0.channel[0].store.assign(0,0).assign(1,1);
+      sbc1.channel.modify(0).store = sbc1.channel[0].store.assign(0,0);
       sbc0.cpointers[0] = 0;
       sbc0.cpointers[1] = 1;
       sbc1.cpointers[0] = 0;
@@ -1090,33 +1088,37 @@ void SbConstraint::test_comparison(){
   }
 };
 
-std::vector<SbConstraint::Msg> 
-SbConstraint::unify_last_msgs_vec(const std::vector<Msg> &channel, 
-                                  const std::vector<Msg> &lmv, int pid,
+SbConstraint::Channel 
+SbConstraint::unify_last_msgs_vec(const Channel &channel, 
+                                  const Channel &lmv, int pid,
                                   const Common &common,
                                   bool *unifiable){
-  std::vector<Msg> ch = channel;
+  Channel ch = channel;
   VecSet<Lang::NML> covered;
+  NMLMask::mask_t covered_mask = 0;
   int j = int(lmv.size())-1;
   for(int i = int(ch.size())-1; i >= 0; --i){
-    if(ch[i].wpid == pid && (ch[i].nmls.empty() || !ch[i].nmls.subset_of(covered))){
+    if(ch[i].wpid == pid && (ch[i].nmls.empty() ||
+                             !NMLMask::may_be_subset(ch[i].nml_mask,covered_mask) ||
+                             !ch[i].nmls.subset_of(covered))){
       // ch[i] is a last message for pid
       // or the dummy message
       if(j < 0){
         // There is no matching message in lmv
         *unifiable = false;
-        return std::vector<Msg>();
+        return Channel();
       }
-      if(lmv[j].wpid != pid || ch[i].nmls != lmv[j].nmls){
+      if(lmv[j].wpid != pid || !ch[i].same_nmls(lmv[j])){
         *unifiable = false;
-        return std::vector<Msg>();
+        return Channel();
       }
-      ch[i].store = ch[i].store.unify(lmv[j].store,unifiable);
+      ch.modify(i).store = ch[i].store.unify(lmv[j].store,unifiable);
       if(!*unifiable){
-        return std::vector<Msg>();
+        return Channel();
       }
       --j;
       covered.insert(ch[i].nmls);
+      covered_mask |= ch[i].nml_mask;
     }
   }
   
@@ -1126,7 +1128,7 @@ SbConstraint::unify_last_msgs_vec(const std::vector<Msg> &channel,
       bool ok = propagate_value_in_channel(&ch,*it,common.index(*it));
       if(!ok){
         *unifiable = false;
-        return std::vector<Msg>();
+        return Channel();
       }
     }
   }
@@ -1151,12 +1153,12 @@ bool SbConstraint::ok_channel(){
   }
   if(use_last_msgs_vec){
     for(unsigned p = 0; p < pcs.size(); ++p){
-      std::vector<Msg> new_channel;
+      Channel new_channel;
       int matching = 0;
       for(auto lmvit = common.last_msgs_vec[p][pcs[p]].begin();
           matching < 2 && lmvit != common.last_msgs_vec[p][pcs[p]].end(); ++lmvit){
         bool unifiable;
-        std::vector<Msg> ch = unify_last_msgs_vec(channel,*lmvit,p,common,&unifiable);
+        Channel ch = unify_last_msgs_vec(channel,*lmvit,p,common,&unifiable);
         if(unifiable){
           ++matching;
           new_channel = ch;
@@ -1180,7 +1182,7 @@ bool SbConstraint::ok_channel(){
         Store orig_store = channel[i].store;
         for(auto msgit = common.last_msgs[p][pcs[p]].begin();
             msgit != common.last_msgs[p][pcs[p]].end(); ++msgit){
-          if(msgit->nmls == channel[i].nmls){
+          if(msgit->same_nmls(channel[i])){
             bool unifiable;
             Store new_store = orig_store.unify(msgit->store,&unifiable);
             if(unifiable){
@@ -1188,9 +1190,9 @@ bool SbConstraint::ok_channel(){
                 /* Ambiguous match: there are more than one message in
                  * last_msgs that match this message. */
                 /* We cannot pick any one of them */
-                channel[i].store = orig_store;
+                channel.modify(i).store = orig_store;
               }else{
-                channel[i].store = new_store;
+                channel.modify(i).store = new_store;
                 match = true;
               }
             }
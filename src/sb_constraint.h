@@ -24,6 +24,7 @@
 #include "channel_constraint.h"
 #include "constraint.h"
 #include "machine.h"
+#include "transition_code.h"
 #include "vecset.h"
 #include "zstar.h"
 
@@ -57,6 +58,8 @@ public:
      * and has target state pc.
      */
     std::vector<std::vector<std::vector<const Machine::PTransition*> > > transitions_by_pc;
+    /* The lowered transitions of all_transitions */
+    TransitionTable codes;
 
     /* last_msgs[pid][s] is a set S of messages such that it is only
      * possible for process pid to be in a local state s and have the
@@ -66,7 +69,7 @@ public:
      * with m2.store.
      */
     std::vector<std::vector<VecSet<Msg> > > last_msgs;
-    std::vector<std::vector<VecSet<std::vector<Msg> > > > last_msgs_vec;
+    std::vector<std::vector<VecSet<Channel> > > last_msgs_vec;
     /* can_have_pending[pid][s] is true iff it is possible for process
      * pid to be at local state s and have a non-locked message in the
      * channel to the right of its cpointer. Equivalently iff process
@@ -78,9 +81,10 @@ public:
     friend class SbConstraint;
     friend class SbTsoBwd;
 
-    /* Returns true iff a is a suffix of b */
-    template<class T>
-    bool vector_is_suffix(const std::vector<T> &a, const std::vector<T> &b) const;
+    /* Returns true iff a is a suffix of b. V is a sequence type,
+     * such as std::vector or Channel. */
+    template<class V>
+    bool vector_is_suffix(const V &a, const V &b) const;
   };
   /* Constructs a constraint where process pid is at control state
    * pcs[pid], all registers and memory locations are unrestricted,
@@ -110,7 +114,7 @@ private:
     VecSet<Lang::NML> written_nmls; // NMLs that were written
   };
 
-  virtual std::list<pre_constr_t> pre(const Machine::PTransition &, bool locked) const;
+  virtual std::list<pre_constr_t> pre(const TransitionCode &, bool locked) const;
 
   /* Checks that the channel is possible according to
    * common.last_msgs. Will constrain the possible values in message
@@ -140,10 +144,10 @@ private:
    * This function is a helper to ok_channel when use_last_msgs_vec is
    * set.
    */
-  static std::vector<Msg> unify_last_msgs_vec(const std::vector<Msg> &channel,
-                                              const std::vector<Msg> &lmv, int pid,
-                                              const Common &common,
-                                              bool *unifiable);
+  static Channel unify_last_msgs_vec(const Channel &channel,
+                                     const Channel &lmv, int pid,
+                                     const Common &common,
+                                     bool *unifiable);
 
   friend class Common;
   friend class SbTsoBwd;
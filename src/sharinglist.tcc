@@ -18,6 +18,7 @@
  *
  */
 
+#include <atomic>
 #include <cassert>
 
 template<class T> class sharinglist<T>::consbox{
@@ -31,12 +32,12 @@ public:
   consbox *next;
   int *ptr_count; // Refers to next
 #ifndef NDEBUG
-  static int consbox_count;
+  static std::atomic<int> consbox_count;
 #endif
 };
 
 #ifndef NDEBUG
-template<class T> int sharinglist<T>::consbox::consbox_count = 0;
+template<class T> std::atomic<int> sharinglist<T>::consbox::consbox_count(0);
 #endif
 
 template<class T> sharinglist<T>::consbox::consbox(const T &v) : v(v) {
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SMALL_VECTOR_H__
+#define __SMALL_VECTOR_H__
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/* A SmallVector is a sequence with the same interface as a subset of
+ * std::vector, which keeps up to N elements in a buffer inside the
+ * object itself. Only when more than N elements are stored, the
+ * elements are moved to the heap.
+ *
+ * SmallVector is intended as storage for small containers that are
+ * created and copied in large numbers, such as the sets of written
+ * memory locations in channel messages (see VecSet), where it saves
+ * one heap allocation per container.
+ *
+ * T need not be default constructible.
+ */
+template<class T, int N> class SmallVector{
+public:
+  typedef T value_type;
+  typedef std::size_t size_type;
+  typedef T *iterator;
+  typedef const T *const_iterator;
+
+  SmallVector() : sz(0), cap(N), ptr(inline_buffer()) {};
+  template<typename ITER>
+  SmallVector(ITER begin, ITER end);
+  SmallVector(const SmallVector &);
+  SmallVector(SmallVector &&);
+  SmallVector &operator=(const SmallVector &);
+  SmallVector &operator=(SmallVector &&);
+  ~SmallVector();
+
+  size_type size() const { return sz; };
+  bool empty() const { return sz == 0; };
+  /* The number of elements that can be stored without reallocation. */
+  size_type capacity() const { return cap; };
+  /* Returns true iff the elements are stored in the inline buffer. */
+  bool is_inline() const { return ptr == inline_buffer(); };
+  T &operator[](size_type i) { return ptr[i]; };
+  const T &operator[](size_type i) const { return ptr[i]; };
+  T &back() { return ptr[sz-1]; };
+  const T &back() const { return ptr[sz-1]; };
+  iterator begin() { return ptr; };
+  iterator end() { return ptr+sz; };
+  const_iterator begin() const { return ptr; };
+  const_iterator end() const { return ptr+sz; };
+  void reserve(size_type n) { if(n > cap) grow(n); };
+  /* Appends a copy of t. t may be an element of this vector. */
+  void push_back(const T &t);
+  void pop_back() { ptr[--sz].~T(); };
+  /* Changes the size to n, appending copies of t if n is larger than
+   * the current size. */
+  void resize(size_type n, const T &t);
+  /* Removes all elements. The capacity is left unchanged. */
+  void clear();
+  bool operator==(const SmallVector &v) const;
+  bool operator!=(const SmallVector &v) const { return !(*this == v); };
+  bool operator<(const SmallVector &v) const;
+  bool operator>(const SmallVector &v) const { return v < *this; };
+  bool operator<=(const SmallVector &v) const { return !(v < *this); };
+  bool operator>=(const SmallVector &v) const { return !(*this < v); };
+
+  static void test();
+private:
+  /* Number of elements */
+  size_type sz;
+  /* Number of elements for which there is room at ptr */
+  size_type cap;
+  /* Points to the elements: either the inline buffer or an array
+   * allocated on the heap. */
+  T *ptr;
+  /* Room for N elements of type T. */
+  alignas(T) unsigned char buffer[N*sizeof(T)];
+
+  T *inline_buffer() { return reinterpret_cast<T*>(buffer); };
+  const T *inline_buffer() const { return reinterpret_cast<const T*>(buffer); };
+  /* Moves the elements into an array with room for n elements.
+   *
+   * Pre: n >= sz
+   */
+  void grow(size_type n);
+  /* Destroys all elements and releases heap memory. Leaves this
+   * vector empty and inline. */
+  void release();
+};
+
+#include "smallvector.tcc"
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2012 Carl Leonardsson
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "test.h"
+#include "vecset.h"
+
+#include <cassert>
+#include <vector>
+
+template<class T, int N>
+template<typename ITER>
+SmallVector<T,N>::SmallVector(ITER begin, ITER end)
+  : sz(0), cap(N), ptr(inline_buffer()) {
+  for(; begin != end; ++begin){
+    push_back(*begin);
+  }
+};
+
+template<class T, int N>
+SmallVector<T,N>::SmallVector(const SmallVector &v)
+  : sz(0), cap(N), ptr(inline_buffer()) {
+  reserve(v.sz);
+  for(size_type i = 0; i < v.sz; ++i){
+    new (ptr+i) T(v.ptr[i]);
+  }
+  sz = v.sz;
+};
+
+template<class T, int N>
+SmallVector<T,N>::SmallVector(SmallVector &&v)
+  : sz(0), cap(N), ptr(inline_buffer()) {
+  if(v.is_inline()){
+    for(size_type i = 0; i < v.sz; ++i){
+      new (ptr+i) T(std::move(v.ptr[i]));
+    }
+    sz = v.sz;
+    v.clear();
+  }else{
+    /* Steal the heap array */
+    sz = v.sz;
+    cap = v.cap;
+    ptr = v.ptr;
+    v.sz = 0;
+    v.cap = N;
+    v.ptr = v.inline_buffer();
+  }
+};
+
+template<class T, int N>
+SmallVector<T,N> &SmallVector<T,N>::operator=(const SmallVector &v){
+  if(this != &v){
+    clear();
+    reserve(v.sz);
+    for(size_type i = 0; i < v.sz; ++i){
+      new (ptr+i) T(v.ptr[i]);
+    }
+    sz = v.sz;
+  }
+  return *this;
+};
+
+template<class T, int N>
+SmallVector<T,N> &SmallVector<T,N>::operator=(SmallVector &&v){
+  if(this != &v){
+    release();
+    if(v.is_inline()){
+      for(size_type i = 0; i < v.sz; ++i){
+        new (ptr+i) T(std::move(v.ptr[i]));
+      }
+      sz = v.sz;
+      v.clear();
+    }else{
+      sz = v.sz;
+      cap = v.cap;
+      ptr = v.ptr;
+      v.sz = 0;
+      v.cap = N;
+      v.ptr = v.inline_buffer();
+    }
+  }
+  return *this;
+};
+
+template<class T, int N>
+SmallVector<T,N>::~SmallVector(){
+  release();
+};
+
+template<class T, int N>
+void SmallVector<T,N>::release(){
+  clear();
+  if(!is_inline()){
+    ::operator delete(ptr);
+    ptr = inline_buffer();
+    cap = N;
+  }
+};
+
+template<class T, int N>
+void SmallVector<T,N>::clear(){
+  for(size_type i = 0; i < sz; ++i){
+    ptr[i].~T();
+  }
+  sz = 0;
+};
+
+template<class T, int N>
+void SmallVector<T,N>::grow(size_type n){
+  assert(n >= sz);
+  T *p = static_cast<T*>(::operator new(n*sizeof(T)));
+  for(size_type i = 0; i < sz; ++i){
+    new (p+i) T(std::move(ptr[i]));
+    ptr[i].~T();
+  }
+  if(!is_inline()){
+    ::operator delete(ptr);
+  }
+  ptr = p;
+  cap = n;
+};
+
+template<class T, int N>
+void SmallVector<T,N>::push_back(const T &t){
+  if(sz == cap){
+    /* t may refer into the array that is about to be moved */
+    T t_copy(t);
+    grow(2*cap);
+    new (ptr+sz) T(std::move(t_copy));
+  }else{
+    new (ptr+sz) T(t);
+  }
+  ++sz;
+};
+
+template<class T, int N>
+void SmallVector<T,N>::resize(size_type n, const T &t){
+  if(n <= sz){
+    while(sz > n){
+      pop_back();
+    }
+  }else{
+    T t_copy(t);
+    reserve(n);
+    while(sz < n){
+      new (ptr+sz) T(t_copy);
+      ++sz;
+    }
+  }
+};
+
+template<class T, int N>
+bool SmallVector<T,N>::operator==(const SmallVector &v) const{
+  if(sz != v.sz) return false;
+  for(size_type i = 0; i < sz; ++i){
+    if(!(ptr[i] == v.ptr[i])) return false;
+  }
+  return true;
+};
+
+template<class T, int N>
+bool SmallVector<T,N>::operator<(const SmallVector &v) const{
+  for(size_type i = 0; i < sz && i < v.sz; ++i){
+    if(ptr[i] < v.ptr[i]) return true;
+    if(v.ptr[i] < ptr[i]) return false;
+  }
+  return sz < v.sz;
+};
+
+namespace SmallVectorTest{
+  /* An element type without default constructor, which counts its
+   * live instances. */
+  class Elem{
+  public:
+    Elem(int v) : v(v) { ++live(); };
+    Elem(const Elem &e) : v(e.v) { ++live(); };
+    Elem &operator=(const Elem &e) { v = e.v; return *this; };
+    ~Elem() { --live(); };
+    bool operator==(const Elem &e) const { return v == e.v; };
+    bool operator<(const Elem &e) const { return v < e.v; };
+    int v;
+    /* The number of Elem objects currently alive. */
+    static int &live() { static int n = 0; return n; };
+  };
+};
+
+template<class T, int N>
+void SmallVector<T,N>::test(){
+  /* Test 1: Inline and heap storage */
+  {
+    SmallVector<int,2> v;
+    bool ok = v.empty() && v.is_inline();
+    v.push_back(1);
+    v.push_back(2);
+    ok = ok && v.is_inline() && v.size() == 2;
+    v.push_back(3);
+    ok = ok && !v.is_inline() && v.size() == 3 && v[0] == 1 && v[1] == 2 && v[2] == 3;
+    v.clear();
+    ok = ok && v.empty() && v.capacity() >= 3;
+    Test::inner_test("Inline and heap storage",ok);
+  }
+
+  /* Test 2: Pushing an element of the vector itself */
+  {
+    SmallVector<int,2> v;
+    v.push_back(7);
+    v.push_back(v.back());
+    v.push_back(v.back());
+    v.push_back(v[0]);
+    v.push_back(v.back());
+    bool ok = v.size() == 5;
+    for(int i = 0; i < 5; ++i){
+      ok = ok && v[i] == 7;
+    }
+    Test::inner_test("Aliasing push_back",ok);
+  }
+
+  /* Test 3: Copying and moving */
+  {
+    SmallVector<int,2> small; small.push_back(1);
+    SmallVector<int,2> big; for(int i = 0; i < 5; ++i) big.push_back(i);
+    SmallVector<int,2> small2(small), big2(big);
+    bool ok = small2 == small && big2 == big && big < small && !(small < big);
+    SmallVector<int,2> small3(std::move(small2)), big3(std::move(big2));
+    ok = ok && small3 == small && big3 == big && small2.empty() && big2.empty() &&
+      small2.is_inline() && big2.is_inline();
+    small3 = big3;
+    big3 = small;
+    ok = ok && small3 == big && big3 == small;
+    small3 = small3;
+    ok = ok && small3 == big;
+    big2 = std::move(small3);
+    ok = ok && big2 == big && small3.empty();
+    Test::inner_test("Copy and move",ok);
+  }
+
+  /* Test 4: Elements without default constructor are constructed
+   * and destroyed correctly. */
+  {
+    typedef SmallVectorTest::Elem E;
+    {
+      SmallVector<E,2> v;
+      for(int i = 0; i < 10; ++i){
+        v.push_back(E(i));
+      }
+      SmallVector<E,2> w(v);
+      w.resize(3,E(0));
+      w.resize(6,E(1));
+      SmallVector<E,2> x(std::move(w));
+      v = x;
+      v.pop_back();
+    }
+    Test::inner_test("Element lifetime",E::live() == 0);
+  }
+
+  /* Test 5: VecSet with SmallVector storage */
+  {
+    std::vector<int> vals = {5,3,9,3,1,7,5,0,2,8};
+    VecSet<int> s0;
+    VecSet<int,SmallVector<int,2> > s1;
+    bool ok = true;
+    for(int v : vals){
+      ok = ok && s0.insert(v) == s1.insert(v);
+    }
+    ok = ok && s1.size() == s0.size() && VecSet<int>(s1) == s0;
+    VecSet<int,SmallVector<int,2> > s2 = {4,3,2};
+    ok = ok && s2.subset_of(s0) == false && s2.intersects(s0);
+    ok = ok && s1.insert(s2) == 1 && s1.count(4) == 1 && s1.find(6) == -1;
+    ok = ok && VecSet<int,SmallVector<int,2> >::singleton(4).subset_of(s1);
+    Test::inner_test("VecSet",ok);
+  }
+};
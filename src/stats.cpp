@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "log.h"
+#include "stats.h"
+#include "test.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+bool Stats::enabled = false;
+
+namespace{
+
+  /* All counters of live threads are registered in live_counters.
+   * The counters of terminated threads are added to
+   * retired_counters. */
+  std::mutex registry_mutex;
+  std::set<Stats::counters_t*> live_counters;
+  Stats::counters_t retired_counters;
+
+  struct registered_counters_t{
+    registered_counters_t(){
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      live_counters.insert(&counters);
+    };
+    ~registered_counters_t(){
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      retired_counters += counters;
+      live_counters.erase(&counters);
+    };
+    Stats::counters_t counters;
+  };
+
+  /* Time and tick counter when profiling was last enabled. */
+  std::chrono::steady_clock::time_point start_time;
+  uint64_t start_ticks = 0;
+
+};
+
+std::string Stats::probe_name(probe_t p){
+  switch(p){
+  case POP: return "pop";
+  case PARTRED: return "partred";
+  case PRE: return "pre";
+  case POST: return "post";
+  case IS_INIT_STATE: return "is_init_state";
+  case INSERT: return "insert";
+  case ENTAILMENT_COMPARE: return "entailment_compare";
+  case INVALIDATE: return "invalidate";
+  case VISITED: return "visited";
+  case PROBE_COUNT: break;
+  }
+  throw new std::logic_error("Stats::probe_name: Invalid probe.");
+};
+
+Stats::counters_t::counters_t() : current(NO_PROBE) {
+  for(int p = 0; p < PROBE_COUNT; ++p){
+    calls[p] = ticks[p] = child_ticks[p] = 0;
+    parent[p] = NO_PROBE;
+    open[p] = 0;
+  }
+};
+
+Stats::counters_t &Stats::counters_t::operator+=(const counters_t &c){
+  for(int p = 0; p < PROBE_COUNT; ++p){
+    calls[p] += c.calls[p];
+    ticks[p] += c.ticks[p];
+    child_ticks[p] += c.child_ticks[p];
+    if(c.calls[p]) parent[p] = c.parent[p];
+  }
+  return *this;
+};
+
+Stats::counters_t &Stats::thread_counters(){
+  static thread_local registered_counters_t tc;
+  return tc.counters;
+};
+
+Stats::counters_t Stats::total(){
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  counters_t sum = retired_counters;
+  for(counters_t *c : live_counters){
+    sum += *c;
+  }
+  return sum;
+};
+
+void Stats::set_enabled(bool e){
+  if(e){
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    retired_counters = counters_t();
+    for(counters_t *c : live_counters){
+      *c = counters_t();
+    }
+    start_time = std::chrono::steady_clock::now();
+    start_ticks = ticks();
+  }
+  enabled = e;
+};
+
+double Stats::ticks_per_second(){
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  if(secs <= 0) return 1.0;
+  return double(ticks() - start_ticks) / secs;
+};
+
+void Stats::print(){
+  counters_t c = total();
+  double tps = ticks_per_second();
+
+  std::stringstream table, json;
+  table << "Profile:\n"
+        << "  " << std::left << std::setw(26) << "operation" << std::right
+        << std::setw(14) << "calls"
+        << std::setw(12) << "total (s)"
+        << std::setw(12) << "self (s)"
+        << std::setw(12) << "avg (ns)" << "\n";
+  json << "json: {\"action\":\"Stats\", \"ticks_per_second\":" << std::fixed << std::setprecision(0) << tps
+       << ", \"probes\":[";
+  bool first = true;
+  std::set<int> printed;
+
+  /* Print probes as a tree following the parent relation. */
+  std::function<void(probe_t,int)> print_probe =
+    [&](probe_t p, int depth){
+    printed.insert(p);
+    double total_s = double(c.ticks[p]) / tps;
+    double self_s = double(c.ticks[p] - std::min(c.ticks[p],c.child_ticks[p])) / tps;
+    double avg_ns = c.calls[p] ? (1e9 * total_s / double(c.calls[p])) : 0.0;
+    table << "  " << std::left << std::setw(26) << (std::string(2*depth,' ') + probe_name(p)) << std::right
+          << std::setw(14) << c.calls[p]
+          << std::setw(12) << std::fixed << std::setprecision(3) << total_s
+          << std::setw(12) << self_s
+          << std::setw(12) << std::setprecision(0) << avg_ns << "\n";
+    if(!first) json << ", ";
+    first = false;
+    json << "{\"name\":\"" << probe_name(p) << "\""
+         << ", \"parent\":\"" << (c.parent[p] == NO_PROBE ? "" : probe_name(c.parent[p])) << "\""
+         << ", \"calls\":" << c.calls[p]
+         << ", \"ticks\":" << c.ticks[p]
+         << ", \"child_ticks\":" << c.child_ticks[p]
+         << std::setprecision(6)
+         << ", \"time\":" << total_s
+         << ", \"self_time\":" << self_s << "}";
+    for(int q = 0; q < PROBE_COUNT; ++q){
+      if(c.calls[q] && c.parent[q] == p && printed.count(q) == 0){
+        print_probe(probe_t(q),depth+1);
+      }
+    }
+  };
+  for(int p = 0; p < PROBE_COUNT; ++p){
+    if(c.calls[p] && c.parent[p] == NO_PROBE){
+      print_probe(probe_t(p),0);
+    }
+  }
+  /* Probes that are only nested in each other */
+  for(int p = 0; p < PROBE_COUNT; ++p){
+    if(c.calls[p] && printed.count(p) == 0){
+      print_probe(probe_t(p),0);
+    }
+  }
+  json << "]}\n";
+
+  Log::result << table.str();
+  Log::json << json.str();
+};
+
+void Stats::test(){
+  bool was_enabled = enabled;
+
+  /* Test 1: Disabled probes count nothing */
+  {
+    set_enabled(true);
+    set_enabled(false);
+    {
+      Probe p(PRE);
+    }
+    Test::inner_test("Disabled probes",total().calls[PRE] == 0);
+  }
+
+  /* Test 2: Nesting */
+  {
+    set_enabled(true);
+    for(int i = 0; i < 10; ++i){
+      Probe p(INSERT);
+      for(int j = 0; j < 3; ++j){
+        Probe q(ENTAILMENT_COMPARE);
+      }
+      Probe r(INVALIDATE);
+      {
+        Probe s(INVALIDATE); // Recursive
+      }
+    }
+    counters_t c = total();
+    Test::inner_test("Nested probes",
+                     c.calls[INSERT] == 10 && c.calls[ENTAILMENT_COMPARE] == 30 &&
+                     c.calls[INVALIDATE] == 20 &&
+                     c.parent[INSERT] == NO_PROBE &&
+                     c.parent[ENTAILMENT_COMPARE] == INSERT &&
+                     c.parent[INVALIDATE] == INSERT &&
+                     c.child_ticks[INSERT] == c.ticks[ENTAILMENT_COMPARE] + c.ticks[INVALIDATE] &&
+                     c.child_ticks[INSERT] <= c.ticks[INSERT] &&
+                     thread_counters().current == NO_PROBE);
+  }
+
+  /* Test 3: Indirect recursion */
+  {
+    set_enabled(true);
+    for(int i = 0; i < 10; ++i){
+      Probe p(INSERT);
+      Probe q(ENTAILMENT_COMPARE);
+      Probe r(INSERT);
+    }
+    counters_t c = total();
+    Test::inner_test("Indirectly recursive probes",
+                     c.calls[INSERT] == 20 && c.calls[ENTAILMENT_COMPARE] == 10 &&
+                     c.parent[INSERT] == NO_PROBE &&
+                     c.parent[ENTAILMENT_COMPARE] == INSERT &&
+                     c.child_ticks[INSERT] == c.ticks[ENTAILMENT_COMPARE] &&
+                     c.child_ticks[ENTAILMENT_COMPARE] == 0 &&
+                     c.ticks[ENTAILMENT_COMPARE] <= c.ticks[INSERT] &&
+                     thread_counters().open[INSERT] == 0 &&
+                     thread_counters().current == NO_PROBE);
+  }
+
+  set_enabled(was_enabled);
+};
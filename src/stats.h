@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/* Stats provides lightweight profiling of the hot paths of the
+ * reachability analyses (enabled by the flag --stats).
+ *
+ * The code to be profiled is wrapped in a Probe object:
+ *
+ *   {
+ *     Stats::Probe probe(Stats::PRE);
+ *     ... call pre ...
+ *   }
+ *
+ * Each probe counts the number of calls and the number of elapsed
+ * ticks (cycles of the time stamp counter where available). Probes
+ * may be nested, in which case the time of the inner probe is also
+ * accounted as child time of the outer one, so that the self time of
+ * each probe can be reported.
+ *
+ * A probe entered while another probe of the same kind is open on
+ * the same thread (directly as in A -> A, or indirectly as in A -> B
+ * -> A) is only counted as a call. Its time is already part of the
+ * time of the outermost probe of its kind, and remains part of the
+ * self time of the probe enclosing it (B above).
+ *
+ * The counters are kept per thread, and are summed when
+ * reported. When profiling is disabled, a probe costs a single test
+ * of a global flag.
+ */
+namespace Stats{
+
+  /* The profiled operations */
+  enum probe_t {
+    POP,
+    PARTRED,
+    PRE,
+    POST,
+    IS_INIT_STATE,
+    INSERT,
+    ENTAILMENT_COMPARE,
+    INVALIDATE,
+    VISITED,
+    PROBE_COUNT,
+    NO_PROBE = PROBE_COUNT
+  };
+
+  std::string probe_name(probe_t p);
+
+  struct counters_t{
+    counters_t();
+    /* calls[p] is the number of times probe p has been entered. */
+    uint64_t calls[PROBE_COUNT];
+    /* ticks[p] is the total number of ticks spent in probe p. */
+    uint64_t ticks[PROBE_COUNT];
+    /* child_ticks[p] is the number of ticks spent in other probes
+     * nested inside probe p. */
+    uint64_t child_ticks[PROBE_COUNT];
+    /* parent[p] is the probe enclosing p when p was last entered, or
+     * NO_PROBE. */
+    probe_t parent[PROBE_COUNT];
+    /* The innermost probe currently entered. */
+    probe_t current;
+    /* open[p] is the number of probes p currently entered. Not
+     * summed by +=. */
+    unsigned open[PROBE_COUNT];
+    counters_t &operator+=(const counters_t &c);
+  };
+
+  /* True iff profiling is enabled. */
+  extern bool enabled;
+  /* Enable or disable profiling. Enabling profiling resets all
+   * counters. */
+  void set_enabled(bool e);
+
+  /* The counters of the calling thread. */
+  counters_t &thread_counters();
+  /* The sum of the counters of all threads. */
+  counters_t total();
+
+  /* The current value of the tick counter. */
+  inline uint64_t ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+      (std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  };
+  /* The number of ticks per second, as measured since profiling was
+   * enabled. */
+  double ticks_per_second();
+
+  class Probe{
+  public:
+    Probe(probe_t p) : probe(p), parent(NO_PROBE), counters(enabled ? &thread_counters() : 0), start(0) {
+      if(counters){
+        parent = counters->current;
+        counters->current = probe;
+        ++counters->open[probe];
+        start = ticks();
+      }
+    };
+    ~Probe(){
+      if(counters){
+        uint64_t d = ticks() - start;
+        ++counters->calls[probe];
+        /* Time of recursive calls is already accounted for by the
+         * outermost call. */
+        if(--counters->open[probe] == 0){
+          counters->ticks[probe] += d;
+          counters->parent[probe] = parent;
+          if(parent != NO_PROBE){
+            counters->child_ticks[parent] += d;
+          }
+        }
+        counters->current = parent;
+      }
+    };
+    Probe(const Probe&) = delete;
+    Probe &operator=(const Probe&) = delete;
+  private:
+    probe_t probe;
+    probe_t parent;
+    counters_t *counters;
+    uint64_t start;
+  };
+
+  /* Print a table of the counters summed over all threads to
+   * Log::result, and the same information as a json directive to
+   * Log::json. */
+  void print();
+
+  void test();
+
+};
+
+#endif
@@ -86,6 +86,12 @@ public:
    * objects in m_infos should be in the order the corresponding Sync
    * insertions were performed.
    *
+   * Implementations copy m and edit the copy. Copying is cheap, since
+   * the automata of a Machine are copy-on-write: only the automata
+   * that are accessed through non-const methods are duplicated. So
+   * implementations should only use non-const access to the automata
+   * they change.
+   *
    * This Sync surrenders ownership of *info to the caller.
    */
   virtual Machine *insert(const Machine &m, const std::vector<const InsInfo*> &m_infos, InsInfo **info) const = 0;
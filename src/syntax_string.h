@@ -22,14 +22,20 @@
 #define __SYNTAX_STRING_H__
 
 #include <config.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <list>
 #include <map>
+#include <mutex>
 #include <stdexcept>
 #include <sstream>
 #include "cmsat.h"
 
+class MachineImage;
+
 template<class Var> class SyntaxString{
 public:
   SyntaxString(const SyntaxString &ss);
@@ -92,6 +98,41 @@ public:
    */
   template<typename C, typename A> int eval(C c, A a) const;
 
+  /* Evaluates this expression for n valuations at once.
+   *
+   * The valuations are given in struct of arrays form: for each
+   * constant variable v, cols[v] should be a pointer to an array of n
+   * integers, where cols[v][j] is the value of v in valuation j. The
+   * value of this expression under valuation j is written to out[j].
+   *
+   * Pre: This expression contains no arguments.
+   */
+  template<typename C> void eval_batch(C cols, int n, int *out) const;
+
+  /* Same as eval_batch(cols,n,out), but instead of the values,
+   * writes a bitmask to mask. Bit j%64 of mask[j/64] is set iff
+   * this expression evaluates to value under valuation j.
+   *
+   * mask should have room for (n+63)/64 elements.
+   */
+  template<typename C> void eval_batch_mask(C cols, int n, int value, uint64_t *mask) const;
+
+  /* Interval evaluation of this expression.
+   *
+   * For each constant variable v, the value of v is only known to lie
+   * in the interval [lbs[v],ubs[v]]. Sets *lo and *hi such that this
+   * expression evaluates to a value in [*lo,*hi] under every
+   * valuation within those bounds. Boolean subexpressions take the
+   * values 0 and 1.
+   *
+   * The bounds are exact when lbs[v] == ubs[v] for all v.
+   *
+   * Pre: This expression contains no arguments.
+   */
+  template<typename C> void eval_interval(C lbs, C ubs, long *lo, long *hi) const;
+
+  static void test();
+
 protected:
 
   /* Makes a nullary term of this term by substituting each occurrence
@@ -200,7 +241,10 @@ protected:
   };
   typedef short symbol_t;
 
-  typedef int ptr_count_t;
+  /* Pointer counters are atomic, so that copies of the same string
+   * may be created and destroyed concurrently by different threads.
+   */
+  typedef std::atomic<int> ptr_count_t;
 
   /* Invariant: Control symbols (the ones in symbol_t_name) are
    * always on even indices. Symbols which are not control are
@@ -304,6 +348,65 @@ private:
 
   SyntaxString<Var> separate_interval(int offset, int new_symbol_count) const throw();
 
+  /* Hash-consing: Syntax strings built by combine, bind and
+   * substitute are interned, so that structurally equal strings
+   * share their symbol and constant arrays. This saves memory, and
+   * lets compare decide equality by comparing pointers.
+   *
+   * The intern table holds one reference to each interned array,
+   * which keeps the arrays from being modified in place (see
+   * translate). Arrays that are referenced only by the table are
+   * released by purge, which is called when the table has grown
+   * sufficiently since the last purge.
+   */
+  struct symbols_key_t{
+    const symbol_t *symbols;
+    int symbol_count;
+    bool operator<(const symbols_key_t &k) const{
+      if(symbol_count != k.symbol_count) return symbol_count < k.symbol_count;
+      for(int i = 0; i < symbol_count; i++){
+        if(symbols[i] != k.symbols[i]) return symbols[i] < k.symbols[i];
+      }
+      return false;
+    };
+  };
+  struct consts_key_t{
+    const Var *consts;
+    int const_count;
+    bool operator<(const consts_key_t &k) const{
+      if(const_count != k.const_count) return const_count < k.const_count;
+      for(int i = 0; i < const_count; i++){
+        if(consts[i] < k.consts[i]) return true;
+        if(!(consts[i] == k.consts[i])) return false;
+      }
+      return false;
+    };
+  };
+  class InternTable{
+  public:
+    InternTable() : purge_limit(min_purge_limit) {};
+    ~InternTable();
+    std::mutex mutex;
+    /* Map the interned arrays to their pointer counters */
+    std::map<symbols_key_t,ptr_count_t*> symbols;
+    std::map<consts_key_t,ptr_count_t*> consts;
+    /* Releases the arrays that are referenced only by this table.
+     * Pre: mutex is held by the caller. */
+    void purge();
+    /* purge is called when the table contains more entries than this. */
+    std::size_t purge_limit;
+    static const std::size_t min_purge_limit = 4096;
+  };
+  static InternTable &intern_table();
+  /* Replaces the symbol and constant arrays of this syntax string by
+   * the equal interned arrays, or interns them if there are no such
+   * arrays.
+   *
+   * Pre: This syntax string is fully constructed, and its arrays will
+   * not be modified.
+   */
+  void intern();
+
   /* Same as to_msat_term(env,var_decl_map), but works for the 
    * sub expression starting at symbol i.
    */
@@ -326,6 +429,7 @@ private:
 #endif
 
   template<class Var2> friend class SyntaxString;
+  friend class MachineImage;
 };
 
 #include "syntax_string.tcc"
@@ -18,6 +18,7 @@
  *
  */
 
+#include "test.h"
 #include <string>
 #include <cstring>
 #include <vector>
@@ -90,14 +91,12 @@ template<class Var> void SyntaxString<Var>::init(const SyntaxString<Var> &ss){
 }
 
 template<class Var> void SyntaxString<Var>::self_destruct(){
-  (*symbols_ptr_count)--;
-  if(*symbols_ptr_count == 0){
+  if(--(*symbols_ptr_count) == 0){
     delete symbols_ptr_count;
     delete[] symbols;
   }
   if(consts_ptr_count){
-    (*consts_ptr_count)--;
-    if(*consts_ptr_count == 0){
+    if(--(*consts_ptr_count) == 0){
       delete consts_ptr_count;
       delete[] consts;
     }
@@ -108,6 +107,94 @@ template<class Var> SyntaxString<Var>::~SyntaxString(){
   self_destruct();
 }
 
+template<class Var> typename SyntaxString<Var>::InternTable &SyntaxString<Var>::intern_table(){
+  static InternTable table;
+  return table;
+}
+
+template<class Var> SyntaxString<Var>::InternTable::~InternTable(){
+  for(auto it = symbols.begin(); it != symbols.end(); it++){
+    if(--(*it->second) == 0){
+      delete it->second;
+      delete[] it->first.symbols;
+    }
+  }
+  for(auto it = consts.begin(); it != consts.end(); it++){
+    if(--(*it->second) == 0){
+      delete it->second;
+      delete[] it->first.consts;
+    }
+  }
+}
+
+template<class Var> void SyntaxString<Var>::InternTable::purge(){
+  /* An array referenced only by the table cannot gain new references
+   * other than through intern, which holds mutex. */
+  for(auto it = symbols.begin(); it != symbols.end();){
+    if(*it->second == 1){
+      delete it->second;
+      delete[] it->first.symbols;
+      it = symbols.erase(it);
+    }else{
+      it++;
+    }
+  }
+  for(auto it = consts.begin(); it != consts.end();){
+    if(*it->second == 1){
+      delete it->second;
+      delete[] it->first.consts;
+      it = consts.erase(it);
+    }else{
+      it++;
+    }
+  }
+  purge_limit = 2*(symbols.size()+consts.size());
+  if(purge_limit < min_purge_limit){
+    purge_limit = min_purge_limit;
+  }
+}
+
+template<class Var> void SyntaxString<Var>::intern(){
+  InternTable &table = intern_table();
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  symbols_key_t sk = {symbols,symbol_count};
+  auto sit = table.symbols.find(sk);
+  if(sit == table.symbols.end()){
+    (*symbols_ptr_count)++;
+    table.symbols[sk] = symbols_ptr_count;
+  }else if(sit->first.symbols != symbols){
+    (*sit->second)++;
+    if(--(*symbols_ptr_count) == 0){
+      delete symbols_ptr_count;
+      delete[] symbols;
+    }
+    symbols = const_cast<symbol_t*>(sit->first.symbols);
+    symbols_ptr_count = sit->second;
+  }
+
+  if(consts){
+    consts_key_t ck = {consts,const_count};
+    auto cit = table.consts.find(ck);
+    if(cit == table.consts.end()){
+      (*consts_ptr_count)++;
+      table.consts[ck] = consts_ptr_count;
+    }else if(cit->first.consts != consts){
+      (*cit->second)++;
+      if(--(*consts_ptr_count) == 0){
+        delete consts_ptr_count;
+        delete[] consts;
+      }
+      consts = const_cast<Var*>(cit->first.consts);
+      consts_ptr_count = cit->second;
+    }
+  }
+
+  if(table.symbols.size() + table.consts.size() > table.purge_limit){
+    table.purge();
+  }
+}
+
 template<class Var> SyntaxString<Var> &SyntaxString<Var>::operator=(const SyntaxString<Var> &ss){
   if(&ss != this){
     self_destruct();
@@ -254,8 +341,8 @@ template<class Var> std::string SyntaxString<Var>::to_inner_string(int i, const
 
 template<class Var> SyntaxString<Var> SyntaxString<Var>::combine(symbol_t op, const SyntaxString<Var> &a, 
                                                                  const SyntaxString<Var> &b){
-  static std::vector<int> a_map(8);
-  static std::vector<int> b_map(8);
+  static thread_local std::vector<int> a_map(8);
+  static thread_local std::vector<int> b_map(8);
   if(a.const_count > int(a_map.size())) a_map.resize(a.const_count*2);
   if(b.const_count > int(b_map.size())) b_map.resize(b.const_count*2);
 
@@ -342,6 +429,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::combine(symbol_t op, co
     }
   }
 
+  ss.intern();
   assert(ss.check_invariant());
   return ss;
 };
@@ -357,6 +445,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::combine(symbol_t op, co
   if(ss.consts_ptr_count){
     (*ss.consts_ptr_count)++;
   }
+  ss.intern();
   assert(ss.check_invariant());
   return ss;
 };
@@ -443,8 +532,8 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::bind(const std::vector<
   SyntaxString<Var> ss(symbol_count,const_count+argv.size(),0);
 
   /* Build new consts and remember index remappings */
-  static std::vector<int> const_map(8);
-  static std::vector<int> arg_map(8);
+  static thread_local std::vector<int> const_map(8);
+  static thread_local std::vector<int> arg_map(8);
   if(int(const_map.size()) < const_count) const_map.resize(const_count*2);
   if(int(arg_map.size()) < arg_count) arg_map.resize(arg_count*2);
 
@@ -514,6 +603,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::bind(const std::vector<
     i += 2;
   }
 
+  ss.intern();
   assert(ss.check_invariant());
   return ss;
 };
@@ -548,8 +638,8 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::substitute(const Syntax
 
   /* Construct the new consts */
   int cc = 0; // Number of constants inserted so far
-  static std::vector<int> c_map(8);
-  static std::vector<int> tc_map(8);
+  static thread_local std::vector<int> c_map(8);
+  static thread_local std::vector<int> tc_map(8);
   if(int(c_map.size()) < const_count) c_map.resize(const_count*2);
   if(int(c_map.size()) < const_count) c_map.resize(const_count*2);
   {
@@ -592,7 +682,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::substitute(const Syntax
 
   /* Copy symbols while remapping variables */
   {
-    static std::vector<int> ref_map(32); // ref_map[i] == j if ss.symbols[j] is a pointer to symbols[i]
+    static thread_local std::vector<int> ref_map(32); // ref_map[i] == j if ss.symbols[j] is a pointer to symbols[i]
     if(ss.symbol_count > int(ref_map.size())) ref_map.resize(ss.symbol_count*2);
     for(int a = 0; a < ss.symbol_count; a++){
       ref_map[a] = -1; // ref_map[i] == -1 if there is no pointer to symbols[i]
@@ -637,6 +727,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::substitute(const Syntax
     }
   }
 
+  ss.intern();
   assert(ss.check_invariant());
   return ss;
 };
@@ -696,7 +787,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::separate_interval(int o
   SyntaxString<Var> ss(new_symbol_count,const_count,0);
 
   /* Copy constants and setup arg_count */
-  static std::vector<int> c_map(8);
+  static thread_local std::vector<int> c_map(8);
   if(const_count > int(c_map.size())) c_map.resize(const_count*2);
   {
     int cc = 0; // Constants added hitherto
@@ -846,7 +937,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::generalise() const thro
 };
 
 template<class Var> void SyntaxString<Var>::translate(std::function<Var(const Var&)> &t){
-  static std::vector<int> c_map(8);
+  static thread_local std::vector<int> c_map(8);
   if(int(c_map.size()) < const_count) c_map.resize(const_count*2);
   bool identity_map;
 
@@ -959,8 +1050,8 @@ template<class Var> int SyntaxString<Var>::compare(const SyntaxString<Var> &ss)
     return 1;
   }
 
-  /* Compare symbols */
-  std::vector<int> vars;
+  /* Compare symbols. (Interned strings which are equal share their
+   * arrays.) */
   if(symbols != ss.symbols){
     if(symbol_count < ss.symbol_count){
       return -1;
@@ -970,9 +1061,6 @@ template<class Var> int SyntaxString<Var>::compare(const SyntaxString<Var> &ss)
 
     /* symbol_count == ss.symbol_count */
     for(int i = 0; i < symbol_count; i++){
-      if(i % 2 == 0 && symbols[i] == VAR){
-        vars.push_back(symbols[i+1]);
-      }
       if(symbols[i] < ss.symbols[i]){
         return -1;
       }else if(symbols[i] > ss.symbols[i]){
@@ -1500,7 +1588,7 @@ template<class Var> SyntaxString<Var> SyntaxString<Var>::simplify() const throw(
 
 template<class Var> 
 template<typename C, typename A> int SyntaxString<Var>::eval(C c, A a) const{
-  static std::vector<int> e(16);
+  static thread_local std::vector<int> e(16);
   int sc = symbol_count/2;
   if(sc > int(e.size())){
     e.resize(sc);
@@ -1574,3 +1662,238 @@ template<typename C, typename A> int SyntaxString<Var>::eval(C c, A a) const{
   }
   return e[0];
 };
+
+template<class Var>
+template<typename C> void SyntaxString<Var>::eval_batch(C cols, int n, int *out) const{
+  /* e[i*n+j] is the value of the subexpression at symbol i under
+   * valuation j. */
+  static thread_local std::vector<int> scratch;
+  int sc = symbol_count/2;
+  if(int(scratch.size()) < sc*n){
+    scratch.resize(sc*n);
+  }
+  int *e = scratch.data();
+  for(int i = sc-1; i >= 0; i--){
+    int *ei = e + i*n;
+    const int *el = e + (i+1)*n;
+    const int *er = (binary_symbol(symbols[i*2])) ? e + (i+symbols[i*2+1]/2)*n : 0;
+    switch(symbols[i*2]){
+    case INT: case TRUE: case FALSE:
+      {
+        int k = (symbols[i*2] == INT) ? symbols[i*2+1] : ((symbols[i*2] == TRUE) ? 1 : 0);
+        for(int j = 0; j < n; ++j) ei[j] = k;
+        break;
+      }
+    case VAR:
+      {
+        const int *col = cols[consts[symbols[i*2+1]]];
+        for(int j = 0; j < n; ++j) ei[j] = col[j];
+        break;
+      }
+    case ARG:
+      throw new std::logic_error("SyntaxString::eval_batch: Arguments are not supported.");
+    case PLUS:
+      for(int j = 0; j < n; ++j) ei[j] = el[j] + er[j];
+      break;
+    case MINUS:
+      for(int j = 0; j < n; ++j) ei[j] = el[j] - er[j];
+      break;
+    case UNMINUS:
+      for(int j = 0; j < n; ++j) ei[j] = -el[j];
+      break;
+    case EQ:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] == er[j]);
+      break;
+    case NEQ:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] != er[j]);
+      break;
+    case LT:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] < er[j]);
+      break;
+    case LEQ:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] <= er[j]);
+      break;
+    case GT:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] > er[j]);
+      break;
+    case GEQ:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] >= er[j]);
+      break;
+    case NOT:
+      for(int j = 0; j < n; ++j) ei[j] = 1 - el[j];
+      break;
+    case AND:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] == 1) & (er[j] == 1);
+      break;
+    case OR:
+      for(int j = 0; j < n; ++j) ei[j] = (el[j] == 1) | (er[j] == 1);
+      break;
+    default:
+      throw new std::logic_error("SyntaxString::eval_batch: Unknown symbol.");
+    }
+  }
+  if(out != e){
+    for(int j = 0; j < n; ++j) out[j] = e[j];
+  }
+};
+
+template<class Var>
+template<typename C> void SyntaxString<Var>::eval_interval(C lbs, C ubs, long *lo, long *hi) const{
+  /* [l[i],h[i]] is the interval of the subexpression at symbol i. */
+  static thread_local std::vector<long> l, h;
+  int sc = symbol_count/2;
+  if(int(l.size()) < sc){
+    l.resize(sc);
+    h.resize(sc);
+  }
+  for(int i = sc-1; i >= 0; i--){
+    long l1 = 0, h1 = 0, l2 = 0, h2 = 0;
+    if(i+1 < sc){
+      l1 = l[i+1];
+      h1 = h[i+1];
+    }
+    if(binary_symbol(symbols[i*2])){
+      l2 = l[i+symbols[i*2+1]/2];
+      h2 = h[i+symbols[i*2+1]/2];
+    }
+    switch(symbols[i*2]){
+    case INT:
+      l[i] = h[i] = symbols[i*2+1];
+      break;
+    case TRUE:
+      l[i] = h[i] = 1;
+      break;
+    case FALSE:
+      l[i] = h[i] = 0;
+      break;
+    case VAR:
+      l[i] = lbs[consts[symbols[i*2+1]]];
+      h[i] = ubs[consts[symbols[i*2+1]]];
+      break;
+    case ARG:
+      throw new std::logic_error("SyntaxString::eval_interval: Arguments are not supported.");
+    case PLUS:
+      l[i] = l1 + l2; h[i] = h1 + h2;
+      break;
+    case MINUS:
+      l[i] = l1 - h2; h[i] = h1 - l2;
+      break;
+    case UNMINUS:
+      l[i] = -h1; h[i] = -l1;
+      break;
+    case EQ:
+      l[i] = (l1 == h1 && l2 == h2 && l1 == l2);
+      h[i] = !(h1 < l2 || h2 < l1);
+      break;
+    case NEQ:
+      l[i] = (h1 < l2 || h2 < l1);
+      h[i] = !(l1 == h1 && l2 == h2 && l1 == l2);
+      break;
+    case LT:
+      l[i] = (h1 < l2); h[i] = (l1 < h2);
+      break;
+    case LEQ:
+      l[i] = (h1 <= l2); h[i] = (l1 <= h2);
+      break;
+    case GT:
+      l[i] = (l1 > h2); h[i] = (h1 > l2);
+      break;
+    case GEQ:
+      l[i] = (l1 >= h2); h[i] = (h1 >= l2);
+      break;
+    case NOT:
+      l[i] = 1 - h1; h[i] = 1 - l1;
+      break;
+    case AND:
+      l[i] = std::min(l1,l2); h[i] = std::min(h1,h2);
+      break;
+    case OR:
+      l[i] = std::max(l1,l2); h[i] = std::max(h1,h2);
+      break;
+    default:
+      throw new std::logic_error("SyntaxString::eval_interval: Unknown symbol.");
+    }
+  }
+  *lo = l[0];
+  *hi = h[0];
+};
+
+template<class Var>
+template<typename C> void SyntaxString<Var>::eval_batch_mask(C cols, int n, int value, uint64_t *mask) const{
+  static thread_local std::vector<int> vals;
+  if(int(vals.size()) < n){
+    vals.resize(n);
+  }
+  eval_batch(cols,n,vals.data());
+  for(int w = 0; w < (n+63)/64; ++w){
+    uint64_t m = 0;
+    int jmax = std::min(64,n-w*64);
+    for(int j = 0; j < jmax; ++j){
+      m |= uint64_t(vals[w*64+j] == value) << j;
+    }
+    mask[w] = m;
+  }
+};
+
+template<class Var> void SyntaxString<Var>::test(){
+  InternTable &table = intern_table();
+  std::function<SyntaxString(int,int)> eq_vi =
+    [](int v, int i){ return eq(variable(Var(v)),integer(i)); };
+
+  /* Test 1: Equal strings share their arrays */
+  {
+    SyntaxString a = eq_vi(0,1);
+    SyntaxString b = eq_vi(0,1);
+    Test::inner_test("Equal strings share arrays",
+                     a.symbols == b.symbols && a.consts == b.consts &&
+                     a.symbols_ptr_count == b.symbols_ptr_count &&
+                     a.consts_ptr_count == b.consts_ptr_count &&
+                     a.compare(b) == 0);
+  }
+
+  /* Test 2: Different strings do not share their arrays */
+  {
+    SyntaxString a = eq_vi(0,1);
+    SyntaxString b = eq_vi(0,2);
+    SyntaxString c = eq_vi(1,1);
+    Test::inner_test("Different strings do not share arrays",
+                     a.symbols != b.symbols && a.consts == b.consts &&
+                     a.symbols == c.symbols && a.consts != c.consts &&
+                     a.compare(b) != 0 && a.compare(c) != 0);
+  }
+
+  /* Test 3: purge releases only the arrays that are referenced by
+   * nothing but the table */
+  {
+    SyntaxString a = eq_vi(2,3);
+    const symbol_t *a_symbols = a.symbols;
+    const Var *a_consts = a.consts;
+    std::vector<symbol_t> b_symbols;
+    std::vector<Var> b_consts;
+    bool b_interned;
+    {
+      SyntaxString b = eq_vi(4,5);
+      b_symbols.assign(b.symbols,b.symbols+b.symbol_count);
+      b_consts.assign(b.consts,b.consts+b.const_count);
+      std::lock_guard<std::mutex> lock(table.mutex);
+      b_interned = table.symbols.count({b.symbols,b.symbol_count}) &&
+        table.consts.count({b.consts,b.const_count});
+    }
+    bool a_kept, b_released;
+    {
+      std::lock_guard<std::mutex> lock(table.mutex);
+      table.purge();
+      auto sit = table.symbols.find({a.symbols,a.symbol_count});
+      auto cit = table.consts.find({a.consts,a.const_count});
+      a_kept = sit != table.symbols.end() && sit->first.symbols == a_symbols &&
+        cit != table.consts.end() && cit->first.consts == a_consts &&
+        *a.symbols_ptr_count == 2 && *a.consts_ptr_count == 2;
+      b_released = table.symbols.count({b_symbols.data(),int(b_symbols.size())}) == 0 &&
+        table.consts.count({b_consts.data(),int(b_consts.size())}) == 0;
+    }
+    SyntaxString a2 = eq_vi(2,3);
+    Test::inner_test("purge keeps referenced arrays",
+                     b_interned && a_kept && b_released &&
+                     a2.symbols == a_symbols && a2.consts == a_consts);
+  }
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dual_channel_container.h"
+#include "dual_constraint.h"
+#include "dual_tso_bwd.h"
+#include "channel_container.h"
+#include "log.h"
+#include "preprocessor.h"
+#include "sb_constraint.h"
+#include "sb_tso_bwd.h"
+#include "test.h"
+#include "test_concurrency.h"
+#include "zstar.h"
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace TestConcurrency{
+
+  const int thread_count = 4;
+
+  /* Runs f(i) in thread_count threads, for i = 0, ..., thread_count-1,
+   * and waits for all of them to finish. */
+  void run_threads(std::function<void(int)> f){
+    std::vector<std::thread> ts;
+    for(int i = 0; i < thread_count; ++i){
+      ts.push_back(std::thread(f,i));
+    }
+    for(unsigned i = 0; i < ts.size(); ++i){
+      ts[i].join();
+    }
+  };
+
+  Machine *get_machine(std::string rmm){
+    std::stringstream ss(rmm);
+    PPLexer lex(ss);
+    return new Machine(Parser::p_test(lex));
+  };
+
+  /* The outcome of a reachability analysis */
+  struct outcome_t{
+    Reachability::result_t result;
+    int generated_constraints;
+    bool operator==(const outcome_t &o) const{
+      return result == o.result && generated_constraints == o.generated_constraints;
+    };
+  };
+
+  outcome_t reach_sb(const Machine &m){
+    SbConstraint::Common *common = new SbConstraint::Common(m);
+    SbTsoBwd reach;
+    ExactBwd::Arg arg(m,common->get_bad_states(),common,new ChannelContainer());
+    Reachability::Result *res = reach.reachability(&arg);
+    outcome_t o = {res->result,res->generated_constraints};
+    delete res;
+    return o;
+  };
+
+  outcome_t reach_dual(const Machine &m){
+    DualConstraint::Common *common = new DualConstraint::Common(m);
+    DualTsoBwd reach;
+    ExactBwd::Arg arg(m,common->get_bad_states(),common,new DualChannelContainer());
+    Reachability::Result *res = reach.reachability(&arg);
+    outcome_t o = {res->result,res->generated_constraints};
+    delete res;
+    return o;
+  };
+
+  void test(){
+    /* Test 1: Copies of a shared expression are created, evaluated
+     * and destroyed concurrently. */
+    {
+      Lang::Expr<int> e = Lang::Expr<int>::plus(Lang::Expr<int>::reg(0),
+                                                Lang::Expr<int>::minus(Lang::Expr<int>::reg(1),
+                                                                       Lang::Expr<int>::integer(1)));
+      std::atomic<bool> ok(true);
+      run_threads([&e,&ok](int t){
+          std::vector<Lang::Expr<int> > copies;
+          for(int i = 0; i < 10000; ++i){
+            copies.push_back(e);
+            std::vector<int> regs = {t, i};
+            if(copies.back().eval<const std::vector<int>&,int*>(regs,0) != t+i-1){
+              ok = false;
+            }
+            if(copies.size() > 64) copies.clear();
+          }
+        });
+      Test::inner_test("Shared expressions",ok && e.eval<const std::vector<int>&,int*>({2,3},0) == 4);
+    }
+
+    /* Test 2: Copies of a shared ZStar vector are created and
+     * destroyed concurrently. */
+    {
+      ZStar<int>::Vector v(std::vector<ZStar<int> >({ZStar<int>(1),ZStar<int>(),ZStar<int>(3)}));
+      std::atomic<bool> ok(true);
+      run_threads([&v,&ok](int){
+          std::vector<ZStar<int>::Vector> copies;
+          for(int i = 0; i < 10000; ++i){
+            copies.push_back(v);
+            if(copies.back()[2] != ZStar<int>(3)) ok = false;
+            if(copies.size() > 64) copies.clear();
+          }
+        });
+      ZStar<int>::Vector w = v;
+      Test::inner_test("Shared ZStar vectors",ok && w.size() == 3 && w[0] == ZStar<int>(1));
+    }
+
+    /* Test 3: Concurrent logging */
+    {
+      std::stringstream ss;
+      Log::set_json_stream(&ss);
+      run_threads([](int t){
+          for(int i = 0; i < 1000; ++i){
+            Log::json << "json: " << t << " " << i << "\n";
+          }
+        });
+      Log::set_json_stream(0);
+      /* Each line is written by several operations, and must still
+       * arrive whole. */
+      std::set<std::pair<int,int> > seen;
+      bool whole = true;
+      std::string ln;
+      while(std::getline(ss,ln)){
+        std::stringstream ls(ln);
+        std::string prefix;
+        int t, i;
+        std::string rest;
+        if(!(ls >> prefix >> t >> i) || prefix != "json:" || (ls >> rest)){
+          whole = false;
+        }else{
+          seen.insert(std::pair<int,int>(t,i));
+        }
+      }
+      Test::inner_test("Concurrent logging",whole && int(seen.size()) == thread_count*1000);
+    }
+
+    std::string rmm =
+      "forbidden\n"
+      "  CS CS\n"
+      "data\n"
+      "  x = 0 : [0:1]\n"
+      "  y = 0 : [0:1]\n"
+      "process\n"
+      "registers\n"
+      "  $r0 = * : [0:1]\n"
+      "text\n"
+      "  %LOCKED%write: x := 1;\n"
+      "  read: $r0 := y;\n"
+      "  if $r0 = 0 then\n"
+      "    CS: nop\n"
+      "process\n"
+      "registers\n"
+      "  $r0 = * : [0:1]\n"
+      "text\n"
+      "  %LOCKED%write: y := 1;\n"
+      "  read: $r0 := x;\n"
+      "  if $r0 = 0 then\n"
+      "    CS: nop\n";
+    /* Dekker's mutual exclusion. The critical sections are
+     * reachable unless the writes are locked. */
+    std::function<Machine*(bool)> dekker =
+      [&rmm](bool locked){
+      std::string s = rmm;
+      std::string::size_type i;
+      while((i = s.find("%LOCKED%")) != std::string::npos){
+        s.replace(i,8,locked ? "locked " : "");
+      }
+      return get_machine(s);
+    };
+
+    /* Test 4: The possible writes of a shared machine are computed
+     * concurrently. */
+    {
+      Machine *m = dekker(false);
+      Machine m2(*m);
+      std::atomic<bool> ok(true);
+      const std::list<std::pair<int,Lang::MemLoc<int> > > &expected = m2.get_possible_writes();
+      run_threads([m,&expected,&ok](int){
+          if(m->get_possible_writes() != expected) ok = false;
+        });
+      Test::inner_test("Possible writes",ok && expected.size() == 2);
+      delete m;
+    }
+
+    /* Test 5, 6: Several analyses run in parallel on a shared
+     * machine, and agree with a sequential analysis. */
+    {
+      std::vector<std::string> names = {"SB","Dual"};
+      std::vector<std::function<outcome_t(const Machine&)> > engines = {reach_sb,reach_dual};
+      for(unsigned e = 0; e < engines.size(); ++e){
+        bool ok = true;
+        for(int locked = 0; locked < 2; ++locked){
+          Machine *m = dekker(locked);
+          outcome_t expected = engines[e](*m);
+          ok = ok && (expected.result == (locked ? Reachability::UNREACHABLE : Reachability::REACHABLE));
+          std::vector<outcome_t> outcomes(thread_count);
+          std::function<outcome_t(const Machine&)> &engine = engines[e];
+          run_threads([m,&engine,&outcomes](int t){
+              outcomes[t] = engine(*m);
+            });
+          for(int t = 0; t < thread_count; ++t){
+            ok = ok && outcomes[t] == expected;
+          }
+          delete m;
+        }
+        Test::inner_test("Parallel "+names[e]+" reachability",ok);
+      }
+    }
+  };
+
+};
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TEST_CONCURRENCY_H__
+#define __TEST_CONCURRENCY_H__
+
+/* Tests that the core of Memorax may be used by several threads at
+ * the same time: Expressions, ZStar vectors and machines may be
+ * shared between threads, logging may happen concurrently, and
+ * several reachability analyses may run in parallel on the same
+ * machine.
+ */
+namespace TestConcurrency{
+
+  void test();
+
+};
+
+#endif
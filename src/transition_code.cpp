@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "test.h"
+#include "transition_code.h"
+
+TransitionCode::TransitionCode(const Machine::PTransition &t,
+                               const std::function<int(const Lang::NML&)> &index,
+                               int mem_size)
+  : transition(t), op(t.instruction.get_type()),
+    pid(t.pid), source(t.source), target(t.target),
+    nml(Lang::NML::global(0)), nmli(-1), reg(-1),
+    locked(op == Lang::LOCKED), fence(t.instruction.is_fence()),
+    read_mask((mem_size+63)/64,0), write_mask((mem_size+63)/64,0),
+    any_writes(t.instruction.get_writes().size() > 0) {
+  const Lang::Stmt<int> &s = t.instruction;
+
+  switch(op){
+  case Lang::READASSERT: case Lang::READASSIGN: case Lang::WRITE:
+  case Lang::UPDATE: case Lang::DELETEE: case Lang::PROPAGATE:
+    if(s.get_memloc().get_type() != Lang::MemLoc<int>::GLOBAL_REG_DEREF){
+      nml = Lang::NML(s.get_memloc(),pid);
+      nmli = index(nml);
+    }
+    break;
+  default:
+    break;
+  }
+
+  switch(op){
+  case Lang::ASSIGNMENT: case Lang::READASSIGN:
+    reg = s.get_reg();
+    break;
+  default:
+    break;
+  }
+
+  switch(op){
+  case Lang::ASSIGNMENT: case Lang::READASSERT: case Lang::WRITE:
+    expr_regs = s.get_expr().get_registers();
+    break;
+  case Lang::ASSUME:
+    expr_regs = s.get_condition().get_registers();
+    break;
+  default:
+    break;
+  }
+
+  set_bits(read_mask,s.get_reads(),index,mem_size);
+  set_bits(write_mask,s.get_writes(),index,mem_size);
+  for(const Lang::MemLoc<int> &ml : s.get_writes()){
+    if(ml.get_type() != Lang::MemLoc<int>::GLOBAL_REG_DEREF){
+      write_nmls.insert(Lang::NML(ml,pid));
+    }
+  }
+
+  if(op == Lang::LOCKED){
+    for(int i = 0; i < s.get_statement_count(); ++i){
+      Machine::PTransition ti(source,*s.get_statement(i),target,pid);
+      children.push_back(TransitionCode(ti,index,mem_size));
+    }
+  }else if(op == Lang::SEQUENCE){
+    for(int i = 0; i < s.get_statement_count(); ++i){
+      Machine::PTransition ti(target,*s.get_statement(i),target,pid);
+      children.push_back(TransitionCode(ti,index,mem_size));
+    }
+  }
+};
+
+void TransitionCode::set_bits(std::vector<uint64_t> &mask,
+                              const std::vector<Lang::MemLoc<int> > &mls,
+                              const std::function<int(const Lang::NML&)> &index,
+                              int mem_size){
+  for(const Lang::MemLoc<int> &ml : mls){
+    if(ml.get_type() == Lang::MemLoc<int>::GLOBAL_REG_DEREF){
+      /* Any location may be accessed */
+      for(int i = 0; i < mem_size; ++i){
+        mask[i/64] |= (uint64_t(1) << (i%64));
+      }
+    }else{
+      int i = index(Lang::NML(ml,pid));
+      mask[i/64] |= (uint64_t(1) << (i%64));
+    }
+  }
+};
+
+void TransitionTable::init(const std::vector<Machine::PTransition> &ts,
+                           const std::function<int(const Lang::NML&)> &index,
+                           int mem_size){
+  codes.clear();
+  by_key.clear();
+  codes.reserve(ts.size());
+  for(const Machine::PTransition &t : ts){
+    by_key[key_t(t.pid,t.source,t.target)].push_back(codes.size());
+    codes.push_back(TransitionCode(t,index,mem_size));
+  }
+  base = ts.empty() ? 0 : &ts[0];
+  this->index = index;
+  this->mem_size = mem_size;
+};
+
+void TransitionCode::test(){
+  typedef Lang::Expr<int> E;
+  typedef Lang::MemLoc<int> ML;
+  /* Two global variables x (0), y (1), and one local variable per
+   * process (2 for P0, 3 for P1). */
+  std::function<int(const Lang::NML&)> index =
+    [](const Lang::NML &nml){
+    return nml.is_global() ? nml.get_id() : 2 + nml.get_owner();
+  };
+
+  /* Test 1: Write */
+  {
+    Machine::PTransition t(0,Lang::Stmt<int>::write(ML::global(1),E::reg(0) + E::reg(2)),1,1);
+    TransitionCode c(t,index,4);
+    Test::inner_test("Write",
+                     c.op == Lang::WRITE && c.pid == 1 && c.source == 0 && c.target == 1 &&
+                     c.nmli == 1 && c.nml == Lang::NML::global(1) && c.reg == -1 &&
+                     c.expr_regs == std::set<int>({0,2}) &&
+                     !c.reads(1) && c.writes(1) && !c.writes(0) && c.has_writes() &&
+                     c.write_nmls == VecSet<Lang::NML>::singleton(Lang::NML::global(1)) &&
+                     !c.locked && c.children.empty());
+  }
+
+  /* Test 2: Local read */
+  {
+    Machine::PTransition t(2,Lang::Stmt<int>::read_assign(1,ML::local(0)),3,1);
+    TransitionCode c(t,index,4);
+    Test::inner_test("Local read",
+                     c.op == Lang::READASSIGN && c.reg == 1 &&
+                     c.nml == Lang::NML::local(0,1) && c.nmli == 3 &&
+                     c.reads(3) && !c.reads(2) && !c.has_writes());
+  }
+
+  /* Test 3: Locked block containing a sequence */
+  {
+    std::vector<Lang::Stmt<int>::labeled_stmt_t> seq;
+    seq.push_back(Lang::Stmt<int>::read_assert(ML::global(0),E::integer(1)));
+    seq.push_back(Lang::Stmt<int>::write(ML::global(1),E::integer(2)));
+    std::vector<Lang::Stmt<int> > alts;
+    alts.push_back(Lang::Stmt<int>::sequence(seq));
+    alts.push_back(Lang::Stmt<int>::nop());
+    Machine::PTransition t(4,Lang::Stmt<int>::locked_block(alts),5,0);
+    TransitionCode c(t,index,4);
+    bool ok = c.op == Lang::LOCKED && c.locked && c.nmli == -1 &&
+      c.reads(0) && c.writes(1) && !c.writes(0) &&
+      c.children.size() == 2;
+    if(ok){
+      const TransitionCode &s = c.children[0];
+      ok = s.op == Lang::SEQUENCE && s.source == 4 && s.target == 5 &&
+        s.children.size() == 2 &&
+        s.children[0].op == Lang::READASSERT && s.children[0].nmli == 0 &&
+        s.children[0].source == 5 && s.children[0].target == 5 &&
+        s.children[1].op == Lang::WRITE && s.children[1].nmli == 1 &&
+        c.children[1].op == Lang::NOP && c.children[1].source == 4;
+    }
+    Test::inner_test("Locked block",ok);
+  }
+
+  /* Test 4: Table lookup */
+  {
+    std::vector<Machine::PTransition> ts;
+    ts.push_back(Machine::PTransition(0,Lang::Stmt<int>::nop(),1,0));
+    ts.push_back(Machine::PTransition(1,Lang::Stmt<int>::write(ML::global(0),E::integer(1)),2,0));
+    ts.push_back(Machine::PTransition(1,Lang::Stmt<int>::write(ML::global(1),E::integer(1)),2,0));
+    TransitionTable table;
+    table.init(ts,index,4);
+    /* Copies of the transitions are found, e.g. after the automaton
+     * holding them has been copied. */
+    Machine::PTransition copy(ts[1]);
+    /* The same statement in another process is not. */
+    Machine::PTransition other(1,ts[1].instruction,2,1);
+    std::unique_ptr<TransitionCode> tmp;
+    const TransitionCode &cc = table.get(copy,tmp);
+    bool copy_found = (tmp.get() == 0);
+    const TransitionCode &oc = table.get(other,tmp);
+    Test::inner_test("Table lookup",
+                     table.find(ts[0]) && table.find(ts[0])->op == Lang::NOP &&
+                     table.find(ts[1]) && table.find(ts[1])->writes(0) &&
+                     table.find(ts[2]) && table.find(ts[2])->writes(1) && !table.find(ts[2])->writes(0) &&
+                     copy_found && &cc == table.find(ts[1]) &&
+                     table.find(other) == 0 && &oc == tmp.get() && oc.pid == 1 && oc.writes(0));
+  }
+};
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TRANSITION_CODE_H__
+#define __TRANSITION_CODE_H__
+
+#include "machine.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+/* A TransitionCode is a flat description of a Machine::PTransition,
+ * computed once, so that pre-image computations do not need to
+ * traverse (and copy) the statement of the transition over and over
+ * again.
+ *
+ * It records the type of the statement, the memory location and
+ * register that it concerns, the registers of its expression, masks
+ * of the memory store entries that it reads and writes, and the
+ * transitions of the sub-statements of locked blocks and sequences.
+ */
+class TransitionCode{
+public:
+  /* Lowers the transition t. index(nml) should be the index of nml
+   * in a memory store, and mem_size the size of memory stores. */
+  TransitionCode(const Machine::PTransition &t,
+                 const std::function<int(const Lang::NML&)> &index,
+                 int mem_size);
+
+  /* The lowered transition */
+  Machine::PTransition transition;
+  Lang::stmt_t op;
+  int pid;
+  int source;
+  int target;
+  /* For statements with a unique memory location (see
+   * Lang::Stmt::get_memloc): That location from a global perspective,
+   * and its index in a memory store. Otherwise nmli is -1 and nml is
+   * arbitrary. */
+  Lang::NML nml;
+  int nmli;
+  /* The register of an assignment or assigning read, otherwise -1. */
+  int reg;
+  /* The registers of the expression or condition of the statement. */
+  std::set<int> expr_regs;
+  /* All memory locations written by the statement (including
+   * updates), from a global perspective. */
+  VecSet<Lang::NML> write_nmls;
+  /* The statement is a locked block, or a fence */
+  bool locked;
+  bool fence;
+  /* For locked blocks and sequences: The transitions for the
+   * sub-statements, in order. The sub-transitions of a locked block
+   * have the same source and target as the block. The sub-transitions
+   * of a sequence all have target as both source and target.
+   */
+  std::vector<TransitionCode> children;
+
+  /* Returns true iff the statement may read / write memory store
+   * entry i. */
+  bool reads(int i) const { return test_bit(read_mask,i); };
+  bool writes(int i) const { return test_bit(write_mask,i); };
+  bool has_writes() const { return any_writes; };
+
+  static void test();
+private:
+  /* Bit i%64 of mask[i/64] is set iff entry i is read / written. */
+  std::vector<uint64_t> read_mask;
+  std::vector<uint64_t> write_mask;
+  bool any_writes;
+
+  static bool test_bit(const std::vector<uint64_t> &mask, int i){
+    return mask[i/64] & (uint64_t(1) << (i%64));
+  };
+  void set_bits(std::vector<uint64_t> &mask,
+                const std::vector<Lang::MemLoc<int> > &mls,
+                const std::function<int(const Lang::NML&)> &index,
+                int mem_size);
+};
+
+/* A TransitionTable holds the TransitionCodes of a fixed vector of
+ * transitions (typically Common::all_transitions of some constraint
+ * class).
+ *
+ * Elements of that vector are looked up by address in constant
+ * time. Other transitions (e.g. copies taken from an automaton that
+ * has since been detached by copy-on-write) are looked up by value:
+ * They are keyed on their process, source and target, and the
+ * transitions sharing a key are told apart by comparing them to the
+ * lowered transitions.
+ */
+class TransitionTable{
+public:
+  TransitionTable() : base(0), mem_size(0) {};
+  /* Lower all transitions in ts. ts must not be modified afterwards. */
+  void init(const std::vector<Machine::PTransition> &ts,
+            const std::function<int(const Lang::NML&)> &index,
+            int mem_size);
+  /* Returns the code of t if t is equal to an element of the vector
+   * given to init, otherwise null. */
+  const TransitionCode *find(const Machine::PTransition &t) const{
+    if(base && base <= &t && &t < base + codes.size()){
+      return &codes[&t - base];
+    }
+    auto it = by_key.find(key_t(t.pid,t.source,t.target));
+    if(it == by_key.end()) return 0;
+    for(int i : it->second){
+      if(codes[i].transition == t) return &codes[i];
+    }
+    return 0;
+  };
+  /* Returns the code of t. If t is not an element of the vector
+   * given to init, then t is lowered into tmp, which is returned. */
+  const TransitionCode &get(const Machine::PTransition &t,
+                            std::unique_ptr<TransitionCode> &tmp) const{
+    const TransitionCode *c = find(t);
+    if(c) return *c;
+    tmp.reset(new TransitionCode(t,index,mem_size));
+    return *tmp;
+  };
+private:
+  /* (pid, source, target) */
+  typedef std::tuple<int,int,int> key_t;
+  /* The first element of the vector given to init */
+  const Machine::PTransition *base;
+  std::vector<TransitionCode> codes;
+  /* Maps each key to the indices in codes of the transitions with
+   * that key. */
+  std::map<key_t,std::vector<int> > by_key;
+  std::function<int(const Lang::NML&)> index;
+  int mem_size;
+};
+
+#endif
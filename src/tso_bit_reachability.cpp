@@ -0,0 +1,1161 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "budget.h"
+#include "heartbeat.h"
+#include "log.h"
+#include "preprocessor.h"
+#include "stats.h"
+#include "test.h"
+#include "tso_bit_reachability.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+/* Common contains the state layout and the precomputed transitions
+ * for one machine, memory model and buffer bound.
+ *
+ * A state is an array of words words. Each component of the state
+ * (control states, memory, registers, buffers) is stored in a
+ * bitfield. A bitfield never straddles two words. Unused buffer slots
+ * are always zero, so that each state has a unique representation.
+ */
+class TsoBitReachability::Common{
+public:
+  Common(const Machine &m, model_t model, int k);
+
+  /* A bitfield storing integer values in [offset,offset+mask]. */
+  struct bitfield{
+    int element;
+    int shift;
+    data_t mask;
+    int offset;
+  };
+
+  int get(const data_t *s, const bitfield &bf) const{
+    return int((s[bf.element] >> bf.shift) & bf.mask) + bf.offset;
+  };
+  void set(data_t *s, const bitfield &bf, int v) const{
+    s[bf.element] = (s[bf.element] & ~(bf.mask << bf.shift)) | (data_t(v - bf.offset) << bf.shift);
+  };
+  /* Sets the bits of bf to zero. */
+  void clear(data_t *s, const bitfield &bf) const{
+    s[bf.element] &= ~(bf.mask << bf.shift);
+  };
+
+  const Machine &machine;
+  model_t model;
+  int k;
+  int proc_count;
+  /* The number of words in each state. */
+  int words;
+
+  /* All memory locations. Globals first, then the locals of each
+   * process in order. */
+  std::vector<Lang::NML> all_nmls;
+  int nml_index(const Lang::NML &nml) const{
+    if(nml.is_global()) return nml.get_id();
+    return ml_offsets[nml.get_owner()] + nml.get_id();
+  };
+
+  /* pcs[p] is the control state of process p. */
+  std::vector<bitfield> pcs;
+  /* mem[i] is the memory value of all_nmls[i]. */
+  std::vector<bitfield> mem;
+  /* regs[p][r] is the value of register r of process p. */
+  std::vector<std::vector<bitfield> > regs;
+  /* TSO: tso_len[p] is the number of writes in the buffer of process
+   * p. tso_nml[p][j] and tso_val[p][j] are the memory location index
+   * and value of the j:th oldest write in the buffer. */
+  std::vector<bitfield> tso_len;
+  std::vector<std::vector<bitfield> > tso_nml, tso_val;
+  /* PSO: pso_len[p][i] is the number of writes to all_nmls[i] in the
+   * buffers of process p. pso_val[p][i][j] is the value of the j:th
+   * oldest such write. */
+  std::vector<std::vector<bitfield> > pso_len;
+  std::vector<std::vector<std::vector<bitfield> > > pso_val;
+
+  /* All instruction transitions of the machine, followed by all
+   * update transitions. */
+  std::vector<Machine::PTransition> all_transitions;
+  /* trans_per_cs[p][q] contains pointers to the instruction
+   * transitions of process p with source q. */
+  std::vector<std::vector<std::vector<const Machine::PTransition*> > > trans_per_cs;
+  /* update_trans[p][q][i] is the transition describing that the
+   * oldest write to all_nmls[i] by process p leaves its buffer for
+   * memory while p is in control state q. */
+  std::vector<std::vector<std::vector<const Machine::PTransition*> > > update_trans;
+
+  /* Returns all initial states, each as a vector of words words. */
+  std::vector<std::vector<data_t> > initial_states() const;
+  bool is_forbidden(const data_t *s) const;
+  /* Returns the value of all_nmls[nmli] as seen by process pid. */
+  int read(const data_t *s, int pid, int nmli) const;
+  /* Returns true iff all buffers of process pid are empty. */
+  bool buffers_empty(const data_t *s, int pid) const;
+  /* Appends to succ all states (words words each) that are reachable
+   * from s by t, where t is an instruction transition. Sets
+   * bound_hit to true if t is disabled in s because of a full
+   * buffer. */
+  void post(const data_t *s, const Machine::PTransition &t,
+            std::vector<data_t> &succ, bool &bound_hit) const;
+  /* Appends to succ the state reached from s when the oldest
+   * buffered write of process pid to all_nmls[nmli] reaches memory.
+   *
+   * Pre: Such a write exists, and under TSO it is the oldest write
+   * in the buffer of pid.
+   */
+  void flush(const data_t *s, int pid, int nmli, std::vector<data_t> &succ) const;
+  /* Appends to succ every successor of s, and to succ_trans the
+   * corresponding transitions. */
+  void successors(const data_t *s, std::vector<data_t> &succ,
+                  std::vector<const Machine::PTransition*> &succ_trans,
+                  bool &bound_hit) const;
+  /* A 64-bit hash of s. Never returns 0. */
+  data_t hash(const data_t *s) const;
+
+  class RegVal{
+  public:
+    RegVal(int pid, const Common &common, const data_t *s)
+      : pid(pid), common(common), s(s) {};
+    int operator[](int r) const{
+      return common.get(s,common.regs[pid][r]);
+    };
+  private:
+    int pid;
+    const Common &common;
+    const data_t *s;
+  };
+private:
+  std::vector<int> ml_offsets;
+  /* Executes s atomically by process pid on each state in states,
+   * directly on memory. Replaces states (words words each) by the
+   * resulting states. */
+  void exec_atomic(const Lang::Stmt<int> &s, int pid, std::vector<data_t> &states) const;
+  /* Executes the non-compound statement s atomically by process pid
+   * on state st. Returns false if s is not enabled. */
+  bool step_atomic(const Lang::Stmt<int> &s, int pid, data_t *st) const;
+  /* Pushes a write of val to all_nmls[nmli] onto the buffer of pid in
+   * st. Returns false if the buffer is full. */
+  bool push_write(data_t *st, int pid, int nmli, int val) const;
+};
+
+TsoBitReachability::Common::Common(const Machine &m, model_t model, int k)
+  : machine(m), model(model), k(k), proc_count(m.automata.size()) {
+  if(k < 1){
+    throw new std::logic_error("TsoBitReachability: Buffer bound must be at least 1.");
+  }
+
+  /* Set up ml_offsets and all_nmls */
+  for(unsigned i = 0; i < machine.gvars.size(); ++i){
+    all_nmls.push_back(Lang::NML::global(i));
+  }
+  for(int p = 0; p < proc_count; ++p){
+    ml_offsets.push_back(all_nmls.size());
+    for(unsigned i = 0; i < machine.lvars[p].size(); ++i){
+      all_nmls.push_back(Lang::NML::local(i,p));
+    }
+  }
+
+  /* Compute a sequence of non-overlapping bitfields. */
+  int element = 0, bit = 0;
+  std::function<bitfield(int,int)> next =
+    [&element,&bit](int lb, int ub){
+    data_t range = data_t(std::int64_t(ub) - std::int64_t(lb));
+    int width = 0;
+    while(width < 64 && (range >> width)) ++width;
+    if(bit + width > 64){
+      ++element;
+      bit = 0;
+    }
+    bitfield bf;
+    bf.element = element;
+    bf.shift = bit;
+    bf.mask = (width == 64) ? ~data_t(0) : ((data_t(1) << width) - 1);
+    bf.offset = lb;
+    bit += width;
+    if(bit == 64){
+      ++element;
+      bit = 0;
+    }
+    return bf;
+  };
+  std::function<const Lang::VarDecl::Domain&(const Lang::VarDecl&)> finite =
+    [](const Lang::VarDecl &decl)->const Lang::VarDecl::Domain&{
+    if(!decl.domain.is_finite()){
+      throw new std::logic_error("TsoBitReachability: Memory location or register "+
+                                 decl.name+" has an infinite domain. Not supported.");
+    }
+    return decl.domain;
+  };
+
+  for(int p = 0; p < proc_count; ++p){
+    pcs.push_back(next(0,int(machine.automata[p].get_states().size())-1));
+  }
+  int vmin = 0, vmax = 0;
+  for(unsigned i = 0; i < all_nmls.size(); ++i){
+    const Lang::VarDecl::Domain &dom = finite(machine.get_var_decl(all_nmls[i]));
+    mem.push_back(next(dom.get_lower_bound(),dom.get_upper_bound()));
+    if(i == 0 || dom.get_lower_bound() < vmin) vmin = dom.get_lower_bound();
+    if(i == 0 || dom.get_upper_bound() > vmax) vmax = dom.get_upper_bound();
+  }
+  for(int p = 0; p < proc_count; ++p){
+    regs.push_back(std::vector<bitfield>());
+    for(unsigned r = 0; r < machine.regs[p].size(); ++r){
+      const Lang::VarDecl::Domain &dom = finite(machine.regs[p][r]);
+      regs[p].push_back(next(dom.get_lower_bound(),dom.get_upper_bound()));
+    }
+  }
+  for(int p = 0; p < proc_count; ++p){
+    if(model == TSO){
+      tso_len.push_back(next(0,k));
+      tso_nml.push_back(std::vector<bitfield>());
+      tso_val.push_back(std::vector<bitfield>());
+      for(int j = 0; j < k; ++j){
+        tso_nml[p].push_back(next(0,std::max(int(all_nmls.size())-1,0)));
+        tso_val[p].push_back(next(vmin,vmax));
+      }
+    }else{
+      pso_len.push_back(std::vector<bitfield>());
+      pso_val.push_back(std::vector<std::vector<bitfield> >(all_nmls.size()));
+      for(unsigned i = 0; i < all_nmls.size(); ++i){
+        const Lang::VarDecl::Domain &dom = machine.get_var_decl(all_nmls[i]).domain;
+        pso_len[p].push_back(next(0,k));
+        for(int j = 0; j < k; ++j){
+          pso_val[p][i].push_back(next(dom.get_lower_bound(),dom.get_upper_bound()));
+        }
+      }
+    }
+  }
+  words = element + (bit ? 1 : 0);
+  if(words == 0) words = 1;
+  Log::debug << "TsoBitReachability::Common: " << words << " words per state.\n";
+
+  /* Set up the transitions. Pointers into all_transitions are taken
+   * only after it has been completely filled. */
+  for(int p = 0; p < proc_count; ++p){
+    const std::vector<Automaton::State> &states = machine.automata[p].get_states();
+    for(unsigned q = 0; q < states.size(); ++q){
+      for(auto it = states[q].fwd_transitions.begin(); it != states[q].fwd_transitions.end(); ++it){
+        all_transitions.push_back(Machine::PTransition(**it,p));
+      }
+    }
+  }
+  int instr_count = all_transitions.size();
+  for(int p = 0; p < proc_count; ++p){
+    int q_count = machine.automata[p].get_states().size();
+    for(int q = 0; q < q_count; ++q){
+      for(unsigned i = 0; i < all_nmls.size(); ++i){
+        Lang::MemLoc<int> ml = all_nmls[i].localize(p);
+        all_transitions.push_back(Machine::PTransition(q,Lang::Stmt<int>::update(p,VecSet<Lang::MemLoc<int> >::singleton(ml)),q,p));
+      }
+    }
+  }
+  trans_per_cs.resize(proc_count);
+  update_trans.resize(proc_count);
+  for(int p = 0; p < proc_count; ++p){
+    int q_count = machine.automata[p].get_states().size();
+    trans_per_cs[p].resize(q_count);
+    update_trans[p].resize(q_count);
+  }
+  for(int i = 0; i < int(all_transitions.size()); ++i){
+    const Machine::PTransition *t = &all_transitions[i];
+    if(i < instr_count){
+      trans_per_cs[t->pid][t->source].push_back(t);
+    }else{
+      update_trans[t->pid][t->source].push_back(t);
+    }
+  }
+};
+
+std::vector<std::vector<TsoBitReachability::data_t> > TsoBitReachability::Common::initial_states() const{
+  /* The memory locations and registers, in order, as bitfields with
+   * their declarations. */
+  std::vector<const bitfield*> bfs;
+  std::vector<const Lang::VarDecl*> decls;
+  for(unsigned i = 0; i < all_nmls.size(); ++i){
+    bfs.push_back(&mem[i]);
+    decls.push_back(&machine.get_var_decl(all_nmls[i]));
+  }
+  for(int p = 0; p < proc_count; ++p){
+    for(unsigned r = 0; r < machine.regs[p].size(); ++r){
+      bfs.push_back(&regs[p][r]);
+      decls.push_back(&machine.regs[p][r]);
+    }
+  }
+
+  std::vector<std::vector<data_t> > res;
+  std::vector<data_t> s(words,0);
+  for(unsigned i = 0; i < bfs.size(); ++i){
+    if(decls[i]->value.is_wild()){
+      set(s.data(),*bfs[i],decls[i]->domain.get_lower_bound());
+    }else{
+      set(s.data(),*bfs[i],decls[i]->value.get_value());
+    }
+  }
+  /* Enumerate the values of the wild memory locations and registers
+   * as an odometer. */
+  while(true){
+    res.push_back(s);
+    unsigned i = 0;
+    for(; i < bfs.size(); ++i){
+      if(!decls[i]->value.is_wild()) continue;
+      int v = get(s.data(),*bfs[i]);
+      if(v < decls[i]->domain.get_upper_bound()){
+        set(s.data(),*bfs[i],v+1);
+        break;
+      }
+      set(s.data(),*bfs[i],decls[i]->domain.get_lower_bound());
+    }
+    if(i == bfs.size()) break;
+  }
+  return res;
+};
+
+bool TsoBitReachability::Common::is_forbidden(const data_t *s) const{
+  for(const std::vector<int> &fb : machine.forbidden){
+    bool match = true;
+    for(int p = 0; match && p < proc_count; ++p){
+      match = (fb[p] == get(s,pcs[p]));
+    }
+    if(match) return true;
+  }
+  return false;
+};
+
+int TsoBitReachability::Common::read(const data_t *s, int pid, int nmli) const{
+  if(model == TSO){
+    for(int j = get(s,tso_len[pid])-1; j >= 0; --j){
+      if(get(s,tso_nml[pid][j]) == nmli){
+        return get(s,tso_val[pid][j]);
+      }
+    }
+  }else{
+    int len = get(s,pso_len[pid][nmli]);
+    if(len){
+      return get(s,pso_val[pid][nmli][len-1]);
+    }
+  }
+  return get(s,mem[nmli]);
+};
+
+bool TsoBitReachability::Common::buffers_empty(const data_t *s, int pid) const{
+  if(model == TSO){
+    return get(s,tso_len[pid]) == 0;
+  }
+  for(unsigned i = 0; i < all_nmls.size(); ++i){
+    if(get(s,pso_len[pid][i])) return false;
+  }
+  return true;
+};
+
+bool TsoBitReachability::Common::push_write(data_t *st, int pid, int nmli, int val) const{
+  if(model == TSO){
+    int len = get(st,tso_len[pid]);
+    if(len == k) return false;
+    set(st,tso_nml[pid][len],nmli);
+    set(st,tso_val[pid][len],val);
+    set(st,tso_len[pid],len+1);
+  }else{
+    int len = get(st,pso_len[pid][nmli]);
+    if(len == k) return false;
+    set(st,pso_val[pid][nmli][len],val);
+    set(st,pso_len[pid][nmli],len+1);
+  }
+  return true;
+};
+
+void TsoBitReachability::Common::flush(const data_t *s, int pid, int nmli, std::vector<data_t> &succ) const{
+  std::size_t off = succ.size();
+  succ.insert(succ.end(),s,s+words);
+  data_t *st = succ.data() + off;
+  if(model == TSO){
+    int len = get(s,tso_len[pid]);
+    assert(len > 0 && get(s,tso_nml[pid][0]) == nmli);
+    set(st,mem[nmli],get(s,tso_val[pid][0]));
+    for(int j = 1; j < len; ++j){
+      set(st,tso_nml[pid][j-1],get(s,tso_nml[pid][j]));
+      set(st,tso_val[pid][j-1],get(s,tso_val[pid][j]));
+    }
+    clear(st,tso_nml[pid][len-1]);
+    clear(st,tso_val[pid][len-1]);
+    set(st,tso_len[pid],len-1);
+  }else{
+    int len = get(s,pso_len[pid][nmli]);
+    assert(len > 0);
+    set(st,mem[nmli],get(s,pso_val[pid][nmli][0]));
+    for(int j = 1; j < len; ++j){
+      set(st,pso_val[pid][nmli][j-1],get(s,pso_val[pid][nmli][j]));
+    }
+    clear(st,pso_val[pid][nmli][len-1]);
+    set(st,pso_len[pid][nmli],len-1);
+  }
+};
+
+bool TsoBitReachability::Common::step_atomic(const Lang::Stmt<int> &s, int pid, data_t *st) const{
+  RegVal regval(pid,*this,st);
+  switch(s.get_type()){
+  case Lang::NOP: case Lang::FENCE: case Lang::SSFENCE: case Lang::LLFENCE:
+    return true;
+  case Lang::ASSIGNMENT:
+    {
+      int v = s.get_expr().eval<RegVal,int*>(regval,0);
+      if(!machine.regs[pid][s.get_reg()].domain.member(v)) return false;
+      set(st,regs[pid][s.get_reg()],v);
+      return true;
+    }
+  case Lang::ASSUME:
+    return s.get_condition().eval<RegVal,int*>(regval,0);
+  case Lang::READASSERT:
+    {
+      int nmli = nml_index(Lang::NML(s.get_memloc(),pid));
+      return get(st,mem[nmli]) == s.get_expr().eval<RegVal,int*>(regval,0);
+    }
+  case Lang::READASSIGN:
+    {
+      int v = get(st,mem[nml_index(Lang::NML(s.get_memloc(),pid))]);
+      if(!machine.regs[pid][s.get_reg()].domain.member(v)) return false;
+      set(st,regs[pid][s.get_reg()],v);
+      return true;
+    }
+  case Lang::WRITE:
+    {
+      Lang::NML nml(s.get_memloc(),pid);
+      int v = s.get_expr().eval<RegVal,int*>(regval,0);
+      if(!machine.get_var_decl(nml).domain.member(v)) return false;
+      set(st,mem[nml_index(nml)],v);
+      return true;
+    }
+  default:
+    throw new std::logic_error("TsoBitReachability: Unsupported statement in locked block.");
+  }
+};
+
+void TsoBitReachability::Common::exec_atomic(const Lang::Stmt<int> &s, int pid, std::vector<data_t> &states) const{
+  switch(s.get_type()){
+  case Lang::SEQUENCE:
+    for(int i = 0; i < s.get_statement_count() && states.size(); ++i){
+      exec_atomic(*s.get_statement(i),pid,states);
+    }
+    break;
+  case Lang::LOCKED:
+    {
+      std::vector<data_t> res;
+      for(int i = 0; i < s.get_statement_count(); ++i){
+        std::vector<data_t> alt = states;
+        exec_atomic(*s.get_statement(i),pid,alt);
+        res.insert(res.end(),alt.begin(),alt.end());
+      }
+      states.swap(res);
+      break;
+    }
+  default:
+    {
+      std::size_t n = 0;
+      for(std::size_t off = 0; off < states.size(); off += words){
+        if(step_atomic(s,pid,states.data()+off)){
+          std::copy(states.begin()+off,states.begin()+off+words,states.begin()+n);
+          n += words;
+        }
+      }
+      states.resize(n);
+    }
+  }
+};
+
+void TsoBitReachability::Common::post(const data_t *s, const Machine::PTransition &t,
+                                      std::vector<data_t> &succ, bool &bound_hit) const{
+  const int pid = t.pid;
+  std::size_t off = succ.size();
+  RegVal regval(pid,*this,s);
+  /* Make a copy of s at the end of succ, with the control state of
+   * pid updated. Returns a pointer to the copy. */
+  std::function<data_t*()> emit =
+    [this,&succ,off,s,&t]()->data_t*{
+    succ.resize(off+words);
+    std::copy(s,s+words,succ.begin()+off);
+    set(succ.data()+off,pcs[t.pid],t.target);
+    return succ.data()+off;
+  };
+  const Lang::Stmt<int> &stmt = t.instruction;
+  switch(stmt.get_type()){
+  case Lang::NOP: case Lang::LLFENCE:
+    emit();
+    break;
+  case Lang::ASSIGNMENT:
+    {
+      int v = stmt.get_expr().eval<RegVal,int*>(regval,0);
+      if(machine.regs[pid][stmt.get_reg()].domain.member(v)){
+        set(emit(),regs[pid][stmt.get_reg()],v);
+      }
+      break;
+    }
+  case Lang::ASSUME:
+    if(stmt.get_condition().eval<RegVal,int*>(regval,0)){
+      emit();
+    }
+    break;
+  case Lang::READASSERT:
+    {
+      int nmli = nml_index(Lang::NML(stmt.get_memloc(),pid));
+      if(read(s,pid,nmli) == stmt.get_expr().eval<RegVal,int*>(regval,0)){
+        emit();
+      }
+      break;
+    }
+  case Lang::READASSIGN:
+    {
+      int v = read(s,pid,nml_index(Lang::NML(stmt.get_memloc(),pid)));
+      if(machine.regs[pid][stmt.get_reg()].domain.member(v)){
+        set(emit(),regs[pid][stmt.get_reg()],v);
+      }
+      break;
+    }
+  case Lang::WRITE:
+    {
+      Lang::NML nml(stmt.get_memloc(),pid);
+      int v = stmt.get_expr().eval<RegVal,int*>(regval,0);
+      if(machine.get_var_decl(nml).domain.member(v)){
+        if(!push_write(emit(),pid,nml_index(nml),v)){
+          succ.resize(off);
+          bound_hit = true;
+        }
+      }
+      break;
+    }
+  case Lang::FENCE:
+    if(buffers_empty(s,pid)){
+      emit();
+    }
+    break;
+  case Lang::SSFENCE:
+    if(model == TSO || buffers_empty(s,pid)){
+      emit();
+    }
+    break;
+  case Lang::LOCKED:
+    if(buffers_empty(s,pid)){
+      std::vector<data_t> states(s,s+words);
+      set(states.data(),pcs[pid],t.target);
+      exec_atomic(stmt,pid,states);
+      succ.insert(succ.end(),states.begin(),states.end());
+    }
+    break;
+  default:
+    throw new std::logic_error("TsoBitReachability: Unsupported transition: "+t.to_string(machine));
+  }
+};
+
+void TsoBitReachability::Common::successors(const data_t *s, std::vector<data_t> &succ,
+                                            std::vector<const Machine::PTransition*> &succ_trans,
+                                            bool &bound_hit) const{
+  for(int p = 0; p < proc_count; ++p){
+    int pc = get(s,pcs[p]);
+    for(const Machine::PTransition *t : trans_per_cs[p][pc]){
+      post(s,*t,succ,bound_hit);
+      succ_trans.resize(succ.size()/words,t);
+    }
+    if(model == TSO){
+      if(get(s,tso_len[p])){
+        int nmli = get(s,tso_nml[p][0]);
+        flush(s,p,nmli,succ);
+        succ_trans.push_back(update_trans[p][pc][nmli]);
+      }
+    }else{
+      for(unsigned i = 0; i < all_nmls.size(); ++i){
+        if(get(s,pso_len[p][i])){
+          flush(s,p,i,succ);
+          succ_trans.push_back(update_trans[p][pc][i]);
+        }
+      }
+    }
+  }
+};
+
+TsoBitReachability::data_t TsoBitReachability::Common::hash(const data_t *s) const{
+  data_t h = 0x9e3779b97f4a7c15ULL;
+  for(int i = 0; i < words; ++i){
+    h ^= s[i];
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+  }
+  return h ? h : 1;
+};
+
+TsoBitReachability::HashCompactSet::HashCompactSet() : table(1024,0), count(0) {};
+
+bool TsoBitReachability::HashCompactSet::insert(data_t h){
+  if(h == 0) h = 1;
+  if(2*(count+1) > long(table.size())){
+    /* Grow, keeping the load factor at most 1/2 */
+    std::vector<data_t> old(table.size()*2,0);
+    old.swap(table);
+    for(data_t g : old){
+      if(g){
+        std::size_t i = g & (table.size()-1);
+        while(table[i]) i = (i+1) & (table.size()-1);
+        table[i] = g;
+      }
+    }
+  }
+  std::size_t i = h & (table.size()-1);
+  while(table[i]){
+    if(table[i] == h) return false;
+    i = (i+1) & (table.size()-1);
+  }
+  table[i] = h;
+  ++count;
+  return true;
+};
+
+Reachability::Result *TsoBitReachability::reachability(Reachability::Arg *arg) const{
+  const Machine &machine = arg->machine;
+  model_t model = TSO;
+  int k = 1;
+  if(Arg *targ = dynamic_cast<Arg*>(arg)){
+    model = targ->model;
+    k = targ->k;
+  }
+  Result *result = new Result(machine);
+  result->timer.start();
+  result->result = UNREACHABLE;
+
+  Common common(machine,model,k);
+  const int words = common.words;
+
+  /* parents[id] is the id of the parent of the state with id id, and
+   * the transition leading from the parent to it. Initial states have
+   * parent -1. */
+  std::vector<std::pair<long,const Machine::PTransition*> > parents;
+  /* The states that have been found but not explored, words words
+   * each, and their ids. */
+  std::deque<data_t> queue;
+  std::deque<long> queue_ids;
+  HashCompactSet visited;
+  /* True iff some write was disabled by a full buffer */
+  bool bound_hit = false;
+  long found = -1;
+
+  /* Construct the witness trace ending in the state with id id. */
+  std::function<void(long)> set_trace =
+    [&result,&parents](long id){
+    result->trace = new Trace(0);
+    while(parents[id].first >= 0){
+      result->trace->push_front(0,*parents[id].second);
+      id = parents[id].first;
+    }
+  };
+
+  {
+    std::vector<std::vector<data_t> > init = common.initial_states();
+    for(unsigned i = 0; found < 0 && i < init.size(); ++i){
+      ++result->generated_constraints;
+      if(visited.insert(common.hash(init[i].data()))){
+        long id = parents.size();
+        parents.push_back(std::make_pair(-1l,(const Machine::PTransition*)0));
+        if(common.is_forbidden(init[i].data())){
+          found = id;
+        }
+        queue.insert(queue.end(),init[i].begin(),init[i].end());
+        queue_ids.push_back(id);
+      }
+    }
+  }
+
+  Heartbeat heartbeat("TsoBitReachability");
+  Budget own_budget;
+  Budget &budget = arg->budget ? *arg->budget : own_budget;
+  /* The number of generated states that were already visited */
+  long revisited = 0;
+  std::vector<data_t> s(words), succ;
+  std::vector<const Machine::PTransition*> succ_trans;
+  while(found < 0 && queue_ids.size()){
+    Budget::exhausted_t exhausted = budget.check(result->generated_constraints);
+    if(exhausted != Budget::NOT_EXHAUSTED){
+      result->result = FAILURE;
+      result->failure_reason = Budget::to_string(exhausted);
+      break;
+    }
+    if(heartbeat.due()){
+      Heartbeat::sample_t hs;
+      hs.generated = result->generated_constraints;
+      hs.queued = queue_ids.size();
+      hs.stored = visited.size();
+      hs.subsumed = revisited;
+      heartbeat.beat(hs);
+    }
+    long id;
+    {
+      Stats::Probe probe(Stats::POP);
+      std::copy(queue.begin(),queue.begin()+words,s.begin());
+      queue.erase(queue.begin(),queue.begin()+words);
+      id = queue_ids.front();
+      queue_ids.pop_front();
+    }
+
+    succ.clear();
+    succ_trans.clear();
+    {
+      Stats::Probe probe(Stats::POST);
+      common.successors(s.data(),succ,succ_trans,bound_hit);
+    }
+
+    for(unsigned i = 0; found < 0 && i < succ_trans.size(); ++i){
+      const data_t *child = succ.data() + i*words;
+      ++result->generated_constraints;
+      bool is_new;
+      {
+        Stats::Probe probe(Stats::VISITED);
+        is_new = visited.insert(common.hash(child));
+      }
+      if(!is_new){
+        ++revisited;
+        continue;
+      }
+      long cid = parents.size();
+      parents.push_back(std::make_pair(id,succ_trans[i]));
+      if(common.is_forbidden(child)){
+        found = cid;
+      }
+      queue.insert(queue.end(),child,child+words);
+      queue_ids.push_back(cid);
+    }
+  }
+
+  if(found >= 0){
+    result->result = REACHABLE;
+    set_trace(found);
+  }else if(result->result == UNREACHABLE && bound_hit){
+    result->result = FAILURE;
+    std::stringstream ss;
+    ss << "no witness within buffer bound " << k;
+    result->failure_reason = ss.str();
+  }else if(result->result == UNREACHABLE){
+    /* The visited set is hash compacted, so some states may have
+     * been wrongly considered visited. */
+    result->result = FAILURE;
+    result->failure_reason = "probably unreachable (hash compaction)";
+  }
+  result->stored_constraints = visited.size();
+
+  result->timer.stop();
+  return result;
+};
+
+Trace *TsoBitReachability::replay(const Machine &m, const std::vector<Machine::PTransition> &guide,
+                                  int slack, long max_states){
+  /* Every buffered write in a replay stems from a write in guide, or
+   * from one of the slack steps. */
+  int k = std::max(1,slack);
+  for(const Machine::PTransition &g : guide){
+    if(g.instruction.get_type() == Lang::WRITE) ++k;
+  }
+  Common common(m,TSO,k);
+  const int words = common.words;
+
+  /* Returns true iff the instruction t of m can stand in for the
+   * instruction g of guide. */
+  std::function<bool(const Lang::Stmt<int>&,const Lang::Stmt<int>&)> matches =
+    [](const Lang::Stmt<int> &t, const Lang::Stmt<int> &g){
+    if(t.compare(g,false) == 0) return true;
+    if(t.get_type() == Lang::LOCKED && g.get_type() != Lang::LOCKED){
+      return t.get_statement_count() == 1 && t.get_statement(0)->compare(g,false) == 0;
+    }
+    if(g.get_type() == Lang::LOCKED && t.get_type() != Lang::LOCKED){
+      return g.get_statement_count() == 1 && g.get_statement(0)->compare(t,false) == 0;
+    }
+    return false;
+  };
+
+  /* The transitions leading from an initial state to the current
+   * state of the search. */
+  std::vector<const Machine::PTransition*> path;
+  HashCompactSet visited;
+  long explored = 0;
+  bool bound_hit = false;
+
+  /* Searches from s, where the first i elements of guide have been
+   * followed and slack_left steps that do not follow guide remain.
+   * Returns true iff a forbidden state is found, in which case path
+   * leads to it. */
+  std::function<bool(const data_t*,unsigned,int)> search;
+
+  /* Flushes the whole buffer of process pid in s, appending the
+   * update transitions to path. */
+  std::function<void(std::vector<data_t>&,int)> flush_all =
+    [&common,&path,words](std::vector<data_t> &s, int pid){
+    std::vector<data_t> succ;
+    while(!common.buffers_empty(s.data(),pid)){
+      int nmli = common.get(s.data(),common.tso_nml[pid][0]);
+      path.push_back(common.update_trans[pid][common.get(s.data(),common.pcs[pid])][nmli]);
+      succ.clear();
+      common.flush(s.data(),pid,nmli,succ);
+      std::copy(succ.begin(),succ.begin()+words,s.begin());
+    }
+  };
+
+  /* Executes the instruction transition t from s, after flushing the
+   * buffer of its process if t requires that, and continues the
+   * search from each resulting state. If atomic is set, then the
+   * buffer is flushed also before and after t, so that t takes effect
+   * as if it were in a locked block. */
+  std::function<bool(const data_t*,const Machine::PTransition*,bool,unsigned,int)> try_instr =
+    [&](const data_t *s, const Machine::PTransition *t, bool atomic, unsigned i, int slack_left){
+    std::size_t path_len = path.size();
+    std::vector<data_t> st(s,s+words);
+    Lang::stmt_t type = t->instruction.get_type();
+    if(atomic || type == Lang::LOCKED || type == Lang::FENCE){
+      flush_all(st,t->pid);
+    }
+    std::vector<data_t> succ;
+    common.post(st.data(),*t,succ,bound_hit);
+    path.push_back(t);
+    std::size_t post_len = path.size();
+    for(std::size_t off = 0; off < succ.size(); off += words){
+      std::vector<data_t> child(succ.begin()+off,succ.begin()+off+words);
+      if(atomic) flush_all(child,t->pid);
+      if(search(child.data(),i,slack_left)) return true;
+      path.resize(post_len);
+    }
+    path.resize(path_len);
+    return false;
+  };
+
+  /* Flushes the oldest write of pid from s and continues the
+   * search. Pre: The buffer of pid is not empty. */
+  std::function<bool(const data_t*,int,unsigned,int)> try_flush =
+    [&](const data_t *s, int pid, unsigned i, int slack_left){
+    int nmli = common.get(s,common.tso_nml[pid][0]);
+    std::vector<data_t> succ;
+    common.flush(s,pid,nmli,succ);
+    path.push_back(common.update_trans[pid][common.get(s,common.pcs[pid])][nmli]);
+    if(search(succ.data(),i,slack_left)) return true;
+    path.pop_back();
+    return false;
+  };
+
+  search = [&](const data_t *s, unsigned i, int slack_left){
+    if(common.is_forbidden(s)) return true;
+    if(explored >= max_states) return false;
+    data_t h = common.hash(s);
+    h ^= (data_t(i) << 8 | data_t(slack_left)) * 0x9e3779b97f4a7c15ULL;
+    if(!visited.insert(h)) return false;
+    ++explored;
+
+    int pid = -1;
+    if(i < guide.size() && guide[i].pid < common.proc_count){
+      const Machine::PTransition &g = guide[i];
+      pid = g.pid;
+      if(g.instruction.get_type() == Lang::UPDATE){
+        if(common.buffers_empty(s,pid)){
+          if(search(s,i+1,slack_left)) return true;
+        }else if(try_flush(s,pid,i+1,slack_left)){
+          return true;
+        }
+      }else{
+        for(const Machine::PTransition *t : common.trans_per_cs[pid][common.get(s,common.pcs[pid])]){
+          if(matches(t->instruction,g.instruction)){
+            bool atomic = g.instruction.get_type() == Lang::LOCKED &&
+              t->instruction.get_type() != Lang::LOCKED;
+            if(try_instr(s,t,atomic,i+1,slack_left)) return true;
+          }
+        }
+      }
+    }
+
+    if(slack_left > 0){
+      for(int p = 0; p < common.proc_count; ++p){
+        if(!common.buffers_empty(s,p) && try_flush(s,p,i,slack_left-1)){
+          return true;
+        }
+      }
+      for(int p = 0; p < common.proc_count; ++p){
+        if(pid >= 0 && p != pid) continue;
+        for(const Machine::PTransition *t : common.trans_per_cs[p][common.get(s,common.pcs[p])]){
+          if(pid >= 0 && matches(t->instruction,guide[i].instruction)) continue;
+          if(try_instr(s,t,false,i,slack_left-1)) return true;
+        }
+      }
+    }
+    return false;
+  };
+
+  std::vector<std::vector<data_t> > init = common.initial_states();
+  for(const std::vector<data_t> &s : init){
+    if(search(s.data(),0,slack)){
+      Trace *trace = new Trace(0);
+      for(const Machine::PTransition *t : path){
+        trace->push_back(*t,0);
+      }
+      return trace;
+    }
+  }
+  return 0;
+};
+
+void TsoBitReachability::test(){
+  std::function<Machine*(std::string)> get_machine =
+    [](std::string rmm){
+    std::stringstream ss(rmm);
+    PPLexer lex(ss);
+    return new Machine(Parser::p_test(lex));
+  };
+
+  std::function<Result*(const Machine&,model_t,int)> reach =
+    [](const Machine &m, model_t model, int k){
+    TsoBitReachability r;
+    Arg arg(m,model,k);
+    return r.reachability(&arg);
+  };
+
+  /* Returns true iff res reports that the search found no witness
+   * without hitting the buffer bound. */
+  std::function<bool(const Result*)> probably_unreachable =
+    [](const Result *res){
+    return res->result == FAILURE &&
+      res->failure_reason == "probably unreachable (hash compaction)";
+  };
+
+  /* Test 1: Dekker */
+  {
+    Machine *m = get_machine
+      ("forbidden CS CS\n"
+       "data\n"
+       "  x = 0 : [0:1]\n"
+       "  y = 0 : [0:1]\n"
+       "process\n"
+       "text\n"
+       "L1:\n"
+       "  write: x := 1;\n"
+       "  read: y = 0;\n"
+       "CS:\n"
+       "  write: x := 0;\n"
+       "  goto L1\n"
+       "process\n"
+       "text\n"
+       "L1:\n"
+       "  write: y := 1;\n"
+       "  read: x = 0;\n"
+       "CS:\n"
+       "  write: y := 0;\n"
+       "  goto L1\n"
+       );
+
+    Result *res = reach(*m,TSO,1);
+    bool trace_ok = res->trace && res->trace->size() >= 2;
+    Test::inner_test("#1.1 Dekker (TSO)",res->result == REACHABLE && trace_ok);
+    delete res;
+
+    res = reach(*m,PSO,2);
+    Test::inner_test("#1.2 Dekker (PSO)",res->result == REACHABLE);
+    delete res;
+
+    delete m;
+  }
+
+  /* Test 2: Dekker with fences */
+  {
+    Machine *m = get_machine
+      ("forbidden CS CS\n"
+       "data\n"
+       "  x = 0 : [0:1]\n"
+       "  y = 0 : [0:1]\n"
+       "process\n"
+       "text\n"
+       "L1:\n"
+       "  write: x := 1;\n"
+       "  fence;\n"
+       "  read: y = 0;\n"
+       "CS:\n"
+       "  write: x := 0;\n"
+       "  fence;\n"
+       "  goto L1\n"
+       "process\n"
+       "text\n"
+       "L1:\n"
+       "  locked write: y := 1;\n"
+       "  read: x = 0;\n"
+       "CS:\n"
+       "  locked write: y := 0;\n"
+       "  goto L1\n"
+       );
+
+    for(int k = 1; k <= 2; ++k){
+      Result *res = reach(*m,TSO,k);
+      std::stringstream ss;
+      ss << "#2." << k << " Fenced Dekker (TSO, k = " << k << ")";
+      Test::inner_test(ss.str(),probably_unreachable(res));
+      delete res;
+    }
+
+    Result *res = reach(*m,PSO,1);
+    Test::inner_test("#2.3 Fenced Dekker (PSO)",probably_unreachable(res));
+    delete res;
+
+    delete m;
+  }
+
+  /* Test 3: Message passing, which is allowed by PSO but not TSO */
+  {
+    Machine *m = get_machine
+      ("forbidden END END\n"
+       "data\n"
+       "  x = 0 : [0:1]\n"
+       "  y = 0 : [0:1]\n"
+       "process\n"
+       "text\n"
+       "  write: x := 1;\n"
+       "  write: y := 1;\n"
+       "END:\n"
+       "  nop\n"
+       "process\n"
+       "text\n"
+       "  read: y = 1;\n"
+       "  read: x = 0;\n"
+       "END:\n"
+       "  nop\n"
+       );
+
+    Result *res = reach(*m,TSO,2);
+    Test::inner_test("#3.1 MP (TSO)",probably_unreachable(res));
+    delete res;
+
+    res = reach(*m,PSO,1);
+    Test::inner_test("#3.2 MP (PSO)",res->result == REACHABLE);
+    delete res;
+
+    delete m;
+  }
+
+  /* Test 4: Buffer bound */
+  {
+    Machine *m = get_machine
+      ("forbidden END BAD\n"
+       "data\n"
+       "  x = 0 : [0:2]\n"
+       "process\n"
+       "text\n"
+       "  write: x := 1;\n"
+       "  write: x := 1;\n"
+       "END:\n"
+       "  nop\n"
+       "process\n"
+       "text\n"
+       "  read: x = 2;\n"
+       "BAD:\n"
+       "  nop\n"
+       );
+
+    Result *res = reach(*m,TSO,1);
+    Test::inner_test("#4.1 Bound (k = 1)",res->result == FAILURE &&
+                     res->failure_reason == "no witness within buffer bound 1");
+    delete res;
+
+    res = reach(*m,TSO,2);
+    Test::inner_test("#4.2 Bound (k = 2)",probably_unreachable(res));
+    delete res;
+
+    delete m;
+  }
+
+  /* Test 5: Locked block and wild initial values */
+  {
+    Machine *m = get_machine
+      ("forbidden END END\n"
+       "data\n"
+       "  x = * : [0:2]\n"
+       "process\n"
+       "registers\n"
+       "  $r = 0 : [0:2]\n"
+       "text\n"
+       "  locked{\n"
+       "    read: $r := x;\n"
+       "    write: x := 2\n"
+       "  };\n"
+       "  assume: $r = 1;\n"
+       "END:\n"
+       "  nop\n"
+       "process\n"
+       "text\n"
+       "  read: x = 2;\n"
+       "END:\n"
+       "  nop\n"
+       );
+
+    Result *res = reach(*m,TSO,1);
+    Test::inner_test("#5 Locked block",res->result == REACHABLE);
+    delete res;
+
+    delete m;
+  }
+
+  /* Test 6: Replaying a witness on synchronized variants */
+  {
+    std::function<std::string(std::string,std::string)> dekker =
+      [](std::string w0, std::string w1){
+      return
+        "forbidden CS CS\n"
+        "data\n"
+        "  x = 0 : [0:1]\n"
+        "  y = 0 : [0:1]\n"
+        "process\n"
+        "text\n"
+        "  " + w0 + "write: x := 1;\n"
+        "  read: y = 0;\n"
+        "CS:\n"
+        "  nop\n"
+        "process\n"
+        "text\n"
+        "  " + w1 + "write: y := 1;\n"
+        "  read: x = 0;\n"
+        "CS:\n"
+        "  nop\n";
+    };
+    Machine *m0 = get_machine(dekker("",""));
+    Machine *m1 = get_machine(dekker("","fence;\n  "));
+    Machine *m2 = get_machine(dekker("locked ","locked "));
+    Result *res = reach(*m0,TSO,1);
+    std::vector<Machine::PTransition> guide;
+    for(int i = 1; res->trace && i <= res->trace->size(); ++i){
+      guide.push_back(*(*res->trace)[i]);
+    }
+    Trace *t0 = replay(*m0,guide,0);
+    Trace *t1_exact = replay(*m1,guide,0);
+    Trace *t1 = replay(*m1,guide,1);
+    Trace *t2 = replay(*m2,guide,2);
+    Test::inner_test("#6 Replay",
+                     res->result == REACHABLE && t0 && t0->size() == res->trace->size() &&
+                     !t1_exact && t1 && !t2);
+    if(t0) delete t0;
+    if(t1_exact) delete t1_exact;
+    if(t1) delete t1;
+    if(t2) delete t2;
+    delete res;
+    delete m0;
+    delete m1;
+    delete m2;
+  }
+};
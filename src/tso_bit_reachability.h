@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TSO_BIT_REACHABILITY_H__
+#define __TSO_BIT_REACHABILITY_H__
+
+#include "reachability.h"
+
+#include <cstdint>
+#include <vector>
+
+/* TsoBitReachability implements a forward, explicit state
+ * reachability analysis under TSO or PSO with bounded store buffers.
+ *
+ * Under TSO each process has one store buffer. Under PSO each process
+ * has one store buffer per memory location. A buffer holds at most k
+ * pending writes, and a write that would overflow its buffer is not
+ * enabled. Hence every witness that is found is a real TSO (PSO)
+ * witness. The analysis never reports UNREACHABLE. When it finds no
+ * witness it reports FAILURE, with the reason "no witness within
+ * buffer bound k" if some write was disabled by a full buffer, and
+ * otherwise "probably unreachable (hash compaction)" (see below).
+ *
+ * Locked blocks are executed atomically, directly on memory, when
+ * all buffers of the executing process are empty.
+ *
+ * States are bit-packed into a fixed number of words, in the same
+ * manner as VipsBitConstraint. The visited set only stores a 64-bit
+ * hash of each state (hash compaction). A hash collision may cause a
+ * state to be wrongly considered visited, and its successors to be
+ * left unexplored. With n visited states, the probability that this
+ * happens at all is below n^2/2^65. The absence of a witness is
+ * therefore never a proof.
+ *
+ * Witness traces consist of the instructions of the machine, and
+ * update transitions for the writes leaving a buffer for memory.
+ */
+class TsoBitReachability : public Reachability{
+public:
+  enum model_t {
+    TSO,
+    PSO
+  };
+
+  class Arg : public Reachability::Arg{
+  public:
+    Arg(const Machine &m, model_t model, int k)
+      : Reachability::Arg(m), model(model), k(k) {};
+    /* The memory model */
+    model_t model;
+    /* The buffer bound. Pre: k >= 1 */
+    int k;
+  };
+
+  virtual ~TsoBitReachability(){};
+
+  /* If arg is a TsoBitReachability::Arg, then its memory model and
+   * buffer bound are used. Otherwise TSO with buffer bound 1 is
+   * used. */
+  virtual Result *reachability(Reachability::Arg *arg) const;
+  /* Searches for a TSO witness for m by replaying guide, a TSO
+   * witness trace for some machine m0 such that m is obtained from m0
+   * by inserting synchronization.
+   *
+   * The search is a bounded forward simulation of m which follows
+   * the instructions of guide in order. An instruction of guide is
+   * matched by an equal instruction of m, or by the same instruction
+   * in a locked block. A locked block of a single instruction in
+   * guide is also matched by that instruction alone, with the buffer
+   * flushed immediately before and after it, since SB witnesses show
+   * writes that are updated at once as locked writes. An update in
+   * guide flushes the oldest write
+   * in the buffer of its process, and is skipped when that buffer is
+   * empty. Before executing a fence or locked block, the buffer of
+   * the executing process is flushed. In addition, at most slack
+   * steps that do not follow guide are allowed: flushes of any
+   * buffer, and other instructions of the process of the next
+   * element of guide (of any process once guide has been
+   * followed to its end). At most max_states states are explored.
+   *
+   * Returns a witness trace for m if one is found, otherwise
+   * null. Every returned trace is a real TSO witness for m.
+   */
+  static Trace *replay(const Machine &m, const std::vector<Machine::PTransition> &guide,
+                       int slack, long max_states = 10000);
+
+  static void test();
+private:
+  typedef std::uint64_t data_t;
+  class Common;
+
+  /* A set of states, represented only by their hashes.
+   *
+   * Implemented as an open addressing hash table of 64-bit hashes.
+   */
+  class HashCompactSet{
+  public:
+    HashCompactSet();
+    /* Inserts the hash h. Returns true iff h was not already in the set. */
+    bool insert(data_t h);
+    long size() const { return count; };
+  private:
+    /* Slots containing 0 are empty. Hashes equal to 0 are stored as 1. */
+    std::vector<data_t> table;
+    long count;
+  };
+};
+
+#endif
@@ -94,12 +94,16 @@ namespace TsoFencins{
                         [&fs](const FenceSet &fs2){ return fs.includes(fs2); }) != end;
   }
 
+  VerdictCache *verdict_cache = 0;
+  std::string failure_reason;
+
   std::list<FenceSet> fencins(const Machine &m, Reachability &r,
                               reach_arg_init_t reach_arg_init,
                               bool only_one){
     std::list<FenceSet> queue;
     queue.push_back(FenceSet(m));
     std::list<FenceSet> complete;
+    failure_reason = "";
 
     Reachability::Result *result = 0;
     while(!queue.empty()){
@@ -108,14 +112,22 @@ namespace TsoFencins{
       queue.front().print(Log::msg,Log::null);
       Log::msg << std::endl;
 
-      Reachability::Arg *next_arg = reach_arg_init(queue.front().get_atomized_machine(),result);
-      Reachability::Result *tmp_result = r.reachability(next_arg);
-      delete next_arg;
-      if(result) delete result;
-      result = tmp_result;
-      Log::msg << result->to_string() << "\n" << std::flush;
+      const Machine &am = queue.front().get_atomized_machine();
+      Reachability::result_t verdict;
+      if(verdict_cache && verdict_cache->lookup(am,&verdict) && verdict == Reachability::UNREACHABLE){
+        Log::msg << "Unreachable according to verdict cache.\n" << std::flush;
+      }else{
+        Reachability::Arg *next_arg = reach_arg_init(am,result);
+        Reachability::Result *tmp_result = r.reachability(next_arg);
+        delete next_arg;
+        if(result) delete result;
+        result = tmp_result;
+        verdict = result->result;
+        if(verdict_cache && verdict != Reachability::FAILURE) verdict_cache->insert(am,verdict);
+        Log::msg << result->to_string() << "\n" << std::flush;
+      }
 
-      switch(result->result){
+      switch(verdict){
       case Reachability::REACHABLE:
         {
           Log::debug << " *** Error Trace (TSO) ***\n";
@@ -151,12 +163,15 @@ namespace TsoFencins{
         }
         break;
       case Reachability::FAILURE:
-        throw new std::logic_error("TsoFencins::fencins: FAILURE in underlying reachability analysis.");
+        /* Stop, and return the fence sets found so far */
+        failure_reason = result->failure_reason.size() ? result->failure_reason : "analysis failed";
+        Log::msg << "Reachability analysis failed (" << failure_reason << "). Stopping.\n";
+        queue.clear();
+        continue;
       }
       queue.pop_front();
     }
-    assert(result);
-    delete result;
+    if(result) delete result;
 
     return complete;
   };
@@ -27,9 +27,11 @@
 #include "tso_lock_sync.h"
 #include "trace.h"
 #include "tso_cycle.h"
+#include "verdict_cache.h"
 
 #include <list>
 #include <set>
+#include <string>
 
 namespace TsoFencins{
 
@@ -132,6 +134,20 @@ namespace TsoFencins{
    * analysis.
    */
   typedef std::function<Reachability::Arg*(const Machine&,const Reachability::Result*)> reach_arg_init_t;
+  /* If non-null, fencins consults and updates verdict_cache around
+   * every reachability analysis. Machines known to be unreachable
+   * are not analysed again.
+   *
+   * Default: 0.
+   */
+  extern VerdictCache *verdict_cache;
+  /* If the latest call to fencins was stopped by a failed
+   * reachability analysis (e.g. because its budget was exhausted),
+   * then failure_reason describes the failure, and the returned fence
+   * sets need not be all the fence sets. Otherwise failure_reason is
+   * empty.
+   */
+  extern std::string failure_reason;
   std::list<FenceSet> fencins(const Machine &m,
                               Reachability &r,
                               reach_arg_init_t reach_arg_init,
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "test.h"
+#include "valuation_batch.h"
+
+#include <cassert>
+
+ValuationBatch::ValuationBatch(const std::vector<int> &fixed,
+                               const std::vector<int> &wild,
+                               const std::vector<int> &lbs,
+                               const std::vector<int> &ubs)
+  : wild(wild), lbs(lbs), ubs(ubs), cur(lbs), done(false), sz(0),
+    data(fixed.size()*capacity), cols(fixed.size()) {
+  assert(wild.size() == lbs.size() && wild.size() == ubs.size());
+  for(unsigned r = 0; r < fixed.size(); ++r){
+    cols[r] = data.data() + r*capacity;
+    for(int j = 0; j < capacity; ++j){
+      data[r*capacity+j] = fixed[r];
+    }
+  }
+};
+
+bool ValuationBatch::next(){
+  if(done){
+    sz = 0;
+    return false;
+  }
+  int wc = int(wild.size());
+  int j = 0;
+  while(j < capacity && !done){
+    for(int k = 0; k < wc; ++k){
+      data[wild[k]*capacity+j] = cur[k];
+    }
+    ++j;
+    /* Increase cur */
+    int k = 0;
+    for(; k < wc; ++k){
+      if(cur[k] < ubs[k]){
+        ++cur[k];
+        break;
+      }
+      cur[k] = lbs[k];
+    }
+    done = (k >= wc);
+  }
+  sz = j;
+  return true;
+};
+
+void ValuationBatch::test(){
+  /* Test 1: No wild registers */
+  {
+    ValuationBatch vb({4,5},{},{},{});
+    bool first = vb.next();
+    bool ok = first && vb.size() == 1 && vb.value(0,0) == 4 && vb.value(1,0) == 5;
+    Test::inner_test("No wild registers",ok && !vb.next());
+  }
+
+  /* Test 2: All valuations are produced exactly once, over several
+   * batches */
+  {
+    const int n = 40;
+    ValuationBatch vb({7,0,0},{1,2},{0,-5},{n-1,n-6});
+    std::vector<int> seen(n*n,0);
+    int batches = 0;
+    bool ok = true;
+    while(vb.next()){
+      ++batches;
+      ok = ok && vb.size() > 0 && vb.size() <= capacity;
+      for(int j = 0; j < vb.size(); ++j){
+        int a = vb.columns()[1][j], b = vb.columns()[2][j] + 5;
+        ok = ok && vb.value(0,j) == 7 && 0 <= a && a < n && 0 <= b && b < n;
+        if(ok) ++seen[a*n+b];
+      }
+    }
+    for(int i = 0; i < n*n; ++i){
+      ok = ok && seen[i] == 1;
+    }
+    Test::inner_test("Batched enumeration",
+                     ok && batches == (n*n + capacity - 1) / capacity);
+  }
+};
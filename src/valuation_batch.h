@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __VALUATION_BATCH_H__
+#define __VALUATION_BATCH_H__
+
+#include <vector>
+
+/* A ValuationBatch enumerates all valuations of a number of
+ * registers, where some registers have fixed values and the others
+ * (the wild registers) range over finite intervals.
+ *
+ * The valuations are produced in batches of at most capacity
+ * valuations, in struct of arrays form, suitable for
+ * SyntaxString::eval_batch: After each successful call to next(),
+ * columns()[r][j] is the value of register r in valuation j of the
+ * batch, for 0 <= j < size().
+ *
+ * Example:
+ *
+ * ValuationBatch vb(fixed,wild,lbs,ubs);
+ * while(vb.next()){
+ *   e.eval_batch(vb.columns(),vb.size(),out);
+ *   ...
+ * }
+ */
+class ValuationBatch{
+public:
+  static const int capacity = 256;
+
+  /* Enumerate valuations of fixed.size() registers. Register r has
+   * value fixed[r], unless r == wild[k] for some k, in which case
+   * it ranges over the interval [lbs[k],ubs[k]].
+   *
+   * Pre: wild, lbs and ubs have the same length, and lbs[k] <= ubs[k]
+   * for all k.
+   */
+  ValuationBatch(const std::vector<int> &fixed,
+                 const std::vector<int> &wild,
+                 const std::vector<int> &lbs,
+                 const std::vector<int> &ubs);
+  ValuationBatch(const ValuationBatch&) = delete;
+  ValuationBatch &operator=(const ValuationBatch&) = delete;
+
+  /* Produce the next batch. Returns false if all valuations have
+   * already been produced. */
+  bool next();
+  /* The number of valuations in the current batch. */
+  int size() const { return sz; };
+  /* The columns of the current batch. */
+  const int *const *columns() const { return cols.data(); };
+  /* The value of register r in valuation j of the current batch. */
+  int value(int r, int j) const { return cols[r][j]; };
+
+  static void test();
+private:
+  std::vector<int> wild, lbs, ubs;
+  /* The values of the wild registers in the next valuation to be
+   * produced. */
+  std::vector<int> cur;
+  bool done;
+  int sz;
+  /* data holds capacity values for each register. cols[r] points
+   * into data. */
+  std::vector<int> data;
+  std::vector<const int*> cols;
+};
+
+#endif
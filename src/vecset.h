@@ -21,14 +21,25 @@
 #ifndef __VECSET_H__
 #define __VECSET_H__
 
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include <initializer_list>
 #include <string>
 #include <vector>
 
-/* A set, implemented as a sorted vector */
-template<class T> class VecSet{
+/* A set, implemented as a sorted vector.
+ *
+ * C is the type of the vector in which the elements are stored. It
+ * should provide the subset of the std::vector interface used by
+ * VecSet. For sets that are usually very small and exist in large
+ * numbers, a SmallVector (see smallvector.h) avoids allocating any
+ * heap memory.
+ *
+ * Sets with different storage types but the same element type can be
+ * compared, combined and converted into each other.
+ */
+template<class T, class C = std::vector<T> > class VecSet{
 public:
   /* An empty set */
   VecSet() {};
@@ -37,9 +48,13 @@ public:
    * Pre: v is sorted and distinct.
    */
   VecSet(const std::vector<T> &v)
-    : vec(v) {
+    : vec(v.begin(),v.end()) {
     assert(check_invariant());
   };
+  /* A set consisting of the elements of s. */
+  template<class C2>
+  VecSet(const VecSet<T,C2> &s)
+    : vec(s.vec.begin(),s.vec.end()) {};
   /* A set consisting of the values of [begin,end). Each element is
    * inserted using a separate call to insert.
    */
@@ -50,10 +65,9 @@ public:
   VecSet(VecSet &&) = default;
   VecSet &operator=(const VecSet&) = default;
   VecSet &operator=(VecSet&&) = default;
-  virtual ~VecSet() {};
   /* Returns a set which is the singleton {t}. */
   static VecSet singleton(const T &t){
-    VecSet<T> vs;
+    VecSet vs;
     vs.vec.push_back(t);
     return vs;
   };
@@ -69,7 +83,8 @@ public:
    * Return the number of elements that were inserted into this set
    * and was not already in this set.
    */
-  int insert(const VecSet<T> &s);
+  template<class C2>
+  int insert(const VecSet<T,C2> &s);
   /* Return 1 if t is in this set, 0 otherwise. */
   int count(const T &t) const;
   /* Return the index of t in the vector.
@@ -82,9 +97,11 @@ public:
   /* Empties this set */
   void clear() { vec.clear(); };
   /* Returns true iff all elements in this set are also members of s. */
-  bool subset_of(const VecSet<T> &s) const;
+  template<class C2>
+  bool subset_of(const VecSet<T,C2> &s) const;
   /* Returns true iff there is some element that occurs both in this set and in s. */
-  bool intersects(const VecSet<T> &s) const;
+  template<class C2>
+  bool intersects(const VecSet<T,C2> &s) const;
   /* Returns the i:th smallest element in the set. */
   const T &operator[](int i) const { return vec[i]; };
   class const_iterator{
@@ -100,7 +117,7 @@ public:
      *
      * Pre: 0 <= i <= vec.size()
      */
-    const_iterator(int i, const std::vector<T> &vec)
+    const_iterator(int i, const C &vec)
       : i(i), vec(vec) {
       assert(0 <= i && i <= int(vec.size()));
     };
@@ -138,17 +155,30 @@ public:
     };
   private:
     int i;
-    const std::vector<T> &vec;
+    const C &vec;
   };
   const_iterator begin() const { return const_iterator(0,vec); };
   const_iterator end() const { return const_iterator(vec.size(),vec); };
-  const std::vector<T> &get_vector() const { return vec; };
-  bool operator==(const VecSet<T> &s) const { return vec == s.vec; };
-  bool operator<(const VecSet<T> &s) const { return vec < s.vec; };
-  bool operator>(const VecSet<T> &s) const { return vec > s.vec; };
-  bool operator<=(const VecSet<T> &s) const { return vec <= s.vec; };
-  bool operator!=(const VecSet<T> &s) const { return vec != s.vec; };
-  bool operator>=(const VecSet<T> &s) const { return vec >= s.vec; };
+  const C &get_vector() const { return vec; };
+  /* Sets are compared lexicographically as sorted sequences. */
+  bool operator==(const VecSet &s) const { return equals(s); };
+  bool operator<(const VecSet &s) const { return less(s); };
+  bool operator>(const VecSet &s) const { return s.less(*this); };
+  bool operator<=(const VecSet &s) const { return !s.less(*this); };
+  bool operator!=(const VecSet &s) const { return !equals(s); };
+  bool operator>=(const VecSet &s) const { return !less(s); };
+  template<class C2>
+  bool operator==(const VecSet<T,C2> &s) const { return equals(s); };
+  template<class C2>
+  bool operator<(const VecSet<T,C2> &s) const { return less(s); };
+  template<class C2>
+  bool operator>(const VecSet<T,C2> &s) const { return s.less(*this); };
+  template<class C2>
+  bool operator<=(const VecSet<T,C2> &s) const { return !s.less(*this); };
+  template<class C2>
+  bool operator!=(const VecSet<T,C2> &s) const { return !equals(s); };
+  template<class C2>
+  bool operator>=(const VecSet<T,C2> &s) const { return !less(s); };
   /* Produces a string representation of the set with each element t
    * represented as f(t) without any new lines between the elements.
    */
@@ -158,7 +188,7 @@ private:
    *
    * Invariant: vec is sorted and distinct.
    */
-  std::vector<T> vec;
+  C vec;
   /* Return the index of the least element in the set which is greater than or equal to t.
    * Return vec.size() if there is no such element in the set.
    */
@@ -167,6 +197,15 @@ private:
    *
    * (Used for debugging.) */
   bool check_invariant() const;
+  template<class C2>
+  bool equals(const VecSet<T,C2> &s) const{
+    return vec.size() == s.vec.size() && std::equal(vec.begin(),vec.end(),s.vec.begin());
+  };
+  template<class C2>
+  bool less(const VecSet<T,C2> &s) const{
+    return std::lexicographical_compare(vec.begin(),vec.end(),s.vec.begin(),s.vec.end());
+  };
+  template<class T2, class C2> friend class VecSet;
 };
 
 #include "vecset.tcc"
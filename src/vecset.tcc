@@ -19,9 +19,9 @@
  */
 
 
-template<class T>
+template<class T, class C>
 template<typename ITER>
-VecSet<T>::VecSet(ITER begin, ITER end){
+VecSet<T,C>::VecSet(ITER begin, ITER end){
   for(; begin != end; ++begin){
     if(vec.size() && vec.back() < *begin){
       vec.push_back(*begin);
@@ -31,8 +31,8 @@ VecSet<T>::VecSet(ITER begin, ITER end){
   }
 };
 
-template<class T>
-VecSet<T>::VecSet(std::initializer_list<T> il){
+template<class T, class C>
+VecSet<T,C>::VecSet(std::initializer_list<T> il){
   for(auto it = il.begin(); it != il.end(); ++it){
     if(vec.size() && vec.back() < *it){
       vec.push_back(*it);
@@ -42,8 +42,8 @@ VecSet<T>::VecSet(std::initializer_list<T> il){
   }
 };
 
-template<class T>
-int VecSet<T>::find_geq(const T &t) const{
+template<class T, class C>
+int VecSet<T,C>::find_geq(const T &t) const{
   /* Use binary search */
   int a = 0;
   int b = vec.size();
@@ -60,8 +60,8 @@ int VecSet<T>::find_geq(const T &t) const{
   return a;
 };
 
-template<class T>
-int VecSet<T>::find(const T &t) const{
+template<class T, class C>
+int VecSet<T,C>::find(const T &t) const{
   int i = find_geq(t);
   if(i == int(vec.size()) || !(vec[i] == t)){
     return -1;
@@ -70,8 +70,8 @@ int VecSet<T>::find(const T &t) const{
   }
 };
 
-template<class T>
-int VecSet<T>::count(const T &t) const{
+template<class T, class C>
+int VecSet<T,C>::count(const T &t) const{
   if(find(t) >= 0){
     return 1;
   }else{
@@ -79,8 +79,8 @@ int VecSet<T>::count(const T &t) const{
   }
 };
 
-template<class T>
-std::pair<int,bool> VecSet<T>::insert(const T &t){
+template<class T, class C>
+std::pair<int,bool> VecSet<T,C>::insert(const T &t){
   int i = find_geq(t);
   if(i < int(vec.size()) && vec[i] == t){
     /* t is already in the set */
@@ -99,8 +99,9 @@ std::pair<int,bool> VecSet<T>::insert(const T &t){
   }
 };
 
-template<class T>
-int VecSet<T>::insert(const VecSet<T> &s){
+template<class T, class C>
+template<class C2>
+int VecSet<T,C>::insert(const VecSet<T,C2> &s){
   if(s.size() == 0){
     return 0;
   }else if(s.size() == 1){
@@ -155,8 +156,8 @@ int VecSet<T>::insert(const VecSet<T> &s){
   }
 };
 
-template<class T>
-bool VecSet<T>::check_invariant() const{
+template<class T, class C>
+bool VecSet<T,C>::check_invariant() const{
   for(unsigned i = 1; i < vec.size(); ++i){
     if(!(vec[i-1] < vec[i])){
       return false;
@@ -165,8 +166,8 @@ bool VecSet<T>::check_invariant() const{
   return true;
 };
 
-template<class T>
-std::string VecSet<T>::to_string_one_line(std::function<std::string(const T&)> &f) const{
+template<class T, class C>
+std::string VecSet<T,C>::to_string_one_line(std::function<std::string(const T&)> &f) const{
   std::string s = "{";
   for(unsigned i = 0; i < vec.size(); ++i){
     if(i != 0) s += ", ";
@@ -176,8 +177,9 @@ std::string VecSet<T>::to_string_one_line(std::function<std::string(const T&)> &
   return s;
 };
 
-template<class T>
-bool VecSet<T>::subset_of(const VecSet<T> &s) const{
+template<class T, class C>
+template<class C2>
+bool VecSet<T,C>::subset_of(const VecSet<T,C2> &s) const{
   if(vec.size() > s.vec.size()){
     return false;
   }
@@ -199,8 +201,9 @@ bool VecSet<T>::subset_of(const VecSet<T> &s) const{
   return true;
 };
 
-template<class T>
-bool VecSet<T>::intersects(const VecSet<T> &s) const{
+template<class T, class C>
+template<class C2>
+bool VecSet<T,C>::intersects(const VecSet<T,C2> &s) const{
   int a = 0; // pointer into vec
   int b = 0; // pointer into s.vec
   while(a < int(vec.size()) && b < int(s.vec.size())){
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "verdict_cache.h"
+#include "machine_image.h"
+#include "preprocessor.h"
+#include "test.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+VerdictCache::VerdictCache(const std::string &analysis)
+  : analysis(analysis), hits(0), misses(0) {
+};
+
+uint64_t VerdictCache::key(const Machine &m) const{
+  std::string s = analysis;
+  s += '\0';
+  s += MachineImage::canonical_string(m);
+  return MachineImage::checksum(s.data(),s.size());
+};
+
+bool VerdictCache::lookup(const Machine &m, Reachability::result_t *verdict){
+  auto it = verdicts.find(key(m));
+  if(it == verdicts.end()){
+    ++misses;
+    return false;
+  }
+  ++hits;
+  *verdict = it->second;
+  return true;
+};
+
+void VerdictCache::insert(const Machine &m, Reachability::result_t verdict){
+  if(verdict != Reachability::FAILURE){
+    verdicts[key(m)] = verdict;
+  }
+};
+
+void VerdictCache::load(const std::string &filename){
+  std::ifstream is(filename.c_str());
+  if(!is){
+    return;
+  }
+  std::string line;
+  if(!std::getline(is,line) || line != "memorax-verdict-cache 1"){
+    throw new Error("'"+filename+"' is not a verdict cache of a supported version.");
+  }
+  int lineno = 1;
+  while(std::getline(is,line)){
+    ++lineno;
+    if(line.empty()) continue;
+    std::stringstream ss(line);
+    uint64_t h;
+    std::string v;
+    if(!(ss >> std::hex >> h >> v) || (v != "reachable" && v != "unreachable")){
+      std::stringstream msg;
+      msg << "Malformed line " << lineno << " in '" << filename << "'.";
+      throw new Error(msg.str());
+    }
+    verdicts[h] = (v == "reachable") ? Reachability::REACHABLE : Reachability::UNREACHABLE;
+  }
+};
+
+void VerdictCache::save(const std::string &filename) const{
+  std::ofstream os(filename.c_str(),std::ios::out | std::ios::trunc);
+  if(!os){
+    throw new Error("Unable to open '"+filename+"' for writing.");
+  }
+  os << "memorax-verdict-cache 1\n";
+  for(auto it = verdicts.begin(); it != verdicts.end(); ++it){
+    char h[17];
+    std::snprintf(h,sizeof(h),"%016llx",(unsigned long long)it->first);
+    os << h << " " << (it->second == Reachability::REACHABLE ? "reachable" : "unreachable") << "\n";
+  }
+  if(!os){
+    throw new Error("Failed to write verdict cache to '"+filename+"'.");
+  }
+};
+
+void VerdictCache::test(){
+  std::function<Machine*(std::string)> get_machine =
+    [](std::string rmm){
+    std::stringstream ss(rmm);
+    PPLexer lex(ss);
+    return new Machine(Parser::p_test(lex));
+  };
+
+  const std::string rmm0 =
+    "forbidden CS CS\n"
+    "data\n"
+    "  x = 0 : [0:1]\n"
+    "  y = 0 : [0:1]\n"
+    "process\n"
+    "text\n"
+    "  write: x := 1;\n"
+    "  read: y = 0;\n"
+    "  CS: nop\n"
+    "process\n"
+    "text\n"
+    "  write: y := 1;\n"
+    "  read: x = 0;\n"
+    "  CS: nop\n";
+  /* Same as rmm0, but with different labels */
+  const std::string rmm1 =
+    "forbidden END END\n"
+    "data\n"
+    "  x = 0 : [0:1]\n"
+    "  y = 0 : [0:1]\n"
+    "process\n"
+    "text\n"
+    "  L0: write: x := 1;\n"
+    "  L1: read: y = 0;\n"
+    "  END: nop\n"
+    "process\n"
+    "text\n"
+    "  write: y := 1;\n"
+    "  M1: read: x = 0;\n"
+    "  END: nop\n";
+  /* Same as rmm0, but with a fence */
+  const std::string rmm2 =
+    "forbidden CS CS\n"
+    "data\n"
+    "  x = 0 : [0:1]\n"
+    "  y = 0 : [0:1]\n"
+    "process\n"
+    "text\n"
+    "  write: x := 1;\n"
+    "  fence;\n"
+    "  read: y = 0;\n"
+    "  CS: nop\n"
+    "process\n"
+    "text\n"
+    "  write: y := 1;\n"
+    "  read: x = 0;\n"
+    "  CS: nop\n";
+
+  Machine *m0 = get_machine(rmm0);
+  Machine *m1 = get_machine(rmm1);
+  Machine *m2 = get_machine(rmm2);
+
+  /* Test 1: Lookup and insert */
+  {
+    VerdictCache vc("sb");
+    Reachability::result_t r0 = Reachability::FAILURE, r1 = Reachability::FAILURE;
+    bool miss = !vc.lookup(*m0,&r0);
+    vc.insert(*m0,Reachability::REACHABLE);
+    bool hit0 = vc.lookup(*m0,&r0);
+    bool hit1 = vc.lookup(*m1,&r1);
+    Test::inner_test("Lookup and insert",
+                     miss && hit0 && hit1 && r0 == Reachability::REACHABLE && r1 == Reachability::REACHABLE &&
+                     vc.get_hits() == 2 && vc.get_misses() == 1);
+  }
+
+  /* Test 2: Different machines, analyses and failures */
+  {
+    VerdictCache vc("sb"), vc2("pb k=1");
+    Reachability::result_t r;
+    vc.insert(*m0,Reachability::REACHABLE);
+    vc2.insert(*m0,Reachability::UNREACHABLE);
+    vc.insert(*m2,Reachability::FAILURE);
+    bool ok = !vc.lookup(*m2,&r) && vc.size() == 1 &&
+      vc.lookup(*m0,&r) && r == Reachability::REACHABLE &&
+      vc2.lookup(*m0,&r) && r == Reachability::UNREACHABLE;
+    Test::inner_test("Distinguish machines and analyses",ok);
+  }
+
+  /* Test 3: Save and load */
+  {
+    VerdictCache vc("sb");
+    vc.insert(*m0,Reachability::REACHABLE);
+    vc.insert(*m2,Reachability::UNREACHABLE);
+    char tmp_file_name[] = "mmxvctestXXXXXX";
+    int fd = mkstemp(tmp_file_name);
+    bool ok = false;
+    if(fd != -1){
+      close(fd);
+      vc.save(tmp_file_name);
+      VerdictCache vc2("sb");
+      vc2.load(tmp_file_name);
+      Reachability::result_t r0, r2;
+      ok = vc2.size() == 2 &&
+        vc2.lookup(*m0,&r0) && r0 == Reachability::REACHABLE &&
+        vc2.lookup(*m2,&r2) && r2 == Reachability::UNREACHABLE;
+      unlink(tmp_file_name);
+    }
+    VerdictCache vc3("sb");
+    vc3.load(tmp_file_name); // Missing file
+    Test::inner_test("Save and load",ok && vc3.size() == 0);
+  }
+
+  delete m0;
+  delete m1;
+  delete m2;
+};
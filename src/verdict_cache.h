@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __VERDICT_CACHE_H__
+#define __VERDICT_CACHE_H__
+
+#include "machine.h"
+#include "reachability.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/* A VerdictCache remembers the outcomes of reachability analyses
+ * (REACHABLE or UNREACHABLE), so that fence insertion does not need
+ * to analyse a machine whose verdict is already known.
+ *
+ * Machines are identified by a hash of MachineImage::canonical_string,
+ * so machines which differ only in the numbering of control states
+ * or in printing information share their verdict. The hash also
+ * covers a description of the analysis, since different analyses
+ * (e.g. pb with different k) may give different verdicts for the same
+ * machine.
+ *
+ * The cache can be saved to and loaded from a file (set by the flag
+ * --verdict-cache), so that repeated runs over the same machines reuse
+ * earlier verdicts. Files are text, one verdict per line:
+ *
+ *   memorax-verdict-cache 1
+ *   <hash> reachable|unreachable
+ *
+ * where <hash> is 16 hexadecimal digits.
+ */
+class VerdictCache{
+public:
+  class Error : public std::exception{
+  public:
+    Error(std::string m) : msg("VerdictCache: "+m) {};
+    virtual ~Error() throw() {};
+    virtual const char *what() const throw() { return msg.c_str(); };
+  private:
+    std::string msg;
+  };
+
+  /* analysis describes the reachability analysis whose verdicts are
+   * cached. Verdicts recorded under different descriptions never
+   * match. */
+  VerdictCache(const std::string &analysis);
+  /* If a verdict for m is cached, assigns it to *verdict and returns
+   * true. Otherwise returns false. */
+  bool lookup(const Machine &m, Reachability::result_t *verdict);
+  /* Records verdict as the verdict for m. FAILURE is not recorded. */
+  void insert(const Machine &m, Reachability::result_t verdict);
+  /* Adds the verdicts in the file filename to this cache. A file that
+   * does not exist is treated as empty. Throws Error* if the file is
+   * malformed. */
+  void load(const std::string &filename);
+  /* Writes all verdicts in this cache to the file
+   * filename. Throws Error* on failure. */
+  void save(const std::string &filename) const;
+  int size() const { return verdicts.size(); };
+  /* The number of calls to lookup that found, respectively did not
+   * find, a verdict. */
+  int get_hits() const { return hits; };
+  int get_misses() const { return misses; };
+
+  static void test();
+private:
+  std::string analysis;
+  std::map<uint64_t,Reachability::result_t> verdicts;
+  int hits;
+  int misses;
+
+  uint64_t key(const Machine &m) const;
+};
+
+#endif
@@ -18,7 +18,10 @@
  *
  */
 
+#include "budget.h"
+#include "heartbeat.h"
 #include "preprocessor.h"
+#include "stats.h"
 #include "test.h"
 #include "vips_bit_reachability.h"
 
@@ -58,19 +61,55 @@ Reachability::Result *VipsBitReachability::reachability(Arg *arg) const{
     }
   }
 
+  Heartbeat heartbeat("VipsBitReachability");
+  Budget own_budget;
+  Budget &budget = arg->budget ? *arg->budget : own_budget;
+  /* The number of generated constraints that were already visited */
+  long revisited = 0;
   while(!found_forbidden && buf.size()){
-    const VipsBitConstraint *vbc = buf.pop();
+    Budget::exhausted_t exhausted = budget.check(result->generated_constraints);
+    if(exhausted != Budget::NOT_EXHAUSTED){
+      result->result = FAILURE;
+      result->failure_reason = Budget::to_string(exhausted);
+      break;
+    }
+    if(heartbeat.due()){
+      Heartbeat::sample_t s;
+      s.generated = result->generated_constraints;
+      s.queued = buf.size();
+      s.stored = visited.size();
+      s.subsumed = revisited;
+      heartbeat.beat(s);
+    }
+    const VipsBitConstraint *vbc;
+    {
+      Stats::Probe probe(Stats::POP);
+      vbc = buf.pop();
+    }
 
-    VecSet<const Machine::PTransition*> transes = vbc->partred(common);
+    VecSet<const Machine::PTransition*> transes;
+    {
+      Stats::Probe probe(Stats::PARTRED);
+      transes = vbc->partred(common);
+    }
 
     for(int i = 0; !found_forbidden && i < transes.size(); ++i){
-      VipsBitConstraint *child = vbc->post(common,*transes[i]);
+      VipsBitConstraint *child;
+      {
+        Stats::Probe probe(Stats::POST);
+        child = vbc->post(common,*transes[i]);
+      }
       if(child){
         ++result->generated_constraints;
-        if(visited.count(child)){
+        bool is_new;
+        {
+          Stats::Probe probe(Stats::VISITED);
+          is_new = visited.insert(std::make_pair(child,parent_t(transes[i],vbc))).second;
+        }
+        if(!is_new){
+          ++revisited;
           common.dealloc(child);
         }else{
-          visited[child] = parent_t(transes[i],vbc);
           buf.push(child);
           if(child->is_forbidden(common)){
             result->result = REACHABLE;
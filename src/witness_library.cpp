@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "witness_library.h"
+#include "log.h"
+#include "preprocessor.h"
+#include "test.h"
+#include "tso_bit_reachability.h"
+
+#include <sstream>
+#include <stdexcept>
+
+WitnessLibrary::WitnessLibrary(int capacity, int slack, long max_states)
+  : capacity(capacity), slack(slack), max_states(max_states), hits(0), misses(0) {
+};
+
+void WitnessLibrary::add(const Trace &t){
+  std::vector<Machine::PTransition> guide;
+  for(int i = 1; i <= t.size(); ++i){
+    guide.push_back(*t[i]);
+  }
+  guides.push_front(guide);
+  while(int(guides.size()) > capacity){
+    guides.pop_back();
+  }
+};
+
+Trace *WitnessLibrary::replay(const Machine &m){
+  for(auto it = guides.begin(); it != guides.end(); ++it){
+    Trace *t = 0;
+    try{
+      t = TsoBitReachability::replay(m,*it,slack,max_states);
+    }catch(std::logic_error *exc){
+      /* m is not supported by TsoBitReachability */
+      Log::debug << "WitnessLibrary: Unable to replay: " << exc->what() << "\n";
+      delete exc;
+      break;
+    }
+    if(t){
+      guides.splice(guides.begin(),guides,it);
+      ++hits;
+      return t;
+    }
+  }
+  ++misses;
+  return 0;
+};
+
+void WitnessLibrary::test(){
+  std::function<Machine*(std::string)> get_machine =
+    [](std::string rmm){
+    std::stringstream ss(rmm);
+    PPLexer lex(ss);
+    return new Machine(Parser::p_test(lex));
+  };
+
+  std::function<std::string(std::string,std::string)> dekker =
+    [](std::string s0, std::string s1){
+    return
+      "forbidden CS CS\n"
+      "data\n"
+      "  x = 0 : [0:1]\n"
+      "  y = 0 : [0:1]\n"
+      "process\n"
+      "text\n"
+      "  " + s0 + "write: x := 1;\n"
+      "  read: y = 0;\n"
+      "  CS: nop\n"
+      "process\n"
+      "text\n"
+      "  " + s1 + "write: y := 1;\n"
+      "  read: x = 0;\n"
+      "  CS: nop\n";
+  };
+
+  Machine *m0 = get_machine(dekker("",""));
+  Machine *m1 = get_machine(dekker("fence;\n  ",""));
+  Machine *m2 = get_machine(dekker("locked ","locked "));
+  TsoBitReachability r;
+  TsoBitReachability::Arg arg(*m0,TsoBitReachability::TSO,1);
+  Reachability::Result *res = r.reachability(&arg);
+
+  /* Test 1: Replay */
+  {
+    WitnessLibrary wl;
+    Trace *t0 = wl.replay(*m0);
+    if(res->trace) wl.add(*res->trace);
+    Trace *t1 = wl.replay(*m1);
+    Trace *t2 = wl.replay(*m2);
+    Test::inner_test("Replay",
+                     !t0 && t1 && !t2 && wl.get_hits() == 1 && wl.get_misses() == 2);
+    if(t1) delete t1;
+  }
+
+  /* Test 2: Capacity */
+  {
+    WitnessLibrary wl(2);
+    for(int i = 0; i < 3 && res->trace; ++i){
+      wl.add(*res->trace);
+    }
+    Test::inner_test("Capacity",wl.size() == 2);
+  }
+
+  delete res;
+  delete m0;
+  delete m1;
+  delete m2;
+};
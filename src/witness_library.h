@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018 Tuan Phong Ngo
+ *
+ * This file is part of Memorax.
+ *
+ * Memorax is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Memorax is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __WITNESS_LIBRARY_H__
+#define __WITNESS_LIBRARY_H__
+
+#include "machine.h"
+#include "trace.h"
+
+#include <list>
+#include <vector>
+
+/* A WitnessLibrary keeps the witness traces found during fence
+ * insertion, so that a later candidate can be refuted by replaying an
+ * earlier witness against it (see TsoBitReachability::replay) instead
+ * of by a full reachability analysis. Insufficient candidates tend to
+ * differ from an earlier one only by synchronization that the earlier
+ * witness can step around.
+ *
+ * The witnesses are replayed under TSO. Hence only witnesses of TSO
+ * analyses (sb, pb) should be added.
+ */
+class WitnessLibrary{
+public:
+  /* At most capacity witnesses are kept. slack and max_states are
+   * passed on to TsoBitReachability::replay. */
+  WitnessLibrary(int capacity = 8, int slack = 2, long max_states = 10000);
+  /* Stores the transitions of t. When the library is full, the
+   * witness that was least recently added or successfully replayed
+   * is dropped. */
+  void add(const Trace &t);
+  /* Tries to replay the stored witnesses on m, most recently useful
+   * first. Returns a witness trace for m, or null if none of the
+   * stored witnesses could be replayed. The caller takes ownership of
+   * the returned trace. */
+  Trace *replay(const Machine &m);
+  int size() const { return guides.size(); };
+  /* The number of calls to replay that did, respectively did not,
+   * return a witness. */
+  int get_hits() const { return hits; };
+  int get_misses() const { return misses; };
+
+  static void test();
+private:
+  int capacity;
+  int slack;
+  long max_states;
+  /* The stored witnesses, most recently useful first. */
+  std::list<std::vector<Machine::PTransition> > guides;
+  int hits;
+  int misses;
+};
+
+#endif
@@ -29,8 +29,12 @@
 
 #include "constraint.h"
 #include "lang.h"
+#include "expr_solver.h"
+#include "valuation_batch.h"
 #include "vecset.h"
 
+#include <set>
+
 template<class Z> class ZStar{
 public:
   /* The integer i. */
@@ -161,7 +165,9 @@ public:
      *      domain of register r in decls is finite.
      *
      * I.e. tries to instantiate any STAR in this vector such that e
-     * will evaluate to value.
+     * will evaluate to value. A STAR is kept wherever e does not
+     * constrain the register, and the domains are searched by
+     * interval propagation (see ExprSolver) rather than exhaustively.
      */
     VecSet<Vector> possible_regs(const Lang::Expr<int> &e, int value,
                                  const std::vector<Lang::VarDecl> &decls) const;
@@ -174,7 +180,9 @@ public:
      *      domain of register r in decls is finite.
      *
      * I.e. tries to instantiate any STAR in this vector such that b
-     * will evaluate to true.
+     * will evaluate to true. A STAR is kept wherever b does not
+     * constrain the register, and the domains are searched by
+     * interval propagation (see ExprSolver) rather than exhaustively.
      */
     VecSet<Vector> possible_regs(const Lang::BExpr<int> &b,
                                  const std::vector<Lang::VarDecl> &decls) const;
@@ -199,10 +207,33 @@ public:
     /* vec[0] is the reference counter. vec[1] is the number of
      * values in the vector. All subsequent entries in store are
      * values.
+     *
+     * The reference counter is updated atomically, so that copies
+     * of a vector may be shared between threads.
      */
     ZStar *vec;
 
+    void retain_vec();
     void release_vec();
+    /* Sets up the arguments for a ValuationBatch enumerating the
+     * instances of this vector: Each STAR register r is wild, and
+     * ranges over the domain given in decls[r], while all other
+     * registers are fixed. If regs is non-null, then only the STAR
+     * registers in *regs are wild, and the other STAR registers are
+     * fixed to an arbitrary value.
+     */
+    void instance_domains(const std::vector<Lang::VarDecl> &decls,
+                          const std::set<int> *regs,
+                          std::vector<int> &fixed, std::vector<int> &wild,
+                          std::vector<int> &lbs, std::vector<int> &ubs) const;
+    /* Finds the instances of this vector for which the expression
+     * e evaluates to value, using ExprSolver, and inserts them into
+     * res. Registers that are STAR in this vector are left STAR in
+     * the instances wherever e does not constrain them.
+     */
+    template<class E>
+    void solve(const E &e, int value, const std::vector<Lang::VarDecl> &decls,
+               VecSet<Vector> &res) const;
   };
 
   static void test();
@@ -126,7 +126,7 @@ template<class Z> inline ZStar<Z>::Vector::Vector(const std::vector<Z> &v){
 
 template<class Z> inline ZStar<Z>::Vector::Vector(const ZStar<Z>::Vector &v){
   vec = v.vec;
-  vec[0] = vec[0] + ZStar<Z>(1);
+  retain_vec();
   assert(int(vec[0]) > 1);
 };
 
@@ -146,7 +146,7 @@ ZStar<Z>::Vector::operator=(const ZStar<Z>::Vector &v){
     assert(int(v.vec[0]) > 0);
     release_vec();
     vec = v.vec;
-    vec[0] = vec[0] + ZStar<Z>(1);
+    retain_vec();
     assert(int(vec[0]) > 1);
   }
   return *this;
@@ -234,13 +234,16 @@ template<class Z> inline int ZStar<Z>::Vector::compare(const ZStar<Z>::Vector &v
 template<class Z> inline void ZStar<Z>::Vector::release_vec(){
   assert(vec != 0);
   assert(int(vec[0]) > 0);
-  vec[0] = vec[0] - ZStar<Z>(1);
-  if(vec[0].get_int() == 0){
+  if(__atomic_sub_fetch(&vec[0].z,1,__ATOMIC_ACQ_REL) == 0){
     delete[] vec;
   }
   vec = 0;
 };
 
+template<class Z> inline void ZStar<Z>::Vector::retain_vec(){
+  __atomic_add_fetch(&vec[0].z,1,__ATOMIC_RELAXED);
+};
+
 template<class Z> Constraint::Comparison 
 ZStar<Z>::Vector::entailment_compare(const ZStar<Z>::Vector &v) const{
   if(size() != v.size()){
@@ -272,41 +275,92 @@ template<class Z> std::string ZStar<Z>::Vector::to_string() const throw(){
 };
 
 template<class Z>
-VecSet<typename ZStar<Z>::Vector> 
-ZStar<Z>::Vector::possible_regs(const Lang::Expr<int> &e, int value,
-                                const std::vector<Lang::VarDecl> &decls) const{
-  VecSet<Vector> res;
-
-  std::vector<Z> v(size());
+void ZStar<Z>::Vector::instance_domains(const std::vector<Lang::VarDecl> &decls,
+                                        const std::set<int> *regs,
+                                        std::vector<int> &fixed, std::vector<int> &wild,
+                                        std::vector<int> &lbs, std::vector<int> &ubs) const{
+  fixed.assign(size(),0);
+  wild.clear();
+  lbs.clear();
+  ubs.clear();
   for(int i = 0; i < size(); ++i){
     if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      v[i] = decls[i].domain.get_lower_bound();
+      if(regs == 0 || regs->count(i)){
+        assert(decls[i].domain.is_finite());
+        wild.push_back(i);
+        lbs.push_back(decls[i].domain.get_lower_bound());
+        ubs.push_back(decls[i].domain.get_upper_bound());
+      }
     }else{
-      v[i] = (*this)[i].get_int();
+      fixed[i] = (*this)[i].get_int();
     }
   }
+};
 
-  while(true){
-    if(e.eval<std::vector<Z>,int*>(v,0) == value){
-      res.insert(Vector(v));
+template<class Z>
+template<class E>
+void ZStar<Z>::Vector::solve(const E &e, int value, const std::vector<Lang::VarDecl> &decls,
+                              VecSet<Vector> &res) const{
+  std::set<int> regs = e.get_registers();
+  std::vector<int> lbs(size(),0), ubs(size(),0);
+  for(int i = 0; i < size(); ++i){
+    if(!(*this)[i].is_wild()){
+      lbs[i] = ubs[i] = (*this)[i].get_int();
+    }else if(regs.count(i)){
+      assert(decls[i].domain.is_finite());
+      lbs[i] = decls[i].domain.get_lower_bound();
+      ubs[i] = decls[i].domain.get_upper_bound();
     }
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild()){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
+  }
+
+  ExprSolver::emit_t add_box =
+    [this,&decls,&regs,&res](const std::vector<int> &bl, const std::vector<int> &bu){
+    /* A register is left STAR if it is STAR in this vector and the
+     * box covers its whole domain. Registers with a partial interval
+     * are enumerated. */
+    std::vector<ZStar> v(size());
+    std::vector<int> enum_regs;
+    for(int i = 0; i < size(); ++i){
+      if(!(*this)[i].is_wild()){
+        v[i] = (*this)[i];
+      }else if(regs.count(i) == 0){
+        v[i] = STAR;
+      }else if(bl[i] == bu[i]){
+        v[i] = bl[i];
+      }else if(bl[i] == decls[i].domain.get_lower_bound() &&
+               bu[i] == decls[i].domain.get_upper_bound()){
+        v[i] = STAR;
+      }else{
+        enum_regs.push_back(i);
+        v[i] = bl[i];
+      }
+    }
+    while(true){
+      res.insert(Vector(v));
+      /* Increase enumerated values in v */
+      unsigned k = 0;
+      for(; k < enum_regs.size(); ++k){
+        int r = enum_regs[k];
+        if(v[r].get_int() < bu[r]){
+          v[r] = v[r].get_int() + 1;
           break;
         }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
+          v[r] = bl[r];
         }
       }
+      if(k >= enum_regs.size()) break;
     }
-    if(i >= size()) break;
-  }
+  };
+  ExprSolver::solve(e,value,lbs,ubs,add_box);
+};
+
 
+template<class Z>
+VecSet<typename ZStar<Z>::Vector> 
+ZStar<Z>::Vector::possible_regs(const Lang::Expr<int> &e, int value,
+                                const std::vector<Lang::VarDecl> &decls) const{
+  VecSet<Vector> res;
+  solve(e,value,decls,res);
   return res;
 };
 
@@ -315,37 +369,7 @@ VecSet<typename ZStar<Z>::Vector>
 ZStar<Z>::Vector::possible_regs(const Lang::BExpr<int> &b,
                                 const std::vector<Lang::VarDecl> &decls) const{
   VecSet<Vector> res;
-
-  std::vector<Z> v(size());
-  for(int i = 0; i < size(); ++i){
-    if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      v[i] = decls[i].domain.get_lower_bound();
-    }else{
-      v[i] = (*this)[i].get_int();
-    }
-  }
-
-  while(true){
-    if(b.eval<std::vector<Z>,int*>(v,0)){
-      res.insert(Vector(v));
-    }
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild()){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
-          break;
-        }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
-        }
-      }
-    }
-    if(i >= size()) break;
-  }
-
+  solve(b,1,decls,res);
   return res;
 };
 
@@ -366,33 +390,17 @@ template<class Z>
 VecSet<Z> ZStar<Z>::Vector::possible_values(const Lang::Expr<int> &e, 
                                             const std::vector<Lang::VarDecl> &decls) const{
   VecSet<Z> res;
-
-  std::vector<Z> v(size());
-  for(int i = 0; i < size(); ++i){
-    if((*this)[i].is_wild()){
-      assert(decls[i].domain.is_finite());
-      v[i] = decls[i].domain.get_lower_bound();
-    }else{
-      v[i] = (*this)[i].get_int();
-    }
-  }
-
-  while(true){
-    res.insert(e.eval<std::vector<Z>,int*>(v,0));
-    /* Increase wild values in v */
-    int i = 0;
-    for(; i < size(); ++i){
-      if((*this)[i].is_wild()){
-        if(v[i] < decls[i].domain.get_upper_bound()){
-          v[i] = v[i] + 1;
-          break;
-        }else{
-          assert(v[i] == decls[i].domain.get_upper_bound());
-          v[i] = decls[i].domain.get_lower_bound();
-        }
-      }
+  std::set<int> regs = e.get_registers();
+
+  std::vector<int> fixed, wild, lbs, ubs;
+  instance_domains(decls,&regs,fixed,wild,lbs,ubs);
+  ValuationBatch vb(fixed,wild,lbs,ubs);
+  int vals[ValuationBatch::capacity];
+  while(vb.next()){
+    e.eval_batch(vb.columns(),vb.size(),vals);
+    for(int j = 0; j < vb.size(); ++j){
+      res.insert(vals[j]);
     }
-    if(i >= size()) break;
   }
 
   return res;
@@ -562,6 +570,80 @@ template<class Z> void ZStar<Z>::test(){
     /* Test #3 (No solutions) */
     Test::inner_test("Test non-deterministic evaluation (#3)",
                      v0.possible_regs(e0,6,decls0) == VecSet<ZStar<int>::Vector>());
-    
+
+    /* Test #4 (Batch evaluation agrees with eval, over several
+     * batches) */
+    std::vector<Lang::VarDecl> decls4 = decls0;
+    for(int i = 0; i < 3; ++i){
+      decls4[i].domain = Lang::VarDecl::Domain(-4,5);
+    }
+    typedef Lang::Expr<int> E;
+    typedef Lang::BExpr<int> B;
+    E e4 = E::reg(0) - E::reg(1) + E::integer(2) - -E::reg(2);
+    B b4 = (B::lt(E::reg(0) + E::reg(1),E::reg(2)) && !B::eq(E::reg(0),E::reg(1))) ||
+      B::geq(E::reg(2),E::integer(4)) || (B::neq(E::reg(1),E::integer(2)) && B::tt() && !B::ff());
+    ZStar<int>::Vector v4(3);
+    VecSet<ZStar<int>::Vector> e4_regs, b4_regs;
+    VecSet<int> e4_values;
+    std::vector<int> v(3);
+    for(v[0] = -4; v[0] <= 5; ++v[0]){
+      for(v[1] = -4; v[1] <= 5; ++v[1]){
+        for(v[2] = -4; v[2] <= 5; ++v[2]){
+          int val = e4.eval<const std::vector<int>&,int*>(v,0);
+          e4_values.insert(val);
+          if(val == 1) e4_regs.insert(ZStar<int>::Vector(v));
+          if(b4.eval<const std::vector<int>&,int*>(v,0)) b4_regs.insert(ZStar<int>::Vector(v));
+        }
+      }
+    }
+    /* All instances of the vectors in vs, without STARs. Fails if
+     * vs contains overlapping vectors. */
+    std::function<bool(const VecSet<ZStar<int>::Vector>&,VecSet<ZStar<int>::Vector>&)> instances =
+      [](const VecSet<ZStar<int>::Vector> &vs, VecSet<ZStar<int>::Vector> &res)->bool{
+      int count = 0;
+      for(const ZStar<int>::Vector &w : vs){
+        std::vector<int> u(3);
+        for(u[0] = -4; u[0] <= 5; ++u[0]){
+          for(u[1] = -4; u[1] <= 5; ++u[1]){
+            for(u[2] = -4; u[2] <= 5; ++u[2]){
+              bool inst = true;
+              for(int i = 0; i < 3; ++i){
+                inst = inst && (w[i].is_wild() || w[i].get_int() == u[i]);
+              }
+              if(inst){
+                res.insert(ZStar<int>::Vector(u));
+                ++count;
+              }
+            }
+          }
+        }
+      }
+      return count == int(res.size());
+    };
+    VecSet<ZStar<int>::Vector> e4_inst, b4_inst;
+    Test::inner_test("Test non-deterministic evaluation (#4)",
+                     instances(v4.possible_regs(e4,1,decls4),e4_inst) && e4_inst == e4_regs &&
+                     instances(v4.possible_regs(b4,decls4),b4_inst) && b4_inst == b4_regs &&
+                     v4.possible_values(e4,decls4) == e4_values);
+
+    /* Test #5 (Unconstrained registers are left STAR) */
+    B b5 = B::eq(E::reg(0),E::integer(1)) || B::eq(E::reg(1),E::integer(2));
+    VecSet<ZStar<int>::Vector> vset5;
+    {
+      std::vector<ZStar<int> > w(3);
+      w[0] = 1;
+      vset5.insert(ZStar<int>::Vector(w));
+      w[1] = 2;
+      for(int i = -4; i <= 5; ++i){
+        if(i != 1){
+          w[0] = i;
+          vset5.insert(ZStar<int>::Vector(w));
+        }
+      }
+    }
+    Test::inner_test("Test non-deterministic evaluation (#5)",
+                     v4.possible_regs(b5,decls4) == vset5 &&
+                     v4.possible_regs(B::neq(E::reg(2),E::reg(2)+E::integer(1)),decls4) ==
+                     VecSet<ZStar<int>::Vector>::singleton(v4));
   }
 };